@@ -0,0 +1,225 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <xtt.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Compare the crypto providers built into the library, primitive by primitive,
+ * on the sizes a handshake and its records use.
+ */
+
+#define RECORD_LENGTH 1024
+#define SIGNED_LENGTH 200
+#define PRF_INPUT_LENGTH (64 + 24)
+
+struct operation {
+    const char *name;
+    int iterations;
+    int (*run)(void);
+};
+
+static int run_x25519(void);
+static int run_ed25519_sign(void);
+static int run_ed25519_verify(void);
+static int run_sha512(void);
+static int run_blake2b(void);
+static int run_prf_sha512(void);
+static int run_prf_blake2b(void);
+static int run_chacha_seal(void);
+static int run_aes256_seal(void);
+
+static const struct operation operations[] = {
+    {"x25519 keygen+dh", 2000, run_x25519},
+    {"ed25519 sign", 2000, run_ed25519_sign},
+    {"ed25519 verify", 2000, run_ed25519_verify},
+    {"sha512 1KB", 50000, run_sha512},
+    {"blake2b 1KB", 50000, run_blake2b},
+    {"prf sha512", 50000, run_prf_sha512},
+    {"prf blake2b", 50000, run_prf_blake2b},
+    {"chacha20poly1305 1KB", 50000, run_chacha_seal},
+    {"aes256gcm 1KB", 50000, run_aes256_seal},
+};
+
+#define OPERATION_COUNT (sizeof(operations) / sizeof(operations[0]))
+
+static const char *provider_names[] = {"libsodium", "openssl"};
+
+#define PROVIDER_COUNT (sizeof(provider_names) / sizeof(provider_names[0]))
+
+static unsigned char input[RECORD_LENGTH];
+static unsigned char output[RECORD_LENGTH];
+static unsigned char key[64];
+static unsigned char mac[16];
+static xtt_ed25519_pub_key ed25519_pub;
+static xtt_ed25519_priv_key ed25519_priv;
+static xtt_ed25519_signature ed25519_signature;
+static xtt_aes256_key_schedule aes256_schedule;
+
+static double now_us(void);
+
+static double operation_ns(const struct operation *operation);
+
+int main()
+{
+    const struct xtt_crypto_provider *providers[PROVIDER_COUNT];
+    double ns[OPERATION_COUNT][PROVIDER_COUNT];
+
+    for (size_t p = 0; p < PROVIDER_COUNT; ++p) {
+        providers[p] = xtt_crypto_find_provider(provider_names[p]);
+        if (NULL == providers[p])
+            continue;
+
+        if (0 != xtt_crypto_set_provider(providers[p])) {
+            fprintf(stderr, "Error initializing %s\n", provider_names[p]);
+            return 1;
+        }
+
+        // Keys etc. are made under each provider, since their AES key schedules differ.
+        xtt_crypto_get_random(input, sizeof(input));
+        xtt_crypto_get_random(key, sizeof(key));
+        if (0 != xtt_crypto_create_ed25519_key_pair(&ed25519_pub, &ed25519_priv)
+                || 0 != xtt_crypto_sign_ed25519(ed25519_signature.data, input, SIGNED_LENGTH, &ed25519_priv)) {
+            fprintf(stderr, "Error creating Ed25519 keys under %s\n", provider_names[p]);
+            return 1;
+        }
+        if (xtt_crypto_aead_aes256_is_available()
+                && 0 != xtt_crypto_aead_aes256_expand_key(&aes256_schedule, (const xtt_aes256_key*)key)) {
+            fprintf(stderr, "Error expanding AES-256 key under %s\n", provider_names[p]);
+            return 1;
+        }
+
+        for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+            ns[i][p] = operation_ns(&operations[i]);
+            if (ns[i][p] < -1) {
+                fprintf(stderr, "Error running %s under %s\n", operations[i].name, provider_names[p]);
+                return 1;
+            }
+        }
+    }
+
+    printf("%22s", "ns/op");
+    for (size_t p = 0; p < PROVIDER_COUNT; ++p)
+        printf(" %12s", provider_names[p]);
+    printf("\n");
+
+    for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+        printf("%22s", operations[i].name);
+        for (size_t p = 0; p < PROVIDER_COUNT; ++p) {
+            if (NULL == providers[p]) {
+                printf(" %12s", "not built");
+            } else if (ns[i][p] < 0) {
+                printf(" %12s", "unavailable");
+            } else {
+                printf(" %12.0f", ns[i][p]);
+            }
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
+
+int run_x25519(void)
+{
+    xtt_x25519_pub_key pub;
+    xtt_x25519_priv_key priv;
+    if (0 != xtt_crypto_create_x25519_key_pair(&pub, &priv))
+        return -1;
+
+    return xtt_crypto_do_x25519_diffie_hellman(output, &priv, &pub);
+}
+
+int run_ed25519_sign(void)
+{
+    return xtt_crypto_sign_ed25519(output, input, SIGNED_LENGTH, &ed25519_priv);
+}
+
+int run_ed25519_verify(void)
+{
+    return xtt_crypto_verify_ed25519(ed25519_signature.data, input, SIGNED_LENGTH, &ed25519_pub);
+}
+
+int run_sha512(void)
+{
+    uint16_t out_length;
+    return xtt_crypto_hash_sha512(output, &out_length, input, RECORD_LENGTH);
+}
+
+int run_blake2b(void)
+{
+    uint16_t out_length;
+    return xtt_crypto_hash_blake2b(output, &out_length, input, RECORD_LENGTH);
+}
+
+int run_prf_sha512(void)
+{
+    return xtt_crypto_prf_sha512(output, 32, input, PRF_INPUT_LENGTH, key, sizeof(key));
+}
+
+int run_prf_blake2b(void)
+{
+    return xtt_crypto_prf_blake2b(output, 32, input, PRF_INPUT_LENGTH, key, sizeof(key));
+}
+
+int run_chacha_seal(void)
+{
+    static const xtt_chacha_nonce nonce;
+    return xtt_crypto_aead_chacha_encrypt_detached(output, mac, input, RECORD_LENGTH, NULL, 0,
+                                                   &nonce, (const xtt_chacha_key*)key);
+}
+
+int run_aes256_seal(void)
+{
+    static const xtt_aes256_nonce nonce;
+    return xtt_crypto_aead_aes256_encrypt_detached_expanded(output, mac, input, RECORD_LENGTH, NULL, 0,
+                                                            &nonce, &aes256_schedule);
+}
+
+double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+/*
+ * return:
+ *      ns per operation
+ *      -1 if the operation isn't available under the current provider
+ *      -2 on error
+ */
+double operation_ns(const struct operation *operation)
+{
+    if (run_aes256_seal == operation->run && !xtt_crypto_aead_aes256_is_available())
+        return -1;
+
+    double start = now_us();
+    for (int i = 0; i < operation->iterations; ++i) {
+        if (0 != operation->run())
+            return -2;
+    }
+
+    return 1000 * (now_us() - start) / operation->iterations;
+}
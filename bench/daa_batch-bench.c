@@ -0,0 +1,194 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <xtt.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Compare the per-signature cost of verifying DAA signatures one at a time
+ * against verifying them as a batch, for batch sizes from 1 to 256.
+ */
+
+#define MAX_BATCH_SIZE 256
+#define SIGNATURES_PER_MEASUREMENT 1024
+
+xtt_daa_group_pub_key_lrsw gpk = {.data={
+    0x04, 0x27, 0xd4, 0x35, 0xbf, 0xc7, 0x1d, 0x4a, 0x42, 0xb1, 0xd2, 0x26,
+    0x25, 0x54, 0xfe, 0x12, 0x54, 0x84, 0xbc, 0x67, 0x2e, 0xe7, 0xfb, 0x68,
+    0xf7, 0x00, 0xb3, 0x7f, 0x2a, 0xb4, 0x91, 0x61, 0xb8, 0xd3, 0xed, 0x78,
+    0x53, 0x42, 0x26, 0x26, 0x48, 0x27, 0xaf, 0x66, 0xfe, 0xcf, 0xfb, 0xb3,
+    0x8d, 0xd0, 0xcc, 0x76, 0xff, 0x23, 0x38, 0x36, 0xc4, 0x9b, 0x5a, 0xfa,
+    0x58, 0x0c, 0x70, 0x34, 0xca, 0xb4, 0xf5, 0xf7, 0xfd, 0x9d, 0x06, 0x7e,
+    0xc7, 0xad, 0x6e, 0xb4, 0x7a, 0x92, 0x1a, 0xd4, 0x08, 0x27, 0xee, 0xdd,
+    0xf2, 0xf6, 0x82, 0xf6, 0x94, 0x50, 0xdd, 0xba, 0xec, 0x99, 0x37, 0xca,
+    0x11, 0x76, 0x80, 0xf7, 0xdc, 0xe8, 0xd9, 0x20, 0x0b, 0xa6, 0x99, 0xa7,
+    0x11, 0x6c, 0xf4, 0xc2, 0x5a, 0x34, 0x05, 0x52, 0x1e, 0x19, 0x30, 0x40,
+    0xa1, 0x0e, 0xe9, 0x10, 0x4d, 0xd5, 0xc0, 0x18, 0xdf, 0x04, 0xee, 0x9c,
+    0x97, 0x24, 0xaf, 0x83, 0xe6, 0x5a, 0x91, 0xcc, 0x0f, 0xcf, 0x5c, 0xfe,
+    0xa9, 0x34, 0x39, 0x81, 0x4d, 0xfe, 0x05, 0xc8, 0xca, 0x0c, 0xd8, 0x5e,
+    0xf0, 0x55, 0xad, 0xf8, 0x1d, 0xd0, 0xf1, 0xd1, 0x3b, 0x90, 0x61, 0xac,
+    0x82, 0x12, 0xfb, 0x07, 0x78, 0xee, 0xdb, 0xd6, 0x2e, 0xd7, 0xe0, 0x16,
+    0x89, 0xe1, 0x27, 0x8f, 0xac, 0xde, 0xcd, 0x71, 0x39, 0xe7, 0xec, 0x88,
+    0x01, 0xa8, 0xdb, 0xc8, 0xa7, 0x8e, 0x36, 0x90, 0xce, 0xd2, 0x1e, 0x32,
+    0x79, 0xc4, 0x6a, 0x88, 0x3c, 0x8a, 0xe5, 0x63, 0xb0, 0xd6, 0xb1, 0x31,
+    0x9d, 0x23, 0x19, 0x2a, 0xc2, 0x94, 0xb6, 0x7d, 0xc0, 0x0e, 0xd3, 0xfb,
+    0x96, 0xbd, 0xe6, 0x48, 0xec, 0xe3, 0x20, 0xee, 0xd1, 0x0d, 0x5a, 0x93,
+    0x15, 0x8c, 0xdb, 0x2d, 0x93, 0xec, 0xff, 0x0f, 0x20, 0x9f, 0x6e, 0xfd,
+    0x05, 0x3a, 0x18, 0xe3, 0xf6, 0xd8
+}};
+
+xtt_daa_credential_lrsw cred = {.data={
+    0x04, 0xe1, 0x63, 0x6e, 0x34, 0x7c, 0x7f, 0xbc, 0x41, 0xc2, 0x0b, 0xf5,
+    0x28, 0x7d, 0xb8, 0xb9, 0xbd, 0x77, 0x89, 0xb7, 0x3e, 0x0b, 0xda, 0x91,
+    0xe1, 0xe1, 0x90, 0x1c, 0xcf, 0x06, 0x6f, 0xb0, 0x10, 0xd7, 0xab, 0x7a,
+    0x3b, 0x8f, 0x29, 0x5a, 0xb3, 0x10, 0xd2, 0xba, 0xed, 0x57, 0x98, 0xed,
+    0x2c, 0x2c, 0xa0, 0x4d, 0xa0, 0x2f, 0xfc, 0x03, 0x85, 0xd6, 0xc7, 0x08,
+    0xfe, 0xfd, 0xab, 0x37, 0x5c, 0x04, 0xa4, 0x65, 0x2b, 0xf6, 0xa6, 0xb0,
+    0x75, 0xda, 0x3b, 0xc7, 0x4d, 0x11, 0x0e, 0xa5, 0x22, 0x3b, 0x64, 0xcc,
+    0x28, 0x3f, 0x8e, 0xc4, 0x91, 0x65, 0x25, 0xa8, 0x7e, 0x36, 0x67, 0xa4,
+    0x53, 0xed, 0x42, 0xda, 0xbd, 0xdc, 0x49, 0xfe, 0xe9, 0xb0, 0x0a, 0x0c,
+    0x76, 0x3c, 0x52, 0xae, 0xb1, 0x00, 0xb4, 0xa1, 0x90, 0x7c, 0xcc, 0x4e,
+    0xe8, 0xe2, 0x4e, 0xb9, 0xf7, 0xa4, 0x91, 0xa7, 0xd1, 0x57, 0x04, 0x8a,
+    0x71, 0x60, 0xca, 0x86, 0xf8, 0xc4, 0x67, 0x79, 0x68, 0x8c, 0x19, 0x59,
+    0xf2, 0xb1, 0x58, 0x4e, 0xbe, 0x7a, 0xbb, 0xc5, 0x87, 0x2f, 0xbf, 0xed,
+    0xe1, 0x6b, 0xba, 0xf1, 0xe0, 0x3b, 0xf6, 0x5f, 0xca, 0x23, 0xfa, 0x78,
+    0xb9, 0x89, 0x91, 0xbd, 0x3a, 0x51, 0x1b, 0x0a, 0xbe, 0x7c, 0x1a, 0xdb,
+    0x2a, 0xef, 0xc7, 0xb8, 0x5d, 0xbd, 0x51, 0xd5, 0x4d, 0x00, 0x5c, 0x7d,
+    0x7a, 0xc4, 0xd1, 0x04, 0xd6, 0x53, 0xc8, 0xc3, 0x8f, 0xc9, 0xfb, 0x26,
+    0xa8, 0xc8, 0xb7, 0xf6, 0x7f, 0x58, 0xb4, 0x64, 0x05, 0x8c, 0x1b, 0x8c,
+    0xea, 0x26, 0x8f, 0x1c, 0x81, 0xcf, 0xb6, 0x37, 0x7b, 0x6b, 0x11, 0x36,
+    0xa9, 0x9a, 0xd1, 0x0c, 0xf3, 0xfd, 0xc3, 0xe3, 0x9e, 0x72, 0x41, 0x97,
+    0x51, 0x18, 0xca, 0x24, 0x29, 0xf2, 0xa4, 0x6f, 0xd5, 0x50, 0x30, 0x98,
+    0x15, 0x68, 0x84, 0xf7, 0x2b, 0x5a, 0x80, 0x39
+}};
+
+xtt_daa_priv_key_lrsw daa_priv_key = {.data={
+    0x0b, 0x8a, 0x76, 0xe0, 0xbf, 0x23, 0xf2, 0x1a, 0x5b, 0x54, 0x7d, 0x8c,
+    0x97, 0xcf, 0x3f, 0xa0, 0xae, 0x72, 0xb6, 0x60, 0x29, 0x10, 0x18, 0x14,
+    0x61, 0xb6, 0x58, 0x6a, 0x44, 0x97, 0xa1, 0xf7
+}};
+
+static const char *basename = "BASENAME";
+
+static unsigned char signatures[MAX_BATCH_SIZE][sizeof(xtt_daa_signature_lrsw)];
+static unsigned char msgs[MAX_BATCH_SIZE][64];
+static struct xtt_daa_verify_item items[MAX_BATCH_SIZE];
+static int results[MAX_BATCH_SIZE];
+
+static double now_us(void);
+
+static double one_at_a_time_us(uint16_t batch_size, struct xtt_daa_group_public_key_context *gpk_ctx);
+
+static double batched_us(uint16_t batch_size, struct xtt_daa_group_public_key_context *gpk_ctx);
+
+int main()
+{
+    uint16_t basename_len = (uint16_t)strlen(basename);
+
+    if (0 != xtt_crypto_initialize_crypto()) {
+        fprintf(stderr, "Error initializing crypto\n");
+        return 1;
+    }
+
+    struct xtt_daa_group_public_key_context gpk_ctx;
+    if (XTT_ERROR_SUCCESS != xtt_initialize_daa_group_public_key_context_lrsw(&gpk_ctx,
+                                                                              (unsigned char*)basename,
+                                                                              basename_len,
+                                                                              &gpk)) {
+        fprintf(stderr, "Error initializing group public key context\n");
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_BATCH_SIZE; ++i) {
+        xtt_crypto_get_random(msgs[i], sizeof(msgs[i]));
+        if (0 != xtt_daa_sign_lrsw(signatures[i],
+                                   msgs[i],
+                                   sizeof(msgs[i]),
+                                   (unsigned char*)basename,
+                                   basename_len,
+                                   &cred,
+                                   &daa_priv_key)) {
+            fprintf(stderr, "Error creating DAA signature\n");
+            return 1;
+        }
+        items[i] = (struct xtt_daa_verify_item){.signature=signatures[i],
+                                                .msg=msgs[i],
+                                                .msg_len=sizeof(msgs[i]),
+                                                .basename=(unsigned char*)basename,
+                                                .basename_len=basename_len};
+    }
+
+    printf("%10s %20s %20s %10s\n", "batch_size", "one_at_a_time(us)", "batched(us)", "speedup");
+    for (uint16_t batch_size = 1; batch_size <= MAX_BATCH_SIZE; batch_size *= 2) {
+        double single = one_at_a_time_us(batch_size, &gpk_ctx);
+        double batched = batched_us(batch_size, &gpk_ctx);
+        if (single < 0 || batched < 0) {
+            fprintf(stderr, "Error verifying signatures\n");
+            return 1;
+        }
+
+        printf("%10u %20.1f %20.1f %9.2fx\n", batch_size, single, batched, single / batched);
+    }
+
+    return 0;
+}
+
+double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+double one_at_a_time_us(uint16_t batch_size, struct xtt_daa_group_public_key_context *gpk_ctx)
+{
+    int rounds = SIGNATURES_PER_MEASUREMENT / batch_size;
+
+    double start = now_us();
+    for (int round = 0; round < rounds; ++round) {
+        for (uint16_t i = 0; i < batch_size; ++i) {
+            if (XTT_ERROR_SUCCESS != gpk_ctx->verify_signature(items[i].signature,
+                                                               items[i].msg,
+                                                               items[i].msg_len,
+                                                               gpk_ctx))
+                return -1;
+        }
+    }
+
+    return (now_us() - start) / (rounds * batch_size);
+}
+
+double batched_us(uint16_t batch_size, struct xtt_daa_group_public_key_context *gpk_ctx)
+{
+    int rounds = SIGNATURES_PER_MEASUREMENT / batch_size;
+
+    double start = now_us();
+    for (int round = 0; round < rounds; ++round) {
+        if (XTT_ERROR_SUCCESS != xtt_batch_verify_daa_signatures(results, items, batch_size, gpk_ctx))
+            return -1;
+    }
+
+    return (now_us() - start) / (rounds * batch_size);
+}
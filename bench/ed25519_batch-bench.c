@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <xtt.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Compare the per-signature cost of verifying Ed25519 signatures one at a time
+ * against verifying them as a batch, for batch sizes from 1 to 256.
+ */
+
+#define MAX_BATCH_SIZE 256
+#define SIGNATURES_PER_MEASUREMENT 4096
+
+static xtt_ed25519_pub_key pub_keys[MAX_BATCH_SIZE];
+static xtt_ed25519_signature signatures[MAX_BATCH_SIZE];
+static unsigned char msgs[MAX_BATCH_SIZE][64];
+static struct xtt_ed25519_verify_item items[MAX_BATCH_SIZE];
+static int results[MAX_BATCH_SIZE];
+
+static double now_us(void);
+
+static double one_at_a_time_us(uint16_t batch_size);
+
+static double batched_us(uint16_t batch_size);
+
+int main()
+{
+    if (0 != xtt_crypto_initialize_crypto()) {
+        fprintf(stderr, "Error initializing crypto\n");
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_BATCH_SIZE; ++i) {
+        xtt_ed25519_priv_key priv_key;
+        xtt_crypto_get_random(msgs[i], sizeof(msgs[i]));
+        if (0 != xtt_crypto_create_ed25519_key_pair(&pub_keys[i], &priv_key)
+                || 0 != xtt_crypto_sign_ed25519(signatures[i].data, msgs[i], sizeof(msgs[i]), &priv_key)) {
+            fprintf(stderr, "Error creating Ed25519 signature\n");
+            return 1;
+        }
+        items[i] = (struct xtt_ed25519_verify_item){.signature=signatures[i].data,
+                                                    .msg=msgs[i],
+                                                    .msg_len=sizeof(msgs[i]),
+                                                    .pub_key=&pub_keys[i]};
+    }
+
+    printf("%10s %20s %20s %10s\n", "batch_size", "one_at_a_time(us)", "batched(us)", "speedup");
+    for (uint16_t batch_size = 1; batch_size <= MAX_BATCH_SIZE; batch_size *= 2) {
+        double single = one_at_a_time_us(batch_size);
+        double batched = batched_us(batch_size);
+        if (single < 0 || batched < 0) {
+            fprintf(stderr, "Error verifying signatures\n");
+            return 1;
+        }
+
+        printf("%10u %20.1f %20.1f %9.2fx\n", batch_size, single, batched, single / batched);
+    }
+
+    return 0;
+}
+
+double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+double one_at_a_time_us(uint16_t batch_size)
+{
+    int rounds = SIGNATURES_PER_MEASUREMENT / batch_size;
+
+    double start = now_us();
+    for (int round = 0; round < rounds; ++round) {
+        for (uint16_t i = 0; i < batch_size; ++i) {
+            if (0 != xtt_crypto_verify_ed25519(items[i].signature,
+                                               items[i].msg,
+                                               items[i].msg_len,
+                                               items[i].pub_key))
+                return -1;
+        }
+    }
+
+    return (now_us() - start) / (rounds * batch_size);
+}
+
+double batched_us(uint16_t batch_size)
+{
+    int rounds = SIGNATURES_PER_MEASUREMENT / batch_size;
+
+    double start = now_us();
+    for (int round = 0; round < rounds; ++round) {
+        if (0 != xtt_crypto_batch_verify_ed25519(results, items, batch_size))
+            return -1;
+    }
+
+    return (now_us() - start) / (rounds * batch_size);
+}
@@ -0,0 +1,1073 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <xtt.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Load-test the server engine with simulated clients, all in this process.
+ *
+ * Client threads each drive a share of the clients through Identity handshakes, back-to-back.
+ * Messages travel between the clients and the server over lock-free in-memory channels
+ * (no sockets), so the results show how the server itself scales
+ * with its number of worker threads and of concurrent clients.
+ *
+ * For each (server threads, clients) point, this reports handshakes/second,
+ * latency histograms of each request/response round-trip and of whole handshakes,
+ * and the server's CPU time per handshake. The server's CPU time is that of the engine's workers only:
+ * the simulated clients, and the thread feeding the engine from its channel, aren't counted.
+ *
+ * If the library was built with XTT_ENABLE_STATS, its per-phase latencies and error counts
+ * (for the clients and the server together) are printed at the end.
+ *
+ * usage: handshake_load-bench [-t max_server_threads] [-n max_clients] [-c client_threads]
+ *                             [-d seconds] [-s suite_spec] [-v] [-j json_path]
+ *
+ *      -t  Server threads are doubled from 1 up to this, per engine stage (default: half the CPUs).
+ *      -n  Clients are quadrupled from 1 up to this (default: 64).
+ *      -c  Threads running the simulated clients (default: half the CPUs).
+ *      -d  Seconds measured at each point, after a short warm-up (default: 2).
+ *      -s  Numeric xtt_suite_spec to handshake with (default: 1).
+ *      -v  Also print the latency histograms.
+ *      -j  Also write the results there as JSON ("-" for stdout).
+ */
+
+#define MAX_CLIENTS 1024
+#define MAX_CLIENT_THREADS 64
+#define MAX_POINTS 64
+#define MAX_MESSAGE_LENGTH 1024
+#define CHANNEL_CAPACITY MAX_CLIENTS    // Each client has at most one message in flight.
+#define CHANNEL_MASK (CHANNEL_CAPACITY - 1)
+#define WARMUP_MS 500
+#define COOKIE_ROTATION_MS 1000
+#define IDLE_YIELDS 64
+#define IDLE_SLEEP_NS 20000
+#define HISTOGRAM_SUB_BUCKETS 4         // Per power of two.
+#define HISTOGRAM_BUCKETS 160           // Up to 2^40ns.
+
+typedef char channel_capacity_is_power_of_two[(0 == (CHANNEL_CAPACITY & CHANNEL_MASK)) ? 1 : -1];
+
+xtt_daa_group_pub_key_lrsw gpk = {.data={
+    0x04, 0x27, 0xd4, 0x35, 0xbf, 0xc7, 0x1d, 0x4a, 0x42, 0xb1, 0xd2, 0x26,
+    0x25, 0x54, 0xfe, 0x12, 0x54, 0x84, 0xbc, 0x67, 0x2e, 0xe7, 0xfb, 0x68,
+    0xf7, 0x00, 0xb3, 0x7f, 0x2a, 0xb4, 0x91, 0x61, 0xb8, 0xd3, 0xed, 0x78,
+    0x53, 0x42, 0x26, 0x26, 0x48, 0x27, 0xaf, 0x66, 0xfe, 0xcf, 0xfb, 0xb3,
+    0x8d, 0xd0, 0xcc, 0x76, 0xff, 0x23, 0x38, 0x36, 0xc4, 0x9b, 0x5a, 0xfa,
+    0x58, 0x0c, 0x70, 0x34, 0xca, 0xb4, 0xf5, 0xf7, 0xfd, 0x9d, 0x06, 0x7e,
+    0xc7, 0xad, 0x6e, 0xb4, 0x7a, 0x92, 0x1a, 0xd4, 0x08, 0x27, 0xee, 0xdd,
+    0xf2, 0xf6, 0x82, 0xf6, 0x94, 0x50, 0xdd, 0xba, 0xec, 0x99, 0x37, 0xca,
+    0x11, 0x76, 0x80, 0xf7, 0xdc, 0xe8, 0xd9, 0x20, 0x0b, 0xa6, 0x99, 0xa7,
+    0x11, 0x6c, 0xf4, 0xc2, 0x5a, 0x34, 0x05, 0x52, 0x1e, 0x19, 0x30, 0x40,
+    0xa1, 0x0e, 0xe9, 0x10, 0x4d, 0xd5, 0xc0, 0x18, 0xdf, 0x04, 0xee, 0x9c,
+    0x97, 0x24, 0xaf, 0x83, 0xe6, 0x5a, 0x91, 0xcc, 0x0f, 0xcf, 0x5c, 0xfe,
+    0xa9, 0x34, 0x39, 0x81, 0x4d, 0xfe, 0x05, 0xc8, 0xca, 0x0c, 0xd8, 0x5e,
+    0xf0, 0x55, 0xad, 0xf8, 0x1d, 0xd0, 0xf1, 0xd1, 0x3b, 0x90, 0x61, 0xac,
+    0x82, 0x12, 0xfb, 0x07, 0x78, 0xee, 0xdb, 0xd6, 0x2e, 0xd7, 0xe0, 0x16,
+    0x89, 0xe1, 0x27, 0x8f, 0xac, 0xde, 0xcd, 0x71, 0x39, 0xe7, 0xec, 0x88,
+    0x01, 0xa8, 0xdb, 0xc8, 0xa7, 0x8e, 0x36, 0x90, 0xce, 0xd2, 0x1e, 0x32,
+    0x79, 0xc4, 0x6a, 0x88, 0x3c, 0x8a, 0xe5, 0x63, 0xb0, 0xd6, 0xb1, 0x31,
+    0x9d, 0x23, 0x19, 0x2a, 0xc2, 0x94, 0xb6, 0x7d, 0xc0, 0x0e, 0xd3, 0xfb,
+    0x96, 0xbd, 0xe6, 0x48, 0xec, 0xe3, 0x20, 0xee, 0xd1, 0x0d, 0x5a, 0x93,
+    0x15, 0x8c, 0xdb, 0x2d, 0x93, 0xec, 0xff, 0x0f, 0x20, 0x9f, 0x6e, 0xfd,
+    0x05, 0x3a, 0x18, 0xe3, 0xf6, 0xd8
+}};
+
+xtt_daa_credential_lrsw cred = {.data={
+    0x04, 0xe1, 0x63, 0x6e, 0x34, 0x7c, 0x7f, 0xbc, 0x41, 0xc2, 0x0b, 0xf5,
+    0x28, 0x7d, 0xb8, 0xb9, 0xbd, 0x77, 0x89, 0xb7, 0x3e, 0x0b, 0xda, 0x91,
+    0xe1, 0xe1, 0x90, 0x1c, 0xcf, 0x06, 0x6f, 0xb0, 0x10, 0xd7, 0xab, 0x7a,
+    0x3b, 0x8f, 0x29, 0x5a, 0xb3, 0x10, 0xd2, 0xba, 0xed, 0x57, 0x98, 0xed,
+    0x2c, 0x2c, 0xa0, 0x4d, 0xa0, 0x2f, 0xfc, 0x03, 0x85, 0xd6, 0xc7, 0x08,
+    0xfe, 0xfd, 0xab, 0x37, 0x5c, 0x04, 0xa4, 0x65, 0x2b, 0xf6, 0xa6, 0xb0,
+    0x75, 0xda, 0x3b, 0xc7, 0x4d, 0x11, 0x0e, 0xa5, 0x22, 0x3b, 0x64, 0xcc,
+    0x28, 0x3f, 0x8e, 0xc4, 0x91, 0x65, 0x25, 0xa8, 0x7e, 0x36, 0x67, 0xa4,
+    0x53, 0xed, 0x42, 0xda, 0xbd, 0xdc, 0x49, 0xfe, 0xe9, 0xb0, 0x0a, 0x0c,
+    0x76, 0x3c, 0x52, 0xae, 0xb1, 0x00, 0xb4, 0xa1, 0x90, 0x7c, 0xcc, 0x4e,
+    0xe8, 0xe2, 0x4e, 0xb9, 0xf7, 0xa4, 0x91, 0xa7, 0xd1, 0x57, 0x04, 0x8a,
+    0x71, 0x60, 0xca, 0x86, 0xf8, 0xc4, 0x67, 0x79, 0x68, 0x8c, 0x19, 0x59,
+    0xf2, 0xb1, 0x58, 0x4e, 0xbe, 0x7a, 0xbb, 0xc5, 0x87, 0x2f, 0xbf, 0xed,
+    0xe1, 0x6b, 0xba, 0xf1, 0xe0, 0x3b, 0xf6, 0x5f, 0xca, 0x23, 0xfa, 0x78,
+    0xb9, 0x89, 0x91, 0xbd, 0x3a, 0x51, 0x1b, 0x0a, 0xbe, 0x7c, 0x1a, 0xdb,
+    0x2a, 0xef, 0xc7, 0xb8, 0x5d, 0xbd, 0x51, 0xd5, 0x4d, 0x00, 0x5c, 0x7d,
+    0x7a, 0xc4, 0xd1, 0x04, 0xd6, 0x53, 0xc8, 0xc3, 0x8f, 0xc9, 0xfb, 0x26,
+    0xa8, 0xc8, 0xb7, 0xf6, 0x7f, 0x58, 0xb4, 0x64, 0x05, 0x8c, 0x1b, 0x8c,
+    0xea, 0x26, 0x8f, 0x1c, 0x81, 0xcf, 0xb6, 0x37, 0x7b, 0x6b, 0x11, 0x36,
+    0xa9, 0x9a, 0xd1, 0x0c, 0xf3, 0xfd, 0xc3, 0xe3, 0x9e, 0x72, 0x41, 0x97,
+    0x51, 0x18, 0xca, 0x24, 0x29, 0xf2, 0xa4, 0x6f, 0xd5, 0x50, 0x30, 0x98,
+    0x15, 0x68, 0x84, 0xf7, 0x2b, 0x5a, 0x80, 0x39
+}};
+
+xtt_daa_priv_key_lrsw daa_priv_key = {.data={
+    0x0b, 0x8a, 0x76, 0xe0, 0xbf, 0x23, 0xf2, 0x1a, 0x5b, 0x54, 0x7d, 0x8c,
+    0x97, 0xcf, 0x3f, 0xa0, 0xae, 0x72, 0xb6, 0x60, 0x29, 0x10, 0x18, 0x14,
+    0x61, 0xb6, 0x58, 0x6a, 0x44, 0x97, 0xa1, 0xf7
+}};
+
+static const char *basename = "BASENAME";
+
+enum latency {
+    LATENCY_CLIENT_INIT,        // ClientInit sent -> ServerInitAndAttest received
+    LATENCY_CLIENT_ATTEST,      // Identity_ClientAttest sent -> Identity_ServerFinished received
+    LATENCY_HANDSHAKE,          // ClientInit built -> Identity_ServerFinished parsed
+    LATENCY_COUNT
+};
+
+static const char *latency_names[LATENCY_COUNT] = {
+    "client_init",
+    "client_attest",
+    "handshake",
+};
+
+/*
+ * Latencies in nanoseconds, in buckets of HISTOGRAM_SUB_BUCKETS per power of two.
+ */
+struct histogram {
+    uint64_t count;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/*
+ * A bounded multi-producer/multi-consumer queue of connections (after D. Vyukov),
+ * as used by the key pool: a connection is enqueued once its peer's message is in its buffer.
+ */
+struct channel_slot {
+    uint64_t sequence;
+    struct connection *connection;
+};
+
+struct channel {
+    struct channel_slot slots[CHANNEL_CAPACITY];
+
+    unsigned char pad0[64];
+    uint64_t enqueue_pos;
+    unsigned char pad1[64 - sizeof(uint64_t)];
+    uint64_t dequeue_pos;
+    unsigned char pad2[64 - sizeof(uint64_t)];
+};
+
+enum connection_state {
+    CONNECTION_IDLE,
+    CONNECTION_AWAITING_SERVER_INIT,
+    CONNECTION_AWAITING_SERVER_FINISHED
+};
+
+/*
+ * Both ends of one simulated connection.
+ * The client end is only touched by its client thread, the server end only by the engine (and feeder).
+ */
+struct connection {
+    // Client end
+    struct xtt_client_handshake_context client_ctx;
+    unsigned char client_in[MAX_MESSAGE_LENGTH];
+    unsigned char client_out[MAX_MESSAGE_LENGTH];
+    xtt_client_id client_id;
+    enum connection_state state;
+    uint16_t client_thread;
+    uint64_t handshake_start_ns;
+    uint64_t sent_ns;
+
+    // Server end
+    struct xtt_server_handshake_context server_ctx;
+    struct xtt_server_engine_job job;
+    unsigned char server_in[MAX_MESSAGE_LENGTH];
+    unsigned char server_out[MAX_MESSAGE_LENGTH];
+};
+
+struct client_thread {
+    pthread_t thread;
+    uint16_t index;
+    struct channel inbox;
+    struct xtt_daa_context daa_ctx;
+    uint32_t in_flight;
+
+    // Only counted while measuring.
+    uint64_t handshakes;
+    uint64_t failures;
+    struct histogram latencies[LATENCY_COUNT];
+};
+
+struct point {
+    uint16_t server_threads;
+    uint16_t clients;
+    double seconds;
+    uint64_t handshakes;
+    uint64_t failures;
+    double server_cpu_us_per_handshake;
+    double process_cpu_us_per_handshake;
+    struct histogram latencies[LATENCY_COUNT];
+};
+
+// Options
+static uint16_t max_server_threads;
+static uint16_t max_clients = 64;
+static uint16_t client_thread_count;
+static uint32_t seconds_per_point = 2;
+static xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512;
+static int verbose;
+static const char *json_path;
+
+// Server state, shared by every point.
+static struct xtt_server_root_certificate_context root_certificate;
+static struct xtt_server_certificate_context cert_ctx;
+static struct xtt_server_cookie_context cookie_ctx;
+static struct xtt_daa_group_public_key_context gpk_ctx;
+static xtt_client_id server_id;
+static xtt_daa_group_id gid;
+
+// State of the point being run.
+static struct xtt_server_engine engine;
+static struct channel server_inbox;
+static struct connection connections[MAX_CLIENTS];
+static struct client_thread client_threads[MAX_CLIENT_THREADS];
+static uint16_t active_client_threads;
+static uint16_t active_clients;
+static pthread_t feeder_thread;
+static int measuring;
+static int stopping;
+static int feeder_stopping;
+static uint64_t server_failures;
+
+static struct point points[MAX_POINTS];
+static uint16_t point_count;
+
+static int parse_options(int argc, char **argv);
+
+static int initialize_server(void);
+
+static int initialize_clients(void);
+
+static int run_point(struct point *point_out, uint16_t server_threads, uint16_t clients);
+
+static void *run_client_thread(void *arg);
+
+static void *run_feeder(void *arg);
+
+static void start_handshake(struct client_thread *self, struct connection *connection);
+
+static void handle_response(struct client_thread *self, struct connection *connection);
+
+static void send_to_server(struct connection *connection);
+
+static xtt_error_code lookup_gpk(struct xtt_daa_group_public_key_context **gpk_ctx_out,
+                                 const xtt_daa_group_id *claimed_gid,
+                                 void *user_data);
+
+static void on_complete(struct xtt_server_engine_job *job, void *user_data);
+
+static void channel_initialize(struct channel *channel);
+
+static void channel_send(struct channel *channel, struct connection *connection);
+
+static int channel_receive(struct channel *channel, struct connection **connection_out);
+
+static void idle(uint32_t *idle_rounds);
+
+static uint64_t now_ns(void);
+
+static uint64_t cpu_ns(clockid_t clock);
+
+static void sleep_ms(uint32_t ms);
+
+static void histogram_add(struct histogram *histogram, uint64_t value_ns);
+
+static void histogram_merge(struct histogram *into, const struct histogram *from);
+
+static uint64_t histogram_bucket_floor_ns(uint16_t bucket);
+
+static double histogram_percentile_us(const struct histogram *histogram, double fraction);
+
+static void print_point(const struct point *point);
+
+static void print_histogram(const struct histogram *histogram);
+
+static int write_json(const char *path);
+
+static void print_library_stats(void);
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint16_t half_the_cpus = (cpus > 1) ? (uint16_t)(cpus / 2) : 1;
+    max_server_threads = half_the_cpus;
+    client_thread_count = half_the_cpus;
+
+    if (0 != parse_options(argc, argv))
+        return 1;
+
+    if (0 != xtt_crypto_initialize_crypto()) {
+        fprintf(stderr, "Error initializing crypto\n");
+        return 1;
+    }
+
+    if (!xtt_crypto_suite_available(suite_spec)) {
+        fprintf(stderr, "Suite %d isn't available\n", (int)suite_spec);
+        return 1;
+    }
+
+    if (0 != initialize_server() || 0 != initialize_clients()) {
+        fprintf(stderr, "Error initializing server or clients\n");
+        return 1;
+    }
+
+    printf("%7s %7s %10s %10s %10s %10s %10s %10s %10s %10s %8s\n",
+           "threads", "clients", "hs/s", "cpu_us/hs",
+           "init_p50", "init_p99", "attest_p50", "attest_p99", "hs_p50", "hs_p99", "failures");
+
+    int failed = 0;
+    for (uint16_t server_threads = 1; server_threads <= max_server_threads; server_threads *= 2) {
+        for (uint32_t clients = 1; clients <= max_clients && point_count < MAX_POINTS; clients *= 4) {
+            struct point *point = &points[point_count++];
+            if (0 != run_point(point, server_threads, (uint16_t)clients)) {
+                fprintf(stderr, "Error running %u server threads with %u clients\n",
+                        server_threads, (unsigned)clients);
+                return 1;
+            }
+
+            print_point(point);
+            if (0 != point->failures)
+                failed = 1;
+        }
+    }
+
+    print_library_stats();
+
+    if (NULL != json_path && 0 != write_json(json_path)) {
+        fprintf(stderr, "Error writing %s\n", json_path);
+        return 1;
+    }
+
+    if (failed) {
+        fprintf(stderr, "Some handshakes failed\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int parse_options(int argc, char **argv)
+{
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "t:n:c:d:s:vj:"))) {
+        long value = ('v' == opt || 'j' == opt) ? 0 : strtol(optarg, NULL, 10);
+        switch (opt) {
+            case 't':
+                if (value < 1 || value > XTT_SERVER_ENGINE_MAX_WORKERS)
+                    goto usage;
+                max_server_threads = (uint16_t)value;
+                break;
+            case 'n':
+                if (value < 1 || value > MAX_CLIENTS)
+                    goto usage;
+                max_clients = (uint16_t)value;
+                break;
+            case 'c':
+                if (value < 1 || value > MAX_CLIENT_THREADS)
+                    goto usage;
+                client_thread_count = (uint16_t)value;
+                break;
+            case 'd':
+                if (value < 1)
+                    goto usage;
+                seconds_per_point = (uint32_t)value;
+                break;
+            case 's':
+                suite_spec = (xtt_suite_spec)value;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'j':
+                json_path = optarg;
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (max_server_threads > XTT_SERVER_ENGINE_MAX_WORKERS)
+        max_server_threads = XTT_SERVER_ENGINE_MAX_WORKERS;
+    if (client_thread_count > MAX_CLIENT_THREADS)
+        client_thread_count = MAX_CLIENT_THREADS;
+
+    return 0;
+
+usage:
+    fprintf(stderr,
+            "usage: %s [-t max_server_threads (1-%d)] [-n max_clients (1-%d)] [-c client_threads (1-%d)]\n"
+            "          [-d seconds] [-s suite_spec] [-v] [-j json_path]\n",
+            argv[0], XTT_SERVER_ENGINE_MAX_WORKERS, MAX_CLIENTS, MAX_CLIENT_THREADS);
+    return -1;
+}
+
+int initialize_server(void)
+{
+    // 1) Root and server certificates
+    xtt_certificate_root_id root_id;
+    memcpy(root_id.data, "1234567890987654", sizeof(xtt_certificate_root_id));
+    xtt_ed25519_pub_key root_public_key;
+    xtt_ed25519_priv_key root_private_key;
+    if (0 != xtt_crypto_create_ed25519_key_pair(&root_public_key, &root_private_key))
+        return -1;
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_root_certificate_context_ed25519(&root_certificate,
+                                                                                    &root_id,
+                                                                                    &root_public_key))
+        return -1;
+
+    memcpy(server_id.data, "4567890987654321", sizeof(xtt_client_id));
+    xtt_ed25519_pub_key server_public_key;
+    xtt_ed25519_priv_key server_private_key;
+    if (0 != xtt_crypto_create_ed25519_key_pair(&server_public_key, &server_private_key))
+        return -1;
+    xtt_certificate_expiry expiry;
+    memcpy(expiry.data, "21001231", sizeof(expiry.data));
+    unsigned char serialized_certificate[XTT_SERVER_CERTIFICATE_ED25519_LENGTH];
+    if (0 != generate_server_certificate_ed25519(serialized_certificate,
+                                                 &server_id,
+                                                 &server_public_key,
+                                                 &expiry,
+                                                 &root_id,
+                                                 &root_private_key))
+        return -1;
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_certificate_context_ed25519(&cert_ctx,
+                                                                               serialized_certificate,
+                                                                               &server_private_key))
+        return -1;
+
+    // 2) Cookie keys
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_cookie_context(&cookie_ctx))
+        return -1;
+
+    // 3) The clients' group (there's only one, so its GID is just the first half of its GPK's hash)
+    unsigned char gpk_hash[64];
+    uint16_t gpk_hash_length;
+    if (0 != xtt_crypto_hash_sha512(gpk_hash, &gpk_hash_length, gpk.data, sizeof(gpk.data)))
+        return -1;
+    memcpy(gid.data, gpk_hash, sizeof(gid.data));
+
+    if (XTT_ERROR_SUCCESS != xtt_initialize_daa_group_public_key_context_lrsw(&gpk_ctx,
+                                                                              (unsigned char*)basename,
+                                                                              (uint16_t)strlen(basename),
+                                                                              &gpk))
+        return -1;
+
+    return 0;
+}
+
+int initialize_clients(void)
+{
+    for (uint16_t i = 0; i < client_thread_count; ++i) {
+        client_threads[i].index = i;
+        if (XTT_ERROR_SUCCESS != xtt_initialize_daa_context_lrsw(&client_threads[i].daa_ctx,
+                                                                 &gid,
+                                                                 &daa_priv_key,
+                                                                 &cred,
+                                                                 (unsigned char*)basename,
+                                                                 (uint16_t)strlen(basename)))
+            return -1;
+    }
+
+    for (uint16_t i = 0; i < MAX_CLIENTS; ++i) {
+        connections[i].client_id = xtt_null_client_id;
+        connections[i].client_id.data[0] = (unsigned char)(i >> 8);
+        connections[i].client_id.data[1] = (unsigned char)i;
+    }
+
+    return 0;
+}
+
+int run_point(struct point *point_out, uint16_t server_threads, uint16_t clients)
+{
+    memset(point_out, 0, sizeof(*point_out));
+    point_out->server_threads = server_threads;
+    point_out->clients = clients;
+
+    // 1) Reset the channels and clients, and start from fresh cookie keys
+    //      (so the replay filters don't fill up over the points).
+    if (XTT_ERROR_SUCCESS != xtt_rotate_server_cookie_context(&cookie_ctx))
+        return -1;
+
+    active_clients = clients;
+    active_client_threads = (clients < client_thread_count) ? clients : client_thread_count;
+    channel_initialize(&server_inbox);
+    for (uint16_t i = 0; i < active_client_threads; ++i) {
+        struct client_thread *client_thread = &client_threads[i];
+        channel_initialize(&client_thread->inbox);
+        client_thread->in_flight = 0;
+        client_thread->handshakes = 0;
+        client_thread->failures = 0;
+        memset(client_thread->latencies, 0, sizeof(client_thread->latencies));
+    }
+    for (uint16_t i = 0; i < clients; ++i) {
+        connections[i].state = CONNECTION_IDLE;
+        connections[i].client_thread = i % active_client_threads;
+    }
+    __atomic_store_n(&measuring, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stopping, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&feeder_stopping, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&server_failures, 0, __ATOMIC_RELAXED);
+
+    // 2) Start the server, then the clients
+    struct xtt_server_engine_config config = {
+        .certificate_ctx = &cert_ctx,
+        .cookie_ctx = &cookie_ctx,
+        .lookup_gpk = lookup_gpk,
+        .assign_client_id = NULL,
+        .on_complete = on_complete,
+        .user_data = NULL,
+        .workers_per_stage = {server_threads, server_threads, server_threads, server_threads}
+    };
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_engine(&engine, &config))
+        return -1;
+
+    if (0 != pthread_create(&feeder_thread, NULL, run_feeder, NULL))
+        return -1;
+
+    for (uint16_t i = 0; i < active_client_threads; ++i) {
+        if (0 != pthread_create(&client_threads[i].thread, NULL, run_client_thread, &client_threads[i]))
+            return -1;
+    }
+
+    // 3) Warm up, then measure
+    sleep_ms(WARMUP_MS);
+
+    clockid_t feeder_clock;
+    clockid_t client_clocks[MAX_CLIENT_THREADS];
+    if (0 != pthread_getcpuclockid(feeder_thread, &feeder_clock))
+        return -1;
+    for (uint16_t i = 0; i < active_client_threads; ++i) {
+        if (0 != pthread_getcpuclockid(client_threads[i].thread, &client_clocks[i]))
+            return -1;
+    }
+
+    uint64_t not_server_cpu = cpu_ns(feeder_clock);
+    for (uint16_t i = 0; i < active_client_threads; ++i)
+        not_server_cpu += cpu_ns(client_clocks[i]);
+    uint64_t process_cpu = cpu_ns(CLOCK_PROCESS_CPUTIME_ID);
+    uint64_t start = now_ns();
+    __atomic_store_n(&measuring, 1, __ATOMIC_RELEASE);
+
+    for (uint32_t elapsed_ms = 0; elapsed_ms < 1000 * seconds_per_point; elapsed_ms += COOKIE_ROTATION_MS) {
+        sleep_ms(COOKIE_ROTATION_MS);
+        if (XTT_ERROR_SUCCESS != xtt_rotate_server_cookie_context(&cookie_ctx))
+            return -1;
+    }
+
+    __atomic_store_n(&measuring, 0, __ATOMIC_RELEASE);
+    uint64_t elapsed = now_ns() - start;
+    process_cpu = cpu_ns(CLOCK_PROCESS_CPUTIME_ID) - process_cpu;
+    not_server_cpu = cpu_ns(feeder_clock) - not_server_cpu;
+    for (uint16_t i = 0; i < active_client_threads; ++i)
+        not_server_cpu += cpu_ns(client_clocks[i]);
+
+    // 4) Let the in-flight handshakes finish, then stop
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for (uint16_t i = 0; i < active_client_threads; ++i)
+        pthread_join(client_threads[i].thread, NULL);
+
+    __atomic_store_n(&feeder_stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(feeder_thread, NULL);
+
+    xtt_server_engine_shutdown(&engine);
+
+    // 5) Add up the clients' view
+    point_out->seconds = (double)elapsed / 1e9;
+    point_out->failures = __atomic_load_n(&server_failures, __ATOMIC_RELAXED);
+    for (uint16_t i = 0; i < active_client_threads; ++i) {
+        point_out->handshakes += client_threads[i].handshakes;
+        point_out->failures += client_threads[i].failures;
+        for (int latency = 0; latency < LATENCY_COUNT; ++latency)
+            histogram_merge(&point_out->latencies[latency], &client_threads[i].latencies[latency]);
+    }
+
+    if (0 != point_out->handshakes) {
+        // The client threads' CPU clocks were read after the process's, so this can come out slightly negative.
+        double server_cpu = (double)process_cpu - (double)not_server_cpu;
+        point_out->server_cpu_us_per_handshake = (server_cpu > 0 ? server_cpu : 0) / 1e3 / (double)point_out->handshakes;
+        point_out->process_cpu_us_per_handshake = (double)process_cpu / 1e3 / (double)point_out->handshakes;
+    }
+
+    return 0;
+}
+
+void *run_client_thread(void *arg)
+{
+    struct client_thread *self = arg;
+    struct connection *connection;
+    uint32_t idle_rounds = 0;
+
+    for (uint16_t i = self->index; i < active_clients; i += active_client_threads)
+        start_handshake(self, &connections[i]);
+
+    for (;;) {
+        if (0 == channel_receive(&self->inbox, &connection)) {
+            handle_response(self, connection);
+            idle_rounds = 0;
+            continue;
+        }
+
+        if (0 == self->in_flight && __atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+            break;
+
+        idle(&idle_rounds);
+    }
+
+    return NULL;
+}
+
+void *run_feeder(void *arg)
+{
+    struct connection *connection;
+    uint32_t idle_rounds = 0;
+    (void)arg;
+
+    for (;;) {
+        if (0 == channel_receive(&server_inbox, &connection)) {
+            connection->job.in_message = connection->server_in;
+            connection->job.out_buffer = connection->server_out;
+            connection->job.handshake_ctx = &connection->server_ctx;
+            connection->job.user_data = connection;
+            if (XTT_ERROR_SUCCESS != xtt_server_engine_submit(&engine, &connection->job)) {
+                // Never reached the engine, so answer for it.
+                __atomic_add_fetch(&server_failures, 1, __ATOMIC_RELAXED);
+                connection->client_in[0] = XTT_ERROR_MSG;
+                channel_send(&client_threads[connection->client_thread].inbox, connection);
+            }
+            idle_rounds = 0;
+            continue;
+        }
+
+        if (__atomic_load_n(&feeder_stopping, __ATOMIC_ACQUIRE))
+            break;
+
+        idle(&idle_rounds);
+    }
+
+    return NULL;
+}
+
+/*
+ * Build and send a ClientInit, unless we're stopping.
+ */
+void start_handshake(struct client_thread *self, struct connection *connection)
+{
+    uint16_t length;
+
+    connection->state = CONNECTION_IDLE;
+    if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+        return;
+
+    connection->handshake_start_ns = now_ns();
+    if (XTT_ERROR_SUCCESS != xtt_initialize_client_handshake_context(&connection->client_ctx,
+                                                                     XTT_VERSION_ONE,
+                                                                     suite_spec)
+            || XTT_ERROR_SUCCESS != xtt_build_client_init(connection->client_out,
+                                                          &length,
+                                                          &connection->client_ctx)) {
+        ++self->failures;
+        return;
+    }
+
+    connection->state = CONNECTION_AWAITING_SERVER_INIT;
+    send_to_server(connection);
+    ++self->in_flight;
+}
+
+/*
+ * Take the server's response, and send the next message (or start the next handshake).
+ */
+void handle_response(struct client_thread *self, struct connection *connection)
+{
+    uint64_t received = now_ns();
+    int counted = __atomic_load_n(&measuring, __ATOMIC_ACQUIRE);
+    uint16_t length;
+
+    --self->in_flight;
+
+    switch (connection->state) {
+        case CONNECTION_AWAITING_SERVER_INIT: {
+            if (counted)
+                histogram_add(&self->latencies[LATENCY_CLIENT_INIT], received - connection->sent_ns);
+
+            xtt_certificate_root_id claimed_root_id;
+            if (XTT_SERVERINITANDATTEST_MSG != xtt_get_message_type(connection->client_in)
+                    || XTT_ERROR_SUCCESS != xtt_preparse_serverinitandattest(&claimed_root_id,
+                                                                             connection->client_in,
+                                                                             &connection->client_ctx)
+                    || XTT_ERROR_SUCCESS != xtt_build_identity_client_attest(connection->client_out,
+                                                                             &length,
+                                                                             connection->client_in,
+                                                                             &root_certificate,
+                                                                             &connection->client_id,
+                                                                             &server_id,
+                                                                             &self->daa_ctx,
+                                                                             &connection->client_ctx))
+                break;
+
+            connection->state = CONNECTION_AWAITING_SERVER_FINISHED;
+            send_to_server(connection);
+            ++self->in_flight;
+            return;
+        }
+        case CONNECTION_AWAITING_SERVER_FINISHED: {
+            if (counted)
+                histogram_add(&self->latencies[LATENCY_CLIENT_ATTEST], received - connection->sent_ns);
+
+            xtt_client_id assigned_client_id = connection->client_id;
+            if (XTT_ID_SERVERFINISHED_MSG != xtt_get_message_type(connection->client_in)
+                    || XTT_ERROR_SUCCESS != xtt_parse_identity_server_finished(&assigned_client_id,
+                                                                               connection->client_in,
+                                                                               &connection->client_ctx))
+                break;
+
+            if (counted) {
+                ++self->handshakes;
+                histogram_add(&self->latencies[LATENCY_HANDSHAKE], now_ns() - connection->handshake_start_ns);
+            }
+            start_handshake(self, connection);
+            return;
+        }
+        case CONNECTION_IDLE:
+            break;
+    }
+
+    if (counted)
+        ++self->failures;
+    start_handshake(self, connection);
+}
+
+void send_to_server(struct connection *connection)
+{
+    memcpy(connection->server_in, connection->client_out, xtt_get_message_length(connection->client_out));
+    connection->sent_ns = now_ns();
+    channel_send(&server_inbox, connection);
+}
+
+xtt_error_code
+lookup_gpk(struct xtt_daa_group_public_key_context **gpk_ctx_out,
+           const xtt_daa_group_id *claimed_gid,
+           void *user_data)
+{
+    (void)user_data;
+
+    if (0 != memcmp(claimed_gid->data, gid.data, sizeof(xtt_daa_group_id)))
+        return XTT_ERROR_DAA;
+
+    *gpk_ctx_out = &gpk_ctx;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void on_complete(struct xtt_server_engine_job *job, void *user_data)
+{
+    struct connection *connection = job->user_data;
+    (void)user_data;
+
+    if (XTT_ERROR_SUCCESS != job->rc)
+        __atomic_add_fetch(&server_failures, 1, __ATOMIC_RELAXED);
+
+    if (0 != job->out_length)
+        memcpy(connection->client_in, connection->server_out, job->out_length);
+    else
+        connection->client_in[0] = XTT_ERROR_MSG;
+
+    channel_send(&client_threads[connection->client_thread].inbox, connection);
+}
+
+void channel_initialize(struct channel *channel)
+{
+    for (uint64_t i = 0; i < CHANNEL_CAPACITY; ++i)
+        channel->slots[i].sequence = i;
+    channel->enqueue_pos = 0;
+    channel->dequeue_pos = 0;
+}
+
+void channel_send(struct channel *channel, struct connection *connection)
+{
+    struct channel_slot *slot;
+    uint64_t pos = __atomic_load_n(&channel->enqueue_pos, __ATOMIC_RELAXED);
+
+    // Never full, since it has room for every client's one message.
+    for (;;) {
+        slot = &channel->slots[pos & CHANNEL_MASK];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (0 == diff) {
+            if (__atomic_compare_exchange_n(&channel->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else {
+            pos = __atomic_load_n(&channel->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->connection = connection;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+int channel_receive(struct channel *channel, struct connection **connection_out)
+{
+    struct channel_slot *slot;
+    uint64_t pos = __atomic_load_n(&channel->dequeue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &channel->slots[pos & CHANNEL_MASK];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+        if (0 == diff) {
+            if (__atomic_compare_exchange_n(&channel->dequeue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;  // empty
+        } else {
+            pos = __atomic_load_n(&channel->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    *connection_out = slot->connection;
+    __atomic_store_n(&slot->sequence, pos + CHANNEL_MASK + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*
+ * Back off from polling an empty channel: yield for a while, then sleep,
+ * so idle pollers don't take CPU from the engine's workers.
+ */
+void idle(uint32_t *idle_rounds)
+{
+    if (++*idle_rounds < IDLE_YIELDS) {
+        sched_yield();
+    } else {
+        struct timespec nap = {0, IDLE_SLEEP_NS};
+        nanosleep(&nap, NULL);
+    }
+}
+
+uint64_t now_ns(void)
+{
+    return cpu_ns(CLOCK_MONOTONIC);
+}
+
+uint64_t cpu_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    struct timespec duration = {ms / 1000, (long)(ms % 1000) * 1000000};
+    while (0 != nanosleep(&duration, &duration))
+        ;
+}
+
+void histogram_add(struct histogram *histogram, uint64_t value_ns)
+{
+    uint16_t bucket;
+    if (value_ns < HISTOGRAM_SUB_BUCKETS) {
+        bucket = (uint16_t)value_ns;
+    } else {
+        // Top two bits below the leading one pick the sub-bucket.
+        int msb = 63 - __builtin_clzll(value_ns);
+        bucket = (uint16_t)((msb - 1) * HISTOGRAM_SUB_BUCKETS + ((value_ns >> (msb - 2)) & (HISTOGRAM_SUB_BUCKETS - 1)));
+    }
+    if (bucket >= HISTOGRAM_BUCKETS)
+        bucket = HISTOGRAM_BUCKETS - 1;
+
+    ++histogram->buckets[bucket];
+    ++histogram->count;
+}
+
+void histogram_merge(struct histogram *into, const struct histogram *from)
+{
+    into->count += from->count;
+    for (uint16_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        into->buckets[i] += from->buckets[i];
+}
+
+uint64_t histogram_bucket_floor_ns(uint16_t bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+
+    uint16_t msb = bucket / HISTOGRAM_SUB_BUCKETS + 1;
+    uint64_t sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS;
+    return (HISTOGRAM_SUB_BUCKETS + sub_bucket) << (msb - 2);
+}
+
+/*
+ * The upper edge of the bucket holding the given fraction of the values.
+ */
+double histogram_percentile_us(const struct histogram *histogram, double fraction)
+{
+    if (0 == histogram->count)
+        return 0;
+
+    uint64_t rank = (uint64_t)(fraction * (double)histogram->count + 0.999999);
+    uint64_t seen = 0;
+    for (uint16_t i = 0; i < HISTOGRAM_BUCKETS - 1; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= rank)
+            return (double)histogram_bucket_floor_ns(i + 1) / 1e3;
+    }
+
+    return (double)histogram_bucket_floor_ns(HISTOGRAM_BUCKETS - 1) / 1e3;
+}
+
+void print_point(const struct point *point)
+{
+    printf("%7u %7u %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %8llu\n",
+           point->server_threads,
+           point->clients,
+           (double)point->handshakes / point->seconds,
+           point->server_cpu_us_per_handshake,
+           histogram_percentile_us(&point->latencies[LATENCY_CLIENT_INIT], 0.5),
+           histogram_percentile_us(&point->latencies[LATENCY_CLIENT_INIT], 0.99),
+           histogram_percentile_us(&point->latencies[LATENCY_CLIENT_ATTEST], 0.5),
+           histogram_percentile_us(&point->latencies[LATENCY_CLIENT_ATTEST], 0.99),
+           histogram_percentile_us(&point->latencies[LATENCY_HANDSHAKE], 0.5),
+           histogram_percentile_us(&point->latencies[LATENCY_HANDSHAKE], 0.99),
+           (unsigned long long)point->failures);
+
+    if (!verbose)
+        return;
+
+    for (int latency = 0; latency < LATENCY_COUNT; ++latency) {
+        printf("    %s latency (us):\n", latency_names[latency]);
+        print_histogram(&point->latencies[latency]);
+    }
+}
+
+void print_histogram(const struct histogram *histogram)
+{
+    uint64_t most = 0;
+    for (uint16_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        if (histogram->buckets[i] > most)
+            most = histogram->buckets[i];
+    }
+
+    for (uint16_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        if (0 == histogram->buckets[i])
+            continue;
+
+        int bar = (int)(50 * histogram->buckets[i] / most);
+        printf("    %12.1f - %12.1f %10llu %.*s\n",
+               (double)histogram_bucket_floor_ns(i) / 1e3,
+               (double)histogram_bucket_floor_ns(i + 1) / 1e3,
+               (unsigned long long)histogram->buckets[i],
+               bar,
+               "##################################################");
+    }
+}
+
+int write_json(const char *path)
+{
+    FILE *out = (0 == strcmp(path, "-")) ? stdout : fopen(path, "w");
+    if (NULL == out)
+        return -1;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"suite_spec\": %d,\n", (int)suite_spec);
+    fprintf(out, "  \"client_threads\": %u,\n", client_thread_count);
+    fprintf(out, "  \"seconds_per_point\": %u,\n", seconds_per_point);
+    fprintf(out, "  \"points\": [\n");
+    for (uint16_t p = 0; p < point_count; ++p) {
+        const struct point *point = &points[p];
+        fprintf(out, "    {\"server_threads\": %u, \"clients\": %u, \"seconds\": %.3f, \"handshakes\": %llu, "
+                     "\"handshakes_per_second\": %.1f, \"failures\": %llu,\n",
+                point->server_threads,
+                point->clients,
+                point->seconds,
+                (unsigned long long)point->handshakes,
+                (double)point->handshakes / point->seconds,
+                (unsigned long long)point->failures);
+        fprintf(out, "     \"server_cpu_us_per_handshake\": %.1f, \"process_cpu_us_per_handshake\": %.1f,\n",
+                point->server_cpu_us_per_handshake,
+                point->process_cpu_us_per_handshake);
+        fprintf(out, "     \"latency_us\": {");
+        for (int latency = 0; latency < LATENCY_COUNT; ++latency) {
+            const struct histogram *histogram = &point->latencies[latency];
+            fprintf(out, "%s\n       \"%s\": {\"count\": %llu, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"buckets\": [",
+                    (0 == latency) ? "" : ",",
+                    latency_names[latency],
+                    (unsigned long long)histogram->count,
+                    histogram_percentile_us(histogram, 0.5),
+                    histogram_percentile_us(histogram, 0.9),
+                    histogram_percentile_us(histogram, 0.99));
+
+            // [floor_us, count] of each non-empty bucket
+            int first = 1;
+            for (uint16_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+                if (0 == histogram->buckets[i])
+                    continue;
+                fprintf(out, "%s[%.3f, %llu]",
+                        first ? "" : ", ",
+                        (double)histogram_bucket_floor_ns(i) / 1e3,
+                        (unsigned long long)histogram->buckets[i]);
+                first = 0;
+            }
+            fprintf(out, "]}");
+        }
+        fprintf(out, "}}%s\n", (p + 1 < point_count) ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    if (stdout == out)
+        return 0;
+    return (0 == fclose(out)) ? 0 : -1;
+}
+
+void print_library_stats(void)
+{
+    struct xtt_stats stats;
+    if (XTT_ERROR_SUCCESS != xtt_stats_snapshot(&stats) || !stats.enabled)
+        return;
+
+    printf("\n%-16s %10s %10s %10s %10s %10s\n", "phase", "count", "mean_us", "p50_us", "p99_us", "max_us");
+    for (int phase = 0; phase < XTT_STATS_PHASE_COUNT; ++phase) {
+        const struct xtt_stats_histogram *histogram = &stats.phases[phase];
+        if (0 == histogram->count)
+            continue;
+
+        printf("%-16s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+               xtt_stats_phase_string((xtt_stats_phase)phase),
+               (unsigned long long)histogram->count,
+               (double)histogram->total_ns / (double)histogram->count / 1e3,
+               (double)xtt_stats_percentile(histogram, 0.50) / 1e3,
+               (double)xtt_stats_percentile(histogram, 0.99) / 1e3,
+               (double)histogram->max_ns / 1e3);
+    }
+
+    for (int code = 0; code < XTT_ERROR_CODE_COUNT; ++code) {
+        if (0 == stats.errors[code])
+            continue;
+
+        printf("error %-10d %10llu\n", code, (unsigned long long)stats.errors[code]);
+    }
+}
@@ -0,0 +1,713 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <xtt.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * Time each step of an Identity handshake, for every suite available on this host,
+ * and the primitives those steps are built from.
+ *
+ * Every operation is timed on its own, and reported as its median and 99th-percentile time,
+ * and its median cycle count. Cycles are read from the timestamp counter,
+ * so are only reported on x86 (and tick at its constant rate, not the core's current clock).
+ *
+ * usage: handshake_steps-bench [json-path]
+ *
+ * Given a path (or "-" for stdout), the results are also written there as JSON,
+ * for comparison against other hosts or earlier builds.
+ */
+
+#ifndef HANDSHAKES_PER_SUITE
+#define HANDSHAKES_PER_SUITE 256
+#endif
+#define WARMUP_HANDSHAKES 8
+#define HANDSHAKES_PER_COOKIE_ROTATION 4096
+#define PRIMITIVE_ITERATIONS 2048
+#define DAA_ITERATIONS 128
+#define MAX_SAMPLES (HANDSHAKES_PER_SUITE > PRIMITIVE_ITERATIONS ? HANDSHAKES_PER_SUITE : PRIMITIVE_ITERATIONS)
+#define MAX_RESULTS 64
+#define MSG_LENGTH 64
+#define HASH_INPUT_LENGTH 256
+#define PRF_OUTPUT_LENGTH 32
+#define RECORD_LENGTH 1024
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_CYCLE_COUNTER 1
+#endif
+
+xtt_daa_group_pub_key_lrsw gpk = {.data={
+    0x04, 0x27, 0xd4, 0x35, 0xbf, 0xc7, 0x1d, 0x4a, 0x42, 0xb1, 0xd2, 0x26,
+    0x25, 0x54, 0xfe, 0x12, 0x54, 0x84, 0xbc, 0x67, 0x2e, 0xe7, 0xfb, 0x68,
+    0xf7, 0x00, 0xb3, 0x7f, 0x2a, 0xb4, 0x91, 0x61, 0xb8, 0xd3, 0xed, 0x78,
+    0x53, 0x42, 0x26, 0x26, 0x48, 0x27, 0xaf, 0x66, 0xfe, 0xcf, 0xfb, 0xb3,
+    0x8d, 0xd0, 0xcc, 0x76, 0xff, 0x23, 0x38, 0x36, 0xc4, 0x9b, 0x5a, 0xfa,
+    0x58, 0x0c, 0x70, 0x34, 0xca, 0xb4, 0xf5, 0xf7, 0xfd, 0x9d, 0x06, 0x7e,
+    0xc7, 0xad, 0x6e, 0xb4, 0x7a, 0x92, 0x1a, 0xd4, 0x08, 0x27, 0xee, 0xdd,
+    0xf2, 0xf6, 0x82, 0xf6, 0x94, 0x50, 0xdd, 0xba, 0xec, 0x99, 0x37, 0xca,
+    0x11, 0x76, 0x80, 0xf7, 0xdc, 0xe8, 0xd9, 0x20, 0x0b, 0xa6, 0x99, 0xa7,
+    0x11, 0x6c, 0xf4, 0xc2, 0x5a, 0x34, 0x05, 0x52, 0x1e, 0x19, 0x30, 0x40,
+    0xa1, 0x0e, 0xe9, 0x10, 0x4d, 0xd5, 0xc0, 0x18, 0xdf, 0x04, 0xee, 0x9c,
+    0x97, 0x24, 0xaf, 0x83, 0xe6, 0x5a, 0x91, 0xcc, 0x0f, 0xcf, 0x5c, 0xfe,
+    0xa9, 0x34, 0x39, 0x81, 0x4d, 0xfe, 0x05, 0xc8, 0xca, 0x0c, 0xd8, 0x5e,
+    0xf0, 0x55, 0xad, 0xf8, 0x1d, 0xd0, 0xf1, 0xd1, 0x3b, 0x90, 0x61, 0xac,
+    0x82, 0x12, 0xfb, 0x07, 0x78, 0xee, 0xdb, 0xd6, 0x2e, 0xd7, 0xe0, 0x16,
+    0x89, 0xe1, 0x27, 0x8f, 0xac, 0xde, 0xcd, 0x71, 0x39, 0xe7, 0xec, 0x88,
+    0x01, 0xa8, 0xdb, 0xc8, 0xa7, 0x8e, 0x36, 0x90, 0xce, 0xd2, 0x1e, 0x32,
+    0x79, 0xc4, 0x6a, 0x88, 0x3c, 0x8a, 0xe5, 0x63, 0xb0, 0xd6, 0xb1, 0x31,
+    0x9d, 0x23, 0x19, 0x2a, 0xc2, 0x94, 0xb6, 0x7d, 0xc0, 0x0e, 0xd3, 0xfb,
+    0x96, 0xbd, 0xe6, 0x48, 0xec, 0xe3, 0x20, 0xee, 0xd1, 0x0d, 0x5a, 0x93,
+    0x15, 0x8c, 0xdb, 0x2d, 0x93, 0xec, 0xff, 0x0f, 0x20, 0x9f, 0x6e, 0xfd,
+    0x05, 0x3a, 0x18, 0xe3, 0xf6, 0xd8
+}};
+
+xtt_daa_credential_lrsw cred = {.data={
+    0x04, 0xe1, 0x63, 0x6e, 0x34, 0x7c, 0x7f, 0xbc, 0x41, 0xc2, 0x0b, 0xf5,
+    0x28, 0x7d, 0xb8, 0xb9, 0xbd, 0x77, 0x89, 0xb7, 0x3e, 0x0b, 0xda, 0x91,
+    0xe1, 0xe1, 0x90, 0x1c, 0xcf, 0x06, 0x6f, 0xb0, 0x10, 0xd7, 0xab, 0x7a,
+    0x3b, 0x8f, 0x29, 0x5a, 0xb3, 0x10, 0xd2, 0xba, 0xed, 0x57, 0x98, 0xed,
+    0x2c, 0x2c, 0xa0, 0x4d, 0xa0, 0x2f, 0xfc, 0x03, 0x85, 0xd6, 0xc7, 0x08,
+    0xfe, 0xfd, 0xab, 0x37, 0x5c, 0x04, 0xa4, 0x65, 0x2b, 0xf6, 0xa6, 0xb0,
+    0x75, 0xda, 0x3b, 0xc7, 0x4d, 0x11, 0x0e, 0xa5, 0x22, 0x3b, 0x64, 0xcc,
+    0x28, 0x3f, 0x8e, 0xc4, 0x91, 0x65, 0x25, 0xa8, 0x7e, 0x36, 0x67, 0xa4,
+    0x53, 0xed, 0x42, 0xda, 0xbd, 0xdc, 0x49, 0xfe, 0xe9, 0xb0, 0x0a, 0x0c,
+    0x76, 0x3c, 0x52, 0xae, 0xb1, 0x00, 0xb4, 0xa1, 0x90, 0x7c, 0xcc, 0x4e,
+    0xe8, 0xe2, 0x4e, 0xb9, 0xf7, 0xa4, 0x91, 0xa7, 0xd1, 0x57, 0x04, 0x8a,
+    0x71, 0x60, 0xca, 0x86, 0xf8, 0xc4, 0x67, 0x79, 0x68, 0x8c, 0x19, 0x59,
+    0xf2, 0xb1, 0x58, 0x4e, 0xbe, 0x7a, 0xbb, 0xc5, 0x87, 0x2f, 0xbf, 0xed,
+    0xe1, 0x6b, 0xba, 0xf1, 0xe0, 0x3b, 0xf6, 0x5f, 0xca, 0x23, 0xfa, 0x78,
+    0xb9, 0x89, 0x91, 0xbd, 0x3a, 0x51, 0x1b, 0x0a, 0xbe, 0x7c, 0x1a, 0xdb,
+    0x2a, 0xef, 0xc7, 0xb8, 0x5d, 0xbd, 0x51, 0xd5, 0x4d, 0x00, 0x5c, 0x7d,
+    0x7a, 0xc4, 0xd1, 0x04, 0xd6, 0x53, 0xc8, 0xc3, 0x8f, 0xc9, 0xfb, 0x26,
+    0xa8, 0xc8, 0xb7, 0xf6, 0x7f, 0x58, 0xb4, 0x64, 0x05, 0x8c, 0x1b, 0x8c,
+    0xea, 0x26, 0x8f, 0x1c, 0x81, 0xcf, 0xb6, 0x37, 0x7b, 0x6b, 0x11, 0x36,
+    0xa9, 0x9a, 0xd1, 0x0c, 0xf3, 0xfd, 0xc3, 0xe3, 0x9e, 0x72, 0x41, 0x97,
+    0x51, 0x18, 0xca, 0x24, 0x29, 0xf2, 0xa4, 0x6f, 0xd5, 0x50, 0x30, 0x98,
+    0x15, 0x68, 0x84, 0xf7, 0x2b, 0x5a, 0x80, 0x39
+}};
+
+xtt_daa_priv_key_lrsw daa_priv_key = {.data={
+    0x0b, 0x8a, 0x76, 0xe0, 0xbf, 0x23, 0xf2, 0x1a, 0x5b, 0x54, 0x7d, 0x8c,
+    0x97, 0xcf, 0x3f, 0xa0, 0xae, 0x72, 0xb6, 0x60, 0x29, 0x10, 0x18, 0x14,
+    0x61, 0xb6, 0x58, 0x6a, 0x44, 0x97, 0xa1, 0xf7
+}};
+
+static const char *basename = "BASENAME";
+
+enum handshake_step {
+    STEP_BUILD_CLIENT_INIT,
+    STEP_BUILD_SERVER_INIT_AND_ATTEST,
+    STEP_PREPARSE_SERVER_INIT_AND_ATTEST,
+    STEP_BUILD_IDENTITY_CLIENT_ATTEST,
+    STEP_PRE_PARSE_CLIENT_ATTEST,
+    STEP_BUILD_IDENTITY_SERVER_FINISHED,
+    STEP_PARSE_IDENTITY_SERVER_FINISHED,
+    STEP_COUNT
+};
+
+static const char *step_names[STEP_COUNT] = {
+    "xtt_build_client_init",
+    "xtt_build_server_init_and_attest",
+    "xtt_preparse_serverinitandattest",
+    "xtt_build_identity_client_attest",
+    "xtt_pre_parse_client_attest",
+    "xtt_build_identity_server_finished",
+    "xtt_parse_identity_server_finished",
+};
+
+static const struct {
+    xtt_suite_spec suite_spec;
+    const char *name;
+} suites[XTT_SUITE_COUNT] = {
+    {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512, "CHACHA20POLY1305_SHA512"},
+    {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B, "CHACHA20POLY1305_BLAKE2B"},
+    {XTT_X25519_LRSW_ED25519_AES256GCM_SHA512, "AES256GCM_SHA512"},
+    {XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B, "AES256GCM_BLAKE2B"},
+};
+
+struct primitive {
+    const char *name;
+    uint32_t iterations;
+    int (*is_available)(void);
+    int (*run)(void);
+};
+
+static int always_available(void);
+static int run_x25519_key_pair(void);
+static int run_x25519_diffie_hellman(void);
+static int run_ed25519_sign(void);
+static int run_ed25519_verify(void);
+static int run_lrsw_sign(void);
+static int run_lrsw_verify(void);
+static int run_chacha_encrypt(void);
+static int run_chacha_decrypt(void);
+static int run_aes256_encrypt(void);
+static int run_aes256_decrypt(void);
+static int run_hash_sha512(void);
+static int run_hash_blake2b(void);
+static int run_prf_sha512(void);
+static int run_prf_blake2b(void);
+
+static const struct primitive primitives[] = {
+    {"x25519_key_pair", PRIMITIVE_ITERATIONS, always_available, run_x25519_key_pair},
+    {"x25519_diffie_hellman", PRIMITIVE_ITERATIONS, always_available, run_x25519_diffie_hellman},
+    {"ed25519_sign", PRIMITIVE_ITERATIONS, always_available, run_ed25519_sign},
+    {"ed25519_verify", PRIMITIVE_ITERATIONS, always_available, run_ed25519_verify},
+    {"lrsw_sign", DAA_ITERATIONS, always_available, run_lrsw_sign},
+    {"lrsw_verify", DAA_ITERATIONS, always_available, run_lrsw_verify},
+    {"chacha20poly1305_encrypt_1024", PRIMITIVE_ITERATIONS, xtt_crypto_aead_chacha_is_available, run_chacha_encrypt},
+    {"chacha20poly1305_decrypt_1024", PRIMITIVE_ITERATIONS, xtt_crypto_aead_chacha_is_available, run_chacha_decrypt},
+    {"aes256gcm_encrypt_1024", PRIMITIVE_ITERATIONS, xtt_crypto_aead_aes256_is_available, run_aes256_encrypt},
+    {"aes256gcm_decrypt_1024", PRIMITIVE_ITERATIONS, xtt_crypto_aead_aes256_is_available, run_aes256_decrypt},
+    {"hash_sha512_256", PRIMITIVE_ITERATIONS, always_available, run_hash_sha512},
+    {"hash_blake2b_256", PRIMITIVE_ITERATIONS, always_available, run_hash_blake2b},
+    {"prf_sha512_32", PRIMITIVE_ITERATIONS, always_available, run_prf_sha512},
+    {"prf_blake2b_32", PRIMITIVE_ITERATIONS, always_available, run_prf_blake2b},
+};
+
+struct stamp {
+    struct timespec time;
+    uint64_t cycles;
+};
+
+struct series {
+    uint32_t count;
+    double ns[MAX_SAMPLES];
+    uint64_t cycles[MAX_SAMPLES];
+};
+
+struct result {
+    const char *group;
+    const char *suite;      // NULL for primitives
+    const char *operation;
+    uint32_t count;
+    double median_ns;
+    double p99_ns;
+    uint64_t median_cycles;
+};
+
+static struct series step_series[STEP_COUNT];
+static struct series primitive_series;
+static struct result results[MAX_RESULTS];
+static uint16_t result_count;
+
+// Long-lived state shared by every handshake: certificates, cookie keys, and DAA keys.
+static struct xtt_server_root_certificate_context root_certificate;
+static struct xtt_server_certificate_context cert_ctx;
+static struct xtt_server_cookie_context cookie_ctx;
+static struct xtt_daa_context daa_ctx;
+static struct xtt_daa_group_public_key_context gpk_ctx;
+static xtt_client_id server_id;
+static const xtt_client_id requested_client_id = {.data={4,2,7,4,2,8,3,9,4,2,4,3,3,6,5,8}};
+
+// Inputs (and outputs) of the primitives.
+static xtt_x25519_pub_key x25519_pub;
+static xtt_x25519_priv_key x25519_priv;
+static xtt_x25519_shared_secret x25519_shared_secret;
+static xtt_ed25519_pub_key ed25519_pub;
+static xtt_ed25519_priv_key ed25519_priv;
+static xtt_ed25519_signature ed25519_signature;
+static xtt_daa_signature_lrsw lrsw_signature;
+static unsigned char msg[MSG_LENGTH];
+static unsigned char hash_input[HASH_INPUT_LENGTH];
+static unsigned char digest[64];
+static xtt_chacha_key chacha_key;
+static xtt_chacha_nonce chacha_nonce;
+static xtt_aes256_key aes256_key;
+static xtt_aes256_nonce aes256_nonce;
+static unsigned char record[RECORD_LENGTH];
+static unsigned char chacha_sealed[RECORD_LENGTH];
+static unsigned char aes256_sealed[RECORD_LENGTH];
+static unsigned char opened[RECORD_LENGTH];
+static unsigned char mac_out[16];
+static unsigned char chacha_mac[16];
+static unsigned char aes256_mac[16];
+
+static int initialize_contexts(void);
+
+static int initialize_primitive_inputs(void);
+
+static void take_stamp(struct stamp *stamp_out);
+
+static void record_since(struct series *series, const struct stamp *start);
+
+static void add_result(const char *group, const char *suite, const char *operation, struct series *series);
+
+static int run_handshake(xtt_suite_spec suite_spec, int timed);
+
+static int measure_primitive(const struct primitive *primitive);
+
+static void print_results(void);
+
+static int write_json(const char *path);
+
+int main(int argc, char **argv)
+{
+    if (0 != xtt_crypto_initialize_crypto()) {
+        fprintf(stderr, "Error initializing crypto\n");
+        return 1;
+    }
+
+    if (0 != initialize_contexts() || 0 != initialize_primitive_inputs()) {
+        fprintf(stderr, "Error initializing benchmark state\n");
+        return 1;
+    }
+
+    uint32_t handshakes = 0;
+    for (int i = 0; i < XTT_SUITE_COUNT; ++i) {
+        if (!xtt_crypto_suite_available(suites[i].suite_spec)) {
+            fprintf(stderr, "Skipping unavailable suite %s\n", suites[i].name);
+            continue;
+        }
+
+        for (int step = 0; step < STEP_COUNT; ++step)
+            step_series[step].count = 0;
+
+        for (int n = 0; n < WARMUP_HANDSHAKES + HANDSHAKES_PER_SUITE; ++n) {
+            int failed_step = run_handshake(suites[i].suite_spec, n >= WARMUP_HANDSHAKES);
+            if (STEP_COUNT != failed_step) {
+                fprintf(stderr, "Error in %s for suite %s\n", step_names[failed_step], suites[i].name);
+                return 1;
+            }
+
+            // Keep the replay filters well below capacity, so no fresh cookie looks like a replay.
+            if (0 == ++handshakes % HANDSHAKES_PER_COOKIE_ROTATION
+                    && XTT_ERROR_SUCCESS != xtt_rotate_server_cookie_context(&cookie_ctx)) {
+                fprintf(stderr, "Error rotating cookie keys\n");
+                return 1;
+            }
+        }
+
+        for (int step = 0; step < STEP_COUNT; ++step)
+            add_result("handshake", suites[i].name, step_names[step], &step_series[step]);
+    }
+
+    for (size_t i = 0; i < sizeof(primitives) / sizeof(primitives[0]); ++i) {
+        if (!primitives[i].is_available())
+            continue;
+
+        if (0 != measure_primitive(&primitives[i])) {
+            fprintf(stderr, "Error running %s\n", primitives[i].name);
+            return 1;
+        }
+    }
+
+    print_results();
+
+    if (argc > 1 && 0 != write_json(argv[1])) {
+        fprintf(stderr, "Error writing %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
+
+int initialize_contexts(void)
+{
+    // 1) Root and server certificates
+    xtt_certificate_root_id root_id;
+    memcpy(root_id.data, "1234567890987654", sizeof(xtt_certificate_root_id));
+    xtt_ed25519_pub_key root_public_key;
+    xtt_ed25519_priv_key root_private_key;
+    if (0 != xtt_crypto_create_ed25519_key_pair(&root_public_key, &root_private_key))
+        return -1;
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_root_certificate_context_ed25519(&root_certificate,
+                                                                                    &root_id,
+                                                                                    &root_public_key))
+        return -1;
+
+    memcpy(server_id.data, "4567890987654321", sizeof(xtt_client_id));
+    xtt_ed25519_pub_key server_public_key;
+    xtt_ed25519_priv_key server_private_key;
+    if (0 != xtt_crypto_create_ed25519_key_pair(&server_public_key, &server_private_key))
+        return -1;
+    xtt_certificate_expiry expiry;
+    memcpy(expiry.data, "21001231", sizeof(expiry.data));
+    unsigned char serialized_certificate[XTT_SERVER_CERTIFICATE_ED25519_LENGTH];
+    if (0 != generate_server_certificate_ed25519(serialized_certificate,
+                                                 &server_id,
+                                                 &server_public_key,
+                                                 &expiry,
+                                                 &root_id,
+                                                 &root_private_key))
+        return -1;
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_certificate_context_ed25519(&cert_ctx,
+                                                                               serialized_certificate,
+                                                                               &server_private_key))
+        return -1;
+
+    // 2) Cookie keys
+    if (XTT_ERROR_SUCCESS != xtt_initialize_server_cookie_context(&cookie_ctx))
+        return -1;
+
+    // 3) Client's DAA credential, and the server's view of its group
+    //      (the server looks its GPK up by GID, so any GID will do here).
+    uint16_t basename_len = (uint16_t)strlen(basename);
+    unsigned char gpk_hash[64];
+    uint16_t gpk_hash_length;
+    if (0 != xtt_crypto_hash_sha512(gpk_hash, &gpk_hash_length, gpk.data, sizeof(gpk.data)))
+        return -1;
+    xtt_daa_group_id gid;
+    memcpy(gid.data, gpk_hash, sizeof(gid.data));
+    if (XTT_ERROR_SUCCESS != xtt_initialize_daa_context_lrsw(&daa_ctx,
+                                                             &gid,
+                                                             &daa_priv_key,
+                                                             &cred,
+                                                             (unsigned char*)basename,
+                                                             basename_len))
+        return -1;
+
+    if (XTT_ERROR_SUCCESS != xtt_initialize_daa_group_public_key_context_lrsw(&gpk_ctx,
+                                                                              (unsigned char*)basename,
+                                                                              basename_len,
+                                                                              &gpk))
+        return -1;
+
+    return 0;
+}
+
+int initialize_primitive_inputs(void)
+{
+    xtt_x25519_priv_key others_priv;
+    if (0 != xtt_crypto_create_x25519_key_pair(&x25519_pub, &others_priv))
+        return -1;
+    if (0 != xtt_crypto_create_x25519_key_pair(&x25519_pub, &x25519_priv))
+        return -1;
+
+    if (0 != xtt_crypto_create_ed25519_key_pair(&ed25519_pub, &ed25519_priv))
+        return -1;
+
+    xtt_crypto_get_random(msg, sizeof(msg));
+    xtt_crypto_get_random(hash_input, sizeof(hash_input));
+    xtt_crypto_get_random(record, sizeof(record));
+    xtt_crypto_get_random(chacha_key.data, sizeof(chacha_key.data));
+    xtt_crypto_get_random(aes256_key.data, sizeof(aes256_key.data));
+
+    // What the verify and decrypt primitives check.
+    if (0 != run_ed25519_sign() || 0 != run_lrsw_sign())
+        return -1;
+    if (xtt_crypto_aead_chacha_is_available()
+            && 0 != xtt_crypto_aead_chacha_encrypt_detached(chacha_sealed, chacha_mac, record, sizeof(record),
+                                                            NULL, 0, &chacha_nonce, &chacha_key))
+        return -1;
+    if (xtt_crypto_aead_aes256_is_available()
+            && 0 != xtt_crypto_aead_aes256_encrypt_detached(aes256_sealed, aes256_mac, record, sizeof(record),
+                                                            NULL, 0, &aes256_nonce, &aes256_key))
+        return -1;
+
+    return 0;
+}
+
+void take_stamp(struct stamp *stamp_out)
+{
+    clock_gettime(CLOCK_MONOTONIC, &stamp_out->time);
+#ifdef HAVE_CYCLE_COUNTER
+    stamp_out->cycles = __builtin_ia32_rdtsc();
+#else
+    stamp_out->cycles = 0;
+#endif
+}
+
+void record_since(struct series *series, const struct stamp *start)
+{
+    struct stamp end;
+    take_stamp(&end);
+
+    if (series->count == MAX_SAMPLES)
+        return;
+
+    series->ns[series->count] = (double)(end.time.tv_sec - start->time.tv_sec) * 1e9
+                                + (double)(end.time.tv_nsec - start->time.tv_nsec);
+    series->cycles[series->count] = end.cycles - start->cycles;
+    ++series->count;
+}
+
+static
+int compare_doubles(const void *one, const void *two)
+{
+    double a = *(const double*)one, b = *(const double*)two;
+    return (a > b) - (a < b);
+}
+
+static
+int compare_uint64s(const void *one, const void *two)
+{
+    uint64_t a = *(const uint64_t*)one, b = *(const uint64_t*)two;
+    return (a > b) - (a < b);
+}
+
+void add_result(const char *group, const char *suite, const char *operation, struct series *series)
+{
+    if (result_count == MAX_RESULTS || 0 == series->count)
+        return;
+
+    qsort(series->ns, series->count, sizeof(series->ns[0]), compare_doubles);
+    qsort(series->cycles, series->count, sizeof(series->cycles[0]), compare_uint64s);
+
+    // Nearest-rank percentiles
+    uint32_t p99_index = (series->count * 99 + 99) / 100 - 1;
+
+    results[result_count++] = (struct result){.group=group,
+                                              .suite=suite,
+                                              .operation=operation,
+                                              .count=series->count,
+                                              .median_ns=series->ns[series->count / 2],
+                                              .p99_ns=series->ns[p99_index],
+                                              .median_cycles=series->cycles[series->count / 2]};
+}
+
+/*
+ * One Identity handshake, between a client and server in this process.
+ *
+ * return:
+ *      STEP_COUNT on success
+ *      the step that failed, otherwise
+ */
+int run_handshake(xtt_suite_spec suite_spec, int timed)
+{
+    unsigned char client_to_server[1024];
+    unsigned char server_to_client[1024];
+    uint16_t length;
+    struct xtt_client_handshake_context client_ctx;
+    struct xtt_server_handshake_context server_ctx;
+    xtt_certificate_root_id claimed_root_id;
+    xtt_client_id client_id = requested_client_id;
+    xtt_client_id servers_view_of_client_id;
+    xtt_daa_group_id claimed_gid;
+    struct stamp start;
+
+#define TIMED_STEP(step, call)                                      \
+    do {                                                            \
+        take_stamp(&start);                                         \
+        if (XTT_ERROR_SUCCESS != (call))                            \
+            return (step);                                          \
+        if (timed)                                                  \
+            record_since(&step_series[(step)], &start);             \
+    } while (0)
+
+    if (XTT_ERROR_SUCCESS != xtt_initialize_client_handshake_context(&client_ctx, XTT_VERSION_ONE, suite_spec))
+        return STEP_BUILD_CLIENT_INIT;
+
+    TIMED_STEP(STEP_BUILD_CLIENT_INIT,
+               xtt_build_client_init(client_to_server, &length, &client_ctx));
+
+    TIMED_STEP(STEP_BUILD_SERVER_INIT_AND_ATTEST,
+               xtt_build_server_init_and_attest(server_to_client, &length, &server_ctx,
+                                                client_to_server, &cert_ctx, &cookie_ctx));
+
+    TIMED_STEP(STEP_PREPARSE_SERVER_INIT_AND_ATTEST,
+               xtt_preparse_serverinitandattest(&claimed_root_id, server_to_client, &client_ctx));
+
+    TIMED_STEP(STEP_BUILD_IDENTITY_CLIENT_ATTEST,
+               xtt_build_identity_client_attest(client_to_server, &length, server_to_client,
+                                                &root_certificate, &client_id, &server_id,
+                                                &daa_ctx, &client_ctx));
+
+    TIMED_STEP(STEP_PRE_PARSE_CLIENT_ATTEST,
+               xtt_pre_parse_client_attest(&servers_view_of_client_id, &claimed_gid,
+                                           client_to_server, &cookie_ctx, &server_ctx));
+
+    TIMED_STEP(STEP_BUILD_IDENTITY_SERVER_FINISHED,
+               xtt_build_identity_server_finished(server_to_client, &length, client_to_server,
+                                                  &servers_view_of_client_id, &gpk_ctx,
+                                                  &cert_ctx, &cookie_ctx, &server_ctx));
+
+    TIMED_STEP(STEP_PARSE_IDENTITY_SERVER_FINISHED,
+               xtt_parse_identity_server_finished(&client_id, server_to_client, &client_ctx));
+
+#undef TIMED_STEP
+
+    return STEP_COUNT;
+}
+
+int measure_primitive(const struct primitive *primitive)
+{
+    struct stamp start;
+
+    for (uint32_t i = 0; i < primitive->iterations / 16; ++i) {
+        if (0 != primitive->run())
+            return -1;
+    }
+
+    primitive_series.count = 0;
+    for (uint32_t i = 0; i < primitive->iterations; ++i) {
+        take_stamp(&start);
+        if (0 != primitive->run())
+            return -1;
+        record_since(&primitive_series, &start);
+    }
+
+    add_result("primitive", NULL, primitive->name, &primitive_series);
+
+    return 0;
+}
+
+void print_results(void)
+{
+    printf("%-10s %-26s %-36s %6s %12s %12s %12s\n",
+           "group", "suite", "operation", "n", "median(ns)", "p99(ns)", "cycles/op");
+    for (uint16_t i = 0; i < result_count; ++i) {
+        const struct result *result = &results[i];
+        printf("%-10s %-26s %-36s %6u %12.0f %12.0f ",
+               result->group,
+               result->suite ? result->suite : "-",
+               result->operation,
+               result->count,
+               result->median_ns,
+               result->p99_ns);
+#ifdef HAVE_CYCLE_COUNTER
+        printf("%12llu\n", (unsigned long long)result->median_cycles);
+#else
+        printf("%12s\n", "-");
+#endif
+    }
+}
+
+int write_json(const char *path)
+{
+    FILE *out = (0 == strcmp(path, "-")) ? stdout : fopen(path, "w");
+    if (NULL == out)
+        return -1;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"handshakes_per_suite\": %d,\n", HANDSHAKES_PER_SUITE);
+#ifdef HAVE_CYCLE_COUNTER
+    fprintf(out, "  \"cycle_counter\": \"tsc\",\n");
+#else
+    fprintf(out, "  \"cycle_counter\": null,\n");
+#endif
+    fprintf(out, "  \"results\": [\n");
+    for (uint16_t i = 0; i < result_count; ++i) {
+        const struct result *result = &results[i];
+        fprintf(out, "    {\"group\": \"%s\", ", result->group);
+        if (result->suite)
+            fprintf(out, "\"suite\": \"%s\", ", result->suite);
+        else
+            fprintf(out, "\"suite\": null, ");
+        fprintf(out, "\"operation\": \"%s\", \"n\": %u, \"median_ns\": %.1f, \"p99_ns\": %.1f, ",
+                result->operation, result->count, result->median_ns, result->p99_ns);
+#ifdef HAVE_CYCLE_COUNTER
+        fprintf(out, "\"cycles_per_op\": %llu}", (unsigned long long)result->median_cycles);
+#else
+        fprintf(out, "\"cycles_per_op\": null}");
+#endif
+        fprintf(out, "%s\n", (i + 1 < result_count) ? "," : "");
+    }
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    if (stdout == out)
+        return 0;
+    return (0 == fclose(out)) ? 0 : -1;
+}
+
+int always_available(void)
+{
+    return 1;
+}
+
+int run_x25519_key_pair(void)
+{
+    xtt_x25519_pub_key pub;
+    xtt_x25519_priv_key priv;
+    return xtt_crypto_create_x25519_key_pair(&pub, &priv);
+}
+
+int run_x25519_diffie_hellman(void)
+{
+    return xtt_crypto_do_x25519_diffie_hellman(x25519_shared_secret.data, &x25519_priv, &x25519_pub);
+}
+
+int run_ed25519_sign(void)
+{
+    return xtt_crypto_sign_ed25519(ed25519_signature.data, msg, sizeof(msg), &ed25519_priv);
+}
+
+int run_ed25519_verify(void)
+{
+    return xtt_crypto_verify_ed25519(ed25519_signature.data, msg, sizeof(msg), &ed25519_pub);
+}
+
+int run_lrsw_sign(void)
+{
+    return xtt_daa_sign_lrsw(lrsw_signature.data,
+                             msg,
+                             sizeof(msg),
+                             (unsigned char*)basename,
+                             (uint16_t)strlen(basename),
+                             &cred,
+                             &daa_priv_key);
+}
+
+int run_lrsw_verify(void)
+{
+    return gpk_ctx.verify_signature(lrsw_signature.data, msg, sizeof(msg), &gpk_ctx);
+}
+
+int run_chacha_encrypt(void)
+{
+    return xtt_crypto_aead_chacha_encrypt_detached(opened, mac_out, record, sizeof(record),
+                                                   NULL, 0, &chacha_nonce, &chacha_key);
+}
+
+int run_chacha_decrypt(void)
+{
+    return xtt_crypto_aead_chacha_decrypt_detached(opened, chacha_sealed, sizeof(chacha_sealed), chacha_mac,
+                                                   NULL, 0, &chacha_nonce, &chacha_key);
+}
+
+int run_aes256_encrypt(void)
+{
+    return xtt_crypto_aead_aes256_encrypt_detached(opened, mac_out, record, sizeof(record),
+                                                   NULL, 0, &aes256_nonce, &aes256_key);
+}
+
+int run_aes256_decrypt(void)
+{
+    return xtt_crypto_aead_aes256_decrypt_detached(opened, aes256_sealed, sizeof(aes256_sealed), aes256_mac,
+                                                   NULL, 0, &aes256_nonce, &aes256_key);
+}
+
+int run_hash_sha512(void)
+{
+    uint16_t digest_length;
+    return xtt_crypto_hash_sha512(digest, &digest_length, hash_input, sizeof(hash_input));
+}
+
+int run_hash_blake2b(void)
+{
+    uint16_t digest_length;
+    return xtt_crypto_hash_blake2b(digest, &digest_length, hash_input, sizeof(hash_input));
+}
+
+int run_prf_sha512(void)
+{
+    return xtt_crypto_prf_sha512(digest, PRF_OUTPUT_LENGTH, hash_input, sizeof(hash_input), msg, sizeof(msg));
+}
+
+int run_prf_blake2b(void)
+{
+    return xtt_crypto_prf_blake2b(digest, PRF_OUTPUT_LENGTH, hash_input, sizeof(hash_input), msg, sizeof(msg));
+}
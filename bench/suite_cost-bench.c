@@ -0,0 +1,209 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <xtt.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Measure, on this host, the parts of a handshake (and the records that follow it)
+ * that depend on the suite: the transcript hashes, the key-derivation PRFs,
+ * and the AEAD encryptions and decryptions.
+ *
+ * The costs are printed on the same scale as `xtt_crypto_suite_cost`,
+ * ready to go into a server's (or client's) `xtt_suite_preferences`.
+ */
+
+#define HANDSHAKES_PER_MEASUREMENT 2000
+#define RECORDS_PER_HANDSHAKE 16
+#define RECORD_LENGTH 1024
+#define HASH_LENGTH 64
+
+// hash_ext inputs hashed during a handshake (see bench/transcript_hash-bench.c)
+static const uint16_t hash_lengths[] = {2 + 70 + 38, 2 + HASH_LENGTH + 130, 2 + 70 + 168 + 136,
+                                        2 + HASH_LENGTH + 1 + 216, 2 + HASH_LENGTH + 1 + 280};
+
+// Encrypted parts of ServerInitAndAttest, Identity_ClientAttest and Identity_ServerFinished
+static const uint16_t handshake_message_lengths[] = {200, 280, 16};
+
+struct suite_functions {
+    xtt_suite_spec suite_spec;
+    const char *name;
+    int (*is_available)(void);
+    int (*hash)(unsigned char*, uint16_t*, const unsigned char*, uint16_t);
+    int (*prf)(unsigned char*, uint16_t, const unsigned char*, uint16_t, const unsigned char*, uint16_t);
+    int (*seal)(unsigned char*, unsigned char*, const unsigned char*, uint16_t, const unsigned char*);
+    int (*open)(unsigned char*, const unsigned char*, uint16_t, const unsigned char*, const unsigned char*);
+};
+
+static int seal_chacha(unsigned char* out, unsigned char* mac, const unsigned char* in, uint16_t len, const unsigned char* key);
+static int open_chacha(unsigned char* out, const unsigned char* in, uint16_t len, const unsigned char* mac, const unsigned char* key);
+static int seal_aes256(unsigned char* out, unsigned char* mac, const unsigned char* in, uint16_t len, const unsigned char* key);
+static int open_aes256(unsigned char* out, const unsigned char* in, uint16_t len, const unsigned char* mac, const unsigned char* key);
+
+static const struct suite_functions suites[XTT_SUITE_COUNT] = {
+    {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512, "CHACHA20POLY1305_SHA512",
+     xtt_crypto_aead_chacha_is_available, xtt_crypto_hash_sha512, xtt_crypto_prf_sha512, seal_chacha, open_chacha},
+    {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B, "CHACHA20POLY1305_BLAKE2B",
+     xtt_crypto_aead_chacha_is_available, xtt_crypto_hash_blake2b, xtt_crypto_prf_blake2b, seal_chacha, open_chacha},
+    {XTT_X25519_LRSW_ED25519_AES256GCM_SHA512, "AES256GCM_SHA512",
+     xtt_crypto_aead_aes256_is_available, xtt_crypto_hash_sha512, xtt_crypto_prf_sha512, seal_aes256, open_aes256},
+    {XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B, "AES256GCM_BLAKE2B",
+     xtt_crypto_aead_aes256_is_available, xtt_crypto_hash_blake2b, xtt_crypto_prf_blake2b, seal_aes256, open_aes256},
+};
+
+static const xtt_chacha_nonce nonce;
+static unsigned char key[32];
+static unsigned char input[RECORD_LENGTH];
+static unsigned char output[RECORD_LENGTH];
+static unsigned char mac[16];
+
+static double now_us(void);
+
+static double handshake_ns(const struct suite_functions *suite);
+
+int main()
+{
+    if (0 != xtt_crypto_initialize_crypto()) {
+        fprintf(stderr, "Error initializing crypto\n");
+        return 1;
+    }
+
+    xtt_crypto_get_random(key, sizeof(key));
+    xtt_crypto_get_random(input, sizeof(input));
+
+    double ns[XTT_SUITE_COUNT];
+    for (int i = 0; i < XTT_SUITE_COUNT; ++i) {
+        ns[i] = suites[i].is_available() ? handshake_ns(&suites[i]) : 0;
+        if (ns[i] < 0) {
+            fprintf(stderr, "Error running suite %s\n", suites[i].name);
+            return 1;
+        }
+    }
+
+    // Scaled so CHACHA20POLY1305_SHA512 costs 100, as in xtt_crypto_suite_cost.
+    printf("%26s %16s %10s %14s\n", "suite", "ns/handshake", "cost", "default_cost");
+    for (int i = 0; i < XTT_SUITE_COUNT; ++i) {
+        if (!suites[i].is_available()) {
+            printf("%26s %16s %10s %14s\n", suites[i].name, "unavailable", "-", "-");
+            continue;
+        }
+
+        printf("%26s %16.0f %10.0f %14u\n",
+               suites[i].name,
+               ns[i],
+               100 * ns[i] / ns[0],
+               xtt_crypto_suite_cost(suites[i].suite_spec));
+    }
+
+    printf("\npreference order:");
+    int printed[XTT_SUITE_COUNT] = {0};
+    for (int n = 0; n < XTT_SUITE_COUNT; ++n) {
+        int cheapest = -1;
+        for (int i = 0; i < XTT_SUITE_COUNT; ++i) {
+            if (!printed[i] && suites[i].is_available() && (cheapest < 0 || ns[i] < ns[cheapest]))
+                cheapest = i;
+        }
+        if (cheapest < 0)
+            break;
+        printed[cheapest] = 1;
+        printf(" %s", suites[cheapest].name);
+    }
+    printf("\n");
+
+    return 0;
+}
+
+int seal_chacha(unsigned char* out, unsigned char* mac_out, const unsigned char* in, uint16_t len, const unsigned char* key_in)
+{
+    return xtt_crypto_aead_chacha_encrypt_detached(out, mac_out, in, len, NULL, 0,
+                                                   &nonce, (const xtt_chacha_key*)key_in);
+}
+
+int open_chacha(unsigned char* out, const unsigned char* in, uint16_t len, const unsigned char* mac_in, const unsigned char* key_in)
+{
+    return xtt_crypto_aead_chacha_decrypt_detached(out, in, len, mac_in, NULL, 0,
+                                                   &nonce, (const xtt_chacha_key*)key_in);
+}
+
+int seal_aes256(unsigned char* out, unsigned char* mac_out, const unsigned char* in, uint16_t len, const unsigned char* key_in)
+{
+    return xtt_crypto_aead_aes256_encrypt_detached(out, mac_out, in, len, NULL, 0,
+                                                   (const xtt_aes256_nonce*)&nonce, (const xtt_aes256_key*)key_in);
+}
+
+int open_aes256(unsigned char* out, const unsigned char* in, uint16_t len, const unsigned char* mac_in, const unsigned char* key_in)
+{
+    return xtt_crypto_aead_aes256_decrypt_detached(out, in, len, mac_in, NULL, 0,
+                                                   (const xtt_aes256_nonce*)&nonce, (const xtt_aes256_key*)key_in);
+}
+
+double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+/*
+ * The suite-dependent work of one handshake, as done by both ends together,
+ * plus RECORDS_PER_HANDSHAKE records each way.
+ */
+double handshake_ns(const struct suite_functions *suite)
+{
+    unsigned char digest[HASH_LENGTH];
+    uint16_t digest_length;
+
+    double start = now_us();
+    for (int round = 0; round < HANDSHAKES_PER_MEASUREMENT; ++round) {
+        for (int side = 0; side < 2; ++side) {
+            for (size_t i = 0; i < sizeof(hash_lengths) / sizeof(hash_lengths[0]); ++i) {
+                if (0 != suite->hash(digest, &digest_length, input, hash_lengths[i]))
+                    return -1;
+            }
+
+            // handshake_secret, then the two keys and two IVs
+            for (int i = 0; i < 5; ++i) {
+                if (0 != suite->prf(output, 32, input, HASH_LENGTH + 24, key, HASH_LENGTH))
+                    return -1;
+            }
+        }
+
+        // Each handshake message is encrypted by one end and decrypted by the other.
+        for (size_t i = 0; i < sizeof(handshake_message_lengths) / sizeof(handshake_message_lengths[0]); ++i) {
+            if (0 != suite->seal(output, mac, input, handshake_message_lengths[i], key))
+                return -1;
+            if (0 != suite->open(output, output, handshake_message_lengths[i], mac, key))
+                return -1;
+        }
+
+        for (int i = 0; i < 2 * RECORDS_PER_HANDSHAKE; ++i) {
+            if (0 != suite->seal(output, mac, input, RECORD_LENGTH, key))
+                return -1;
+            if (0 != suite->open(output, output, RECORD_LENGTH, mac, key))
+                return -1;
+        }
+    }
+
+    return (now_us() - start) * 1e3 / HANDSHAKES_PER_MEASUREMENT;
+}
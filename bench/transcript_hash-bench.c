@@ -0,0 +1,196 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <xtt.h>
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Compare the per-handshake cost of the handshake's transcript hashes
+ * when each hash_ext input is first copied into one buffer and hashed in one shot,
+ * against feeding the pieces straight from the wire buffers into an incremental hash.
+ *
+ * Piece lengths are those of the Ed25519 identity suites.
+ */
+
+#define HANDSHAKES_PER_MEASUREMENT 20000
+#define HASH_LENGTH 64
+#define MAX_PIECES 5
+
+struct transcript_shape {
+    uint16_t piece_lengths[MAX_PIECES];
+};
+
+// hash_ext inputs hashed during one handshake
+static const struct transcript_shape key_hash_inner = {{70, 38}};    // ClientInit || ServerInitAndAttest-up-to-cookie
+static const struct transcript_shape key_hash_outer = {{HASH_LENGTH, 130}};  // inner-hash || cookie
+static const struct transcript_shape server_sig_hash = {{70, 168, 136}};
+static const struct transcript_shape longterm_sig_hash = {{HASH_LENGTH, 1, 136, 80}};
+static const struct transcript_shape daa_sig_hash = {{HASH_LENGTH, 1, 136, 80, 64}};
+
+struct hash_functions {
+    const char *name;
+    int (*hash)(unsigned char*, uint16_t*, const unsigned char*, uint16_t);
+    int (*init)(xtt_hash_state*);
+    int (*update)(xtt_hash_state*, const unsigned char*, uint16_t);
+    int (*final)(unsigned char*, uint16_t*, xtt_hash_state*);
+};
+
+static const struct hash_functions sha512 = {"sha512",
+                                             xtt_crypto_hash_sha512,
+                                             xtt_crypto_hash_sha512_init,
+                                             xtt_crypto_hash_sha512_update,
+                                             xtt_crypto_hash_sha512_final};
+
+static const struct hash_functions blake2b = {"blake2b",
+                                              xtt_crypto_hash_blake2b,
+                                              xtt_crypto_hash_blake2b_init,
+                                              xtt_crypto_hash_blake2b_update,
+                                              xtt_crypto_hash_blake2b_final};
+
+static unsigned char wire[1024];
+
+static double now_us(void);
+
+static int copy_then_hash(const struct hash_functions *funcs, const struct transcript_shape *shape);
+
+static int hash_incrementally(const struct hash_functions *funcs, const struct transcript_shape *shape);
+
+static double handshake_ns(const struct hash_functions *funcs,
+                           int (*method)(const struct hash_functions*, const struct transcript_shape*),
+                           int is_server);
+
+int main()
+{
+    if (0 != xtt_crypto_initialize_crypto()) {
+        fprintf(stderr, "Error initializing crypto\n");
+        return 1;
+    }
+
+    xtt_crypto_get_random(wire, sizeof(wire));
+
+    const struct hash_functions *all_funcs[] = {&sha512, &blake2b};
+
+    printf("%8s %8s %20s %20s %10s\n", "hash", "side", "copy_then_hash(ns)", "incremental(ns)", "speedup");
+    for (size_t i = 0; i < sizeof(all_funcs) / sizeof(all_funcs[0]); ++i) {
+        for (int is_server = 0; is_server <= 1; ++is_server) {
+            double before = handshake_ns(all_funcs[i], copy_then_hash, is_server);
+            double after = handshake_ns(all_funcs[i], hash_incrementally, is_server);
+            if (before < 0 || after < 0) {
+                fprintf(stderr, "Error hashing transcript\n");
+                return 1;
+            }
+
+            printf("%8s %8s %20.1f %20.1f %9.2fx\n",
+                   all_funcs[i]->name,
+                   is_server ? "server" : "client",
+                   before,
+                   after,
+                   before / after);
+        }
+    }
+
+    return 0;
+}
+
+double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+int copy_then_hash(const struct hash_functions *funcs, const struct transcript_shape *shape)
+{
+    unsigned char buffer[1024];
+    unsigned char digest[HASH_LENGTH];
+    uint16_t digest_length;
+
+    uint16_t total_length = 0;
+    for (int i = 0; i < MAX_PIECES; ++i)
+        total_length += shape->piece_lengths[i];
+
+    buffer[0] = total_length >> 8;
+    buffer[1] = total_length & 0xff;
+    unsigned char *out = buffer + 2;
+    const unsigned char *in = wire;
+    for (int i = 0; i < MAX_PIECES; ++i) {
+        memcpy(out, in, shape->piece_lengths[i]);
+        out += shape->piece_lengths[i];
+        in += shape->piece_lengths[i];
+    }
+
+    return funcs->hash(digest, &digest_length, buffer, out - buffer);
+}
+
+int hash_incrementally(const struct hash_functions *funcs, const struct transcript_shape *shape)
+{
+    xtt_hash_state state;
+    unsigned char digest[HASH_LENGTH];
+    uint16_t digest_length;
+
+    uint16_t total_length = 0;
+    for (int i = 0; i < MAX_PIECES; ++i)
+        total_length += shape->piece_lengths[i];
+
+    unsigned char length_prefix[2] = {total_length >> 8, total_length & 0xff};
+    if (0 != funcs->init(&state) || 0 != funcs->update(&state, length_prefix, sizeof(length_prefix)))
+        return -1;
+
+    const unsigned char *in = wire;
+    for (int i = 0; i < MAX_PIECES && 0 != shape->piece_lengths[i]; ++i) {
+        if (0 != funcs->update(&state, in, shape->piece_lengths[i]))
+            return -1;
+        in += shape->piece_lengths[i];
+    }
+
+    return funcs->final(digest, &digest_length, &state);
+}
+
+/*
+ * The client hashes each transcript once.
+ * The server also re-derives the key hash and server signature when it restores its context from the cookie.
+ */
+double handshake_ns(const struct hash_functions *funcs,
+                    int (*method)(const struct hash_functions*, const struct transcript_shape*),
+                    int is_server)
+{
+    const struct transcript_shape *client_shapes[] = {&key_hash_inner, &key_hash_outer, &server_sig_hash,
+                                                      &longterm_sig_hash, &daa_sig_hash};
+    const struct transcript_shape *server_shapes[] = {&key_hash_inner, &key_hash_outer, &server_sig_hash,
+                                                      &key_hash_inner, &key_hash_outer, &server_sig_hash,
+                                                      &longterm_sig_hash, &daa_sig_hash};
+    const struct transcript_shape **shapes = is_server ? server_shapes : client_shapes;
+    size_t shape_count = is_server ? sizeof(server_shapes) / sizeof(server_shapes[0])
+                                   : sizeof(client_shapes) / sizeof(client_shapes[0]);
+
+    double start = now_us();
+    for (int round = 0; round < HANDSHAKES_PER_MEASUREMENT; ++round) {
+        for (size_t i = 0; i < shape_count; ++i) {
+            if (0 != method(funcs, shapes[i]))
+                return -1;
+        }
+    }
+
+    return (now_us() - start) * 1e3 / HANDSHAKES_PER_MEASUREMENT;
+}
@@ -23,10 +23,15 @@
 #include <xtt/certificates.h>
 #include <xtt/context.h>
 #include <xtt/crypto_wrapper.h>
+#include <xtt/crypto_provider.h>
 #include <xtt/crypto_types.h>
 #include <xtt/daa_wrapper.h>
 #include <xtt/error_codes.h>
 #include <xtt/messages.h>
+#include <xtt/record.h>
+#include <xtt/key_pool.h>
+#include <xtt/server_engine.h>
+#include <xtt/stats.h>
 
 #endif
 
@@ -23,6 +23,7 @@
 #include <xtt/crypto_types.h>
 #include <xtt/error_codes.h>
 #include <xtt/certificates.h>
+#include <xtt/crypto_wrapper.h>
 #include <xtt/daa_wrapper.h>
 
 #ifndef SESSION_CONTEXT_BUFFER_SIZE
@@ -38,15 +39,33 @@
 #define MAX_BASENAME_LENGTH 64
 #endif
 
-#ifndef HASH_BUFFER_SIZE
-#define HASH_BUFFER_SIZE 1024
+// Must be a power of two.
+#ifndef XTT_COOKIE_REPLAY_FILTER_WORDS
+#define XTT_COOKIE_REPLAY_FILTER_WORDS (1 << 14)
 #endif
 
+// The widest replay window a session may have, in 64-bit words (see xtt_initialize_session_context).
+#define XTT_RECORD_REPLAY_WINDOW_MAX_WORDS 16
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-struct xtt_handshake_context {
+struct xtt_x25519_key_pool;
+
+struct xtt_handshake_context;
+struct xtt_server_handshake_context;
+struct xtt_client_handshake_context;
+
+#define XTT_HANDSHAKE_MAX_HASH_LENGTH 64
+
+/*
+ * Everything about a handshake that's fixed by its suite_spec.
+ *
+ * There's one (const) instance of this per suite,
+ * which every handshake context of that suite points to.
+ */
+struct xtt_handshake_suite {
     void (*copy_dh_pubkey)(unsigned char* out,
                            uint16_t* out_length,
                            const struct xtt_handshake_context* self);
@@ -55,6 +74,8 @@ struct xtt_handshake_context {
                              const unsigned char* other_pk,
                              const struct xtt_handshake_context* self);
 
+    int (*is_available)(void);
+
     int (*prf)(unsigned char* out,
                uint16_t out_len,
                const unsigned char* in,
@@ -62,6 +83,23 @@ struct xtt_handshake_context {
                const unsigned char* key,
                uint16_t key_len);
 
+    int (*prf_init)(xtt_prf_state* state,
+                    uint16_t out_len,
+                    const unsigned char* key,
+                    uint16_t key_len);
+
+    int (*prf_update)(xtt_prf_state* state,
+                      const unsigned char* in,
+                      uint16_t in_len);
+
+    int (*prf_final)(unsigned char* out,
+                     uint16_t out_len,
+                     xtt_prf_state* state);
+
+    int (*prf_copy)(xtt_prf_state* dst, const xtt_prf_state* src);
+
+    void (*prf_release)(xtt_prf_state* state);
+
     int (*encrypt)(unsigned char* ciphertext,
                    uint16_t* ciphertext_len,
                    const unsigned char* message,
@@ -83,8 +121,49 @@ struct xtt_handshake_context {
                 const unsigned char* in,
                 uint16_t in_len);
 
-    xtt_suite_spec suite_spec;
-    xtt_version version;
+    int (*hash_init)(xtt_hash_state* state);
+
+    int (*hash_update)(xtt_hash_state* state,
+                       const unsigned char* in,
+                       uint16_t in_len);
+
+    int (*hash_final)(unsigned char* out,
+                      uint16_t* out_length,
+                      xtt_hash_state* state);
+
+    void (*hash_release)(xtt_hash_state* state);
+
+    // Server side
+    void (*read_longterm_key)(struct xtt_server_handshake_context *self,
+                              uint16_t* key_length,
+                              unsigned char* key_in);
+
+    int (*verify_client_longterm_signature)(const unsigned char *signature,
+                                            const unsigned char *msg,
+                                            uint16_t msg_len,
+                                            const unsigned char *client_longterm_key);
+
+    int (*batch_verify_client_longterm_signatures)(int *results_out,
+                                                   const struct xtt_ed25519_verify_item *items,
+                                                   uint16_t item_count);
+
+    // Client side
+    int (*verify_server_signature)(const unsigned char *signature,
+                                   const unsigned char *msg,
+                                   uint16_t msg_len,
+                                   const unsigned char *server_public_key);
+
+    void (*copy_longterm_key)(unsigned char* out,
+                              uint16_t* out_length,
+                              const struct xtt_client_handshake_context *self);
+
+    int (*compare_longterm_keys)(unsigned char *other_key,
+                                 const struct xtt_client_handshake_context *self);
+
+    int (*longterm_sign)(unsigned char *signature_out,
+                         const unsigned char *msg,
+                         uint16_t msg_len,
+                         const struct xtt_client_handshake_context *self);
 
     uint16_t longterm_key_length;
     uint16_t longterm_key_signature_length;
@@ -93,6 +172,31 @@ struct xtt_handshake_context {
     uint16_t mac_length;
     uint16_t key_length;
     uint16_t iv_length;
+};
+
+/*
+ * Buffers that are only needed for the duration of a single call into the library.
+ *
+ * Unless a handshake context is given its own (via `xtt_handshake_context_use_scratch`),
+ * each thread uses a thread-local one.
+ */
+struct xtt_handshake_scratch {
+    unsigned char buffer[HANDSHAKE_CONTEXT_BUFFER_SIZE];
+    unsigned char hash_out_buffer[XTT_HANDSHAKE_MAX_HASH_LENGTH];
+    unsigned char shared_secret_buffer[sizeof(xtt_x25519_shared_secret)];
+    unsigned char handshake_secret[XTT_HANDSHAKE_MAX_HASH_LENGTH];
+};
+
+/*
+ * The state a handshake has to keep between messages.
+ */
+struct xtt_handshake_context {
+    const struct xtt_handshake_suite *suite;
+    struct xtt_handshake_scratch *scratch;  // NULL to use the calling thread's own.
+
+    xtt_suite_spec suite_spec;
+    xtt_version version;
+    unsigned char is_client;
 
     xtt_sequence_number tx_sequence_num;
     xtt_sequence_number rx_sequence_num;
@@ -121,57 +225,25 @@ struct xtt_handshake_context {
         xtt_aes256_nonce aes256;
     } tx_iv;
 
-    union {
-        xtt_sha512 sha512;
-        xtt_blake2b blake2b;
-    } hash_out_buffer_raw;
-    unsigned char *hash_out_buffer;
-
-    union {
-        xtt_sha512 sha512;
-        xtt_blake2b blake2b;
-    } inner_hash_raw;
-    unsigned char *inner_hash;
+    unsigned char inner_hash[XTT_HANDSHAKE_MAX_HASH_LENGTH];
 
-    union {
-        xtt_sha512 sha512;
-        xtt_blake2b blake2b;
-    } prf_key_raw;
-    unsigned char *prf_key;
-
-    union {
-        xtt_x25519_shared_secret x25519;
-    } shared_secret_raw;
-    unsigned char *shared_secret_buffer;
-
-    union {
-        xtt_sha512 sha512;
-        xtt_blake2b blake2b;
-    } handshake_secret_raw;
-    unsigned char *handshake_secret;
+    unsigned char session_secret[XTT_HANDSHAKE_MAX_HASH_LENGTH];   // The session's keys are derived from this.
 
     xtt_server_cookie server_cookie;
-    unsigned char hash_buffer[HASH_BUFFER_SIZE];
-    unsigned char client_init_buffer[80];
-    unsigned char server_initandattest_buffer[200];
-    unsigned char server_signature_buffer[sizeof(xtt_ed25519_signature)];
-    // TODO: properly size this
-    unsigned char clientattest_buffer[1024];
-    unsigned char buffer[HANDSHAKE_CONTEXT_BUFFER_SIZE];
     /* TODO: Add a state? (so we're sure where in a handshake a given ctx is) */
 };
 
 struct xtt_server_handshake_context {
     struct xtt_handshake_context base;
 
-    void (*read_longterm_key)(struct xtt_server_handshake_context *self,
-                              uint16_t* key_length,
-                              unsigned char* key_in);
+    unsigned char server_signature_buffer[sizeof(xtt_ed25519_signature)];
 
-    int (*verify_client_longterm_signature)(const unsigned char *signature,
-                                            const unsigned char *msg,
-                                            uint16_t msg_len,
-                                            const unsigned char *client_longterm_key);
+    // Decrypted part of the Identity_ClientAttest
+    unsigned char clientattest_buffer[sizeof(xtt_ed25519_pub_key)
+                                      + sizeof(xtt_ed25519_signature)
+                                      + sizeof(xtt_daa_group_id)
+                                      + sizeof(xtt_client_id)
+                                      + sizeof(xtt_daa_signature_lrsw)];
 
     union {
         xtt_ed25519_pub_key ed25519;
@@ -181,21 +253,20 @@ struct xtt_server_handshake_context {
 struct xtt_client_handshake_context {
     struct xtt_handshake_context base;
 
-    int (*verify_server_signature)(const unsigned char *signature,
-                                   const unsigned char *msg,
-                                   uint16_t msg_len,
-                                   const unsigned char *server_public_key);
-
-    void (*copy_longterm_key)(unsigned char* out,
-                              uint16_t* out_length,
-                              const struct xtt_client_handshake_context *self);
-
-    int (*compare_longterm_keys)(unsigned char *other_key,
-                                 const struct xtt_client_handshake_context *self);
-    int (*longterm_sign)(unsigned char *signature_out,
-                         const unsigned char *msg,
-                         uint16_t msg_len,
-                         const struct xtt_client_handshake_context *self);
+    // The ClientInit we sent
+    unsigned char client_init_buffer[sizeof(xtt_msg_type_raw)
+                                     + sizeof(xtt_length)
+                                     + sizeof(xtt_version_raw)
+                                     + sizeof(xtt_suite_spec_raw)
+                                     + sizeof(xtt_signing_nonce)
+                                     + sizeof(xtt_x25519_pub_key)];
+    // Decrypted part of the ServerInitAndAttest: the server's certificate (signed by its root), and its signature
+    unsigned char server_initandattest_buffer[sizeof(xtt_client_id)
+                                              + sizeof(xtt_certificate_expiry)
+                                              + sizeof(xtt_certificate_root_id)
+                                              + sizeof(xtt_ed25519_pub_key)
+                                              + sizeof(xtt_ed25519_signature)
+                                              + sizeof(xtt_ed25519_signature)];
 
     union {
         xtt_ed25519_pub_key ed25519;
@@ -205,8 +276,127 @@ struct xtt_client_handshake_context {
     } longterm_private_key;
 };
 
+/*
+ * The traffic state of an established session, for the record layer (see xtt/record.h).
+ *
+ * The IVs are kept as-is, so each record's nonce is just its IV with the sequence number XORed in.
+ *
+ * Received sequence numbers go through a sliding replay window (as in RFC 6479):
+ * a ring of bitmap words, advanced a whole word at a time,
+ * so checking and recording a record's sequence number touches a bounded number of words
+ * and never shifts the bitmap.
+ */
+struct xtt_session_context {
+    int (*seal)(unsigned char* mac_out,
+                unsigned char* data,
+                uint16_t data_len,
+                const unsigned char* addl_data,
+                uint16_t addl_len,
+                const unsigned char* nonce,
+                const struct xtt_session_context *self);
+
+    int (*open)(unsigned char* data,
+                uint16_t data_len,
+                const unsigned char* mac,
+                const unsigned char* addl_data,
+                uint16_t addl_len,
+                const unsigned char* nonce,
+                const struct xtt_session_context *self);
+
+    xtt_version version;
+    xtt_suite_spec suite_spec;
+
+    uint16_t mac_length;
+    uint16_t iv_length;
+
+    xtt_session_id session_id;
+
+    xtt_sequence_number tx_sequence_num;
+    xtt_sequence_number rx_sequence_num;    // One past the newest record received.
+
+    uint16_t rx_replay_window_words;                                // How many of the words below are in use.
+    uint64_t rx_replay_window[XTT_RECORD_REPLAY_WINDOW_MAX_WORDS];  // Bit (seq % 64) of word (seq / 64) % words
+                                                                    //  is set once seq has been received.
+    uint64_t replayed_records;
+    uint64_t too_old_records;
+
+    union {
+        xtt_chacha_key chacha;
+        xtt_aes256_key aes256;
+    } rx_key;
+    union {
+        xtt_chacha_nonce chacha;
+        xtt_aes256_nonce aes256;
+    } rx_iv;
+    union {
+        xtt_chacha_key chacha;
+        xtt_aes256_key aes256;
+    } tx_key;
+    union {
+        xtt_chacha_nonce chacha;
+        xtt_aes256_nonce aes256;
+    } tx_iv;
+
+    // The keys expanded once up front, for AEADs that have a key schedule.
+    union {
+        xtt_aes256_key_schedule aes256;
+    } rx_key_schedule;
+    union {
+        xtt_aes256_key_schedule aes256;
+    } tx_key_schedule;
+};
+
+struct xtt_session_stats {
+    uint64_t replayed_records;      // Records rejected as already received.
+    uint64_t too_old_records;       // Records rejected as too far behind the newest to tell.
+    uint32_t replay_window_size;    // How far behind the newest a record may be and still be accepted.
+};
+
+/*
+ * Remembers which ServerCookies have already been used, so replayed ClientAttests can be rejected.
+ *
+ * A blocked Bloom filter whose blocks are single 64-bit words:
+ * each cookie sets 6 bits within one word, so checking-and-recording it is a single atomic OR
+ * (and of two concurrent copies of the same cookie, exactly one gets through).
+ *
+ * Sized at 16 bits per cookie, i.e. XTT_COOKIE_REPLAY_FILTER_WORDS*4 cookies per epoch,
+ * at which point about 0.4% of fresh cookies are mistaken for replays.
+ */
+struct xtt_cookie_replay_filter {
+    uint64_t words[XTT_COOKIE_REPLAY_FILTER_WORDS];
+    uint64_t recorded;
+};
+
+/*
+ * Keys for sealing ServerCookies, and the filters of cookies already seen.
+ *
+ * Each cookie carries, AEAD-sealed, the state needed to rebuild the server's handshake context
+ * once the client's ClientAttest arrives (see `xtt_restore_server_handshake_context`),
+ * so a server needn't keep a context around for every half-open handshake.
+ *
+ * Cookies sealed under the current or the previous key are accepted, once each.
+ * A third slot holds the next key, so a rotation never rewrites a key (or filter) that's still accepted.
+ *
+ * The replay filters are large, so they're allocated separately
+ * (see `xtt_initialize_server_cookie_context` and `xtt_free_server_cookie_context`).
+ */
+#define XTT_SERVER_COOKIE_KEY_SLOTS 3
+
 struct xtt_server_cookie_context {
-    void *_;    // we're not currently using this context
+    uint32_t epoch;                                         // Epoch of the current key.
+    xtt_chacha_key keys[XTT_SERVER_COOKIE_KEY_SLOTS];       // Indexed by epoch % XTT_SERVER_COOKIE_KEY_SLOTS.
+    struct xtt_cookie_replay_filter *replay_filters;        // XTT_SERVER_COOKIE_KEY_SLOTS of them, indexed likewise.
+    uint64_t replays;
+};
+
+struct xtt_server_cookie_stats {
+    uint32_t epoch;                         // Epoch of the current key.
+    uint64_t recorded;                      // Cookies recorded under the current key.
+    uint64_t replays;                       // Cookies rejected as already-seen (false positives included).
+    uint64_t capacity;                      // Cookies per epoch the replay filter is sized for.
+    double expected_false_positive_rate;    // Chance that a fresh cookie would be mistaken for a replay,
+                                            //  given how full the current replay filter is now.
+    uint64_t bytes_per_million_cookies;     // Replay filter memory per million cookies, at capacity.
 };
 
 struct xtt_server_certificate_context {
@@ -240,12 +430,67 @@ struct xtt_daa_group_public_key_context {
                             unsigned char *msg,
                             uint16_t msg_len,
                             struct xtt_daa_group_public_key_context *self);
+    int (*batch_verify_signatures)(int *results_out,
+                                   const struct xtt_daa_verify_item *items,
+                                   uint16_t item_count,
+                                   struct xtt_daa_group_public_key_context *self);
     unsigned char basename[MAX_BASENAME_LENGTH];
     uint16_t basename_length;
 
     union {
         xtt_daa_group_pub_key_lrsw lrsw;
     } gpk;
+
+    // Deserialized and validated once, at initialization.
+    union {
+        xtt_daa_prepared_group_pub_key_lrsw lrsw;
+    } prepared_gpk;
+
+    // Optional, caller-owned (see xtt_precompute_daa_group_public_key_pairings_lrsw).
+    union {
+        const xtt_daa_pairing_tables_lrsw *lrsw;
+    } pairing_tables;
+};
+
+/*
+ * The inputs needed to verify the client's signatures in an IdentityClientAttest.
+ *
+ * Doesn't reference the server_handshake_context,
+ * so it can be handed to another thread while the handshake_context stays where it is.
+ */
+struct xtt_identity_verification_job {
+    struct xtt_daa_group_public_key_context *daa_group_pub_key_ctx;
+
+    int (*verify_client_longterm_signature)(const unsigned char *signature,
+                                            const unsigned char *msg,
+                                            uint16_t msg_len,
+                                            const unsigned char *client_longterm_key);
+    int (*batch_verify_client_longterm_signatures)(int *results_out,
+                                                   const struct xtt_ed25519_verify_item *items,
+                                                   uint16_t item_count);
+
+    uint16_t hash_length;
+
+    union {
+        xtt_sha512 sha512;
+        xtt_blake2b blake2b;
+    } daa_signature_hash;
+    union {
+        xtt_sha512 sha512;
+        xtt_blake2b blake2b;
+    } longterm_signature_hash;
+
+    union {
+        xtt_daa_signature_lrsw lrsw;
+    } daa_signature;
+    union {
+        xtt_ed25519_signature ed25519;
+    } longterm_signature;
+    union {
+        xtt_ed25519_pub_key ed25519;
+    } longterm_key;
+
+    xtt_error_code verdict;
 };
 
 struct xtt_daa_context {
@@ -265,19 +510,264 @@ struct xtt_daa_context {
     struct xtt_daa_tpm_context *tpm_context; // If using a TPM
 };
 
+/*
+ * The suites a server accepts, and what each costs it.
+ *
+ * The server hands its preferences to its clients out-of-band (e.g. with their provisioning),
+ * and each client uses `xtt_choose_suite` to pick the suite that's cheapest for the two of them.
+ * Either side's costs may be the defaults from `xtt_suite_preferences_from_host`,
+ * or measured on that host itself (e.g. with bench/suite_cost-bench).
+ */
+struct xtt_suite_preferences {
+    xtt_suite_spec suite_specs[XTT_SUITE_COUNT];
+    uint32_t costs[XTT_SUITE_COUNT];
+    uint16_t count;
+};
+
+/*
+ * Whether a suite can be used by this build of the library, on this CPU.
+ *
+ * Suites using AES-256-GCM need hardware AES support (see `xtt_crypto_aead_aes256_is_available`).
+ * Contexts can't be initialized for a suite that isn't available.
+ *
+ * Only meaningful after `xtt_crypto_initialize_crypto`.
+ *
+ * return:
+ *      1 if the suite is available
+ *      0 otherwise
+ */
+int
+xtt_crypto_suite_available(xtt_suite_spec suite_spec);
+
+/*
+ * Default relative cost of the parts of a handshake (and its records) that depend on the suite.
+ *
+ * Lower is cheaper; XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512 costs 100.
+ * These are fixed estimates, not measurements of this CPU (beyond whether the suite is available),
+ * so where the choice matters, measure instead (e.g. with bench/suite_cost-bench).
+ *
+ * return:
+ *      The suite's cost
+ *      UINT32_MAX if the suite isn't available
+ */
+uint32_t
+xtt_crypto_suite_cost(xtt_suite_spec suite_spec);
+
+/*
+ * Fill in `preferences_out` with every suite available here, cheapest first,
+ * at its `xtt_crypto_suite_cost`.
+ */
+void
+xtt_suite_preferences_from_host(struct xtt_suite_preferences *preferences_out);
+
+/*
+ * return:
+ *      1 if `suite_spec` is one of the `preferences`
+ *      0 otherwise
+ */
+int
+xtt_suite_preferences_allow(const struct xtt_suite_preferences *preferences,
+                            xtt_suite_spec suite_spec);
+
+/*
+ * Choose the suite for a client to use with a server,
+ * out of the server's preferences and those suites available here.
+ *
+ * The suite chosen is the one whose server cost plus local cost is least
+ * (the earliest in the server's preferences, if there's a tie).
+ *
+ * `client_preferences` gives the local costs, e.g. as measured on this host.
+ * If it's given, only suites in it are considered.
+ * If it's NULL, the local costs are the defaults from `xtt_crypto_suite_cost`.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if any argument is NULL
+ *      XTT_ERROR_UNKNOWN_SUITE_SPEC if none of the server's suites is available here
+ */
+xtt_error_code
+xtt_choose_suite(xtt_suite_spec *suite_spec_out,
+                 const struct xtt_suite_preferences *server_preferences,
+                 const struct xtt_suite_preferences *client_preferences);
+
 xtt_error_code
 xtt_initialize_server_handshake_context(struct xtt_server_handshake_context* ctx_out,
                                         xtt_version version,
                                         xtt_suite_spec suite_spec);
 
+/*
+ * Same as `xtt_initialize_server_handshake_context`,
+ * but takes the ephemeral Diffie-Hellman key pair from a pre-generated pool.
+ *
+ * If key_pool is NULL, a new key pair is generated.
+ */
+xtt_error_code
+xtt_initialize_server_handshake_context_from_key_pool(struct xtt_server_handshake_context* ctx_out,
+                                                      xtt_version version,
+                                                      xtt_suite_spec suite_spec,
+                                                      struct xtt_x25519_key_pool *key_pool);
+
 xtt_error_code
 xtt_initialize_client_handshake_context(struct xtt_client_handshake_context* ctx_out,
                                         xtt_version version,
                                         xtt_suite_spec suite_spec);
 
+/*
+ * Same as `xtt_initialize_client_handshake_context`,
+ * but uses an existing longterm key pair (rather than generating a new one),
+ * for a Session handshake.
+ */
+xtt_error_code
+xtt_initialize_session_client_handshake_context(struct xtt_client_handshake_context* ctx_out,
+                                                xtt_version version,
+                                                xtt_suite_spec suite_spec,
+                                                const xtt_ed25519_pub_key *longterm_key,
+                                                const xtt_ed25519_priv_key *longterm_private_key);
+
+/*
+ * Have a handshake context use `scratch` for its transient buffers,
+ * rather than the calling thread's own.
+ *
+ * `scratch` must outlive the handshake, and mustn't be used by two calls at once.
+ * Pass NULL to go back to the thread's own.
+ */
+void
+xtt_handshake_context_use_scratch(struct xtt_handshake_context *ctx,
+                                  struct xtt_handshake_scratch *scratch);
+
+/*
+ * Start a session from a finished handshake.
+ *
+ * The session gets its own client and server keys and IVs,
+ * derived from the handshake's session secret (never the handshake's traffic keys),
+ * so its sequence numbers start again from 0.
+ *
+ * Received records up to (replay_window_words-1)*64 behind the newest are still accepted.
+ * `replay_window_words` must be a power of two, from 2 to XTT_RECORD_REPLAY_WINDOW_MAX_WORDS.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if any argument is NULL
+ *      XTT_ERROR_INCORRECT_LENGTH if replay_window_words isn't allowed
+ *      XTT_ERROR_UNKNOWN_CRYPTO_SPEC if the handshake's suite_spec isn't known
+ *      XTT_ERROR_CRYPTO if the keys could not be expanded
+ */
+xtt_error_code
+xtt_initialize_session_context(struct xtt_session_context *ctx_out,
+                               const xtt_session_id *session_id,
+                               const struct xtt_handshake_context *handshake_ctx,
+                               uint16_t replay_window_words);
+
+void
+xtt_session_context_get_stats(struct xtt_session_stats *stats_out,
+                              const struct xtt_session_context *ctx);
+
+/*
+ * Exported handshake state is never longer than the context it came from.
+ */
+#define XTT_SERVER_HANDSHAKE_STATE_MAX_LENGTH sizeof(struct xtt_server_handshake_context)
+#define XTT_CLIENT_HANDSHAKE_STATE_MAX_LENGTH sizeof(struct xtt_client_handshake_context)
+
+/*
+ * Write the live state of a handshake as a self-contained, versioned byte string,
+ * so it can be picked up by another thread, process, or machine via
+ * `xtt_import_server_handshake_context`.
+ *
+ * The state includes the handshake's ephemeral private key and traffic keys,
+ * so it must be protected as such while in transit.
+ *
+ * The scratch area (see `xtt_handshake_context_use_scratch`) is not exported.
+ *
+ * out:
+ *      state_out       - At least XTT_SERVER_HANDSHAKE_STATE_MAX_LENGTH bytes.
+ *      state_length    - The number of bytes written.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if any argument is NULL
+ */
+xtt_error_code
+xtt_export_server_handshake_context(unsigned char *state_out,
+                                    uint16_t *state_length,
+                                    const struct xtt_server_handshake_context *ctx);
+
+/*
+ * Rebuild a handshake context from the output of `xtt_export_server_handshake_context`.
+ *
+ * The handshake then continues exactly as it would have with the original context.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if any argument is NULL
+ *      XTT_ERROR_UNKNOWN_VERSION if the state's format is from an unknown version of this library
+ *      XTT_ERROR_INCORRECT_TYPE if the state is from a client handshake
+ *      XTT_ERROR_UNKNOWN_CRYPTO_SPEC if the state's suite_spec isn't known
+ *      XTT_ERROR_INCORRECT_LENGTH if state_length doesn't match the state's contents
+ */
+xtt_error_code
+xtt_import_server_handshake_context(struct xtt_server_handshake_context *ctx_out,
+                                    const unsigned char *state,
+                                    uint16_t state_length);
+
+/*
+ * Same as `xtt_export_server_handshake_context`, for client handshakes.
+ *
+ * The client's longterm private key is included.
+ */
+xtt_error_code
+xtt_export_client_handshake_context(unsigned char *state_out,
+                                    uint16_t *state_length,
+                                    const struct xtt_client_handshake_context *ctx);
+
+/*
+ * Same as `xtt_import_server_handshake_context`, for client handshakes.
+ */
+xtt_error_code
+xtt_import_client_handshake_context(struct xtt_client_handshake_context *ctx_out,
+                                    const unsigned char *state,
+                                    uint16_t state_length);
+
+/*
+ * Pick fresh cookie keys, and allocate (empty) replay filters for them.
+ *
+ * Every initialized context MUST be freed with `xtt_free_server_cookie_context`.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if ctx is NULL
+ *      XTT_ERROR_BAD_INIT if the replay filters couldn't be allocated
+ */
 xtt_error_code
 xtt_initialize_server_cookie_context(struct xtt_server_cookie_context* ctx);
 
+/*
+ * Free the replay filters of a cookie context, and clear its keys.
+ *
+ * No other thread may be using the context.
+ */
+void
+xtt_free_server_cookie_context(struct xtt_server_cookie_context* ctx);
+
+/*
+ * Replace the oldest cookie key with a fresh one (and empty its replay filter),
+ * and make that the current key.
+ *
+ * After this, cookies sealed before the previous rotation get XTT_ERROR_COOKIE_ROTATION.
+ *
+ * May be called while other threads are using the context, but only from one thread at a time,
+ * and no more often than the longest a handshake is allowed to take.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if ctx is NULL
+ */
+xtt_error_code
+xtt_rotate_server_cookie_context(struct xtt_server_cookie_context* ctx);
+
+void
+xtt_server_cookie_context_get_stats(struct xtt_server_cookie_stats *stats_out,
+                                    const struct xtt_server_cookie_context *ctx);
+
 xtt_error_code
 xtt_initialize_server_certificate_context_ed25519(struct xtt_server_certificate_context *ctx_out,
                                                   const unsigned char *serialized_certificate,
@@ -288,12 +778,67 @@ xtt_initialize_server_root_certificate_context_ed25519(struct xtt_server_root_ce
                                                        xtt_certificate_root_id *id,
                                                        xtt_ed25519_pub_key *public_key);
 
+/*
+ * Initialize a context for verifying DAA signatures made under this group public key.
+ *
+ * The first call in a process also runs `xtt_daa_self_test_lrsw`.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_DAA if the DAA self-test fails (the batch verifiers disagree with ecdaa)
+ *      XTT_ERROR_BAD_INIT if the group public key or basename is invalid
+ */
 xtt_error_code
 xtt_initialize_daa_group_public_key_context_lrsw(struct xtt_daa_group_public_key_context *ctx_out,
                                                  const unsigned char *basename,
                                                  uint16_t basename_length,
                                                  xtt_daa_group_pub_key_lrsw *gpk);
 
+/*
+ * Precompute the Miller-loop lines for the fixed G2 points of this group public key,
+ * so that subsequent single and batch verifications only evaluate them.
+ *
+ * The tables are large (XTT_DAA_PAIRING_TABLES_LRSW_SIZE bytes),
+ * so the caller provides them, and must keep them alive for as long as the context is used.
+ * They may be shared (read-only) between threads.
+ *
+ * out:
+ *      tables                      - Filled with the precomputed lines.
+ *
+ * in/out:
+ *      ctx                         - An initialized DAA group public key context.
+ *                                    On success, it's switched to using the tables.
+ *                                    On failure, it's left unchanged.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_DAA if the tables fail their self-check
+ */
+xtt_error_code
+xtt_precompute_daa_group_public_key_pairings_lrsw(struct xtt_daa_group_public_key_context *ctx,
+                                                  xtt_daa_pairing_tables_lrsw *tables);
+
+/*
+ * Verify a batch of DAA signatures against one group public key.
+ *
+ * Each item carries its own message and basename.
+ * The pairings are shared across the batch, which makes this much cheaper per-signature
+ * than verifying the signatures one at a time.
+ *
+ * out:
+ *      results_out                 - One entry per item: 0 if that signature is valid, non-zero otherwise.
+ *                                    Assumed non-NULL and of length at least `item_count`.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS if every signature is valid
+ *      XTT_ERROR_BAD_SIGNATURE if any signature is invalid
+ */
+xtt_error_code
+xtt_batch_verify_daa_signatures(int *results_out,
+                                const struct xtt_daa_verify_item *items,
+                                uint16_t item_count,
+                                struct xtt_daa_group_public_key_context *daa_group_pub_key_ctx);
+
 xtt_error_code
 xtt_initialize_daa_context_lrswTPM(struct xtt_daa_context *ctx_out,
                                    xtt_daa_group_id *gid,
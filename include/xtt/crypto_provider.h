@@ -0,0 +1,201 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_CRYPTO_PROVIDER_H
+#define XTT_CRYPTO_PROVIDER_H
+#pragma once
+
+#include <xtt/crypto_types.h>
+#include <xtt/crypto_wrapper.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A table of implementations of the primitives behind crypto_wrapper.h.
+ *
+ * Every `xtt_crypto_*` function calls through the current provider,
+ * so the implementation can be chosen at runtime.
+ * Key pairs, and the AEADs' combined (ciphertext || MAC) forms, are built on top of these,
+ * so all of the library's randomness comes from `get_random`.
+ *
+ * Providers lay out hash, PRF, and AES-256-GCM key-schedule states differently
+ * (a hash or PRF state may be the provider's own context, or just a handle to one),
+ * so the provider must only be changed while no handshake or session context is in use.
+ *
+ * Each entry has the semantics of the `xtt_crypto_*` function of the same name.
+ */
+struct xtt_crypto_provider {
+    const char *name;
+
+    int (*initialize)(void);
+
+    int (*memcmp_ct)(const unsigned char *one, const unsigned char *two, uint16_t length);
+
+    void (*secure_clear)(unsigned char* memory, uint16_t memory_length);
+
+    int (*get_random)(unsigned char* buffer, uint16_t buffer_length);
+
+    int (*x25519_public_key)(xtt_x25519_pub_key *pub, const xtt_x25519_priv_key *priv);
+
+    int (*do_x25519_diffie_hellman)(unsigned char* shared_secret,
+                                    const xtt_x25519_priv_key* my_sk,
+                                    const xtt_x25519_pub_key* other_pk);
+
+    int (*hash_sha512_init)(xtt_hash_state* state);
+    int (*hash_sha512_update)(xtt_hash_state* state, const unsigned char* in, uint16_t in_len);
+    int (*hash_sha512_final)(unsigned char* out, uint16_t* out_length, xtt_hash_state* state);
+
+    int (*hash_blake2b_init)(xtt_hash_state* state);
+    int (*hash_blake2b_update)(xtt_hash_state* state, const unsigned char* in, uint16_t in_len);
+    int (*hash_blake2b_final)(unsigned char* out, uint16_t* out_length, xtt_hash_state* state);
+
+    int (*hash_copy)(xtt_hash_state* dst, const xtt_hash_state* src);
+    void (*hash_release)(xtt_hash_state* state);
+
+    int (*prf_sha512_init)(xtt_prf_state* state, uint16_t out_len, const unsigned char* key, uint16_t key_len);
+    int (*prf_sha512_update)(xtt_prf_state* state, const unsigned char* in, uint16_t in_len);
+    int (*prf_sha512_final)(unsigned char* out, uint16_t out_len, xtt_prf_state* state);
+
+    int (*prf_blake2b_init)(xtt_prf_state* state, uint16_t out_len, const unsigned char* key, uint16_t key_len);
+    int (*prf_blake2b_update)(xtt_prf_state* state, const unsigned char* in, uint16_t in_len);
+    int (*prf_blake2b_final)(unsigned char* out, uint16_t out_len, xtt_prf_state* state);
+
+    int (*prf_copy)(xtt_prf_state* dst, const xtt_prf_state* src);
+    void (*prf_release)(xtt_prf_state* state);
+
+    // `seed` is the first half of the private key (the second being the public key).
+    int (*ed25519_key_pair_from_seed)(xtt_ed25519_pub_key *pub_key,
+                                      xtt_ed25519_priv_key *priv_key,
+                                      const unsigned char seed[32]);
+
+    int (*sign_ed25519)(unsigned char* signature_out,
+                        const unsigned char* msg,
+                        uint16_t msg_len,
+                        const xtt_ed25519_priv_key* priv_key);
+
+    int (*verify_ed25519)(const unsigned char* signature,
+                          const unsigned char* msg,
+                          uint16_t msg_len,
+                          const xtt_ed25519_pub_key* pub_key);
+
+    int (*batch_verify_ed25519)(int *results_out,
+                                const struct xtt_ed25519_verify_item *items,
+                                uint16_t item_count);
+
+    int (*aead_chacha_is_available)(void);
+
+    int (*aead_aes256_is_available)(void);
+
+    int (*aead_chacha_encrypt_detached)(unsigned char* ciphertext,
+                                        unsigned char* mac_out,
+                                        const unsigned char* message,
+                                        uint16_t msg_len,
+                                        const unsigned char* addl_data,
+                                        uint16_t addl_len,
+                                        const xtt_chacha_nonce* nonce,
+                                        const xtt_chacha_key* key);
+
+    int (*aead_chacha_decrypt_detached)(unsigned char* decrypted,
+                                        const unsigned char* ciphertext,
+                                        uint16_t ciphertext_len,
+                                        const unsigned char* mac,
+                                        const unsigned char* addl_data,
+                                        uint16_t addl_len,
+                                        const xtt_chacha_nonce* nonce,
+                                        const xtt_chacha_key* key);
+
+    int (*aead_aes256_encrypt_detached)(unsigned char* ciphertext,
+                                        unsigned char* mac_out,
+                                        const unsigned char* message,
+                                        uint16_t msg_len,
+                                        const unsigned char* addl_data,
+                                        uint16_t addl_len,
+                                        const xtt_aes256_nonce* nonce,
+                                        const xtt_aes256_key* key);
+
+    int (*aead_aes256_decrypt_detached)(unsigned char* decrypted,
+                                        const unsigned char* ciphertext,
+                                        uint16_t ciphertext_len,
+                                        const unsigned char* mac,
+                                        const unsigned char* addl_data,
+                                        uint16_t addl_len,
+                                        const xtt_aes256_nonce* nonce,
+                                        const xtt_aes256_key* key);
+
+    int (*aead_aes256_expand_key)(xtt_aes256_key_schedule* schedule_out,
+                                  const xtt_aes256_key* key);
+
+    int (*aead_aes256_encrypt_detached_expanded)(unsigned char* ciphertext,
+                                                 unsigned char* mac_out,
+                                                 const unsigned char* message,
+                                                 uint16_t msg_len,
+                                                 const unsigned char* addl_data,
+                                                 uint16_t addl_len,
+                                                 const xtt_aes256_nonce* nonce,
+                                                 const xtt_aes256_key_schedule* schedule);
+
+    int (*aead_aes256_decrypt_detached_expanded)(unsigned char* decrypted,
+                                                 const unsigned char* ciphertext,
+                                                 uint16_t ciphertext_len,
+                                                 const unsigned char* mac,
+                                                 const unsigned char* addl_data,
+                                                 uint16_t addl_len,
+                                                 const xtt_aes256_nonce* nonce,
+                                                 const xtt_aes256_key_schedule* schedule);
+};
+
+/*
+ * Look up a provider built into this library ("libsodium" or "openssl",
+ * depending on the USE_LIBSODIUM and USE_OPENSSL build options).
+ *
+ * return:
+ *      The provider, or NULL if no provider of that name was built
+ */
+const struct xtt_crypto_provider* xtt_crypto_find_provider(const char *name);
+
+/*
+ * The provider currently in use.
+ *
+ * Until `xtt_crypto_set_provider` is called, this is libsodium if it was built, and OpenSSL otherwise.
+ */
+const struct xtt_crypto_provider* xtt_crypto_get_provider(void);
+
+/*
+ * Switch to, and initialize, a provider (a built-in one, or the caller's own).
+ *
+ * Not thread-safe: call this before starting any threads that use the library,
+ * and only while no handshake or session context is in use.
+ * The provider must outlive its use.
+ *
+ * A library built with XTT_FIXED_SUITE and only one of USE_LIBSODIUM and USE_OPENSSL
+ * always runs handshake transcripts and key derivation on that built-in provider's hash and PRF,
+ * whichever provider is set.
+ *
+ * return:
+ *      0 on success
+ *      the provider's `initialize` error otherwise (in which case the current provider is unchanged)
+ */
+int xtt_crypto_set_provider(const struct xtt_crypto_provider *provider);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
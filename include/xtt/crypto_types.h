@@ -37,6 +37,8 @@ typedef enum xtt_suite_spec {
     XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B          = 0x0004
 } xtt_suite_spec;
 
+#define XTT_SUITE_COUNT 4
+
 typedef enum xtt_msg_type {
     XTT_CLIENTINIT_MSG                                      = 0x01,
     XTT_SERVERINITANDATTEST_MSG                             = 0x02,
@@ -45,7 +47,7 @@ typedef enum xtt_msg_type {
     XTT_ID_SERVERFINISHED_MSG                               = 0x13,
 
     XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG                  = 0x21,
-    XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG                    = 0x22,
+    XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG                    = 0x22,    // Not supported (see xtt_pre_parse_client_attest)
     XTT_SESSION_SERVERFINISHED_MSG                          = 0x23,
 
     XTT_RECORD_REGULAR_MSG                                  = 0x31,
@@ -108,12 +110,20 @@ typedef struct {unsigned char data[16];} xtt_chacha_mac;
 typedef struct {unsigned char data[32];} xtt_aes256_key;
 typedef struct {unsigned char data[12];} xtt_aes256_nonce;
 typedef struct {unsigned char data[16];} xtt_aes256_mac;
+/* Expanded AES-256-GCM key (round keys and GHASH table), for many messages under one key */
+typedef struct {unsigned char data[512];} __attribute__((aligned(16))) xtt_aes256_key_schedule;
 
 /* Hash/HMAC/KDF */
 typedef struct {unsigned char data[64];} xtt_sha512;
 
 typedef struct {unsigned char data[64];} xtt_blake2b;
 
+/* Incremental hash state, big (and aligned) enough for any of the hashes above, under any crypto provider */
+typedef struct {unsigned char data[384];} __attribute__((aligned(64))) xtt_hash_state;
+
+/* Incremental keyed-PRF state, big (and aligned) enough for any of the PRFs, under any crypto provider */
+typedef struct {unsigned char data[416];} __attribute__((aligned(64))) xtt_prf_state;
+
 #ifdef __cplusplus
 }
 #endif
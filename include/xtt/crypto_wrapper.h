@@ -26,6 +26,9 @@
 extern "C" {
 #endif
 
+/*
+ * Initialize the current crypto provider (see crypto_provider.h).
+ */
 int xtt_crypto_initialize_crypto();
 
 int xtt_crypto_memcmp(const unsigned char *one, const unsigned char *two, uint16_t length);
@@ -36,6 +39,8 @@ int xtt_crypto_get_random(unsigned char* buffer, uint16_t buffer_length);
 
 int xtt_crypto_create_x25519_key_pair(xtt_x25519_pub_key *pub, xtt_x25519_priv_key *priv);
 
+int xtt_crypto_x25519_public_key(xtt_x25519_pub_key *pub, const xtt_x25519_priv_key *priv);
+
 int xtt_crypto_do_x25519_diffie_hellman(unsigned char* shared_secret,
                                         const xtt_x25519_priv_key* my_sk,
                                         const xtt_x25519_pub_key* other_pk);
@@ -50,6 +55,51 @@ int xtt_crypto_hash_blake2b(unsigned char* out,
                             const unsigned char* in,
                             uint16_t in_len);
 
+/*
+ * Incremental versions of the above,
+ * for hashing an input that's in pieces without first copying it together.
+ *
+ * `_final` gives the same digest as the one-shot hash of everything passed to `_update`.
+ *
+ * A state may hold resources owned by the crypto provider, from a successful `_init` until `_final`
+ * (which frees them whether or not it succeeds).
+ * A state that won't be finished, e.g. because an `_update` failed, must be passed to `xtt_crypto_hash_release`.
+ */
+int xtt_crypto_hash_sha512_init(xtt_hash_state* state);
+
+int xtt_crypto_hash_sha512_update(xtt_hash_state* state,
+                                  const unsigned char* in,
+                                  uint16_t in_len);
+
+int xtt_crypto_hash_sha512_final(unsigned char* out,
+                                 uint16_t* out_length,
+                                 xtt_hash_state* state);
+
+int xtt_crypto_hash_blake2b_init(xtt_hash_state* state);
+
+int xtt_crypto_hash_blake2b_update(xtt_hash_state* state,
+                                   const unsigned char* in,
+                                   uint16_t in_len);
+
+int xtt_crypto_hash_blake2b_final(unsigned char* out,
+                                  uint16_t* out_length,
+                                  xtt_hash_state* state);
+
+/*
+ * Copy a state part-way through, so each copy can be continued and finished on its own.
+ * Structure assignment doesn't do this, since the copies would share the provider's resources.
+ *
+ * If this fails, `dst` needn't (but may) be released.
+ */
+int xtt_crypto_hash_copy(xtt_hash_state* dst, const xtt_hash_state* src);
+
+/*
+ * Free (and clear) a state that won't be finished.
+ *
+ * Does nothing to a state that's already been finished, or whose `_init` failed.
+ */
+void xtt_crypto_hash_release(xtt_hash_state* state);
+
 int xtt_crypto_prf_sha512(unsigned char* out,
                           uint16_t out_len,
                           const unsigned char* in,
@@ -64,6 +114,46 @@ int xtt_crypto_prf_blake2b(unsigned char* out,
                            const unsigned char* key,
                            uint16_t key_len);
 
+/*
+ * Incremental versions of the above.
+ *
+ * Once a state has been keyed (and fed any input common to several outputs),
+ * it can be copied with `xtt_crypto_prf_copy`, and each copy continued from there without redoing that work.
+ *
+ * `out_len` must be the same in `_init` and `_final`.
+ *
+ * As with the hash states, a PRF state that won't be finished must be passed to `xtt_crypto_prf_release`.
+ */
+int xtt_crypto_prf_sha512_init(xtt_prf_state* state,
+                               uint16_t out_len,
+                               const unsigned char* key,
+                               uint16_t key_len);
+
+int xtt_crypto_prf_sha512_update(xtt_prf_state* state,
+                                 const unsigned char* in,
+                                 uint16_t in_len);
+
+int xtt_crypto_prf_sha512_final(unsigned char* out,
+                                uint16_t out_len,
+                                xtt_prf_state* state);
+
+int xtt_crypto_prf_blake2b_init(xtt_prf_state* state,
+                                uint16_t out_len,
+                                const unsigned char* key,
+                                uint16_t key_len);
+
+int xtt_crypto_prf_blake2b_update(xtt_prf_state* state,
+                                  const unsigned char* in,
+                                  uint16_t in_len);
+
+int xtt_crypto_prf_blake2b_final(unsigned char* out,
+                                 uint16_t out_len,
+                                 xtt_prf_state* state);
+
+int xtt_crypto_prf_copy(xtt_prf_state* dst, const xtt_prf_state* src);
+
+void xtt_crypto_prf_release(xtt_prf_state* state);
+
 int xtt_crypto_create_ed25519_key_pair(xtt_ed25519_pub_key *pub_key,
                                        xtt_ed25519_priv_key *priv_key);
 
@@ -77,6 +167,52 @@ int xtt_crypto_verify_ed25519(const unsigned char* signature,
                               uint16_t msg_len,
                               const xtt_ed25519_pub_key* pub_key);
 
+struct xtt_ed25519_verify_item {
+    const unsigned char *signature;
+    const unsigned char *msg;
+    uint16_t msg_len;
+    const xtt_ed25519_pub_key *pub_key;
+};
+
+/*
+ * Verify a batch of Ed25519 signatures, each with its own message and public key.
+ *
+ * The signatures are checked together, with one multi-scalar multiplication per chunk.
+ * If a chunk fails, each half of it is checked the same way, down to single signatures,
+ * to find which are bad.
+ *
+ * The combined check uses the cofactored verification equation,
+ * so signatures whose R or public key isn't in the prime-order subgroup
+ * (which honest signers never produce) are kept out of it and verified one at a time.
+ * Each result is therefore the same as `xtt_crypto_verify_ed25519` would give.
+ *
+ * out:
+ *      results_out                 - One entry per item: 0 if that signature is valid, non-zero otherwise.
+ *
+ * return:
+ *      0 if every signature is valid
+ *      -1 otherwise
+ */
+int xtt_crypto_batch_verify_ed25519(int *results_out,
+                                    const struct xtt_ed25519_verify_item *items,
+                                    uint16_t item_count);
+
+/*
+ * Whether an AEAD can be used on this CPU.
+ *
+ * ChaCha20-Poly1305 always can.
+ * AES-256-GCM needs hardware AES and carry-less multiplication (AES-NI and PCLMUL on x86).
+ *
+ * Only meaningful after `xtt_crypto_initialize_crypto`.
+ *
+ * return:
+ *      1 if the AEAD is available
+ *      0 otherwise
+ */
+int xtt_crypto_aead_chacha_is_available(void);
+
+int xtt_crypto_aead_aes256_is_available(void);
+
 int xtt_crypto_aead_chacha_encrypt(unsigned char* ciphertext,
                                    uint16_t* ciphertext_len,
                                    const unsigned char* message,
@@ -113,6 +249,79 @@ int xtt_crypto_aead_aes256_decrypt(unsigned char* decrypted,
                                    const xtt_aes256_nonce* nonce,
                                    const xtt_aes256_key* key);
 
+/*
+ * Detached-MAC variants of the above, for the record layer.
+ *
+ * The ciphertext is the same length as the message, and the MAC goes to its own buffer,
+ * so encryption and decryption may be done in place (ciphertext == message).
+ *
+ * If decryption fails, the contents of the output are unspecified.
+ */
+int xtt_crypto_aead_chacha_encrypt_detached(unsigned char* ciphertext,
+                                            unsigned char* mac_out,
+                                            const unsigned char* message,
+                                            uint16_t msg_len,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_chacha_nonce* nonce,
+                                            const xtt_chacha_key* key);
+
+int xtt_crypto_aead_chacha_decrypt_detached(unsigned char* decrypted,
+                                            const unsigned char* ciphertext,
+                                            uint16_t ciphertext_len,
+                                            const unsigned char* mac,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_chacha_nonce* nonce,
+                                            const xtt_chacha_key* key);
+
+int xtt_crypto_aead_aes256_encrypt_detached(unsigned char* ciphertext,
+                                            unsigned char* mac_out,
+                                            const unsigned char* message,
+                                            uint16_t msg_len,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_aes256_nonce* nonce,
+                                            const xtt_aes256_key* key);
+
+int xtt_crypto_aead_aes256_decrypt_detached(unsigned char* decrypted,
+                                            const unsigned char* ciphertext,
+                                            uint16_t ciphertext_len,
+                                            const unsigned char* mac,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_aes256_nonce* nonce,
+                                            const xtt_aes256_key* key);
+
+/*
+ * Expand an AES-256-GCM key once, for use by the `_expanded` variants below,
+ * so encrypting each message doesn't redo the key expansion.
+ *
+ * return:
+ *      0 on success
+ *      -1 if AES-256-GCM isn't available on this CPU
+ */
+int xtt_crypto_aead_aes256_expand_key(xtt_aes256_key_schedule* schedule_out,
+                                      const xtt_aes256_key* key);
+
+int xtt_crypto_aead_aes256_encrypt_detached_expanded(unsigned char* ciphertext,
+                                                     unsigned char* mac_out,
+                                                     const unsigned char* message,
+                                                     uint16_t msg_len,
+                                                     const unsigned char* addl_data,
+                                                     uint16_t addl_len,
+                                                     const xtt_aes256_nonce* nonce,
+                                                     const xtt_aes256_key_schedule* schedule);
+
+int xtt_crypto_aead_aes256_decrypt_detached_expanded(unsigned char* decrypted,
+                                                     const unsigned char* ciphertext,
+                                                     uint16_t ciphertext_len,
+                                                     const unsigned char* mac,
+                                                     const unsigned char* addl_data,
+                                                     uint16_t addl_len,
+                                                     const xtt_aes256_nonce* nonce,
+                                                     const xtt_aes256_key_schedule* schedule);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,12 +22,47 @@
 
 #include <xtt/crypto_types.h>
 
+/*
+ * Large enough to hold the DAA library's native (deserialized and validated) form of a group public key.
+ * Checked at compile-time by the DAA wrapper.
+ */
+#ifndef XTT_DAA_PREPARED_GROUP_PUB_KEY_LRSW_SIZE
+#define XTT_DAA_PREPARED_GROUP_PUB_KEY_LRSW_SIZE 1024
+#endif
+
+/*
+ * Large enough to hold the precomputed Miller-loop lines for the fixed G2 points
+ * of one group public key (the G2 generator, X, and Y).
+ * Checked at compile-time by the DAA wrapper.
+ */
+#ifndef XTT_DAA_PAIRING_TABLES_LRSW_SIZE
+#define XTT_DAA_PAIRING_TABLES_LRSW_SIZE (128*1024)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct xtt_daa_tpm_context;
 
+typedef union {
+    unsigned char data[XTT_DAA_PREPARED_GROUP_PUB_KEY_LRSW_SIZE];
+    uint64_t alignment_;
+} xtt_daa_prepared_group_pub_key_lrsw;
+
+typedef union {
+    unsigned char data[XTT_DAA_PAIRING_TABLES_LRSW_SIZE];
+    uint64_t alignment_;
+} xtt_daa_pairing_tables_lrsw;
+
+struct xtt_daa_verify_item {
+    unsigned char *signature;
+    unsigned char *msg;
+    uint16_t msg_len;
+    unsigned char *basename;
+    uint16_t basename_len;
+};
+
 int
 xtt_daa_sign_lrswTPM(unsigned char *signature_out,
                      const unsigned char *msg,
@@ -54,6 +89,115 @@ xtt_daa_verify_lrswTPM(unsigned char* signature,
                        uint16_t basename_len,
                        xtt_daa_group_pub_key_lrsw* gpk);
 
+/*
+ * Deserialize and validate a group public key once,
+ * so it can be used for any number of calls to `xtt_daa_verify_lrswTPM_prepared`.
+ *
+ * Returns 0 on success, non-zero if the group public key is invalid.
+ */
+int
+xtt_daa_prepare_group_public_key_lrsw(xtt_daa_prepared_group_pub_key_lrsw *prepared_gpk_out,
+                                      xtt_daa_group_pub_key_lrsw *gpk);
+
+/*
+ * Same as `xtt_daa_verify_lrswTPM`, but using an already-prepared group public key.
+ *
+ * The prepared key is only read, so may be shared between threads.
+ */
+int
+xtt_daa_verify_lrswTPM_prepared(unsigned char* signature,
+                                unsigned char* msg,
+                                uint16_t msg_len,
+                                unsigned char *basename,
+                                uint16_t basename_len,
+                                const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk);
+
+/*
+ * Verify a batch of signatures made under the same (prepared) group public key.
+ *
+ * The pairing equations of all the signatures are combined, using random 64-bit exponents,
+ * so the batch shares one set of pairings. If the combined check fails,
+ * the batch is bisected to find the bad signatures.
+ *
+ * out:
+ *      results_out         - One entry per item: 0 if that signature is valid, non-zero otherwise.
+ *
+ * Returns 0 if every signature is valid, non-zero otherwise.
+ */
+int
+xtt_daa_batch_verify_lrswTPM_prepared(int *results_out,
+                                      const struct xtt_daa_verify_item *items,
+                                      uint16_t item_count,
+                                      const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk);
+
+/*
+ * Same as `xtt_daa_batch_verify_lrswTPM_prepared`,
+ * but the combined pairings use tables from `xtt_daa_precompute_pairing_tables_lrsw`.
+ * (A signature left on its own by the bisection is still verified by ecdaa.)
+ *
+ * If tables is NULL, this is just `xtt_daa_batch_verify_lrswTPM_prepared`.
+ */
+int
+xtt_daa_batch_verify_lrswTPM_precomputed(int *results_out,
+                                         const struct xtt_daa_verify_item *items,
+                                         uint16_t item_count,
+                                         const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                                         const xtt_daa_pairing_tables_lrsw* tables);
+
+/*
+ * The per-signature checks the batch verifiers do before combining the pairing equations:
+ * that the signature deserializes, that R and S aren't the identity, and that its Schnorr proof checks out.
+ *
+ * ecdaa doesn't expose its own Schnorr verification, so this re-implements its transcript.
+ * It's exposed so it can be checked against ecdaa's verify (see `xtt_daa_self_test_lrsw`).
+ *
+ * Returns 0 if the checks pass, non-zero otherwise.
+ */
+int
+xtt_daa_check_schnorr_lrsw(const struct xtt_daa_verify_item *item);
+
+/*
+ * Check `xtt_daa_check_schnorr_lrsw` and the combined pairing check against ecdaa:
+ * fresh signatures from ecdaa must pass both them and ecdaa's own verify,
+ * and the same signatures over another message or basename must fail all of them.
+ *
+ * It only runs once per process (later calls return the first result),
+ * and group public key contexts can't be initialized unless it passes.
+ *
+ * Returns 0 if the checks agree with ecdaa, non-zero otherwise.
+ */
+int
+xtt_daa_self_test_lrsw(void);
+
+/*
+ * Precompute the Miller-loop line functions for the fixed G2 points of a (prepared) group public key,
+ * so every later pairing against them only has to evaluate the lines at the G1 point.
+ *
+ * This is worth it for a group public key that's used for many verifications:
+ * the tables take a few milliseconds to build, and are checked against a regular pairing before being returned.
+ *
+ * Returns 0 on success, non-zero otherwise (in which case the tables MUST NOT be used).
+ */
+int
+xtt_daa_precompute_pairing_tables_lrsw(xtt_daa_pairing_tables_lrsw *tables_out,
+                                       const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk);
+
+/*
+ * Same as `xtt_daa_verify_lrswTPM_prepared`, for callers that have precomputed pairing tables.
+ *
+ * A single signature is always verified by ecdaa itself: the tables only speed up batches.
+ *
+ * The tables are only read, so may be shared between threads.
+ */
+int
+xtt_daa_verify_lrswTPM_precomputed(unsigned char* signature,
+                                   unsigned char* msg,
+                                   uint16_t msg_len,
+                                   unsigned char *basename,
+                                   uint16_t basename_len,
+                                   const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                                   const xtt_daa_pairing_tables_lrsw* tables);
+
 #ifdef __cplusplus
 }
 #endif
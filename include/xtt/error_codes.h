@@ -48,9 +48,14 @@ typedef enum xtt_error_code {
     XTT_ERROR_WANT_READ,
     XTT_ERROR_RECORD_FAILED_CRYPTO,
     XTT_ERROR_BAD_FINISH,
-    XTT_ERROR_CONTEXT_BUFFER_OVERFLOW
+    XTT_ERROR_CONTEXT_BUFFER_OVERFLOW,
+    XTT_ERROR_RECORD_REPLAYED,
+    XTT_ERROR_RECORD_TOO_OLD,
+    XTT_ERROR_UNSUPPORTED_MESSAGE
 } xtt_error_code;
 
+#define XTT_ERROR_CODE_COUNT (XTT_ERROR_UNSUPPORTED_MESSAGE + 1)
+
 void xtt_strerror(xtt_error_code errnum, char* buffer, size_t buflen);
 
 #ifdef __cplusplus
@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_KEY_POOL_H
+#define XTT_KEY_POOL_H
+#pragma once
+
+#include <xtt/crypto_types.h>
+#include <xtt/error_codes.h>
+
+#include <pthread.h>
+
+// Must be a power of two.
+#ifndef XTT_X25519_KEY_POOL_CAPACITY
+#define XTT_X25519_KEY_POOL_CAPACITY 1024
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A pool of pre-generated ephemeral X25519 key pairs,
+ * so that server handshake contexts don't need to do a scalar multiplication
+ * on the critical path of every ClientInit.
+ *
+ * Taking a key pair from the pool is lock-free;
+ * a background thread tops the pool back up whenever it runs low.
+ * If the pool is ever empty, a key pair is generated in-line (and counted as a miss).
+ *
+ * Optionally, a key pair may be handed out more than once,
+ * within a window bounded both by number of uses and by age.
+ * This trades some forward-secrecy isolation between handshakes for throughput,
+ * and is disabled by default.
+ */
+
+struct xtt_x25519_key_pool_config {
+    uint32_t low_water_mark;        // Wake the refill thread when fewer than this are available.
+                                    //  0 means half the capacity.
+    uint32_t reuse_max_uses;        // Hand out each key pair at most this many times.
+                                    //  0 or 1 disables reuse.
+    uint32_t reuse_max_age_ms;      // Stop handing out a key pair this long after its first use.
+};
+
+struct xtt_x25519_key_pool_stats {
+    uint64_t hits;                  // Key pairs taken from the pool.
+    uint64_t misses;                // Key pairs generated in-line because the pool was empty.
+    uint64_t reuses;                // Key pairs handed out again, within the reuse window.
+    uint64_t generated;             // Key pairs generated by the refill thread.
+    uint32_t available;             // Key pairs currently in the pool.
+};
+
+struct xtt_x25519_key_pool_slot {
+    uint64_t sequence;
+    xtt_x25519_pub_key pub;
+    xtt_x25519_priv_key priv;
+};
+
+struct xtt_x25519_key_pool {
+    struct xtt_x25519_key_pool_slot slots[XTT_X25519_KEY_POOL_CAPACITY];
+
+    // Producer and consumer positions are kept on separate cache lines.
+    unsigned char pad0[64];
+    uint64_t enqueue_pos;
+    unsigned char pad1[64 - sizeof(uint64_t)];
+    uint64_t dequeue_pos;
+    unsigned char pad2[64 - sizeof(uint64_t)];
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t reuses;
+    uint64_t generated;
+
+    struct xtt_x25519_key_pool_config config;
+
+    // Reuse window
+    int reuse_lock;
+    uint32_t reuse_uses;
+    uint64_t reuse_expiry_ms;
+    xtt_x25519_pub_key reuse_pub;
+    xtt_x25519_priv_key reuse_priv;
+
+    // Refill thread
+    pthread_t refill_thread;
+    pthread_mutex_t refill_lock;
+    pthread_cond_t refill_cond;
+    int running;
+};
+
+/*
+ * Initialize a key pool, fill it, and start its refill thread.
+ *
+ * in:
+ *      config              - May be NULL, to use the defaults (no reuse).
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_INIT if the config is invalid or the refill thread could not be started
+ *      XTT_ERROR_CRYPTO if key generation fails
+ */
+xtt_error_code
+xtt_initialize_x25519_key_pool(struct xtt_x25519_key_pool *pool,
+                               const struct xtt_x25519_key_pool_config *config);
+
+/*
+ * Take an ephemeral key pair.
+ *
+ * Safe to call from any number of threads.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_CRYPTO if the pool was empty and in-line key generation failed
+ */
+xtt_error_code
+xtt_x25519_key_pool_acquire(struct xtt_x25519_key_pool *pool,
+                            xtt_x25519_pub_key *pub_out,
+                            xtt_x25519_priv_key *priv_out);
+
+void
+xtt_x25519_key_pool_get_stats(struct xtt_x25519_key_pool_stats *stats_out,
+                              const struct xtt_x25519_key_pool *pool);
+
+/*
+ * Stop the refill thread, and clear every key pair still in the pool.
+ */
+void
+xtt_x25519_key_pool_shutdown(struct xtt_x25519_key_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
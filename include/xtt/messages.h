@@ -110,6 +110,57 @@ xtt_build_server_init_and_attest(unsigned char* out_buffer,
                                  const struct xtt_server_certificate_context* certificate_ctx,
                                  struct xtt_server_cookie_context* cookie_ctx);
 
+/*
+ * Same as `xtt_build_server_init_and_attest`,
+ * but takes the server's ephemeral Diffie-Hellman key pair from a pre-generated pool.
+ *
+ * in:
+ *      key_pool            - An initialized x25519_key_pool.
+ *                            If NULL, a new key pair is generated.
+ */
+xtt_error_code
+xtt_build_server_init_and_attest_from_key_pool(unsigned char* out_buffer,
+                                               uint16_t* out_length,
+                                               struct xtt_server_handshake_context* ctx_out,
+                                               const unsigned char* client_init,
+                                               const struct xtt_server_certificate_context* certificate_ctx,
+                                               struct xtt_server_cookie_context* cookie_ctx,
+                                               struct xtt_x25519_key_pool* key_pool);
+
+/*
+ * Rebuild the server_handshake_context for a handshake,
+ * from the ServerCookie echoed in the client's Identity_ClientAttest or Session_ClientAttest.
+ *
+ * This lets a server throw away its handshake context after sending the ServerInitAndAttest,
+ * rather than holding onto it until the client (maybe) comes back.
+ * Once restored, the handshake continues with `xtt_pre_parse_client_attest` as usual.
+ *
+ * out:
+ *      handshake_ctx_out          - Will be populated with the server_handshake_context,
+ *                                   as it was after the ServerInitAndAttest was sent.
+ *                                   Assumed non-NULL.
+ *
+ * in:
+ *      client_attest              - Received message.
+ *
+ *      certificate_ctx            - MUST be the server_certificate_context used to build the ServerInitAndAttest.
+ *
+ *      cookie_ctx                 - MUST be the server_cookie_context used to build the ServerInitAndAttest.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_COOKIE if the echoed cookie doesn't authenticate
+ *      XTT_ERROR_COOKIE_ROTATION if the cookie's key has since been rotated-out
+ *      XTT_ERROR_UNSUPPORTED_MESSAGE if the client_attest is a Session_ClientAttest with a payload
+ *                                    (see `xtt_pre_parse_client_attest`)
+ *      xtt_error_code on other failures
+ */
+xtt_error_code
+xtt_restore_server_handshake_context(struct xtt_server_handshake_context* handshake_ctx_out,
+                                     const unsigned char* client_attest,
+                                     const struct xtt_server_certificate_context* certificate_ctx,
+                                     struct xtt_server_cookie_context* cookie_ctx);
+
 /*
  * Parse a ServerInitAndAttest message,
  * and get the root_id claimed in the server's certificate.
@@ -179,13 +230,61 @@ xtt_build_identity_client_attest(unsigned char* out_buffer,
                                  struct xtt_daa_context* daa_ctx,
                                  struct xtt_client_handshake_context* handshake_ctx);
 
+/*
+ * Verify the signature in a ServerInitAndAttest message, then build a Session_ClientAttest message.
+ *
+ * This is the reconnect path for a client that already has a ClientID and a registered longterm_key
+ * (from an earlier Identity handshake): it proves possession of the longterm_key,
+ * instead of creating a (much more expensive) DAA signature.
+ *
+ * The handshake_ctx MUST have been initialized with `xtt_initialize_session_client_handshake_context`,
+ * using the longterm_key registered with the server.
+ *
+ * out:
+ *      out_buffer                              - Buffer into which message will be put.
+ *                                                Assumed non-NULL and allocated to sufficient size by the caller.
+ *
+ *      out_length                              - Will be populated with length, in bytes, of output message.
+ *
+ * in:
+ *      server_init_and_attest                  - Received message.
+ *
+ *      root_server_certificate                 - Root server_certificate corresponding to the certificate_root_id claimed in the server's certificate.
+ *
+ *      client_id                               - The ClientID provisioned to us by the server earlier.
+ *
+ *      intended_server_client_id               - The ClientID of the server that we expect we're talking to.
+ *
+ *      handshake_ctx                           - The client_handshake_context used previously when building the ClientInit message.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      xtt_error_code on failure
+ */
+xtt_error_code
+xtt_build_session_client_attest(unsigned char* out_buffer,
+                                uint16_t* out_length,
+                                const unsigned char* server_init_and_attest,
+                                const struct xtt_server_root_certificate_context* root_server_certificate,
+                                const xtt_client_id* client_id,
+                                const xtt_client_id* intended_server_client_id,
+                                struct xtt_client_handshake_context* handshake_ctx);
+
 /*
  * Parse a ClientAttest message,
  * before knowing whether it's an IdentityClientAttest or a SessionClientAttest.
  *
+ * A Session_ClientAttest carrying an early-data payload (XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG)
+ * isn't supported: only the no-payload form, as built by `xtt_build_session_client_attest`, is.
+ *
  * Even though the client's signature is not checked in this function,
  * this function _does_ perform the decryption/authentication-check of the AEAD payload.
  *
+ * The echoed ServerCookie is checked against the ones already used, but not yet recorded as used:
+ * that happens once the client's signature is verified
+ * (by `xtt_complete_identity_server_finished` or `xtt_build_session_server_finished`),
+ * so a forged ClientAttest echoing an overheard cookie can't use it up.
+ *
  * out:
  *      client_id                  - If this is an Identity handshake:
  *                                      * The ClientID that the client is requesting.
@@ -211,7 +310,8 @@ xtt_build_identity_client_attest(unsigned char* out_buffer,
  *
  * return:
  *      XTT_ERROR_SUCCESS on success
- *      xtt_error_code on failure
+ *      XTT_ERROR_UNSUPPORTED_MESSAGE if the client_attest is a Session_ClientAttest with a payload
+ *      xtt_error_code on other failures
  */
 xtt_error_code
 xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
@@ -242,6 +342,9 @@ xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
  *
  *      certificate_ctx             - The server_certificate_context used in creating the ServerInitAndAttest earlier.
  *
+ *      cookie_ctx                  - The server_cookie_context passed to `xtt_pre_parse_client_attest`.
+ *                                    Once the ClientAttest is verified, its ServerCookie gets recorded here as used.
+ *
  *      handshake_ctx               - MUST be the same server_handshake_context used previously in this handshake.
  *                                    Assumed non-NULL.
  *                                    Caller responsible for ensuring pointed-to memory is valid.
@@ -249,7 +352,8 @@ xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
  *
  * return:
  *      XTT_ERROR_SUCCESS on success
- *      xtt_error_code on failure
+ *      XTT_ERROR_BAD_COOKIE if another ClientAttest echoing the same ServerCookie was accepted first
+ *      xtt_error_code on other failures
  */
 xtt_error_code
 xtt_build_identity_server_finished(unsigned char *out_buffer,
@@ -258,8 +362,149 @@ xtt_build_identity_server_finished(unsigned char *out_buffer,
                                    xtt_client_id *client_id,
                                    struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
                                    struct xtt_server_certificate_context *certificate_ctx,
+                                   struct xtt_server_cookie_context* cookie_ctx,
                                    struct xtt_server_handshake_context* handshake_ctx);
 
+/*
+ * `xtt_build_identity_server_finished`, split into three steps,
+ * so the signature verification can be run on another thread:
+ *
+ *      1) `xtt_submit_identity_server_finished` captures the client's signatures,
+ *         and the hashes they sign, into a self-contained job.
+ *      2) `xtt_verify_identity_client_attest` verifies them, and records the verdict in the job.
+ *         This only touches the job (and the daa_group_pub_key_ctx, read-only),
+ *         so it can be run on any thread.
+ *      3) `xtt_complete_identity_server_finished` takes the verdict,
+ *         and builds the IdentityServerFinished message (or an Error message).
+ *
+ * The IdentityClientAttest MUST already have been pre-parsed via the `pre_parse_client_attest` function.
+ * The handshake_ctx MUST NOT be used for anything else between submit and complete.
+ */
+
+/*
+ * Capture the inputs to the signature verification of a (pre-parsed) IdentityClientAttest.
+ *
+ * out:
+ *      job_out                     - Will be populated with the verification job.
+ *                                    On failure, its verdict is set to the returned error,
+ *                                    so it can still be passed to `xtt_complete_identity_server_finished`.
+ *
+ * in:
+ *      client_attest, daa_group_pub_key_ctx, certificate_ctx, handshake_ctx
+ *                                  - As for `xtt_build_identity_server_finished`.
+ *                                    The daa_group_pub_key_ctx must remain valid until the job is verified.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      xtt_error_code on failure
+ */
+xtt_error_code
+xtt_submit_identity_server_finished(struct xtt_identity_verification_job *job_out,
+                                    const unsigned char* client_attest,
+                                    struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
+                                    struct xtt_server_certificate_context *certificate_ctx,
+                                    struct xtt_server_handshake_context* handshake_ctx);
+
+/*
+ * Verify the DAA and longterm_key signatures captured in a job, and record the verdict in it.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS if both signatures are valid
+ *      xtt_error_code on failure
+ */
+xtt_error_code
+xtt_verify_identity_client_attest(struct xtt_identity_verification_job *job);
+
+/*
+ * `xtt_verify_identity_client_attest`, for many jobs at once.
+ *
+ * The signatures are verified in batches (which is much cheaper per-job),
+ * falling back to verifying them one at a time when a batch fails.
+ * Each job gets its own verdict.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS if every job's signatures are valid
+ *      XTT_ERROR_BAD_SIGNATURE otherwise
+ */
+xtt_error_code
+xtt_verify_identity_client_attests(struct xtt_identity_verification_job *jobs,
+                                   uint16_t job_count);
+
+/*
+ * Build the IdentityServerFinished message for a verified job.
+ *
+ * If the job's verdict is a failure, an Error message is built instead,
+ * and the verdict is returned.
+ *
+ * On success, the client's longterm_key can be retrieved from the handshake_ctx.
+ *
+ * out:
+ *      out_buffer, out_length      - As for `xtt_build_identity_server_finished`.
+ *
+ * in:
+ *      job                         - The job returned from `xtt_submit_identity_server_finished`
+ *                                    for this handshake.
+ *
+ *      client_id                   - The ClientID provisioned to this client.
+ *
+ *      cookie_ctx                  - As for `xtt_build_identity_server_finished`.
+ *
+ *      handshake_ctx               - The same server_handshake_context passed to `xtt_submit_identity_server_finished`.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_COOKIE if another ClientAttest echoing the same ServerCookie was accepted first
+ *      xtt_error_code on other failures
+ */
+xtt_error_code
+xtt_complete_identity_server_finished(unsigned char *out_buffer,
+                                      uint16_t *out_length,
+                                      const struct xtt_identity_verification_job *job,
+                                      xtt_client_id *client_id,
+                                      struct xtt_server_cookie_context* cookie_ctx,
+                                      struct xtt_server_handshake_context* handshake_ctx);
+
+/*
+ * Validate the longterm_key signature of a Session_ClientAttest message then build the Session_ServerFinished message.
+ *
+ * The Session_ClientAttest MUST already have been pre-parsed via the `pre_parse_client_attest` function,
+ * which returns the ClientID the client claims.
+ * The caller then looks up the longterm_key registered for that ClientID
+ * (e.g. the one retrieved via `xtt_get_clients_longterm_key_ed25519` at the end of its Identity handshake),
+ * and passes it in here.
+ *
+ * out:
+ *      out_buffer                  - Buffer into which message will be put.
+ *                                    Assumed non-NULL and allocated to sufficient size by the caller.
+ *
+ *      out_length                  - Will be populated with length, in bytes, of output Session_ServerFinished message.
+ *
+ * in:
+ *      client_attest               - Received message
+ *
+ *      client_longterm_key         - The longterm_key registered for the ClientID claimed in the Session_ClientAttest.
+ *
+ *      certificate_ctx             - The server_certificate_context used in creating the ServerInitAndAttest earlier.
+ *
+ *      cookie_ctx                  - As for `xtt_build_identity_server_finished`.
+ *
+ *      handshake_ctx               - MUST be the same server_handshake_context used previously in this handshake.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_SIGNATURE if the client didn't sign with client_longterm_key
+ *      XTT_ERROR_BAD_COOKIE if another ClientAttest echoing the same ServerCookie was accepted first
+ *      xtt_error_code on other failures
+ */
+xtt_error_code
+xtt_build_session_server_finished(unsigned char *out_buffer,
+                                  uint16_t *out_length,
+                                  const unsigned char* client_attest,
+                                  const xtt_ed25519_pub_key *client_longterm_key,
+                                  struct xtt_server_certificate_context *certificate_ctx,
+                                  struct xtt_server_cookie_context* cookie_ctx,
+                                  struct xtt_server_handshake_context* handshake_ctx);
+
 /*
  * Validate an IdentityServerFinished message,
  * retrieve the ClientID provisioned by the server,
@@ -287,6 +532,26 @@ xtt_parse_identity_server_finished(xtt_client_id* client_id,
                                    const unsigned char* identity_server_finished,
                                    struct xtt_client_handshake_context* handshake_ctx);
 
+/*
+ * Validate a Session_ServerFinished message,
+ * and confirm the server echoed our ClientID.
+ *
+ * in:
+ *      client_id                           - The ClientID sent in the Session_ClientAttest.
+ *
+ *      session_server_finished             - Received message.
+ *
+ *      handshake_ctx                       - The existing client_handshake_context used in this handshake.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      xtt_error_code on failure
+ */
+xtt_error_code
+xtt_parse_session_server_finished(const xtt_client_id* client_id,
+                                  const unsigned char* session_server_finished,
+                                  struct xtt_client_handshake_context* handshake_ctx);
+
 /*
  * Build an Error message.
  *
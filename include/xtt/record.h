@@ -0,0 +1,209 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_RECORD_H
+#define XTT_RECORD_H
+#pragma once
+
+#include <xtt/context.h>
+#include <xtt/crypto_types.h>
+#include <xtt/error_codes.h>
+
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Zero-copy record layer.
+ *
+ * A record is laid-out as:
+ *
+ *      msg_type || length || version || session_id || sequence_num    (the additional data)
+ *      || payload_type || payload                                      (encrypted)
+ *      || MAC
+ *
+ * Records are encrypted and decrypted in place, in the caller's buffer:
+ * the caller writes its payload XTT_RECORD_HEADER_LENGTH bytes into the buffer,
+ * leaving XTT_RECORD_MAC_LENGTH bytes free after it,
+ * and the header and MAC are filled in around it.
+ */
+
+// Everything before the payload, i.e. the additional data plus the payload type.
+#define XTT_RECORD_HEADER_LENGTH (sizeof(xtt_msg_type_raw)          \
+                                  + sizeof(xtt_length)              \
+                                  + sizeof(xtt_version_raw)         \
+                                  + sizeof(xtt_session_id)          \
+                                  + sizeof(xtt_sequence_number)     \
+                                  + sizeof(xtt_encapsulated_payload_type_raw))
+
+// Every suite has a 16-byte MAC.
+#define XTT_RECORD_MAC_LENGTH 16
+
+#define XTT_RECORD_OVERHEAD (XTT_RECORD_HEADER_LENGTH + XTT_RECORD_MAC_LENGTH)
+
+/*
+ * Encrypt, in place, the payload at `record + XTT_RECORD_HEADER_LENGTH`.
+ *
+ * in/out:
+ *      record              - At least `payload_length + XTT_RECORD_OVERHEAD` bytes,
+ *                            with the payload already at `record + XTT_RECORD_HEADER_LENGTH`.
+ *                            On success, it holds the whole record.
+ *      ctx                 - Its tx sequence number is advanced.
+ *
+ * out:
+ *      record_length_out   - The length of the whole record.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if any argument is NULL
+ *      XTT_ERROR_INCORRECT_LENGTH if the record wouldn't fit in its length field
+ *      XTT_ERROR_UINT32_OVERFLOW if the session's tx sequence numbers are used up
+ *      XTT_ERROR_RECORD_FAILED_CRYPTO if encryption fails
+ */
+xtt_error_code
+xtt_encrypt_record(unsigned char *record,
+                   uint16_t *record_length_out,
+                   uint16_t payload_length,
+                   xtt_encapsulated_payload_type payload_type,
+                   struct xtt_session_context *ctx);
+
+/*
+ * Authenticate and decrypt, in place, a record from `xtt_encrypt_record`.
+ *
+ * Records may arrive out of order, as long as they're within the session's replay window
+ * (see `xtt_initialize_session_context`) of the newest one received.
+ * Each is accepted at most once.
+ *
+ * in/out:
+ *      record              - On success, the payload is decrypted in place.
+ *                            On failure, the record's contents are unspecified.
+ *      ctx                 - On success, its replay window is updated.
+ *                            A replayed or too-old record is counted.
+ *
+ * out:
+ *      payload_out         - Points into `record`, at the decrypted payload.
+ *      payload_length_out  - The length of the payload.
+ *      payload_type_out    - The payload type.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if any argument is NULL
+ *      XTT_ERROR_INCORRECT_TYPE if this isn't a record
+ *      XTT_ERROR_UNKNOWN_VERSION if the record's version isn't the session's
+ *      XTT_ERROR_INCORRECT_LENGTH if record_length doesn't match the record's length field
+ *      XTT_ERROR_RECORD_REPLAYED if a record with this sequence number was already received
+ *      XTT_ERROR_RECORD_TOO_OLD if the record is too far behind the newest to tell
+ *      XTT_ERROR_RECORD_FAILED_CRYPTO if the record isn't for this session, or fails authentication
+ */
+xtt_error_code
+xtt_decrypt_record(unsigned char **payload_out,
+                   uint16_t *payload_length_out,
+                   xtt_encapsulated_payload_type *payload_type_out,
+                   unsigned char *record,
+                   uint16_t record_length,
+                   struct xtt_session_context *ctx);
+
+/*
+ * Same as `xtt_encrypt_record`, but with the payload given as fragments,
+ * which are gathered into their place in `record_out` (and then encrypted there).
+ *
+ * in:
+ *      record_out_capacity - The length of `record_out`.
+ *
+ * return:
+ *      As for `xtt_encrypt_record`, plus
+ *      XTT_ERROR_INCORRECT_LENGTH if the record wouldn't fit in `record_out`
+ */
+xtt_error_code
+xtt_encrypt_record_iov(unsigned char *record_out,
+                       uint16_t *record_length_out,
+                       uint16_t record_out_capacity,
+                       const struct iovec *payload_iov,
+                       int payload_iovcnt,
+                       xtt_encapsulated_payload_type payload_type,
+                       struct xtt_session_context *ctx);
+
+/*
+ * Same as `xtt_decrypt_record`, but the decrypted payload is scattered out to `payload_iov`,
+ * filling each fragment in turn.
+ *
+ * return:
+ *      As for `xtt_decrypt_record`, plus
+ *      XTT_ERROR_INCORRECT_LENGTH if the payload wouldn't fit in `payload_iov`
+ *          (in which case the record is left as it was, and can be retried)
+ */
+xtt_error_code
+xtt_decrypt_record_iov(const struct iovec *payload_iov,
+                       int payload_iovcnt,
+                       uint16_t *payload_length_out,
+                       xtt_encapsulated_payload_type *payload_type_out,
+                       unsigned char *record,
+                       uint16_t record_length,
+                       struct xtt_session_context *ctx);
+
+/*
+ * One record of a batch, for `xtt_encrypt_records` / `xtt_decrypt_records`.
+ *
+ * Records are processed in order, so a record repeated within a batch is rejected as replayed.
+ */
+struct xtt_record_batch_item {
+    struct xtt_session_context *ctx;
+    unsigned char *record;                          // Encrypted/decrypted in place, as for a single record.
+    uint16_t record_length;                         // Encrypt: out. Decrypt: in.
+    uint16_t payload_length;                        // Encrypt: in. Decrypt: out.
+    xtt_encapsulated_payload_type payload_type;     // Encrypt: in. Decrypt: out.
+    unsigned char *payload;                         // Decrypt: out (points into `record`).
+    xtt_error_code status;                          // Out: what `xtt_encrypt_record` / `xtt_decrypt_record`
+                                                    //  would have returned for this record.
+};
+
+/*
+ * Encrypt a batch of records, which may be for any number of sessions.
+ *
+ * A failed record doesn't stop the rest of the batch.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS if every record was encrypted
+ *      XTT_ERROR_NULL_BUFFER if items is NULL
+ *      otherwise, the status of the first record that failed
+ */
+xtt_error_code
+xtt_encrypt_records(struct xtt_record_batch_item *items,
+                    uint16_t item_count);
+
+/*
+ * Decrypt a batch of records, which may be for any number of sessions.
+ *
+ * A failed record doesn't stop the rest of the batch.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS if every record was decrypted
+ *      XTT_ERROR_NULL_BUFFER if items is NULL
+ *      otherwise, the status of the first record that failed
+ */
+xtt_error_code
+xtt_decrypt_records(struct xtt_record_batch_item *items,
+                    uint16_t item_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
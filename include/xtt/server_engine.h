@@ -0,0 +1,209 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_SERVER_ENGINE_H
+#define XTT_SERVER_ENGINE_H
+#pragma once
+
+#include <xtt/context.h>
+#include <xtt/crypto_types.h>
+#include <xtt/error_codes.h>
+
+#include <pthread.h>
+
+#ifndef XTT_SERVER_ENGINE_MAX_WORKERS
+#define XTT_SERVER_ENGINE_MAX_WORKERS 32
+#endif
+
+#ifndef XTT_SERVER_ENGINE_VERIFY_BATCH
+#define XTT_SERVER_ENGINE_VERIFY_BATCH 32
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A server-side handshake engine.
+ *
+ * The engine takes received handshake messages and runs them through a pipeline of stages,
+ * each of which has its own pool of worker threads:
+ *
+ *      ClientInit:     PARSE -> KEY_DERIVATION -> SIGN             => ServerInitAndAttest
+ *      ClientAttest:   PARSE -> DAA_VERIFY                         => ServerFinished
+ *
+ * This way, a slow DAA verification never stalls the (cheap) ClientInit's queued behind it.
+ *
+ * Each worker has its own queue, and idle workers steal from their siblings' queues.
+ *
+ * A DAA_VERIFY worker takes every job already waiting in its queue (up to XTT_SERVER_ENGINE_VERIFY_BATCH)
+ * and verifies their signatures as one batch.
+ * It never waits for a batch to fill, so under light load batches are just a single job.
+ *
+ * The engine does no allocation: the caller provides the storage for the engine and for every job.
+ */
+
+typedef enum xtt_server_engine_stage {
+    XTT_SERVER_ENGINE_STAGE_PARSE = 0,          // Parse ClientInit/ClientAttest, build/validate ServerCookie
+    XTT_SERVER_ENGINE_STAGE_KEY_DERIVATION,     // Diffie-Hellman and handshake key derivation
+    XTT_SERVER_ENGINE_STAGE_SIGN,               // Sign and encrypt ServerInitAndAttest
+    XTT_SERVER_ENGINE_STAGE_DAA_VERIFY,         // Verify ClientAttest signatures, build ServerFinished
+    XTT_SERVER_ENGINE_STAGE_COUNT
+} xtt_server_engine_stage;
+
+struct xtt_server_engine_job {
+    // Set by the caller before submitting.
+    const unsigned char *in_message;                        // Received ClientInit or Identity_ClientAttest.
+                                                            //  Must remain valid until the job completes.
+    unsigned char *out_buffer;                              // Buffer for the response (or Error) message.
+    struct xtt_server_handshake_context *handshake_ctx;     // One per connection.
+                                                            //  Only one job per handshake_ctx may be in-flight.
+    void *user_data;
+
+    // Set by the engine before the completion callback is called.
+    xtt_error_code rc;
+    uint16_t out_length;
+    xtt_client_id client_id;                                // ClientAttest only: the ClientID provisioned.
+    xtt_daa_group_id daa_group_id;                          // ClientAttest only: the client's claimed GID.
+
+    // Private to the engine.
+    xtt_msg_type msg_type;
+    struct xtt_daa_group_public_key_context *gpk_ctx;
+    struct xtt_server_engine_job *next;
+    struct xtt_server_engine_job *prev;
+};
+
+struct xtt_server_engine_config {
+    struct xtt_server_certificate_context *certificate_ctx;
+    struct xtt_server_cookie_context *cookie_ctx;
+    struct xtt_x25519_key_pool *key_pool;                   // Optional: if NULL, key pairs are generated in-line.
+    const struct xtt_suite_preferences *suite_preferences;  // Optional: if non-NULL, ClientInits for any other suite
+                                                            //  are refused with XTT_ERROR_UNKNOWN_SUITE_SPEC.
+
+    /*
+     * Look up the daa_group_public_key_context for the GID claimed in a ClientAttest.
+     *
+     * Called from a PARSE worker thread.
+     * The returned context must remain valid until the job completes.
+     */
+    xtt_error_code (*lookup_gpk)(struct xtt_daa_group_public_key_context **gpk_ctx_out,
+                                 const xtt_daa_group_id *gid,
+                                 void *user_data);
+
+    /*
+     * Choose the ClientID to provision. Optional:
+     * if NULL, the ClientID requested by the client is echoed back.
+     *
+     * Called from a PARSE worker thread.
+     */
+    xtt_error_code (*assign_client_id)(xtt_client_id *client_id_out,
+                                       const xtt_client_id *requested_client_id,
+                                       const xtt_daa_group_id *gid,
+                                       void *user_data);
+
+    /*
+     * Called once per submitted job, from a worker thread,
+     * after the response (or Error) message has been written to `out_buffer`.
+     */
+    void (*on_complete)(struct xtt_server_engine_job *job,
+                        void *user_data);
+
+    void *user_data;
+
+    uint16_t workers_per_stage[XTT_SERVER_ENGINE_STAGE_COUNT];
+};
+
+struct xtt_server_engine_worker {
+    struct xtt_server_engine *engine;
+    xtt_server_engine_stage stage;
+    uint16_t index;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    struct xtt_server_engine_job *head;
+    struct xtt_server_engine_job *tail;
+};
+
+struct xtt_server_engine_stage_pool {
+    struct xtt_server_engine_worker workers[XTT_SERVER_ENGINE_MAX_WORKERS];
+    uint16_t worker_count;
+    uint32_t next_worker;
+    uint32_t depth;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int shutdown;
+};
+
+struct xtt_server_engine {
+    struct xtt_server_engine_config config;
+    struct xtt_server_engine_stage_pool stages[XTT_SERVER_ENGINE_STAGE_COUNT];
+    int running;
+};
+
+/*
+ * Initialize a server engine and start its worker threads.
+ *
+ * in:
+ *      config              - Every stage must have between 1 and XTT_SERVER_ENGINE_MAX_WORKERS workers.
+ *                            `certificate_ctx`, `cookie_ctx` and any contexts returned by `lookup_gpk`
+ *                            are shared by all workers, and must outlive the engine.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_INIT if the config is invalid or a thread could not be started
+ */
+xtt_error_code
+xtt_initialize_server_engine(struct xtt_server_engine *engine,
+                             const struct xtt_server_engine_config *config);
+
+/*
+ * Submit a received ClientInit or Identity_ClientAttest to the engine.
+ *
+ * On success, `on_complete` will be called exactly once for this job.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_INCORRECT_TYPE if the message isn't one the engine handles
+ *      XTT_ERROR_BAD_INIT if the engine isn't running
+ */
+xtt_error_code
+xtt_server_engine_submit(struct xtt_server_engine *engine,
+                         struct xtt_server_engine_job *job);
+
+/*
+ * Number of jobs currently queued (not yet being worked on) for a stage.
+ */
+uint32_t
+xtt_server_engine_queue_depth(const struct xtt_server_engine *engine,
+                              xtt_server_engine_stage stage);
+
+/*
+ * Finish all submitted jobs, then stop the worker threads.
+ *
+ * The caller must have stopped submitting new jobs before calling this.
+ */
+void
+xtt_server_engine_shutdown(struct xtt_server_engine *engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,122 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_STATS_H
+#define XTT_STATS_H
+#pragma once
+
+#include <xtt/error_codes.h>
+
+#include <stdint.h>
+
+// Values below this are counted exactly, one bucket per nanosecond.
+#define XTT_STATS_HISTOGRAM_LINEAR_BUCKETS 16
+
+// Each power of two above the linear range is split into this many buckets,
+// so a bucket is never more than 1/8th wider than the values in it.
+#define XTT_STATS_HISTOGRAM_SUB_BUCKETS 8
+
+// Up to 2^36 ns (about 68 s); anything longer lands in the last bucket.
+#define XTT_STATS_HISTOGRAM_BUCKETS (XTT_STATS_HISTOGRAM_LINEAR_BUCKETS + 32 * XTT_STATS_HISTOGRAM_SUB_BUCKETS)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Handshake statistics.
+ *
+ * When the library is built with XTT_ENABLE_STATS,
+ * every thread that runs a handshake records the latency of each of its
+ * cryptographic phases into its own histograms, and counts every error code
+ * returned by the public handshake and record functions.
+ * Each thread writes only to its own cache-line-aligned slot, without locks,
+ * and the slots are merged when a snapshot is taken.
+ *
+ * Without XTT_ENABLE_STATS the recording compiles away entirely,
+ * and xtt_stats_snapshot just returns an all-zero snapshot with enabled == 0.
+ */
+
+typedef enum xtt_stats_phase {
+    XTT_STATS_PHASE_DIFFIE_HELLMAN = 0,     // X25519 shared-secret computation.
+    XTT_STATS_PHASE_KEY_DERIVATION,         // Handshake-key hashes and PRFs (excluding the Diffie-Hellman).
+    XTT_STATS_PHASE_SERVER_SIGN,            // Server's signature in ServerInitAndAttest.
+    XTT_STATS_PHASE_DAA_VERIFY,             // Client's DAA signature.
+    XTT_STATS_PHASE_LONGTERM_VERIFY,        // Client's longterm_key signature.
+    XTT_STATS_PHASE_AEAD,                   // Handshake-message and record encryption/decryption.
+    XTT_STATS_PHASE_COUNT
+} xtt_stats_phase;
+
+/*
+ * A log-linear latency histogram, in nanoseconds.
+ *
+ * Batched verifications are recorded as one sample per signature,
+ * each taking an equal share of the batch's time.
+ */
+struct xtt_stats_histogram {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[XTT_STATS_HISTOGRAM_BUCKETS];
+};
+
+struct xtt_stats {
+    int enabled;                                        // 0 if the library was built without XTT_ENABLE_STATS.
+    uint32_t threads;                                   // Threads that have recorded anything.
+    struct xtt_stats_histogram phases[XTT_STATS_PHASE_COUNT];
+    uint64_t errors[XTT_ERROR_CODE_COUNT];              // Times each code was returned (errors[XTT_ERROR_SUCCESS] is always 0).
+};
+
+/*
+ * Merge every thread's statistics into stats_out.
+ *
+ * Safe to call at any time, from any thread, while handshakes are running:
+ * the result is not an atomic cut across threads,
+ * but every counter in it is one that was actually reached.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_NULL_BUFFER if stats_out is NULL
+ */
+xtt_error_code
+xtt_stats_snapshot(struct xtt_stats *stats_out);
+
+/*
+ * The latency (in ns) below which the given fraction (0.0 to 1.0) of a histogram's samples fall,
+ * rounded up to the top of its bucket (but never above max_ns).
+ *
+ * Returns 0 for an empty histogram.
+ */
+uint64_t
+xtt_stats_percentile(const struct xtt_stats_histogram *histogram,
+                     double fraction);
+
+/*
+ * The largest latency (in ns) counted in the given bucket.
+ */
+uint64_t
+xtt_stats_bucket_upper_bound(uint32_t bucket);
+
+const char*
+xtt_stats_phase_string(xtt_stats_phase phase);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
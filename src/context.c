@@ -20,401 +20,774 @@
 #include <xtt/crypto_wrapper.h>
 #include <xtt/daa_wrapper.h>
 #include <xtt/error_codes.h>
+#include <xtt/key_pool.h>
 
 #include "internal/crypto_utils.h"
 #include "internal/message_utils.h"
 #include "internal/byte_utils.h"
+#include "internal/server_cookie.h"
+#include "internal/suites.h"
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
-xtt_error_code
-xtt_initialize_server_handshake_context(struct xtt_server_handshake_context* ctx_out,
-                                        xtt_version version,
-                                        xtt_suite_spec suite_spec)
-{
-    if (ctx_out == NULL)
-        return XTT_ERROR_NULL_BUFFER;
+typedef char hash_fits_in_context[sizeof(xtt_sha512) <= XTT_HANDSHAKE_MAX_HASH_LENGTH
+                                   && sizeof(xtt_blake2b) <= XTT_HANDSHAKE_MAX_HASH_LENGTH ? 1 : -1];
 
-    if (XTT_VERSION_ONE != version)
-        return XTT_ERROR_UNKNOWN_VERSION;
+#ifndef XTT_FIXED_SUITE
+static const struct xtt_handshake_suite suite_x25519_lrsw_ed25519_chacha20poly1305_sha512 =
+    XTT_SUITE_TABLE_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512;
+
+static const struct xtt_handshake_suite suite_x25519_lrsw_ed25519_chacha20poly1305_blake2b =
+    XTT_SUITE_TABLE_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B;
 
-    ctx_out->base.version = version;
+static const struct xtt_handshake_suite suite_x25519_lrsw_ed25519_aes256gcm_sha512 =
+    XTT_SUITE_TABLE_X25519_LRSW_ED25519_AES256GCM_SHA512;
 
-    ctx_out->base.suite_spec = suite_spec;
+static const struct xtt_handshake_suite suite_x25519_lrsw_ed25519_aes256gcm_blake2b =
+    XTT_SUITE_TABLE_X25519_LRSW_ED25519_AES256GCM_BLAKE2B;
+#endif
 
+static
+const struct xtt_handshake_suite*
+lookup_suite(xtt_suite_spec suite_spec)
+{
+    const struct xtt_handshake_suite *suite;
+
+#ifdef XTT_FIXED_SUITE
+    suite = (XTT_FIXED_SUITE_SPEC == suite_spec) ? &xtt_fixed_suite : NULL;
+#else
     switch (suite_spec) {
         case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+            suite = &suite_x25519_lrsw_ed25519_chacha20poly1305_sha512;
+            break;
+        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+            suite = &suite_x25519_lrsw_ed25519_chacha20poly1305_blake2b;
+            break;
+        case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+            suite = &suite_x25519_lrsw_ed25519_aes256gcm_sha512;
+            break;
+        case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+            suite = &suite_x25519_lrsw_ed25519_aes256gcm_blake2b;
+            break;
+        default:
+            suite = NULL;
+    }
+#endif
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    // A suite whose AEAD this CPU can't do would only fail later (or worse), so refuse it up front.
+    if (NULL != suite && !suite->is_available())
+        return NULL;
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+    return suite;
+}
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_sha512;
+/*
+ * Default relative costs of the suite-dependent work in a handshake and its records,
+ * scaled so ChaCha20-Poly1305 with SHA-512 is 100.
+ *
+ * These are typical of a 64-bit x86 CPU with AES-NI and PCLMUL.
+ * Elsewhere the order may differ (ChaCha20-Poly1305 often beats AES-256-GCM on CPUs with weaker AES units),
+ * so hosts that care should measure their own costs with bench/suite_cost-bench
+ * and pass them to xtt_choose_suite.
+ */
+#define CHACHA_COST 60
+#define AES256_COST 30
+#define SHA512_COST 40
+#define BLAKE2B_COST 25
+
+int
+xtt_crypto_suite_available(xtt_suite_spec suite_spec)
+{
+    return NULL != lookup_suite(suite_spec);
+}
 
-            ctx_out->base.encrypt = encrypt_chacha;
-            ctx_out->base.decrypt = decrypt_chacha;
+uint32_t
+xtt_crypto_suite_cost(xtt_suite_spec suite_spec)
+{
+    if (!xtt_crypto_suite_available(suite_spec))
+        return UINT32_MAX;
 
-            ctx_out->base.hash = xtt_crypto_hash_sha512;
+    switch (suite_spec) {
+        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+            return CHACHA_COST + SHA512_COST;
+        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+            return CHACHA_COST + BLAKE2B_COST;
+        case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+            return AES256_COST + SHA512_COST;
+        case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+            return AES256_COST + BLAKE2B_COST;
+    }
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_sha512);
-            ctx_out->base.mac_length = sizeof(xtt_chacha_mac);
-            ctx_out->base.key_length = sizeof(xtt_chacha_key);
-            ctx_out->base.iv_length = sizeof(xtt_chacha_nonce);
+    return UINT32_MAX;
+}
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+void
+xtt_suite_preferences_from_host(struct xtt_suite_preferences *preferences_out)
+{
+    static const xtt_suite_spec all_suites[XTT_SUITE_COUNT] = {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512,
+                                                               XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B,
+                                                               XTT_X25519_LRSW_ED25519_AES256GCM_SHA512,
+                                                               XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B};
+
+    preferences_out->count = 0;
+    for (uint16_t i = 0; i < XTT_SUITE_COUNT; ++i) {
+        uint32_t cost = xtt_crypto_suite_cost(all_suites[i]);
+        if (UINT32_MAX == cost)
+            continue;
+
+        // Insertion sort, cheapest first.
+        uint16_t j = preferences_out->count;
+        while (j > 0 && preferences_out->costs[j - 1] > cost) {
+            preferences_out->suite_specs[j] = preferences_out->suite_specs[j - 1];
+            preferences_out->costs[j] = preferences_out->costs[j - 1];
+            --j;
+        }
+        preferences_out->suite_specs[j] = all_suites[i];
+        preferences_out->costs[j] = cost;
+        ++preferences_out->count;
+    }
+}
 
-            ctx_out->read_longterm_key = read_longterm_key_ed25519;
+int
+xtt_suite_preferences_allow(const struct xtt_suite_preferences *preferences,
+                            xtt_suite_spec suite_spec)
+{
+    for (uint16_t i = 0; i < preferences->count && i < XTT_SUITE_COUNT; ++i) {
+        if (preferences->suite_specs[i] == suite_spec)
+            return 1;
+    }
 
-            ctx_out->verify_client_longterm_signature = verify_server_signature_ed25519;
+    return 0;
+}
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+/*
+ * The client's cost for a suite: its own measured cost, if it has any preferences,
+ * or else the default.
+ */
+static
+uint32_t
+own_suite_cost(const struct xtt_suite_preferences *client_preferences,
+               xtt_suite_spec suite_spec)
+{
+    if (!xtt_crypto_suite_available(suite_spec))
+        return UINT32_MAX;
 
-            return XTT_ERROR_SUCCESS;
-        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+    if (NULL == client_preferences)
+        return xtt_crypto_suite_cost(suite_spec);
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    for (uint16_t i = 0; i < client_preferences->count && i < XTT_SUITE_COUNT; ++i) {
+        if (client_preferences->suite_specs[i] == suite_spec)
+            return client_preferences->costs[i];
+    }
+
+    return UINT32_MAX;
+}
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+xtt_error_code
+xtt_choose_suite(xtt_suite_spec *suite_spec_out,
+                 const struct xtt_suite_preferences *server_preferences,
+                 const struct xtt_suite_preferences *client_preferences)
+{
+    if (NULL == suite_spec_out || NULL == server_preferences)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_blake2b;
+    uint64_t best_cost = UINT64_MAX;
+    for (uint16_t i = 0; i < server_preferences->count && i < XTT_SUITE_COUNT; ++i) {
+        uint32_t own_cost = own_suite_cost(client_preferences, server_preferences->suite_specs[i]);
+        if (UINT32_MAX == own_cost)
+            continue;
+
+        uint64_t cost = (uint64_t)server_preferences->costs[i] + own_cost;
+        if (cost < best_cost) {
+            best_cost = cost;
+            *suite_spec_out = server_preferences->suite_specs[i];
+        }
+    }
 
-            ctx_out->base.encrypt = encrypt_chacha;
-            ctx_out->base.decrypt = decrypt_chacha;
+    if (UINT64_MAX == best_cost)
+        return XTT_ERROR_UNKNOWN_SUITE_SPEC;
 
-            ctx_out->base.hash = xtt_crypto_hash_blake2b;
+    return XTT_ERROR_SUCCESS;
+}
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_blake2b);
-            ctx_out->base.mac_length = sizeof(xtt_chacha_mac);
-            ctx_out->base.key_length = sizeof(xtt_chacha_key);
-            ctx_out->base.iv_length = sizeof(xtt_chacha_nonce);
+static
+xtt_error_code
+initialize_handshake_context(struct xtt_handshake_context *ctx_out,
+                             xtt_version version,
+                             xtt_suite_spec suite_spec,
+                             int is_client)
+{
+    if (XTT_VERSION_ONE != version)
+        return XTT_ERROR_UNKNOWN_VERSION;
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+    ctx_out->suite = lookup_suite(suite_spec);
+    if (NULL == ctx_out->suite)
+        return XTT_ERROR_UNKNOWN_CRYPTO_SPEC;
 
-            ctx_out->read_longterm_key = read_longterm_key_ed25519;
+    ctx_out->scratch = NULL;
 
-            ctx_out->verify_client_longterm_signature = verify_server_signature_ed25519;
+    ctx_out->version = version;
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+    ctx_out->suite_spec = suite_spec;
 
-            return XTT_ERROR_SUCCESS;
-        case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+    ctx_out->is_client = is_client ? 1 : 0;
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    ctx_out->tx_sequence_num = 0;
+    ctx_out->rx_sequence_num = 0;
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+    return XTT_ERROR_SUCCESS;
+}
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_sha512;
+xtt_error_code
+xtt_initialize_server_handshake_context(struct xtt_server_handshake_context* ctx_out,
+                                        xtt_version version,
+                                        xtt_suite_spec suite_spec)
+{
+    return xtt_initialize_server_handshake_context_from_key_pool(ctx_out,
+                                                                 version,
+                                                                 suite_spec,
+                                                                 NULL);
+}
 
-            ctx_out->base.encrypt = encrypt_aes256;
-            ctx_out->base.decrypt = decrypt_aes256;
+xtt_error_code
+xtt_initialize_server_handshake_context_from_key_pool(struct xtt_server_handshake_context* ctx_out,
+                                                      xtt_version version,
+                                                      xtt_suite_spec suite_spec,
+                                                      struct xtt_x25519_key_pool *key_pool)
+{
+    if (ctx_out == NULL)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->base.hash = xtt_crypto_hash_sha512;
+    xtt_error_code rc = initialize_handshake_context(&ctx_out->base, version, suite_spec, 0);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_sha512);
-            ctx_out->base.mac_length = sizeof(xtt_aes256_mac);
-            ctx_out->base.key_length = sizeof(xtt_aes256_key);
-            ctx_out->base.iv_length = sizeof(xtt_aes256_nonce);
+    if (NULL != key_pool)
+        return xtt_x25519_key_pool_acquire(key_pool, &ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519);
+    if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
+        return XTT_ERROR_CRYPTO;
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+    return XTT_ERROR_SUCCESS;
+}
 
-            ctx_out->read_longterm_key = read_longterm_key_ed25519;
+xtt_error_code
+xtt_initialize_client_handshake_context(struct xtt_client_handshake_context* ctx_out,
+                                        xtt_version version,
+                                        xtt_suite_spec suite_spec)
+{
+    if (ctx_out == NULL)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->verify_client_longterm_signature = verify_server_signature_ed25519;
+    xtt_error_code rc = initialize_handshake_context(&ctx_out->base, version, suite_spec, 1);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+    if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
+        return XTT_ERROR_CRYPTO;
 
-            return XTT_ERROR_SUCCESS;
-        case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+    if (0 != xtt_crypto_create_ed25519_key_pair(&ctx_out->longterm_key.ed25519, &ctx_out->longterm_private_key.ed25519))
+        return XTT_ERROR_CRYPTO;
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    return XTT_ERROR_SUCCESS;
+}
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+xtt_error_code
+xtt_initialize_session_client_handshake_context(struct xtt_client_handshake_context* ctx_out,
+                                                xtt_version version,
+                                                xtt_suite_spec suite_spec,
+                                                const xtt_ed25519_pub_key *longterm_key,
+                                                const xtt_ed25519_priv_key *longterm_private_key)
+{
+    if (ctx_out == NULL || longterm_key == NULL || longterm_private_key == NULL)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_blake2b;
+    xtt_error_code rc = initialize_handshake_context(&ctx_out->base, version, suite_spec, 1);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
 
-            ctx_out->base.encrypt = encrypt_aes256;
-            ctx_out->base.decrypt = decrypt_aes256;
+    if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
+        return XTT_ERROR_CRYPTO;
 
-            ctx_out->base.hash = xtt_crypto_hash_blake2b;
+    ctx_out->longterm_key.ed25519 = *longterm_key;
+    ctx_out->longterm_private_key.ed25519 = *longterm_private_key;
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_blake2b);
-            ctx_out->base.mac_length = sizeof(xtt_aes256_mac);
-            ctx_out->base.key_length = sizeof(xtt_aes256_key);
-            ctx_out->base.iv_length = sizeof(xtt_aes256_nonce);
+    return XTT_ERROR_SUCCESS;
+}
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+void
+xtt_handshake_context_use_scratch(struct xtt_handshake_context *ctx,
+                                  struct xtt_handshake_scratch *scratch)
+{
+    ctx->scratch = scratch;
+}
 
-            ctx_out->read_longterm_key = read_longterm_key_ed25519;
+/*
+ * Session keys and IVs: SessionSecret -> prf<length>(session_id || label),
+ * with the labels (and which are ours to send with) following the handshake's.
+ */
+static
+xtt_error_code
+derive_session_keys(struct xtt_session_context *ctx_out,
+                    const struct xtt_handshake_context *handshake_ctx)
+{
+    const struct xtt_handshake_suite *suite = HANDSHAKE_SUITE(handshake_ctx);
+    xtt_error_code rc;
+
+    struct keyed_prf key_prf;
+    keyed_prf_start(&key_prf,
+                    suite->key_length,
+                    handshake_ctx->session_secret,
+                    suite->hash_length,
+                    ctx_out->session_id.data,
+                    sizeof(xtt_session_id),
+                    suite);
+
+    struct keyed_prf iv_prf;
+    keyed_prf_start(&iv_prf,
+                    suite->iv_length,
+                    handshake_ctx->session_secret,
+                    suite->hash_length,
+                    ctx_out->session_id.data,
+                    sizeof(xtt_session_id),
+                    suite);
+
+    unsigned char *client_key = handshake_ctx->is_client ? (unsigned char*)&ctx_out->tx_key : (unsigned char*)&ctx_out->rx_key;
+    unsigned char *client_iv = handshake_ctx->is_client ? (unsigned char*)&ctx_out->tx_iv : (unsigned char*)&ctx_out->rx_iv;
+    unsigned char *server_key = handshake_ctx->is_client ? (unsigned char*)&ctx_out->rx_key : (unsigned char*)&ctx_out->tx_key;
+    unsigned char *server_iv = handshake_ctx->is_client ? (unsigned char*)&ctx_out->rx_iv : (unsigned char*)&ctx_out->tx_iv;
+
+    const char *client_key_string = "XTT session client key";
+    const char *client_iv_string = "XTT session client iv";
+    const char *server_key_string = "XTT session server key";
+    const char *server_iv_string = "XTT session server iv";
+
+    rc = keyed_prf_expand(client_key, &key_prf, (const unsigned char*)client_key_string, strlen(client_key_string));
+    if (XTT_ERROR_SUCCESS != rc)
+        goto cleanup;
+    rc = keyed_prf_expand(client_iv, &iv_prf, (const unsigned char*)client_iv_string, strlen(client_iv_string));
+    if (XTT_ERROR_SUCCESS != rc)
+        goto cleanup;
+    rc = keyed_prf_expand(server_key, &key_prf, (const unsigned char*)server_key_string, strlen(server_key_string));
+    if (XTT_ERROR_SUCCESS != rc)
+        goto cleanup;
+    rc = keyed_prf_expand(server_iv, &iv_prf, (const unsigned char*)server_iv_string, strlen(server_iv_string));
+
+cleanup:
+    keyed_prf_release(&key_prf);
+    keyed_prf_release(&iv_prf);
+
+    return rc;
+}
 
-            ctx_out->verify_client_longterm_signature = verify_server_signature_ed25519;
+xtt_error_code
+xtt_initialize_session_context(struct xtt_session_context *ctx_out,
+                               const xtt_session_id *session_id,
+                               const struct xtt_handshake_context *handshake_ctx,
+                               uint16_t replay_window_words)
+{
+    if (NULL == ctx_out || NULL == session_id || NULL == handshake_ctx)
+        return XTT_ERROR_NULL_BUFFER;
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+    // The window is indexed by masking, so its width must be a power of two.
+    if (replay_window_words < 2
+            || replay_window_words > XTT_RECORD_REPLAY_WINDOW_MAX_WORDS
+            || 0 != (replay_window_words & (replay_window_words - 1)))
+        return XTT_ERROR_INCORRECT_LENGTH;
 
-            return XTT_ERROR_SUCCESS;
+    switch (SUITE_SPEC(handshake_ctx->suite_spec)) {
+        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+            ctx_out->seal = seal_record_chacha;
+            ctx_out->open = open_record_chacha;
+            ctx_out->mac_length = sizeof(xtt_chacha_mac);
+            ctx_out->iv_length = sizeof(xtt_chacha_nonce);
+            break;
+        case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+        case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+            ctx_out->seal = seal_record_aes256;
+            ctx_out->open = open_record_aes256;
+            ctx_out->mac_length = sizeof(xtt_aes256_mac);
+            ctx_out->iv_length = sizeof(xtt_aes256_nonce);
+            break;
         default:
             return XTT_ERROR_UNKNOWN_CRYPTO_SPEC;
     }
+
+    ctx_out->version = handshake_ctx->version;
+    ctx_out->suite_spec = handshake_ctx->suite_spec;
+
+    ctx_out->session_id = *session_id;
+
+    // The session's keys are fresh, so its sequence numbers start over.
+    ctx_out->tx_sequence_num = 0;
+    ctx_out->rx_sequence_num = 0;
+
+    ctx_out->rx_replay_window_words = replay_window_words;
+    memset(ctx_out->rx_replay_window, 0, sizeof(ctx_out->rx_replay_window));
+    ctx_out->replayed_records = 0;
+    ctx_out->too_old_records = 0;
+
+    xtt_error_code rc = derive_session_keys(ctx_out, handshake_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // Expand the AES keys now, rather than for every record.
+    if (seal_record_aes256 == ctx_out->seal) {
+        if (0 != xtt_crypto_aead_aes256_expand_key(&ctx_out->tx_key_schedule.aes256, &ctx_out->tx_key.aes256)
+                || 0 != xtt_crypto_aead_aes256_expand_key(&ctx_out->rx_key_schedule.aes256, &ctx_out->rx_key.aes256))
+            return XTT_ERROR_CRYPTO;
+    }
+
+    return XTT_ERROR_SUCCESS;
 }
 
-xtt_error_code
-xtt_initialize_client_handshake_context(struct xtt_client_handshake_context* ctx_out,
-                                        xtt_version version,
-                                        xtt_suite_spec suite_spec)
+void
+xtt_session_context_get_stats(struct xtt_session_stats *stats_out,
+                              const struct xtt_session_context *ctx)
 {
-    if (ctx_out == NULL)
-        return XTT_ERROR_NULL_BUFFER;
-
-    if (XTT_VERSION_ONE != version)
-        return XTT_ERROR_UNKNOWN_VERSION;
+    stats_out->replayed_records = ctx->replayed_records;
+    stats_out->too_old_records = ctx->too_old_records;
+    stats_out->replay_window_size = (ctx->rx_replay_window_words - 1) * 64;
+}
 
-    ctx_out->base.version = version;
+// Exported handshake state:
+//      format version (1) || role (1) || version (1) || suite_spec (2)
+//      || tx_sequence_num (4) || rx_sequence_num (4) || dh_priv_key
+//      || tx_key || tx_iv || rx_key || rx_iv || inner_hash || session_secret || server_cookie
+//      || role-specific fields
+// All integers are big-endian, and all lengths are fixed by the suite_spec.
+#define HANDSHAKE_STATE_FORMAT_VERSION 1
+#define HANDSHAKE_STATE_HEADER_LENGTH (1 + 1 + sizeof(xtt_version_raw) + sizeof(xtt_suite_spec_raw))
+#define HANDSHAKE_STATE_SERVER 1
+#define HANDSHAKE_STATE_CLIENT 2
+
+static
+uint16_t
+handshake_state_base_length(const struct xtt_handshake_suite *suite)
+{
+    return HANDSHAKE_STATE_HEADER_LENGTH
+           + 2 * sizeof(xtt_sequence_number)
+           + sizeof(xtt_x25519_priv_key)
+           + 2 * (suite->key_length + suite->iv_length)
+           + 2 * suite->hash_length
+           + sizeof(xtt_server_cookie);
+}
 
-    ctx_out->base.suite_spec = suite_spec;
+static
+uint16_t
+server_handshake_state_length(const struct xtt_handshake_suite *suite)
+{
+    return handshake_state_base_length(suite)
+           + sizeof(((struct xtt_server_handshake_context*)0)->server_signature_buffer)
+           + sizeof(((struct xtt_server_handshake_context*)0)->clientattest_buffer)
+           + suite->longterm_key_length;
+}
 
-    switch (suite_spec) {
-        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+static
+uint16_t
+client_handshake_state_length(const struct xtt_handshake_suite *suite)
+{
+    return handshake_state_base_length(suite)
+           + sizeof(((struct xtt_client_handshake_context*)0)->client_init_buffer)
+           + sizeof(((struct xtt_client_handshake_context*)0)->server_initandattest_buffer)
+           + suite->longterm_key_length
+           + sizeof(xtt_ed25519_priv_key);
+}
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+static
+unsigned char*
+put_bytes(unsigned char *out, const void *in, uint16_t length)
+{
+    memcpy(out, in, length);
+    return out + length;
+}
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+static
+const unsigned char*
+get_bytes(void *out, const unsigned char *in, uint16_t length)
+{
+    memcpy(out, in, length);
+    return in + length;
+}
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_sha512;
+static
+unsigned char*
+export_handshake_base(unsigned char *out,
+                      unsigned char role,
+                      const struct xtt_handshake_context *ctx)
+{
+    const struct xtt_handshake_suite *suite = HANDSHAKE_SUITE(ctx);
 
+    *out++ = HANDSHAKE_STATE_FORMAT_VERSION;
+    *out++ = role;
+    *out++ = (xtt_version_raw)ctx->version;
+    short_to_bigendian(ctx->suite_spec, out);
+    out += sizeof(xtt_suite_spec_raw);
 
-            ctx_out->base.encrypt = encrypt_chacha;
-            ctx_out->base.decrypt = decrypt_chacha;
+    long_to_bigendian(ctx->tx_sequence_num, out);
+    out += sizeof(xtt_sequence_number);
+    long_to_bigendian(ctx->rx_sequence_num, out);
+    out += sizeof(xtt_sequence_number);
 
-            ctx_out->base.hash = xtt_crypto_hash_sha512;
+    // The public key is re-derived on import.
+    out = put_bytes(out, ctx->dh_priv_key.x25519.data, sizeof(xtt_x25519_priv_key));
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_sha512);
-            ctx_out->base.mac_length = sizeof(xtt_chacha_mac);
-            ctx_out->base.key_length = sizeof(xtt_chacha_key);
-            ctx_out->base.iv_length = sizeof(xtt_chacha_nonce);
+    out = put_bytes(out, &ctx->tx_key, suite->key_length);
+    out = put_bytes(out, &ctx->tx_iv, suite->iv_length);
+    out = put_bytes(out, &ctx->rx_key, suite->key_length);
+    out = put_bytes(out, &ctx->rx_iv, suite->iv_length);
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+    out = put_bytes(out, ctx->inner_hash, suite->hash_length);
+    out = put_bytes(out, ctx->session_secret, suite->hash_length);
 
-            ctx_out->verify_server_signature = verify_server_signature_ed25519;
+    out = put_bytes(out, ctx->server_cookie.data, sizeof(xtt_server_cookie));
 
-            ctx_out->copy_longterm_key = copy_longterm_key_ed25519;
-            
-            ctx_out->compare_longterm_keys = compare_longterm_keys_ed25519;
+    return out;
+}
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+static
+xtt_error_code
+import_handshake_header(const struct xtt_handshake_suite **suite_out,
+                        unsigned char role,
+                        const unsigned char *state,
+                        uint16_t state_length)
+{
+    if (state_length < HANDSHAKE_STATE_HEADER_LENGTH)
+        return XTT_ERROR_INCORRECT_LENGTH;
 
-            ctx_out->longterm_sign = longterm_sign_ed25519;
+    if (HANDSHAKE_STATE_FORMAT_VERSION != state[0])
+        return XTT_ERROR_UNKNOWN_VERSION;
 
-            if (0 != xtt_crypto_create_ed25519_key_pair(&ctx_out->longterm_key.ed25519, &ctx_out->longterm_private_key.ed25519))
-                return XTT_ERROR_CRYPTO;
+    if (role != state[1])
+        return XTT_ERROR_INCORRECT_TYPE;
 
-            return XTT_ERROR_SUCCESS;
-        case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+    if (XTT_VERSION_ONE != state[2])
+        return XTT_ERROR_UNKNOWN_VERSION;
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    uint16_t suite_spec;
+    bigendian_to_short(&state[3], &suite_spec);
+    *suite_out = lookup_suite((xtt_suite_spec)suite_spec);
+    if (NULL == *suite_out)
+        return XTT_ERROR_UNKNOWN_CRYPTO_SPEC;
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+    return XTT_ERROR_SUCCESS;
+}
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_blake2b;
+static
+const unsigned char*
+import_handshake_base(struct xtt_handshake_context *ctx_out,
+                      const struct xtt_handshake_suite *suite,
+                      const unsigned char *in)
+{
+    ctx_out->suite = suite;
+    ctx_out->scratch = NULL;
 
+    ctx_out->version = (xtt_version)in[2];
+    uint16_t suite_spec;
+    bigendian_to_short(&in[3], &suite_spec);
+    ctx_out->suite_spec = (xtt_suite_spec)suite_spec;
+    ctx_out->is_client = (HANDSHAKE_STATE_CLIENT == in[1]);
+    in += HANDSHAKE_STATE_HEADER_LENGTH;
 
-            ctx_out->base.encrypt = encrypt_chacha;
-            ctx_out->base.decrypt = decrypt_chacha;
+    bigendian_to_long(in, &ctx_out->tx_sequence_num);
+    in += sizeof(xtt_sequence_number);
+    bigendian_to_long(in, &ctx_out->rx_sequence_num);
+    in += sizeof(xtt_sequence_number);
 
-            ctx_out->base.hash = xtt_crypto_hash_blake2b;
+    in = get_bytes(ctx_out->dh_priv_key.x25519.data, in, sizeof(xtt_x25519_priv_key));
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_blake2b);
-            ctx_out->base.mac_length = sizeof(xtt_chacha_mac);
-            ctx_out->base.key_length = sizeof(xtt_chacha_key);
-            ctx_out->base.iv_length = sizeof(xtt_chacha_nonce);
+    in = get_bytes(&ctx_out->tx_key, in, suite->key_length);
+    in = get_bytes(&ctx_out->tx_iv, in, suite->iv_length);
+    in = get_bytes(&ctx_out->rx_key, in, suite->key_length);
+    in = get_bytes(&ctx_out->rx_iv, in, suite->iv_length);
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+    in = get_bytes(ctx_out->inner_hash, in, suite->hash_length);
+    in = get_bytes(ctx_out->session_secret, in, suite->hash_length);
 
-            ctx_out->verify_server_signature = verify_server_signature_ed25519;
+    in = get_bytes(ctx_out->server_cookie.data, in, sizeof(xtt_server_cookie));
 
-            ctx_out->copy_longterm_key = copy_longterm_key_ed25519;
-            
-            ctx_out->compare_longterm_keys = compare_longterm_keys_ed25519;
+    return in;
+}
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+xtt_error_code
+xtt_export_server_handshake_context(unsigned char *state_out,
+                                    uint16_t *state_length,
+                                    const struct xtt_server_handshake_context *ctx)
+{
+    if (NULL == state_out || NULL == state_length || NULL == ctx)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->longterm_sign = longterm_sign_ed25519;
+    const struct xtt_handshake_suite *suite = HANDSHAKE_SUITE(&ctx->base);
 
-            if (0 != xtt_crypto_create_ed25519_key_pair(&ctx_out->longterm_key.ed25519, &ctx_out->longterm_private_key.ed25519))
-                return XTT_ERROR_CRYPTO;
+    assert(server_handshake_state_length(suite) <= XTT_SERVER_HANDSHAKE_STATE_MAX_LENGTH);
 
-            return XTT_ERROR_SUCCESS;
-        case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+    unsigned char *out = export_handshake_base(state_out, HANDSHAKE_STATE_SERVER, &ctx->base);
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    out = put_bytes(out, ctx->server_signature_buffer, sizeof(ctx->server_signature_buffer));
+    out = put_bytes(out, ctx->clientattest_buffer, sizeof(ctx->clientattest_buffer));
+    out = put_bytes(out, &ctx->clients_longterm_key, suite->longterm_key_length);
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+    *state_length = out - state_out;
+    assert(server_handshake_state_length(suite) == *state_length);
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_sha512;
+    return XTT_ERROR_SUCCESS;
+}
 
+xtt_error_code
+xtt_import_server_handshake_context(struct xtt_server_handshake_context *ctx_out,
+                                    const unsigned char *state,
+                                    uint16_t state_length)
+{
+    if (NULL == ctx_out || NULL == state)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->base.encrypt = encrypt_aes256;
-            ctx_out->base.decrypt = decrypt_aes256;
+    const struct xtt_handshake_suite *suite;
+    xtt_error_code rc = import_handshake_header(&suite, HANDSHAKE_STATE_SERVER, state, state_length);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
 
-            ctx_out->base.hash = xtt_crypto_hash_sha512;
+    if (server_handshake_state_length(suite) != state_length)
+        return XTT_ERROR_INCORRECT_LENGTH;
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_sha512);
-            ctx_out->base.mac_length = sizeof(xtt_aes256_mac);
-            ctx_out->base.key_length = sizeof(xtt_aes256_key);
-            ctx_out->base.iv_length = sizeof(xtt_aes256_nonce);
+    const unsigned char *in = import_handshake_base(&ctx_out->base, suite, state);
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+    in = get_bytes(ctx_out->server_signature_buffer, in, sizeof(ctx_out->server_signature_buffer));
+    in = get_bytes(ctx_out->clientattest_buffer, in, sizeof(ctx_out->clientattest_buffer));
+    in = get_bytes(&ctx_out->clients_longterm_key, in, suite->longterm_key_length);
+    assert(in == state + state_length);
 
-            ctx_out->verify_server_signature = verify_server_signature_ed25519;
+    if (0 != xtt_crypto_x25519_public_key(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
+        return XTT_ERROR_CRYPTO;
 
-            ctx_out->copy_longterm_key = copy_longterm_key_ed25519;
-            
-            ctx_out->compare_longterm_keys = compare_longterm_keys_ed25519;
+    return XTT_ERROR_SUCCESS;
+}
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+xtt_error_code
+xtt_export_client_handshake_context(unsigned char *state_out,
+                                    uint16_t *state_length,
+                                    const struct xtt_client_handshake_context *ctx)
+{
+    if (NULL == state_out || NULL == state_length || NULL == ctx)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->longterm_sign = longterm_sign_ed25519;
+    const struct xtt_handshake_suite *suite = HANDSHAKE_SUITE(&ctx->base);
 
-            if (0 != xtt_crypto_create_ed25519_key_pair(&ctx_out->longterm_key.ed25519, &ctx_out->longterm_private_key.ed25519))
-                return XTT_ERROR_CRYPTO;
+    assert(client_handshake_state_length(suite) <= XTT_CLIENT_HANDSHAKE_STATE_MAX_LENGTH);
 
-            return XTT_ERROR_SUCCESS;
-        case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
-            ctx_out->base.hash_out_buffer = (unsigned char*)&ctx_out->base.hash_out_buffer_raw;
-            ctx_out->base.inner_hash = (unsigned char*)&ctx_out->base.inner_hash_raw;
+    unsigned char *out = export_handshake_base(state_out, HANDSHAKE_STATE_CLIENT, &ctx->base);
 
-            ctx_out->base.shared_secret_buffer = (unsigned char*)&ctx_out->base.shared_secret_raw;
-            ctx_out->base.handshake_secret = (unsigned char*)&ctx_out->base.handshake_secret_raw;
-            ctx_out->base.prf_key = (unsigned char*)&ctx_out->base.prf_key_raw;
-            memset(ctx_out->base.prf_key, 0, sizeof(ctx_out->base.prf_key_raw));
+    out = put_bytes(out, ctx->client_init_buffer, sizeof(ctx->client_init_buffer));
+    out = put_bytes(out, ctx->server_initandattest_buffer, sizeof(ctx->server_initandattest_buffer));
+    out = put_bytes(out, &ctx->longterm_key, suite->longterm_key_length);
+    out = put_bytes(out, &ctx->longterm_private_key, sizeof(xtt_ed25519_priv_key));
 
-            ctx_out->base.copy_dh_pubkey = copy_dh_pubkey_x25519;
+    *state_length = out - state_out;
+    assert(client_handshake_state_length(suite) == *state_length);
 
-            ctx_out->base.do_diffie_hellman = do_diffie_hellman_x25519;
-            ctx_out->base.prf = xtt_crypto_prf_blake2b;
+    return XTT_ERROR_SUCCESS;
+}
 
+xtt_error_code
+xtt_import_client_handshake_context(struct xtt_client_handshake_context *ctx_out,
+                                    const unsigned char *state,
+                                    uint16_t state_length)
+{
+    if (NULL == ctx_out || NULL == state)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->base.encrypt = encrypt_aes256;
-            ctx_out->base.decrypt = decrypt_aes256;
+    const struct xtt_handshake_suite *suite;
+    xtt_error_code rc = import_handshake_header(&suite, HANDSHAKE_STATE_CLIENT, state, state_length);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
 
-            ctx_out->base.hash = xtt_crypto_hash_blake2b;
+    if (client_handshake_state_length(suite) != state_length)
+        return XTT_ERROR_INCORRECT_LENGTH;
 
-            ctx_out->base.longterm_key_length = sizeof(xtt_ed25519_pub_key);
-            ctx_out->base.longterm_key_signature_length = sizeof(xtt_ed25519_signature);
-            ctx_out->base.shared_secret_length = sizeof(xtt_x25519_shared_secret);
-            ctx_out->base.hash_length = sizeof(xtt_blake2b);
-            ctx_out->base.mac_length = sizeof(xtt_aes256_mac);
-            ctx_out->base.key_length = sizeof(xtt_aes256_key);
-            ctx_out->base.iv_length = sizeof(xtt_aes256_nonce);
+    const unsigned char *in = import_handshake_base(&ctx_out->base, suite, state);
 
-            ctx_out->base.tx_sequence_num = 0;
-            ctx_out->base.rx_sequence_num = 0;
+    in = get_bytes(ctx_out->client_init_buffer, in, sizeof(ctx_out->client_init_buffer));
+    in = get_bytes(ctx_out->server_initandattest_buffer, in, sizeof(ctx_out->server_initandattest_buffer));
+    in = get_bytes(&ctx_out->longterm_key, in, suite->longterm_key_length);
+    in = get_bytes(&ctx_out->longterm_private_key, in, sizeof(xtt_ed25519_priv_key));
+    assert(in == state + state_length);
 
-            ctx_out->verify_server_signature = verify_server_signature_ed25519;
+    if (0 != xtt_crypto_x25519_public_key(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
+        return XTT_ERROR_CRYPTO;
 
-            ctx_out->copy_longterm_key = copy_longterm_key_ed25519;
-            
-            ctx_out->compare_longterm_keys = compare_longterm_keys_ed25519;
+    return XTT_ERROR_SUCCESS;
+}
 
-            if (0 != xtt_crypto_create_x25519_key_pair(&ctx_out->base.dh_pub_key.x25519, &ctx_out->base.dh_priv_key.x25519))
-                return XTT_ERROR_CRYPTO;
+xtt_error_code
+xtt_initialize_server_cookie_context(struct xtt_server_cookie_context* ctx)
+{
+    if (ctx == NULL)
+        return XTT_ERROR_NULL_BUFFER;
 
-            ctx_out->longterm_sign = longterm_sign_ed25519;
+    ctx->replay_filters = malloc(XTT_SERVER_COOKIE_KEY_SLOTS * sizeof(struct xtt_cookie_replay_filter));
+    if (NULL == ctx->replay_filters)
+        return XTT_ERROR_BAD_INIT;
 
-            if (0 != xtt_crypto_create_ed25519_key_pair(&ctx_out->longterm_key.ed25519, &ctx_out->longterm_private_key.ed25519))
-                return XTT_ERROR_CRYPTO;
+    ctx->epoch = 0;
 
-            return XTT_ERROR_SUCCESS;
-        default:
-            return XTT_ERROR_UNKNOWN_CRYPTO_SPEC;
+    // Every slot must be just as unguessable, whichever epoch it ends up serving.
+    for (int i = 0; i < XTT_SERVER_COOKIE_KEY_SLOTS; ++i) {
+        xtt_crypto_get_random(ctx->keys[i].data, sizeof(xtt_chacha_key));
+        reset_cookie_replay_filter(&ctx->replay_filters[i]);
     }
+    ctx->replays = 0;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void
+xtt_free_server_cookie_context(struct xtt_server_cookie_context* ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    free(ctx->replay_filters);
+    ctx->replay_filters = NULL;
+
+    xtt_crypto_secure_clear((unsigned char*)ctx->keys, sizeof(ctx->keys));
 }
 
 xtt_error_code
-xtt_initialize_server_cookie_context(struct xtt_server_cookie_context* ctx)
+xtt_rotate_server_cookie_context(struct xtt_server_cookie_context* ctx)
 {
-    // We're not currently using anything in the cookie context, so NOOP.
-    (void)ctx;
+    if (ctx == NULL)
+        return XTT_ERROR_NULL_BUFFER;
+
+    // While the current epoch is E, cookies from E and E-1 are accepted,
+    // so the slot for E+1 (last used by E-2) is the only one nobody is reading.
+    // Fill it in before publishing E+1, which retires E-1.
+    uint32_t next_epoch = __atomic_load_n(&ctx->epoch, __ATOMIC_RELAXED) + 1;
+    xtt_crypto_get_random(ctx->keys[next_epoch % XTT_SERVER_COOKIE_KEY_SLOTS].data, sizeof(xtt_chacha_key));
+    reset_cookie_replay_filter(&ctx->replay_filters[next_epoch % XTT_SERVER_COOKIE_KEY_SLOTS]);
+
+    __atomic_store_n(&ctx->epoch, next_epoch, __ATOMIC_RELEASE);
+
     return XTT_ERROR_SUCCESS;
 }
 
+void
+xtt_server_cookie_context_get_stats(struct xtt_server_cookie_stats *stats_out,
+                                    const struct xtt_server_cookie_context *ctx)
+{
+    stats_out->epoch = __atomic_load_n(&ctx->epoch, __ATOMIC_ACQUIRE);
+
+    const struct xtt_cookie_replay_filter *filter = &ctx->replay_filters[stats_out->epoch % XTT_SERVER_COOKIE_KEY_SLOTS];
+    stats_out->recorded = __atomic_load_n(&filter->recorded, __ATOMIC_RELAXED);
+    stats_out->replays = __atomic_load_n(&ctx->replays, __ATOMIC_RELAXED);
+    stats_out->expected_false_positive_rate = cookie_replay_filter_false_positive_rate(filter);
+
+    // 16 bits per cookie.
+    stats_out->capacity = (uint64_t)XTT_COOKIE_REPLAY_FILTER_WORDS * 64 / 16;
+    stats_out->bytes_per_million_cookies = sizeof(filter->words) * 1000000 / stats_out->capacity;
+}
+
 xtt_error_code
 xtt_initialize_server_certificate_context_ed25519(struct xtt_server_certificate_context *ctx_out,
                                                   const unsigned char *serialized_certificate,
@@ -456,10 +829,21 @@ xtt_initialize_daa_group_public_key_context_lrsw(struct xtt_daa_group_public_key
                                                  uint16_t basename_length,
                                                  xtt_daa_group_pub_key_lrsw *gpk)
 {
+    // The batch verifiers rely on our own copy of ecdaa's Schnorr transcript,
+    // so refuse to go any further if it doesn't match this build of ecdaa.
+    if (0 != xtt_daa_self_test_lrsw())
+        return XTT_ERROR_DAA;
+
     ctx_out->verify_signature = verify_lrswTPM;
+    ctx_out->batch_verify_signatures = batch_verify_lrswTPM;
 
     ctx_out->gpk.lrsw = *gpk;
 
+    ctx_out->pairing_tables.lrsw = NULL;
+
+    if (0 != xtt_daa_prepare_group_public_key_lrsw(&ctx_out->prepared_gpk.lrsw, gpk))
+        return XTT_ERROR_BAD_INIT;
+
     if (basename_length > sizeof(ctx_out->basename))
         return XTT_ERROR_BAD_INIT;
     memcpy(ctx_out->basename,
@@ -470,6 +854,33 @@ xtt_initialize_daa_group_public_key_context_lrsw(struct xtt_daa_group_public_key
     return XTT_ERROR_SUCCESS;
 }
 
+xtt_error_code
+xtt_precompute_daa_group_public_key_pairings_lrsw(struct xtt_daa_group_public_key_context *ctx,
+                                                  xtt_daa_pairing_tables_lrsw *tables)
+{
+    if (0 != xtt_daa_precompute_pairing_tables_lrsw(tables, &ctx->prepared_gpk.lrsw))
+        return XTT_ERROR_DAA;
+
+    ctx->pairing_tables.lrsw = tables;
+
+    ctx->verify_signature = verify_lrswTPM_precomputed;
+    ctx->batch_verify_signatures = batch_verify_lrswTPM_precomputed;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+xtt_batch_verify_daa_signatures(int *results_out,
+                                const struct xtt_daa_verify_item *items,
+                                uint16_t item_count,
+                                struct xtt_daa_group_public_key_context *daa_group_pub_key_ctx)
+{
+    return daa_group_pub_key_ctx->batch_verify_signatures(results_out,
+                                                          items,
+                                                          item_count,
+                                                          daa_group_pub_key_ctx);
+}
+
 xtt_error_code
 xtt_initialize_daa_context_lrswTPM(struct xtt_daa_context *ctx_out,
                                    xtt_daa_group_id *gid,
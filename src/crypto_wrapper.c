@@ -0,0 +1,569 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt/crypto_wrapper.h>
+#include <xtt/crypto_provider.h>
+#include <xtt/error_codes.h>
+
+#include "internal/crypto_providers.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/random.h>
+#endif
+
+#include <string.h>
+
+/*
+ * Every primitive calls through the current provider.
+ * The few compositions (key pairs, and the AEADs' combined forms) are done here, once,
+ * so that providers only need to supply the primitives themselves.
+ */
+
+static const struct xtt_crypto_provider *const builtin_providers[] = {
+#ifdef XTT_USE_LIBSODIUM
+    &xtt_crypto_provider_libsodium,
+#endif
+#ifdef XTT_USE_OPENSSL
+    &xtt_crypto_provider_openssl,
+#endif
+};
+
+#ifdef XTT_USE_LIBSODIUM
+static const struct xtt_crypto_provider *current_provider = &xtt_crypto_provider_libsodium;
+#else
+static const struct xtt_crypto_provider *current_provider = &xtt_crypto_provider_openssl;
+#endif
+
+static int check_entropy(void);
+
+const struct xtt_crypto_provider* xtt_crypto_find_provider(const char *name)
+{
+    for (size_t i = 0; i < sizeof(builtin_providers) / sizeof(builtin_providers[0]); ++i) {
+        if (0 == strcmp(name, builtin_providers[i]->name))
+            return builtin_providers[i];
+    }
+
+    return NULL;
+}
+
+const struct xtt_crypto_provider* xtt_crypto_get_provider(void)
+{
+    return current_provider;
+}
+
+int xtt_crypto_set_provider(const struct xtt_crypto_provider *provider)
+{
+    int rc = check_entropy();
+    if (0 != rc)
+        return rc;
+
+    rc = provider->initialize();
+    if (0 != rc)
+        return rc;
+
+    current_provider = provider;
+
+    return 0;
+}
+
+int xtt_crypto_initialize_crypto()
+{
+    int rc = check_entropy();
+    if (0 != rc)
+        return rc;
+
+    return current_provider->initialize();
+}
+
+int xtt_crypto_memcmp(const unsigned char *one, const unsigned char *two, uint16_t length)
+{
+    return current_provider->memcmp_ct(one, two, length);
+}
+
+void xtt_crypto_secure_clear(unsigned char* memory, uint16_t memory_length)
+{
+    current_provider->secure_clear(memory, memory_length);
+}
+
+int xtt_crypto_get_random(unsigned char* buffer, uint16_t buffer_length)
+{
+    return current_provider->get_random(buffer, buffer_length);
+}
+
+int xtt_crypto_create_x25519_key_pair(xtt_x25519_pub_key *pub, xtt_x25519_priv_key *priv)
+{
+    if (0 != current_provider->get_random(priv->data, sizeof(xtt_x25519_priv_key)))
+        return -1;
+
+    return current_provider->x25519_public_key(pub, priv);
+}
+
+int xtt_crypto_x25519_public_key(xtt_x25519_pub_key *pub, const xtt_x25519_priv_key *priv)
+{
+    return current_provider->x25519_public_key(pub, priv);
+}
+
+int xtt_crypto_do_x25519_diffie_hellman(unsigned char* shared_secret,
+                                        const xtt_x25519_priv_key* my_sk,
+                                        const xtt_x25519_pub_key* other_pk)
+{
+    return current_provider->do_x25519_diffie_hellman(shared_secret, my_sk, other_pk);
+}
+
+int xtt_crypto_hash_sha512(unsigned char* out,
+                           uint16_t* out_length,
+                           const unsigned char* in,
+                           uint16_t in_len)
+{
+    xtt_hash_state h;
+
+    if (0 != current_provider->hash_sha512_init(&h))
+        return -1;
+    if (0 != current_provider->hash_sha512_update(&h, in, in_len)) {
+        current_provider->hash_release(&h);
+        return -1;
+    }
+    if (0 != current_provider->hash_sha512_final(out, out_length, &h))
+        return -1;
+
+    return 0;
+}
+
+int xtt_crypto_hash_blake2b(unsigned char* out,
+                            uint16_t* out_length,
+                            const unsigned char* in,
+                            uint16_t in_len)
+{
+    xtt_hash_state h;
+
+    if (0 != current_provider->hash_blake2b_init(&h))
+        return -1;
+    if (0 != current_provider->hash_blake2b_update(&h, in, in_len)) {
+        current_provider->hash_release(&h);
+        return -1;
+    }
+    if (0 != current_provider->hash_blake2b_final(out, out_length, &h))
+        return -1;
+
+    return 0;
+}
+
+int xtt_crypto_hash_sha512_init(xtt_hash_state* state)
+{
+    return current_provider->hash_sha512_init(state);
+}
+
+int xtt_crypto_hash_sha512_update(xtt_hash_state* state,
+                                  const unsigned char* in,
+                                  uint16_t in_len)
+{
+    return current_provider->hash_sha512_update(state, in, in_len);
+}
+
+int xtt_crypto_hash_sha512_final(unsigned char* out,
+                                 uint16_t* out_length,
+                                 xtt_hash_state* state)
+{
+    return current_provider->hash_sha512_final(out, out_length, state);
+}
+
+int xtt_crypto_hash_blake2b_init(xtt_hash_state* state)
+{
+    return current_provider->hash_blake2b_init(state);
+}
+
+int xtt_crypto_hash_blake2b_update(xtt_hash_state* state,
+                                   const unsigned char* in,
+                                   uint16_t in_len)
+{
+    return current_provider->hash_blake2b_update(state, in, in_len);
+}
+
+int xtt_crypto_hash_blake2b_final(unsigned char* out,
+                                  uint16_t* out_length,
+                                  xtt_hash_state* state)
+{
+    return current_provider->hash_blake2b_final(out, out_length, state);
+}
+
+int xtt_crypto_hash_copy(xtt_hash_state* dst, const xtt_hash_state* src)
+{
+    return current_provider->hash_copy(dst, src);
+}
+
+void xtt_crypto_hash_release(xtt_hash_state* state)
+{
+    current_provider->hash_release(state);
+}
+
+int xtt_crypto_prf_sha512(unsigned char* out,
+                          uint16_t out_len,
+                          const unsigned char* in,
+                          uint16_t in_len,
+                          const unsigned char* key,
+                          uint16_t key_len)
+{
+    xtt_prf_state h;
+
+    if (0 != current_provider->prf_sha512_init(&h, out_len, key, key_len))
+        return -1;
+    if (0 != current_provider->prf_sha512_update(&h, in, in_len)) {
+        current_provider->prf_release(&h);
+        return -1;
+    }
+    if (0 != current_provider->prf_sha512_final(out, out_len, &h))
+        return -1;
+
+    return 0;
+}
+
+int xtt_crypto_prf_blake2b(unsigned char* out,
+                           uint16_t out_len,
+                           const unsigned char* in,
+                           uint16_t in_len,
+                           const unsigned char* key,
+                           uint16_t key_len)
+{
+    xtt_prf_state h;
+
+    if (0 != current_provider->prf_blake2b_init(&h, out_len, key, key_len))
+        return -1;
+    if (0 != current_provider->prf_blake2b_update(&h, in, in_len)) {
+        current_provider->prf_release(&h);
+        return -1;
+    }
+    if (0 != current_provider->prf_blake2b_final(out, out_len, &h))
+        return -1;
+
+    return 0;
+}
+
+int xtt_crypto_prf_sha512_init(xtt_prf_state* state,
+                               uint16_t out_len,
+                               const unsigned char* key,
+                               uint16_t key_len)
+{
+    return current_provider->prf_sha512_init(state, out_len, key, key_len);
+}
+
+int xtt_crypto_prf_sha512_update(xtt_prf_state* state,
+                                 const unsigned char* in,
+                                 uint16_t in_len)
+{
+    return current_provider->prf_sha512_update(state, in, in_len);
+}
+
+int xtt_crypto_prf_sha512_final(unsigned char* out,
+                                uint16_t out_len,
+                                xtt_prf_state* state)
+{
+    return current_provider->prf_sha512_final(out, out_len, state);
+}
+
+int xtt_crypto_prf_blake2b_init(xtt_prf_state* state,
+                                uint16_t out_len,
+                                const unsigned char* key,
+                                uint16_t key_len)
+{
+    return current_provider->prf_blake2b_init(state, out_len, key, key_len);
+}
+
+int xtt_crypto_prf_blake2b_update(xtt_prf_state* state,
+                                  const unsigned char* in,
+                                  uint16_t in_len)
+{
+    return current_provider->prf_blake2b_update(state, in, in_len);
+}
+
+int xtt_crypto_prf_blake2b_final(unsigned char* out,
+                                 uint16_t out_len,
+                                 xtt_prf_state* state)
+{
+    return current_provider->prf_blake2b_final(out, out_len, state);
+}
+
+int xtt_crypto_prf_copy(xtt_prf_state* dst, const xtt_prf_state* src)
+{
+    return current_provider->prf_copy(dst, src);
+}
+
+void xtt_crypto_prf_release(xtt_prf_state* state)
+{
+    current_provider->prf_release(state);
+}
+
+int xtt_crypto_create_ed25519_key_pair(xtt_ed25519_pub_key *pub_key,
+                                       xtt_ed25519_priv_key *priv_key)
+{
+    unsigned char seed[32];
+
+    if (0 != current_provider->get_random(seed, sizeof(seed)))
+        return -1;
+
+    int rc = current_provider->ed25519_key_pair_from_seed(pub_key, priv_key, seed);
+
+    current_provider->secure_clear(seed, sizeof(seed));
+
+    return rc;
+}
+
+int xtt_crypto_sign_ed25519(unsigned char* signature_out,
+                            const unsigned char* msg,
+                            uint16_t msg_len,
+                            const xtt_ed25519_priv_key* priv_key)
+{
+    return current_provider->sign_ed25519(signature_out, msg, msg_len, priv_key);
+}
+
+int xtt_crypto_verify_ed25519(const unsigned char* signature,
+                              const unsigned char* msg,
+                              uint16_t msg_len,
+                              const xtt_ed25519_pub_key* pub_key)
+{
+    return current_provider->verify_ed25519(signature, msg, msg_len, pub_key);
+}
+
+int xtt_crypto_batch_verify_ed25519(int *results_out,
+                                    const struct xtt_ed25519_verify_item *items,
+                                    uint16_t item_count)
+{
+    return current_provider->batch_verify_ed25519(results_out, items, item_count);
+}
+
+int xtt_crypto_aead_chacha_is_available(void)
+{
+    return current_provider->aead_chacha_is_available();
+}
+
+int xtt_crypto_aead_aes256_is_available(void)
+{
+    return current_provider->aead_aes256_is_available();
+}
+
+int xtt_crypto_aead_chacha_encrypt(unsigned char* ciphertext,
+                                   uint16_t* ciphertext_len,
+                                   const unsigned char* message,
+                                   uint16_t msg_len,
+                                   const unsigned char* addl_data,
+                                   uint16_t addl_len,
+                                   const xtt_chacha_nonce* nonce,
+                                   const xtt_chacha_key* key)
+{
+    if (msg_len > UINT16_MAX - sizeof(xtt_chacha_mac))
+        return XTT_ERROR_UINT32_OVERFLOW;
+
+    int ret = current_provider->aead_chacha_encrypt_detached(ciphertext,
+                                                             ciphertext + msg_len,
+                                                             message,
+                                                             msg_len,
+                                                             addl_data,
+                                                             addl_len,
+                                                             nonce,
+                                                             key);
+
+    *ciphertext_len = msg_len + sizeof(xtt_chacha_mac);
+
+    return ret;
+}
+
+int xtt_crypto_aead_chacha_decrypt(unsigned char* decrypted,
+                                   uint16_t* decrypted_len,
+                                   const unsigned char* ciphertext,
+                                   uint16_t ciphertext_len,
+                                   const unsigned char* addl_data,
+                                   uint16_t addl_len,
+                                   const xtt_chacha_nonce* nonce,
+                                   const xtt_chacha_key* key)
+{
+    if (ciphertext_len < sizeof(xtt_chacha_mac))
+        return -1;
+
+    uint16_t message_len = ciphertext_len - sizeof(xtt_chacha_mac);
+    int ret = current_provider->aead_chacha_decrypt_detached(decrypted,
+                                                             ciphertext,
+                                                             message_len,
+                                                             ciphertext + message_len,
+                                                             addl_data,
+                                                             addl_len,
+                                                             nonce,
+                                                             key);
+
+    *decrypted_len = message_len;
+
+    return ret;
+}
+
+int xtt_crypto_aead_aes256_encrypt(unsigned char* ciphertext,
+                                   uint16_t* ciphertext_len,
+                                   const unsigned char* message,
+                                   uint16_t msg_len,
+                                   const unsigned char* addl_data,
+                                   uint16_t addl_len,
+                                   const xtt_aes256_nonce* nonce,
+                                   const xtt_aes256_key* key)
+{
+    if (msg_len > UINT16_MAX - sizeof(xtt_aes256_mac))
+        return XTT_ERROR_UINT32_OVERFLOW;
+
+    int ret = current_provider->aead_aes256_encrypt_detached(ciphertext,
+                                                             ciphertext + msg_len,
+                                                             message,
+                                                             msg_len,
+                                                             addl_data,
+                                                             addl_len,
+                                                             nonce,
+                                                             key);
+
+    *ciphertext_len = msg_len + sizeof(xtt_aes256_mac);
+
+    return ret;
+}
+
+int xtt_crypto_aead_aes256_decrypt(unsigned char* decrypted,
+                                   uint16_t* decrypted_len,
+                                   const unsigned char* ciphertext,
+                                   uint16_t ciphertext_len,
+                                   const unsigned char* addl_data,
+                                   uint16_t addl_len,
+                                   const xtt_aes256_nonce* nonce,
+                                   const xtt_aes256_key* key)
+{
+    if (ciphertext_len < sizeof(xtt_aes256_mac))
+        return -1;
+
+    uint16_t message_len = ciphertext_len - sizeof(xtt_aes256_mac);
+    int ret = current_provider->aead_aes256_decrypt_detached(decrypted,
+                                                             ciphertext,
+                                                             message_len,
+                                                             ciphertext + message_len,
+                                                             addl_data,
+                                                             addl_len,
+                                                             nonce,
+                                                             key);
+
+    *decrypted_len = message_len;
+
+    return ret;
+}
+
+int xtt_crypto_aead_chacha_encrypt_detached(unsigned char* ciphertext,
+                                            unsigned char* mac_out,
+                                            const unsigned char* message,
+                                            uint16_t msg_len,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_chacha_nonce* nonce,
+                                            const xtt_chacha_key* key)
+{
+    return current_provider->aead_chacha_encrypt_detached(ciphertext, mac_out, message, msg_len,
+                                                          addl_data, addl_len, nonce, key);
+}
+
+int xtt_crypto_aead_chacha_decrypt_detached(unsigned char* decrypted,
+                                            const unsigned char* ciphertext,
+                                            uint16_t ciphertext_len,
+                                            const unsigned char* mac,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_chacha_nonce* nonce,
+                                            const xtt_chacha_key* key)
+{
+    return current_provider->aead_chacha_decrypt_detached(decrypted, ciphertext, ciphertext_len, mac,
+                                                          addl_data, addl_len, nonce, key);
+}
+
+int xtt_crypto_aead_aes256_encrypt_detached(unsigned char* ciphertext,
+                                            unsigned char* mac_out,
+                                            const unsigned char* message,
+                                            uint16_t msg_len,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_aes256_nonce* nonce,
+                                            const xtt_aes256_key* key)
+{
+    return current_provider->aead_aes256_encrypt_detached(ciphertext, mac_out, message, msg_len,
+                                                          addl_data, addl_len, nonce, key);
+}
+
+int xtt_crypto_aead_aes256_decrypt_detached(unsigned char* decrypted,
+                                            const unsigned char* ciphertext,
+                                            uint16_t ciphertext_len,
+                                            const unsigned char* mac,
+                                            const unsigned char* addl_data,
+                                            uint16_t addl_len,
+                                            const xtt_aes256_nonce* nonce,
+                                            const xtt_aes256_key* key)
+{
+    return current_provider->aead_aes256_decrypt_detached(decrypted, ciphertext, ciphertext_len, mac,
+                                                          addl_data, addl_len, nonce, key);
+}
+
+int xtt_crypto_aead_aes256_expand_key(xtt_aes256_key_schedule* schedule_out,
+                                      const xtt_aes256_key* key)
+{
+    return current_provider->aead_aes256_expand_key(schedule_out, key);
+}
+
+int xtt_crypto_aead_aes256_encrypt_detached_expanded(unsigned char* ciphertext,
+                                                     unsigned char* mac_out,
+                                                     const unsigned char* message,
+                                                     uint16_t msg_len,
+                                                     const unsigned char* addl_data,
+                                                     uint16_t addl_len,
+                                                     const xtt_aes256_nonce* nonce,
+                                                     const xtt_aes256_key_schedule* schedule)
+{
+    return current_provider->aead_aes256_encrypt_detached_expanded(ciphertext, mac_out, message, msg_len,
+                                                                   addl_data, addl_len, nonce, schedule);
+}
+
+int xtt_crypto_aead_aes256_decrypt_detached_expanded(unsigned char* decrypted,
+                                                     const unsigned char* ciphertext,
+                                                     uint16_t ciphertext_len,
+                                                     const unsigned char* mac,
+                                                     const unsigned char* addl_data,
+                                                     uint16_t addl_len,
+                                                     const xtt_aes256_nonce* nonce,
+                                                     const xtt_aes256_key_schedule* schedule)
+{
+    return current_provider->aead_aes256_decrypt_detached_expanded(decrypted, ciphertext, ciphertext_len, mac,
+                                                                   addl_data, addl_len, nonce, schedule);
+}
+
+int check_entropy(void)
+{
+#if defined(__linux__) && defined(RNDGETENTCNT)
+    int rand_fd;
+    int ent_count;
+
+    if ((rand_fd = open("/dev/random", O_RDONLY)) != -1) {
+        if (ioctl(rand_fd, RNDGETENTCNT, &ent_count) == 0 && ent_count < 160) {
+            (void) close(rand_fd);
+            return XTT_ERROR_INSUFFICIENT_ENTROPY;
+        }
+
+        (void) close(rand_fd);
+    }
+    /* TODO: Check entropy on other platforms */
+#endif
+
+    return 0;
+}
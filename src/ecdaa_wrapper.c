@@ -23,9 +23,21 @@
 
 #include <ecdaa.h>
 
+#include <amcl/big_256_56.h>
+#include <amcl/ecp_FP256BN.h>
+#include <amcl/ecp2_FP256BN.h>
+#include <amcl/fp2_FP256BN.h>
+#include <amcl/fp4_FP256BN.h>
+#include <amcl/fp12_FP256BN.h>
+#include <amcl/pair_FP256BN.h>
+#include <amcl/amcl.h>
+
 #include <assert.h>
 #include <string.h>
 
+// The prepared group public key is just ecdaa's own struct, stored in an opaque buffer.
+typedef char xtt_prepared_gpk_is_large_enough[sizeof(struct ecdaa_group_public_key_FP256BN) <= sizeof(xtt_daa_prepared_group_pub_key_lrsw) ? 1 : -1];
+
 int
 xtt_daa_sign_lrswTPM(unsigned char *signature_out,
                      const unsigned char *msg,
@@ -135,6 +147,42 @@ xtt_daa_verify_lrswTPM(unsigned char *signature,
                        unsigned char *basename,
                        uint16_t basename_len,
                        xtt_daa_group_pub_key_lrsw* gpk)
+{
+    xtt_daa_prepared_group_pub_key_lrsw prepared_gpk;
+    if (0 != xtt_daa_prepare_group_public_key_lrsw(&prepared_gpk, gpk)) {
+        return -1;
+    }
+
+    return xtt_daa_verify_lrswTPM_prepared(signature,
+                                           msg,
+                                           msg_len,
+                                           basename,
+                                           basename_len,
+                                           &prepared_gpk);
+}
+
+int
+xtt_daa_prepare_group_public_key_lrsw(xtt_daa_prepared_group_pub_key_lrsw *prepared_gpk_out,
+                                      xtt_daa_group_pub_key_lrsw *gpk)
+{
+    // Deserialization also validates the points (on-curve and in the right subgroup),
+    // which is why it's worth only doing once.
+    struct ecdaa_group_public_key_FP256BN *ecdaa_gpk = (struct ecdaa_group_public_key_FP256BN*)prepared_gpk_out->data;
+    assert(sizeof(xtt_daa_group_pub_key_lrsw) == ecdaa_group_public_key_FP256BN_length());
+    if (0 != ecdaa_group_public_key_FP256BN_deserialize(ecdaa_gpk, gpk->data)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+xtt_daa_verify_lrswTPM_prepared(unsigned char *signature,
+                                unsigned char* msg,
+                                uint16_t msg_len,
+                                unsigned char *basename,
+                                uint16_t basename_len,
+                                const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk)
 {
     // 1) Deserialize signature.
     struct ecdaa_signature_FP256BN ecdaa_sig;
@@ -143,12 +191,9 @@ xtt_daa_verify_lrswTPM(unsigned char *signature,
         return -1;
     }
 
-    // 2) Deserialize gpk.
-    struct ecdaa_group_public_key_FP256BN ecdaa_gpk;
-    assert(sizeof(xtt_daa_group_pub_key_lrsw) == ecdaa_group_public_key_FP256BN_length());
-    if (0 != ecdaa_group_public_key_FP256BN_deserialize(&ecdaa_gpk, gpk->data)) {
-        return -1;
-    }
+    // 2) Use the already-deserialized gpk.
+    // (ecdaa only reads it, it just isn't declared const).
+    struct ecdaa_group_public_key_FP256BN *ecdaa_gpk = (struct ecdaa_group_public_key_FP256BN*)prepared_gpk->data;
 
     // TODO: Actually take rev lists as params to this function.
     struct ecdaa_revocations_FP256BN revocations;
@@ -159,7 +204,7 @@ xtt_daa_verify_lrswTPM(unsigned char *signature,
 
     // 3) Verify signature
     int verify_ret = ecdaa_signature_FP256BN_verify(&ecdaa_sig,
-                                                    &ecdaa_gpk,
+                                                    ecdaa_gpk,
                                                     &revocations,
                                                     msg,
                                                     msg_len,
@@ -170,3 +215,869 @@ xtt_daa_verify_lrswTPM(unsigned char *signature,
 
     return 0;
 }
+
+/*
+ * Batch verification.
+ *
+ * An LRSW DAA signature (c, s, R, S, T, W, K) is valid if
+ *      1) the Schnorr proof (c, s) for W = sk*S (and K = sk*B, with B = H(basename)) checks out,
+ *      2) e(R, Y) == e(S, P2), and
+ *      3) e(R + W, X) == e(T, P2).
+ *
+ * (1) is cheap and checked per-signature. For (2) and (3), which need the pairings,
+ * pick random d_i, e_i and check all the signatures at once:
+ *      e(sum(d_i*S_i + e_i*T_i), P2) * e(-sum(d_i*R_i), Y) * e(-sum(e_i*(R_i + W_i)), X) == 1
+ * which is three Miller loops and one final exponentiation, however many signatures there are.
+ * A bad signature survives this with probability ~2^-64.
+ *
+ * ecdaa doesn't expose its Schnorr verification, so (1) is re-implemented here
+ * (`xtt_daa_check_schnorr_lrsw`), and a signature that fails it is rejected straight away.
+ * So that can't drift from this version of ecdaa unnoticed, `xtt_daa_self_test_lrsw`
+ * checks it against fresh signatures from ecdaa before a group public key context can be initialized.
+ *
+ * The local checks (this transcript, and the pairing tables below) only ever accept
+ * a combination of two or more signatures. A signature that's on its own,
+ * whether from the start or at the bottom of a bisection, is accepted or not by ecdaa's own verify.
+ */
+
+#define BATCH_PENDING 1
+
+/*
+ * Precomputed pairing tables.
+ *
+ * In the (optimal ate) Miller loop for e(Q, P), every line function depends only on the G2 point Q,
+ * except for where it's evaluated (at the G1 point P).
+ * So for a fixed Q, the loop can be run once, ahead of time, recording each line as
+ *      l(P) = cy*yP + cx*xP + c0
+ * (cy, cx, c0 in Fp2, with the twist's powers of w supplied when the line is evaluated).
+ * The lines are recorded in affine form, which costs an Fp2 inversion per line,
+ * but only when the tables are built.
+ *
+ * All three fixed points share the same loop, so they're evaluated together,
+ * sharing the squarings of the accumulator (a multi-Miller loop).
+ */
+
+#define PAIRING_TABLE_MAX_LINES 144
+
+enum {
+    TABLE_P2 = 0,
+    TABLE_Y = 1,
+    TABLE_X = 2,
+    PAIRING_TABLE_POINTS = 3
+};
+
+struct pairing_line {
+    FP2_FP256BN cy;
+    FP2_FP256BN cx;
+    FP2_FP256BN c0;
+};
+
+struct pairing_tables {
+    uint32_t line_count;
+    struct pairing_line lines[PAIRING_TABLE_POINTS][PAIRING_TABLE_MAX_LINES];
+};
+
+typedef char xtt_pairing_tables_are_large_enough[sizeof(struct pairing_tables) <= sizeof(xtt_daa_pairing_tables_lrsw) ? 1 : -1];
+
+/*
+ * A throwaway group, member key and credential (made by ecdaa),
+ * used only by `xtt_daa_self_test_lrsw` to make fresh signatures with ecdaa.
+ */
+static const xtt_daa_group_pub_key_lrsw self_test_gpk = {.data={
+    0x04, 0x27, 0xd4, 0x35, 0xbf, 0xc7, 0x1d, 0x4a, 0x42, 0xb1, 0xd2, 0x26,
+    0x25, 0x54, 0xfe, 0x12, 0x54, 0x84, 0xbc, 0x67, 0x2e, 0xe7, 0xfb, 0x68,
+    0xf7, 0x00, 0xb3, 0x7f, 0x2a, 0xb4, 0x91, 0x61, 0xb8, 0xd3, 0xed, 0x78,
+    0x53, 0x42, 0x26, 0x26, 0x48, 0x27, 0xaf, 0x66, 0xfe, 0xcf, 0xfb, 0xb3,
+    0x8d, 0xd0, 0xcc, 0x76, 0xff, 0x23, 0x38, 0x36, 0xc4, 0x9b, 0x5a, 0xfa,
+    0x58, 0x0c, 0x70, 0x34, 0xca, 0xb4, 0xf5, 0xf7, 0xfd, 0x9d, 0x06, 0x7e,
+    0xc7, 0xad, 0x6e, 0xb4, 0x7a, 0x92, 0x1a, 0xd4, 0x08, 0x27, 0xee, 0xdd,
+    0xf2, 0xf6, 0x82, 0xf6, 0x94, 0x50, 0xdd, 0xba, 0xec, 0x99, 0x37, 0xca,
+    0x11, 0x76, 0x80, 0xf7, 0xdc, 0xe8, 0xd9, 0x20, 0x0b, 0xa6, 0x99, 0xa7,
+    0x11, 0x6c, 0xf4, 0xc2, 0x5a, 0x34, 0x05, 0x52, 0x1e, 0x19, 0x30, 0x40,
+    0xa1, 0x0e, 0xe9, 0x10, 0x4d, 0xd5, 0xc0, 0x18, 0xdf, 0x04, 0xee, 0x9c,
+    0x97, 0x24, 0xaf, 0x83, 0xe6, 0x5a, 0x91, 0xcc, 0x0f, 0xcf, 0x5c, 0xfe,
+    0xa9, 0x34, 0x39, 0x81, 0x4d, 0xfe, 0x05, 0xc8, 0xca, 0x0c, 0xd8, 0x5e,
+    0xf0, 0x55, 0xad, 0xf8, 0x1d, 0xd0, 0xf1, 0xd1, 0x3b, 0x90, 0x61, 0xac,
+    0x82, 0x12, 0xfb, 0x07, 0x78, 0xee, 0xdb, 0xd6, 0x2e, 0xd7, 0xe0, 0x16,
+    0x89, 0xe1, 0x27, 0x8f, 0xac, 0xde, 0xcd, 0x71, 0x39, 0xe7, 0xec, 0x88,
+    0x01, 0xa8, 0xdb, 0xc8, 0xa7, 0x8e, 0x36, 0x90, 0xce, 0xd2, 0x1e, 0x32,
+    0x79, 0xc4, 0x6a, 0x88, 0x3c, 0x8a, 0xe5, 0x63, 0xb0, 0xd6, 0xb1, 0x31,
+    0x9d, 0x23, 0x19, 0x2a, 0xc2, 0x94, 0xb6, 0x7d, 0xc0, 0x0e, 0xd3, 0xfb,
+    0x96, 0xbd, 0xe6, 0x48, 0xec, 0xe3, 0x20, 0xee, 0xd1, 0x0d, 0x5a, 0x93,
+    0x15, 0x8c, 0xdb, 0x2d, 0x93, 0xec, 0xff, 0x0f, 0x20, 0x9f, 0x6e, 0xfd,
+    0x05, 0x3a, 0x18, 0xe3, 0xf6, 0xd8
+}};
+
+static const xtt_daa_credential_lrsw self_test_cred = {.data={
+    0x04, 0xe1, 0x63, 0x6e, 0x34, 0x7c, 0x7f, 0xbc, 0x41, 0xc2, 0x0b, 0xf5,
+    0x28, 0x7d, 0xb8, 0xb9, 0xbd, 0x77, 0x89, 0xb7, 0x3e, 0x0b, 0xda, 0x91,
+    0xe1, 0xe1, 0x90, 0x1c, 0xcf, 0x06, 0x6f, 0xb0, 0x10, 0xd7, 0xab, 0x7a,
+    0x3b, 0x8f, 0x29, 0x5a, 0xb3, 0x10, 0xd2, 0xba, 0xed, 0x57, 0x98, 0xed,
+    0x2c, 0x2c, 0xa0, 0x4d, 0xa0, 0x2f, 0xfc, 0x03, 0x85, 0xd6, 0xc7, 0x08,
+    0xfe, 0xfd, 0xab, 0x37, 0x5c, 0x04, 0xa4, 0x65, 0x2b, 0xf6, 0xa6, 0xb0,
+    0x75, 0xda, 0x3b, 0xc7, 0x4d, 0x11, 0x0e, 0xa5, 0x22, 0x3b, 0x64, 0xcc,
+    0x28, 0x3f, 0x8e, 0xc4, 0x91, 0x65, 0x25, 0xa8, 0x7e, 0x36, 0x67, 0xa4,
+    0x53, 0xed, 0x42, 0xda, 0xbd, 0xdc, 0x49, 0xfe, 0xe9, 0xb0, 0x0a, 0x0c,
+    0x76, 0x3c, 0x52, 0xae, 0xb1, 0x00, 0xb4, 0xa1, 0x90, 0x7c, 0xcc, 0x4e,
+    0xe8, 0xe2, 0x4e, 0xb9, 0xf7, 0xa4, 0x91, 0xa7, 0xd1, 0x57, 0x04, 0x8a,
+    0x71, 0x60, 0xca, 0x86, 0xf8, 0xc4, 0x67, 0x79, 0x68, 0x8c, 0x19, 0x59,
+    0xf2, 0xb1, 0x58, 0x4e, 0xbe, 0x7a, 0xbb, 0xc5, 0x87, 0x2f, 0xbf, 0xed,
+    0xe1, 0x6b, 0xba, 0xf1, 0xe0, 0x3b, 0xf6, 0x5f, 0xca, 0x23, 0xfa, 0x78,
+    0xb9, 0x89, 0x91, 0xbd, 0x3a, 0x51, 0x1b, 0x0a, 0xbe, 0x7c, 0x1a, 0xdb,
+    0x2a, 0xef, 0xc7, 0xb8, 0x5d, 0xbd, 0x51, 0xd5, 0x4d, 0x00, 0x5c, 0x7d,
+    0x7a, 0xc4, 0xd1, 0x04, 0xd6, 0x53, 0xc8, 0xc3, 0x8f, 0xc9, 0xfb, 0x26,
+    0xa8, 0xc8, 0xb7, 0xf6, 0x7f, 0x58, 0xb4, 0x64, 0x05, 0x8c, 0x1b, 0x8c,
+    0xea, 0x26, 0x8f, 0x1c, 0x81, 0xcf, 0xb6, 0x37, 0x7b, 0x6b, 0x11, 0x36,
+    0xa9, 0x9a, 0xd1, 0x0c, 0xf3, 0xfd, 0xc3, 0xe3, 0x9e, 0x72, 0x41, 0x97,
+    0x51, 0x18, 0xca, 0x24, 0x29, 0xf2, 0xa4, 0x6f, 0xd5, 0x50, 0x30, 0x98,
+    0x15, 0x68, 0x84, 0xf7, 0x2b, 0x5a, 0x80, 0x39
+}};
+
+static const xtt_daa_priv_key_lrsw self_test_priv_key = {.data={
+    0x0b, 0x8a, 0x76, 0xe0, 0xbf, 0x23, 0xf2, 0x1a, 0x5b, 0x54, 0x7d, 0x8c,
+    0x97, 0xcf, 0x3f, 0xa0, 0xae, 0x72, 0xb6, 0x60, 0x29, 0x10, 0x18, 0x14,
+    0x61, 0xb6, 0x58, 0x6a, 0x44, 0x97, 0xa1, 0xf7
+}};
+
+enum {
+    SELF_TEST_NOT_RUN = 0,
+    SELF_TEST_PASSED = 1,
+    SELF_TEST_FAILED = 2
+};
+
+static int self_test_state = SELF_TEST_NOT_RUN;
+
+static int run_self_test(void);
+
+static int verify_single(const struct xtt_daa_verify_item *item,
+                         const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk);
+
+static int check_schnorr(struct ecdaa_signature_FP256BN *sig,
+                         const struct xtt_daa_verify_item *item);
+
+static int hash_to_g1(ECP_FP256BN *point_out,
+                      const unsigned char *msg,
+                      uint16_t msg_len);
+
+static void hash_point(hash256 *sha,
+                       ECP_FP256BN *point);
+
+static void random_exponent(BIG_256_56 exponent_out);
+
+static void g2_generator(ECP2_FP256BN *generator_out);
+
+static void g1_generator(ECP_FP256BN *generator_out);
+
+static void miller_loop_parameters(BIG_256_56 n, BIG_256_56 n3);
+
+static void frobenius_constant(FP2_FP256BN *frobenius_out);
+
+static void record_line(struct pairing_line *line_out,
+                        ECP2_FP256BN *T,
+                        ECP2_FP256BN *Q);
+
+static int build_line_table(struct pairing_line *lines_out,
+                            uint32_t *line_count_out,
+                            ECP2_FP256BN *Q);
+
+static void multiply_lines(FP12_FP256BN *accumulator,
+                           const struct pairing_tables *tables,
+                           uint32_t line_index,
+                           FP_FP256BN *xP,
+                           FP_FP256BN *yP);
+
+static int check_pairings_combined(const struct xtt_daa_verify_item *items,
+                                   const int *results,
+                                   uint16_t begin,
+                                   uint16_t end,
+                                   const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                                   const xtt_daa_pairing_tables_lrsw* tables);
+
+static void verify_range(int *results,
+                         const struct xtt_daa_verify_item *items,
+                         uint16_t begin,
+                         uint16_t end,
+                         const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                         const xtt_daa_pairing_tables_lrsw* tables);
+
+static void miller_loop_precomputed(FP12_FP256BN *result_out,
+                                    const xtt_daa_pairing_tables_lrsw* tables,
+                                    ECP_FP256BN *g1_points[]);
+
+int
+xtt_daa_batch_verify_lrswTPM_prepared(int *results_out,
+                                      const struct xtt_daa_verify_item *items,
+                                      uint16_t item_count,
+                                      const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk)
+{
+    return xtt_daa_batch_verify_lrswTPM_precomputed(results_out,
+                                                    items,
+                                                    item_count,
+                                                    prepared_gpk,
+                                                    NULL);
+}
+
+int
+xtt_daa_batch_verify_lrswTPM_precomputed(int *results_out,
+                                         const struct xtt_daa_verify_item *items,
+                                         uint16_t item_count,
+                                         const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                                         const xtt_daa_pairing_tables_lrsw* tables)
+{
+    // 1) Do the per-signature checks, turning away anything that fails them.
+    for (uint16_t i = 0; i < item_count; ++i)
+        results_out[i] = (0 == xtt_daa_check_schnorr_lrsw(&items[i])) ? BATCH_PENDING : -1;
+
+    // 2) Check the pairing equations of everything that's left, together.
+    verify_range(results_out, items, 0, item_count, prepared_gpk, tables);
+
+    int ret = 0;
+    for (uint16_t i = 0; i < item_count; ++i) {
+        assert(BATCH_PENDING != results_out[i]);
+        if (0 != results_out[i])
+            ret = -1;
+    }
+
+    return ret;
+}
+
+int
+xtt_daa_self_test_lrsw(void)
+{
+    int state = __atomic_load_n(&self_test_state, __ATOMIC_ACQUIRE);
+    if (SELF_TEST_NOT_RUN == state) {
+        // Racing threads may both run it, but they'll get the same answer.
+        state = (0 == run_self_test()) ? SELF_TEST_PASSED : SELF_TEST_FAILED;
+        __atomic_store_n(&self_test_state, state, __ATOMIC_RELEASE);
+    }
+
+    return (SELF_TEST_PASSED == state) ? 0 : -1;
+}
+
+int
+run_self_test(void)
+{
+    xtt_daa_group_pub_key_lrsw gpk = self_test_gpk;
+    xtt_daa_credential_lrsw cred = self_test_cred;
+    xtt_daa_priv_key_lrsw priv_key = self_test_priv_key;
+    xtt_daa_prepared_group_pub_key_lrsw prepared_gpk;
+    if (0 != xtt_daa_prepare_group_public_key_lrsw(&prepared_gpk, &gpk))
+        return -1;
+
+    // 1) Two fresh signatures from ecdaa, which both ecdaa and our checks must accept.
+    unsigned char basename[] = "XTT_DAA_SELF_TEST";
+    unsigned char msgs[2][16];
+    unsigned char signatures[2][sizeof(xtt_daa_signature_lrsw)];
+    struct xtt_daa_verify_item items[2];
+    for (int i = 0; i < 2; ++i) {
+        memset(msgs[i], 'a' + i, sizeof(msgs[i]));
+        if (0 != xtt_daa_sign_lrsw(signatures[i],
+                                   msgs[i],
+                                   sizeof(msgs[i]),
+                                   basename,
+                                   sizeof(basename) - 1,
+                                   &cred,
+                                   &priv_key))
+            return -1;
+        items[i] = (struct xtt_daa_verify_item){.signature=signatures[i],
+                                                .msg=msgs[i],
+                                                .msg_len=sizeof(msgs[i]),
+                                                .basename=basename,
+                                                .basename_len=sizeof(basename) - 1};
+
+        if (0 != verify_single(&items[i], &prepared_gpk) || 0 != xtt_daa_check_schnorr_lrsw(&items[i]))
+            return -1;
+    }
+
+    // 2) The combined pairing check must accept them together.
+    int pending[2] = {BATCH_PENDING, BATCH_PENDING};
+    if (0 != check_pairings_combined(items, pending, 0, 2, &prepared_gpk, NULL))
+        return -1;
+
+    // 3) With the message or the basename changed, both ecdaa and our checks must reject.
+    msgs[0][0] ^= 1;
+    int msg_rejected = (0 != verify_single(&items[0], &prepared_gpk)) && (0 != xtt_daa_check_schnorr_lrsw(&items[0]));
+    msgs[0][0] ^= 1;
+    items[0].basename_len -= 1;
+    int basename_rejected = (0 != verify_single(&items[0], &prepared_gpk)) && (0 != xtt_daa_check_schnorr_lrsw(&items[0]));
+    if (!msg_rejected || !basename_rejected)
+        return -1;
+
+    return 0;
+}
+
+int
+verify_single(const struct xtt_daa_verify_item *item,
+              const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk)
+{
+    return xtt_daa_verify_lrswTPM_prepared(item->signature,
+                                           item->msg,
+                                           item->msg_len,
+                                           item->basename,
+                                           item->basename_len,
+                                           prepared_gpk);
+}
+
+int
+xtt_daa_check_schnorr_lrsw(const struct xtt_daa_verify_item *item)
+{
+    struct ecdaa_signature_FP256BN sig;
+    if (0 != ecdaa_signature_FP256BN_deserialize(&sig, item->signature, 1))
+        return -1;
+
+    if (ECP_FP256BN_isinf(&sig.R) || ECP_FP256BN_isinf(&sig.S))
+        return -1;
+
+    return check_schnorr(&sig, item);
+}
+
+int
+check_schnorr(struct ecdaa_signature_FP256BN *sig,
+              const struct xtt_daa_verify_item *item)
+{
+    BIG_256_56 curve_order;
+    BIG_256_56_rcopy(curve_order, CURVE_Order_FP256BN);
+
+    BIG_256_56 minus_c;
+    BIG_256_56_sub(minus_c, curve_order, sig->c);
+    BIG_256_56_norm(minus_c);
+
+    hash256 sha;
+    HASH256_init(&sha);
+
+    // 1) U = s*S - c*W
+    ECP_FP256BN U, W;
+    ECP_FP256BN_copy(&U, &sig->S);
+    ECP_FP256BN_copy(&W, &sig->W);
+    ECP_FP256BN_mul2(&U, &W, sig->s, minus_c);
+
+    hash_point(&sha, &U);
+    hash_point(&sha, &sig->S);
+    hash_point(&sha, &sig->W);
+
+    // 2) If there's a basename, V = s*B - c*K
+    if (0 != item->basename_len) {
+        ECP_FP256BN B, V, K;
+        if (0 != hash_to_g1(&B, item->basename, item->basename_len))
+            return -1;
+        ECP_FP256BN_copy(&V, &B);
+        ECP_FP256BN_copy(&K, &sig->K);
+        ECP_FP256BN_mul2(&V, &K, sig->s, minus_c);
+
+        hash_point(&sha, &B);
+        hash_point(&sha, &sig->K);
+        hash_point(&sha, &V);
+    }
+
+    // 3) c' = H(U | S | W | [B | K | V] | msg)
+    for (uint16_t i = 0; i < item->msg_len; ++i)
+        HASH256_process(&sha, item->msg[i]);
+
+    char digest[32];
+    HASH256_hash(&sha, digest);
+
+    BIG_256_56 c_prime;
+    BIG_256_56_fromBytesLen(c_prime, digest, sizeof(digest));
+    BIG_256_56_mod(c_prime, curve_order);
+
+    // 4) c == c' ?
+    return 0 == BIG_256_56_comp(c_prime, sig->c) ? 0 : -1;
+}
+
+int
+hash_to_g1(ECP_FP256BN *point_out,
+           const unsigned char *msg,
+           uint16_t msg_len)
+{
+    BIG_256_56 modulus;
+    BIG_256_56_rcopy(modulus, Modulus_FP256BN);
+
+    // Try-and-increment: x = H(i | msg) until x is on the curve.
+    // (G1 has cofactor 1, so any point on the curve will do).
+    for (uint32_t i = 0; i < 256; ++i) {
+        hash256 sha;
+        HASH256_init(&sha);
+        HASH256_process(&sha, (int)((i >> 24) & 0xff));
+        HASH256_process(&sha, (int)((i >> 16) & 0xff));
+        HASH256_process(&sha, (int)((i >> 8) & 0xff));
+        HASH256_process(&sha, (int)(i & 0xff));
+        for (uint16_t j = 0; j < msg_len; ++j)
+            HASH256_process(&sha, msg[j]);
+
+        char digest[32];
+        HASH256_hash(&sha, digest);
+
+        BIG_256_56 x;
+        BIG_256_56_fromBytesLen(x, digest, sizeof(digest));
+        BIG_256_56_mod(x, modulus);
+
+        if (ECP_FP256BN_setx(point_out, x, 0))
+            return 0;
+    }
+
+    return -1;
+}
+
+void
+hash_point(hash256 *sha,
+           ECP_FP256BN *point)
+{
+    BIG_256_56 x, y;
+    char bytes[32];
+
+    (void)ECP_FP256BN_get(x, y, point);
+
+    HASH256_process(sha, 0x04);
+    BIG_256_56_toBytes(bytes, x);
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+        HASH256_process(sha, bytes[i]);
+    BIG_256_56_toBytes(bytes, y);
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+        HASH256_process(sha, bytes[i]);
+}
+
+void
+random_exponent(BIG_256_56 exponent_out)
+{
+    char bytes[8];
+    xtt_crypto_get_random((unsigned char*)bytes, sizeof(bytes));
+    bytes[0] |= 0x80;   // never zero
+
+    BIG_256_56_fromBytesLen(exponent_out, bytes, sizeof(bytes));
+}
+
+void
+g2_generator(ECP2_FP256BN *generator_out)
+{
+    BIG_256_56 xa, xb, ya, yb;
+    FP2_FP256BN x, y;
+
+    BIG_256_56_rcopy(xa, CURVE_Pxa_FP256BN);
+    BIG_256_56_rcopy(xb, CURVE_Pxb_FP256BN);
+    BIG_256_56_rcopy(ya, CURVE_Pya_FP256BN);
+    BIG_256_56_rcopy(yb, CURVE_Pyb_FP256BN);
+
+    FP2_FP256BN_from_BIGs(&x, xa, xb);
+    FP2_FP256BN_from_BIGs(&y, ya, yb);
+
+    ECP2_FP256BN_set(generator_out, &x, &y);
+}
+
+int
+check_pairings_combined(const struct xtt_daa_verify_item *items,
+                        const int *results,
+                        uint16_t begin,
+                        uint16_t end,
+                        const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                        const xtt_daa_pairing_tables_lrsw* tables)
+{
+    ECP_FP256BN sum_ST, sum_R, sum_RW;
+    ECP_FP256BN_inf(&sum_ST);
+    ECP_FP256BN_inf(&sum_R);
+    ECP_FP256BN_inf(&sum_RW);
+
+    // 1) Accumulate the randomized G1 sides.
+    for (uint16_t i = begin; i < end; ++i) {
+        if (BATCH_PENDING != results[i])
+            continue;
+
+        struct ecdaa_signature_FP256BN sig;
+        if (0 != ecdaa_signature_FP256BN_deserialize(&sig, items[i].signature, 1))
+            return -1;
+
+        BIG_256_56 d, e;
+        random_exponent(d);
+        random_exponent(e);
+
+        ECP_FP256BN term, other;
+
+        // d*S + e*T
+        ECP_FP256BN_copy(&term, &sig.S);
+        ECP_FP256BN_copy(&other, &sig.T);
+        ECP_FP256BN_mul2(&term, &other, d, e);
+        ECP_FP256BN_add(&sum_ST, &term);
+
+        // d*R
+        ECP_FP256BN_copy(&term, &sig.R);
+        ECP_FP256BN_mul(&term, d);
+        ECP_FP256BN_add(&sum_R, &term);
+
+        // e*(R + W)
+        ECP_FP256BN_copy(&term, &sig.R);
+        ECP_FP256BN_add(&term, &sig.W);
+        ECP_FP256BN_mul(&term, e);
+        ECP_FP256BN_add(&sum_RW, &term);
+    }
+
+    // Only possible if someone's deliberately cancelling terms, so let bisection sort it out.
+    if (ECP_FP256BN_isinf(&sum_ST) || ECP_FP256BN_isinf(&sum_R) || ECP_FP256BN_isinf(&sum_RW))
+        return -1;
+
+    ECP_FP256BN_neg(&sum_R);
+    ECP_FP256BN_neg(&sum_RW);
+
+    // 2) Three Miller loops, one final exponentiation.
+    FP12_FP256BN lhs;
+    if (NULL != tables) {
+        ECP_FP256BN *g1_points[PAIRING_TABLE_POINTS];
+        g1_points[TABLE_P2] = &sum_ST;
+        g1_points[TABLE_Y] = &sum_R;
+        g1_points[TABLE_X] = &sum_RW;
+        miller_loop_precomputed(&lhs, tables, g1_points);
+        PAIR_FP256BN_fexp(&lhs);
+
+        return FP12_FP256BN_isunity(&lhs) ? 0 : -1;
+    }
+
+    // (ecdaa and AMCL only read the gpk, they just don't declare it const).
+    struct ecdaa_group_public_key_FP256BN *gpk = (struct ecdaa_group_public_key_FP256BN*)prepared_gpk->data;
+    ECP2_FP256BN P2;
+    g2_generator(&P2);
+
+    FP12_FP256BN rhs;
+    PAIR_FP256BN_double_ate(&lhs, &gpk->Y, &sum_R, &gpk->X, &sum_RW);
+    PAIR_FP256BN_ate(&rhs, &P2, &sum_ST);
+    FP12_FP256BN_mul(&lhs, &rhs);
+    PAIR_FP256BN_fexp(&lhs);
+
+    return FP12_FP256BN_isunity(&lhs) ? 0 : -1;
+}
+
+void
+verify_range(int *results,
+             const struct xtt_daa_verify_item *items,
+             uint16_t begin,
+             uint16_t end,
+             const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+             const xtt_daa_pairing_tables_lrsw* tables)
+{
+    uint16_t pending = 0;
+    uint16_t last_pending = begin;
+    for (uint16_t i = begin; i < end; ++i) {
+        if (BATCH_PENDING == results[i]) {
+            ++pending;
+            last_pending = i;
+        }
+    }
+
+    if (0 == pending)
+        return;
+
+    // A lone signature is always accepted (or not) by ecdaa itself.
+    if (1 == pending) {
+        results[last_pending] = verify_single(&items[last_pending], prepared_gpk);
+        return;
+    }
+
+    if (0 == check_pairings_combined(items, results, begin, end, prepared_gpk, tables)) {
+        for (uint16_t i = begin; i < end; ++i) {
+            if (BATCH_PENDING == results[i])
+                results[i] = 0;
+        }
+        return;
+    }
+
+    uint16_t middle = begin + (end - begin) / 2;
+    verify_range(results, items, begin, middle, prepared_gpk, tables);
+    verify_range(results, items, middle, end, prepared_gpk, tables);
+}
+
+int
+xtt_daa_verify_lrswTPM_precomputed(unsigned char *signature,
+                                   unsigned char* msg,
+                                   uint16_t msg_len,
+                                   unsigned char *basename,
+                                   uint16_t basename_len,
+                                   const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk,
+                                   const xtt_daa_pairing_tables_lrsw* tables)
+{
+    struct xtt_daa_verify_item item = {.signature=signature,
+                                       .msg=msg,
+                                       .msg_len=msg_len,
+                                       .basename=basename,
+                                       .basename_len=basename_len};
+
+    // The tables only pay off when several signatures share the pairings,
+    // and a lone signature is only ever accepted by ecdaa itself.
+    (void)tables;
+
+    // Same as for a batch: anything our Schnorr check rejects is turned away before any pairings.
+    if (0 != xtt_daa_check_schnorr_lrsw(&item))
+        return -1;
+
+    return verify_single(&item, prepared_gpk);
+}
+
+int
+xtt_daa_precompute_pairing_tables_lrsw(xtt_daa_pairing_tables_lrsw *tables_out,
+                                       const xtt_daa_prepared_group_pub_key_lrsw* prepared_gpk)
+{
+    struct pairing_tables *tables = (struct pairing_tables*)tables_out->data;
+    struct ecdaa_group_public_key_FP256BN *gpk = (struct ecdaa_group_public_key_FP256BN*)prepared_gpk->data;
+
+    // 1) Run the Miller loop for each of the fixed G2 points, recording the lines.
+    ECP2_FP256BN g2_points[PAIRING_TABLE_POINTS];
+    g2_generator(&g2_points[TABLE_P2]);
+    ECP2_FP256BN_copy(&g2_points[TABLE_Y], &gpk->Y);
+    ECP2_FP256BN_copy(&g2_points[TABLE_X], &gpk->X);
+
+    for (int k = 0; k < PAIRING_TABLE_POINTS; ++k) {
+        if (0 != build_line_table(tables->lines[k], &tables->line_count, &g2_points[k]))
+            return -1;
+    }
+
+    // 2) Check the tables against AMCL's own pairing:
+    //  e(a*G, P2) * e(b*G, Y) * e(c*G, X), both ways, for random a, b, c.
+    // (If our lines didn't match this build of AMCL's tower or twist, this would catch it,
+    //  and since each table gets its own point, so would tables for the wrong G2 point).
+    ECP_FP256BN G[PAIRING_TABLE_POINTS];
+    ECP_FP256BN *g1_points[PAIRING_TABLE_POINTS];
+    for (int k = 0; k < PAIRING_TABLE_POINTS; ++k) {
+        BIG_256_56 multiple;
+        random_exponent(multiple);
+        g1_generator(&G[k]);
+        ECP_FP256BN_mul(&G[k], multiple);
+        g1_points[k] = &G[k];
+    }
+
+    FP12_FP256BN from_tables;
+    miller_loop_precomputed(&from_tables, tables_out, g1_points);
+    PAIR_FP256BN_fexp(&from_tables);
+
+    FP12_FP256BN expected, term;
+    ECP2_FP256BN Q;
+    ECP_FP256BN P;
+    g2_generator(&Q);
+    ECP_FP256BN_copy(&P, &G[TABLE_P2]);
+    PAIR_FP256BN_ate(&expected, &Q, &P);
+    ECP2_FP256BN_copy(&Q, &gpk->Y);
+    ECP_FP256BN_copy(&P, &G[TABLE_Y]);
+    PAIR_FP256BN_ate(&term, &Q, &P);
+    FP12_FP256BN_mul(&expected, &term);
+    ECP2_FP256BN_copy(&Q, &gpk->X);
+    ECP_FP256BN_copy(&P, &G[TABLE_X]);
+    PAIR_FP256BN_ate(&term, &Q, &P);
+    FP12_FP256BN_mul(&expected, &term);
+    PAIR_FP256BN_fexp(&expected);
+
+    if (!FP12_FP256BN_equals(&from_tables, &expected))
+        return -1;
+
+    return 0;
+}
+
+void
+g1_generator(ECP_FP256BN *generator_out)
+{
+    BIG_256_56 x, y;
+
+    BIG_256_56_rcopy(x, CURVE_Gx_FP256BN);
+    BIG_256_56_rcopy(y, CURVE_Gy_FP256BN);
+
+    ECP_FP256BN_set(generator_out, x, y);
+}
+
+void
+miller_loop_parameters(BIG_256_56 n, BIG_256_56 n3)
+{
+    // Same loop as AMCL's PAIR_ate for a BN curve:
+    // n = 6x +/- 2, with the NAF-like digits taken from 3n - n.
+    BIG_256_56 x;
+    BIG_256_56_rcopy(x, CURVE_Bnx_FP256BN);
+
+    BIG_256_56_pmul(n, x, 6);
+#if SIGN_OF_X_FP256BN==POSITIVEX
+    BIG_256_56_inc(n, 2);
+#else
+    BIG_256_56_dec(n, 2);
+#endif
+    BIG_256_56_norm(n);
+
+    BIG_256_56_pmul(n3, n, 3);
+    BIG_256_56_norm(n3);
+}
+
+void
+frobenius_constant(FP2_FP256BN *frobenius_out)
+{
+    BIG_256_56 xa, xb;
+
+    BIG_256_56_rcopy(xa, Fra_FP256BN);
+    BIG_256_56_rcopy(xb, Frb_FP256BN);
+    FP2_FP256BN_from_BIGs(frobenius_out, xa, xb);
+
+#if SEXTIC_TWIST_FP256BN==M_TYPE
+    FP2_FP256BN_inv(frobenius_out, frobenius_out);
+    FP2_FP256BN_norm(frobenius_out);
+#endif
+}
+
+void
+record_line(struct pairing_line *line_out,
+            ECP2_FP256BN *T,
+            ECP2_FP256BN *Q)
+{
+    FP2_FP256BN xT, yT, numerator, denominator, tmp;
+
+    (void)ECP2_FP256BN_get(&xT, &yT, T);
+
+    // 1) slope = numerator / denominator
+    if (NULL == Q) {
+        // Tangent at T: 3*xT^2 / 2*yT
+        FP2_FP256BN_sqr(&numerator, &xT);
+        FP2_FP256BN_imul(&numerator, &numerator, 3);
+        FP2_FP256BN_add(&denominator, &yT, &yT);
+    } else {
+        // Chord through T and Q: (yQ - yT) / (xQ - xT)
+        FP2_FP256BN xQ, yQ;
+        (void)ECP2_FP256BN_get(&xQ, &yQ, Q);
+        FP2_FP256BN_sub(&numerator, &yQ, &yT);
+        FP2_FP256BN_sub(&denominator, &xQ, &xT);
+    }
+    FP2_FP256BN_norm(&numerator);
+    FP2_FP256BN_norm(&denominator);
+
+    // 2) l = denominator*(y - yT) - numerator*(x - xT)
+    //  (Scaling by the denominator, instead of dividing, is harmless:
+    //  it's in Fp2, so the final exponentiation removes it).
+    FP2_FP256BN_copy(&line_out->cy, &denominator);
+
+    FP2_FP256BN_neg(&line_out->cx, &numerator);
+    FP2_FP256BN_norm(&line_out->cx);
+
+    FP2_FP256BN_mul(&line_out->c0, &numerator, &xT);
+    FP2_FP256BN_mul(&tmp, &denominator, &yT);
+    FP2_FP256BN_sub(&line_out->c0, &line_out->c0, &tmp);
+    FP2_FP256BN_norm(&line_out->c0);
+}
+
+int
+build_line_table(struct pairing_line *lines_out,
+                 uint32_t *line_count_out,
+                 ECP2_FP256BN *Q)
+{
+    BIG_256_56 n, n3;
+    miller_loop_parameters(n, n3);
+
+    FP2_FP256BN frobenius;
+    frobenius_constant(&frobenius);
+
+    ECP2_FP256BN T, minus_Q, K;
+    ECP2_FP256BN_copy(&T, Q);
+    ECP2_FP256BN_copy(&minus_Q, Q);
+    ECP2_FP256BN_neg(&minus_Q);
+
+    uint32_t count = 0;
+
+    // 1) Main loop: a doubling line per bit, plus an addition line per non-zero digit.
+    for (int i = BIG_256_56_nbits(n3) - 2; i >= 1; --i) {
+        if (count + 2 > PAIRING_TABLE_MAX_LINES)
+            return -1;
+
+        record_line(&lines_out[count++], &T, NULL);
+        ECP2_FP256BN_dbl(&T);
+
+        int digit = BIG_256_56_bit(n3, i) - BIG_256_56_bit(n, i);
+        if (1 == digit) {
+            record_line(&lines_out[count++], &T, Q);
+            ECP2_FP256BN_add(&T, Q);
+        } else if (-1 == digit) {
+            record_line(&lines_out[count++], &T, &minus_Q);
+            ECP2_FP256BN_add(&T, &minus_Q);
+        }
+    }
+
+    // 2) The R-ate fix-up lines, through frob(Q) and -frob^2(Q).
+#if SIGN_OF_X_FP256BN==NEGATIVEX
+    ECP2_FP256BN_neg(&T);
+#endif
+    if (count + 2 > PAIRING_TABLE_MAX_LINES)
+        return -1;
+
+    ECP2_FP256BN_copy(&K, Q);
+    ECP2_FP256BN_frob(&K, &frobenius);
+    record_line(&lines_out[count++], &T, &K);
+    ECP2_FP256BN_add(&T, &K);
+
+    ECP2_FP256BN_frob(&K, &frobenius);
+    ECP2_FP256BN_neg(&K);
+    record_line(&lines_out[count++], &T, &K);
+
+    *line_count_out = count;
+
+    return 0;
+}
+
+void
+multiply_lines(FP12_FP256BN *accumulator,
+               const struct pairing_tables *tables,
+               uint32_t line_index,
+               FP_FP256BN *xP,
+               FP_FP256BN *yP)
+{
+    for (int k = 0; k < PAIRING_TABLE_POINTS; ++k) {
+        // (AMCL only reads the line, it just doesn't declare it const).
+        struct pairing_line *line = (struct pairing_line*)&tables->lines[k][line_index];
+
+        FP2_FP256BN y_term, x_term;
+        FP2_FP256BN_pmul(&y_term, &line->cy, &yP[k]);
+        FP2_FP256BN_pmul(&x_term, &line->cx, &xP[k]);
+
+        FP4_FP256BN a, b, c;
+#if SEXTIC_TWIST_FP256BN==D_TYPE
+        // l = y_term + x_term*w + c0*w^3
+        FP4_FP256BN_from_FP2s(&a, &y_term, &line->c0);
+        FP4_FP256BN_from_FP2(&b, &x_term);
+        FP4_FP256BN_zero(&c);
+#else
+        // M-type: l*w^3 = c0 + y_term*w^3 + x_term*w^2
+        FP4_FP256BN_from_FP2s(&a, &line->c0, &y_term);
+        FP4_FP256BN_zero(&b);
+        FP4_FP256BN_from_FP2(&c, &x_term);
+#endif
+
+        FP12_FP256BN line_value;
+        FP12_FP256BN_from_FP4s(&line_value, &a, &b, &c);
+        FP12_FP256BN_mul(accumulator, &line_value);
+    }
+}
+
+void
+miller_loop_precomputed(FP12_FP256BN *result_out,
+                        const xtt_daa_pairing_tables_lrsw* tables_in,
+                        ECP_FP256BN *g1_points[])
+{
+    const struct pairing_tables *tables = (const struct pairing_tables*)tables_in->data;
+
+    FP_FP256BN xP[PAIRING_TABLE_POINTS], yP[PAIRING_TABLE_POINTS];
+    for (int k = 0; k < PAIRING_TABLE_POINTS; ++k) {
+        BIG_256_56 x, y;
+        (void)ECP_FP256BN_get(x, y, g1_points[k]);
+        FP_FP256BN_nres(&xP[k], x);
+        FP_FP256BN_nres(&yP[k], y);
+    }
+
+    BIG_256_56 n, n3;
+    miller_loop_parameters(n, n3);
+
+    uint32_t line_index = 0;
+    FP12_FP256BN_one(result_out);
+
+    for (int i = BIG_256_56_nbits(n3) - 2; i >= 1; --i) {
+        FP12_FP256BN_sqr(result_out, result_out);
+        multiply_lines(result_out, tables, line_index++, xP, yP);
+
+        int digit = BIG_256_56_bit(n3, i) - BIG_256_56_bit(n, i);
+        if (0 != digit)
+            multiply_lines(result_out, tables, line_index++, xP, yP);
+    }
+
+#if SIGN_OF_X_FP256BN==NEGATIVEX
+    FP12_FP256BN_conj(result_out, result_out);
+#endif
+
+    multiply_lines(result_out, tables, line_index++, xP, yP);
+    multiply_lines(result_out, tables, line_index++, xP, yP);
+
+    assert(line_index == tables->line_count);
+}
@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_CRYPTO_PROVIDERS_INTERNAL_H
+#define XTT_CRYPTO_PROVIDERS_INTERNAL_H
+#pragma once
+
+#include <xtt/crypto_provider.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The providers built into the library (see the USE_LIBSODIUM and USE_OPENSSL build options).
+ */
+
+#ifdef XTT_USE_LIBSODIUM
+extern const struct xtt_crypto_provider xtt_crypto_provider_libsodium;
+#endif
+
+#ifdef XTT_USE_OPENSSL
+extern const struct xtt_crypto_provider xtt_crypto_provider_openssl;
+#endif
+
+#if !defined(XTT_USE_LIBSODIUM) && !defined(XTT_USE_OPENSSL)
+#error "At least one of XTT_USE_LIBSODIUM or XTT_USE_OPENSSL must be defined"
+#endif
+
+/*
+ * With XTT_FIXED_SUITE and only one provider built, the fixed suite's table
+ * calls that provider's hash and PRF primitives directly (see suites.h),
+ * so those are visible across the library (though not exported from it),
+ * rather than static to the provider's file.
+ */
+#if defined(XTT_FIXED_SUITE) && !(defined(XTT_USE_LIBSODIUM) && defined(XTT_USE_OPENSSL))
+
+#ifdef XTT_USE_LIBSODIUM
+#define XTT_DIRECT_PROVIDER libsodium
+#else
+#define XTT_DIRECT_PROVIDER openssl
+#endif
+
+#define XTT_PROVIDER_PRIMITIVE __attribute__((visibility("hidden")))
+
+#define XTT_DIRECT_PRIMITIVE_(provider, name) provider##_##name
+#define XTT_DIRECT_PRIMITIVE_EXPAND(provider, name) XTT_DIRECT_PRIMITIVE_(provider, name)
+#define XTT_DIRECT_PRIMITIVE(name) XTT_DIRECT_PRIMITIVE_EXPAND(XTT_DIRECT_PROVIDER, name)
+
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(hash_sha512_init)(xtt_hash_state* state);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(hash_sha512_update)(xtt_hash_state* state, const unsigned char* in, uint16_t in_len);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(hash_sha512_final)(unsigned char* out, uint16_t* out_length, xtt_hash_state* state);
+
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(hash_blake2b_init)(xtt_hash_state* state);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(hash_blake2b_update)(xtt_hash_state* state, const unsigned char* in, uint16_t in_len);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(hash_blake2b_final)(unsigned char* out, uint16_t* out_length, xtt_hash_state* state);
+
+XTT_PROVIDER_PRIMITIVE void XTT_DIRECT_PRIMITIVE(hash_release)(xtt_hash_state* state);
+
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_sha512_init)(xtt_prf_state* state, uint16_t out_len, const unsigned char* key, uint16_t key_len);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_sha512_update)(xtt_prf_state* state, const unsigned char* in, uint16_t in_len);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_sha512_final)(unsigned char* out, uint16_t out_len, xtt_prf_state* state);
+
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_blake2b_init)(xtt_prf_state* state, uint16_t out_len, const unsigned char* key, uint16_t key_len);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_blake2b_update)(xtt_prf_state* state, const unsigned char* in, uint16_t in_len);
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_blake2b_final)(unsigned char* out, uint16_t out_len, xtt_prf_state* state);
+
+XTT_PROVIDER_PRIMITIVE int XTT_DIRECT_PRIMITIVE(prf_copy)(xtt_prf_state* dst, const xtt_prf_state* src);
+XTT_PROVIDER_PRIMITIVE void XTT_DIRECT_PRIMITIVE(prf_release)(xtt_prf_state* state);
+
+#else
+
+#define XTT_PROVIDER_PRIMITIVE static
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -18,6 +18,9 @@
 
 #include "crypto_utils.h"
 #include "byte_utils.h"
+#include "suites.h"
+#include "stats.h"
+#include "trace.h"
 
 #include <xtt/crypto_wrapper.h>
 #include <xtt/daa_wrapper.h>
@@ -33,6 +36,110 @@ void prepare_nonce(unsigned char* nonce,
                    const unsigned char* iv,
                    uint32_t length);
 
+static __thread struct xtt_handshake_scratch thread_scratch;
+
+struct xtt_handshake_scratch* handshake_scratch(const struct xtt_handshake_context *ctx)
+{
+    if (NULL != ctx->scratch)
+        return ctx->scratch;
+
+    return &thread_scratch;
+}
+
+void transcript_start(struct handshake_transcript *transcript,
+                      uint16_t input_length,
+                      const struct xtt_handshake_context *ctx)
+{
+    unsigned char length_bytes[sizeof(input_length)];
+
+    transcript->suite = ctx->suite;
+    transcript->rc = HANDSHAKE_SUITE(transcript)->hash_init(&transcript->state);
+
+    short_to_bigendian(input_length, length_bytes);
+    if (0 == transcript->rc)
+        transcript->rc = HANDSHAKE_SUITE(transcript)->hash_update(&transcript->state, length_bytes, sizeof(length_bytes));
+
+    transcript->remaining = input_length;
+}
+
+void transcript_absorb(struct handshake_transcript *transcript,
+                       const unsigned char *in,
+                       uint16_t in_len)
+{
+    if (in_len > transcript->remaining)
+        in_len = transcript->remaining;
+
+    if (0 == transcript->rc && 0 != in_len)
+        transcript->rc = HANDSHAKE_SUITE(transcript)->hash_update(&transcript->state, in, in_len);
+
+    transcript->remaining -= in_len;
+}
+
+xtt_error_code transcript_finish(unsigned char *hash_out,
+                                 struct handshake_transcript *transcript)
+{
+    // Every byte of the declared length must have been absorbed.
+    assert(0 == transcript->remaining);
+
+    uint16_t hash_length;
+    if (0 == transcript->rc)
+        transcript->rc = HANDSHAKE_SUITE(transcript)->hash_final(hash_out, &hash_length, &transcript->state);
+
+    if (0 != transcript->rc) {
+        HANDSHAKE_SUITE(transcript)->hash_release(&transcript->state);
+        return XTT_ERROR_CRYPTO;
+    }
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void keyed_prf_start(struct keyed_prf *prf,
+                     uint16_t out_len,
+                     const unsigned char *key,
+                     uint16_t key_len,
+                     const unsigned char *prefix,
+                     uint16_t prefix_len,
+                     const struct xtt_handshake_suite *suite)
+{
+    prf->suite = suite;
+    prf->out_len = out_len;
+
+    prf->rc = HANDSHAKE_SUITE(prf)->prf_init(&prf->state, out_len, key, key_len);
+    if (0 == prf->rc)
+        prf->rc = HANDSHAKE_SUITE(prf)->prf_update(&prf->state, prefix, prefix_len);
+}
+
+xtt_error_code keyed_prf_expand(unsigned char *out,
+                                const struct keyed_prf *prf,
+                                const unsigned char *label,
+                                uint16_t label_len)
+{
+    if (0 != prf->rc)
+        return XTT_ERROR_CRYPTO;
+
+    xtt_prf_state state;
+    if (0 != HANDSHAKE_SUITE(prf)->prf_copy(&state, &prf->state))
+        return XTT_ERROR_CRYPTO;
+
+    if (0 != HANDSHAKE_SUITE(prf)->prf_update(&state, label, label_len)) {
+        HANDSHAKE_SUITE(prf)->prf_release(&state);
+        return XTT_ERROR_CRYPTO;
+    }
+
+    if (0 != HANDSHAKE_SUITE(prf)->prf_final(out, prf->out_len, &state))
+        return XTT_ERROR_CRYPTO;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void keyed_prf_release(struct keyed_prf *prf)
+{
+    HANDSHAKE_SUITE(prf)->prf_release(&prf->state);
+
+    // The provider frees what it owns, but the state itself may still hold key material.
+    xtt_crypto_secure_clear((unsigned char*)prf, sizeof(*prf));
+}
+
 void copy_dh_pubkey_x25519(unsigned char* out,
                            uint16_t* out_length,
                            const struct xtt_handshake_context* self)
@@ -49,9 +156,13 @@ int do_diffie_hellman_x25519(unsigned char* shared_secret,
                              const unsigned char* other_pk,
                              const struct xtt_handshake_context* self)
 {
-    return xtt_crypto_do_x25519_diffie_hellman(shared_secret,
-                                               &self->dh_priv_key.x25519,
-                                               (xtt_x25519_pub_key*)other_pk);
+    TRACE1(do_diffie_hellman_entry, self->suite_spec);
+    int ret = xtt_crypto_do_x25519_diffie_hellman(shared_secret,
+                                                  &self->dh_priv_key.x25519,
+                                                  (xtt_x25519_pub_key*)other_pk);
+    TRACE2(do_diffie_hellman_return, self->suite_spec, ret);
+
+    return ret;
 }
 
 void copy_longterm_key_ed25519(unsigned char* out,
@@ -113,6 +224,8 @@ int encrypt_chacha(unsigned char* ciphertext,
 
     self->tx_sequence_num++;
 
+    TRACE2(encrypt_entry, self->suite_spec, msg_len);
+    STATS_CLOCK(start);
     ret = xtt_crypto_aead_chacha_encrypt(ciphertext,
                                          ciphertext_len,
                                          message,
@@ -121,6 +234,8 @@ int encrypt_chacha(unsigned char* ciphertext,
                                          addl_len,
                                          &nonce,
                                          &self->tx_key.chacha);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE3(encrypt_return, self->suite_spec, *ciphertext_len, ret);
 
     xtt_crypto_secure_clear(nonce.data, sizeof(nonce));
 
@@ -145,6 +260,8 @@ int encrypt_aes256(unsigned char* ciphertext,
 
     self->tx_sequence_num++;
 
+    TRACE2(encrypt_entry, self->suite_spec, msg_len);
+    STATS_CLOCK(start);
     ret = xtt_crypto_aead_aes256_encrypt(ciphertext,
                                          ciphertext_len,
                                          message,
@@ -153,6 +270,8 @@ int encrypt_aes256(unsigned char* ciphertext,
                                          addl_len,
                                          &nonce,
                                          &self->tx_key.aes256);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE3(encrypt_return, self->suite_spec, *ciphertext_len, ret);
 
     xtt_crypto_secure_clear(nonce.data, sizeof(nonce));
 
@@ -198,6 +317,8 @@ int decrypt_chacha(unsigned char* decrypted,
 
     self->rx_sequence_num++;
 
+    TRACE2(decrypt_entry, self->suite_spec, ciphertext_len);
+    STATS_CLOCK(start);
     ret = xtt_crypto_aead_chacha_decrypt(decrypted,
                                          decrypted_len,
                                          ciphertext,
@@ -206,6 +327,8 @@ int decrypt_chacha(unsigned char* decrypted,
                                          addl_len,
                                          &nonce,
                                          &self->rx_key.chacha);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE3(decrypt_return, self->suite_spec, *decrypted_len, ret);
 
     xtt_crypto_secure_clear(nonce.data, sizeof(nonce));
 
@@ -230,6 +353,8 @@ int decrypt_aes256(unsigned char* decrypted,
 
     self->rx_sequence_num++;
 
+    TRACE2(decrypt_entry, self->suite_spec, ciphertext_len);
+    STATS_CLOCK(start);
     ret = xtt_crypto_aead_aes256_decrypt(decrypted,
                                          decrypted_len,
                                          ciphertext,
@@ -238,12 +363,110 @@ int decrypt_aes256(unsigned char* decrypted,
                                          addl_len,
                                          &nonce,
                                          &self->rx_key.aes256);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE3(decrypt_return, self->suite_spec, *decrypted_len, ret);
 
     xtt_crypto_secure_clear(nonce.data, sizeof(nonce));
 
     return ret;
 }
 
+int seal_record_chacha(unsigned char* mac_out,
+                       unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self)
+{
+    TRACE2(seal_record_entry, self->suite_spec, data_len);
+    STATS_CLOCK(start);
+    int ret = xtt_crypto_aead_chacha_encrypt_detached(data,
+                                                      mac_out,
+                                                      data,
+                                                      data_len,
+                                                      addl_data,
+                                                      addl_len,
+                                                      (const xtt_chacha_nonce*)nonce,
+                                                      &self->tx_key.chacha);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE2(seal_record_return, self->suite_spec, ret);
+
+    return ret;
+}
+
+int open_record_chacha(unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* mac,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self)
+{
+    TRACE2(open_record_entry, self->suite_spec, data_len);
+    STATS_CLOCK(start);
+    int ret = xtt_crypto_aead_chacha_decrypt_detached(data,
+                                                      data,
+                                                      data_len,
+                                                      mac,
+                                                      addl_data,
+                                                      addl_len,
+                                                      (const xtt_chacha_nonce*)nonce,
+                                                      &self->rx_key.chacha);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE2(open_record_return, self->suite_spec, ret);
+
+    return ret;
+}
+
+int seal_record_aes256(unsigned char* mac_out,
+                       unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self)
+{
+    TRACE2(seal_record_entry, self->suite_spec, data_len);
+    STATS_CLOCK(start);
+    int ret = xtt_crypto_aead_aes256_encrypt_detached_expanded(data,
+                                                               mac_out,
+                                                               data,
+                                                               data_len,
+                                                               addl_data,
+                                                               addl_len,
+                                                               (const xtt_aes256_nonce*)nonce,
+                                                               &self->tx_key_schedule.aes256);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE2(seal_record_return, self->suite_spec, ret);
+
+    return ret;
+}
+
+int open_record_aes256(unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* mac,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self)
+{
+    TRACE2(open_record_entry, self->suite_spec, data_len);
+    STATS_CLOCK(start);
+    int ret = xtt_crypto_aead_aes256_decrypt_detached_expanded(data,
+                                                               data,
+                                                               data_len,
+                                                               mac,
+                                                               addl_data,
+                                                               addl_len,
+                                                               (const xtt_aes256_nonce*)nonce,
+                                                               &self->rx_key_schedule.aes256);
+    STATS_RECORD(XTT_STATS_PHASE_AEAD, stats_now_ns() - start);
+    TRACE2(open_record_return, self->suite_spec, ret);
+
+    return ret;
+}
+
 void read_longterm_key_ed25519(struct xtt_server_handshake_context *self,
                                uint16_t* key_length,
                                unsigned char* key_in)
@@ -261,7 +484,24 @@ int verify_server_signature_ed25519(const unsigned char *signature,
                                     uint16_t msg_len,
                                     const unsigned char *server_public_key)
 {
+    TRACE1(ed25519_verify_entry, msg_len);
     int ret = xtt_crypto_verify_ed25519(signature, msg, msg_len, (xtt_ed25519_pub_key*)server_public_key);
+    TRACE1(ed25519_verify_return, ret);
+
+    if (0 != ret) {
+        return XTT_ERROR_BAD_SIGNATURE;
+    } else {
+        return XTT_ERROR_SUCCESS;
+    }
+}
+
+int batch_verify_server_signatures_ed25519(int *results_out,
+                                           const struct xtt_ed25519_verify_item *items,
+                                           uint16_t item_count)
+{
+    TRACE1(ed25519_batch_verify_entry, item_count);
+    int ret = xtt_crypto_batch_verify_ed25519(results_out, items, item_count);
+    TRACE2(ed25519_batch_verify_return, item_count, ret);
 
     if (0 != ret) {
         return XTT_ERROR_BAD_SIGNATURE;
@@ -275,10 +515,16 @@ int sign_server_ed25519(unsigned char *signature_out,
                         uint16_t msg_len,
                         const struct xtt_server_certificate_context *self)
 {
-    return xtt_crypto_sign_ed25519(signature_out,
-                                   msg,
-                                   msg_len,
-                                   &self->private_key.ed25519);
+    TRACE1(server_sign_entry, msg_len);
+    STATS_CLOCK(start);
+    int ret = xtt_crypto_sign_ed25519(signature_out,
+                                      msg,
+                                      msg_len,
+                                      &self->private_key.ed25519);
+    STATS_RECORD(XTT_STATS_PHASE_SERVER_SIGN, stats_now_ns() - start);
+    TRACE1(server_sign_return, ret);
+
+    return ret;
 }
 
 int longterm_sign_ed25519(unsigned char *signature_out,
@@ -286,20 +532,26 @@ int longterm_sign_ed25519(unsigned char *signature_out,
                           uint16_t msg_len,
                           const struct xtt_client_handshake_context *self)
 {
-    return xtt_crypto_sign_ed25519(signature_out,
-                                   msg,
-                                   msg_len,
-                                   &self->longterm_private_key.ed25519);
+    TRACE2(longterm_sign_entry, self->base.suite_spec, msg_len);
+    int ret = xtt_crypto_sign_ed25519(signature_out,
+                                      msg,
+                                      msg_len,
+                                      &self->longterm_private_key.ed25519);
+    TRACE2(longterm_sign_return, self->base.suite_spec, ret);
+
+    return ret;
 }
 
 int verify_root_ed25519(const unsigned char *signature,
                         const struct xtt_server_certificate_raw_type *certificate,
                         const struct xtt_server_root_certificate_context *self)
 {
+    TRACE0(root_verify_entry);
     int ret = xtt_crypto_verify_ed25519(signature,
                                         (unsigned char*)certificate,
                                         xtt_server_certificate_length_uptosignature_fromsignaturetype(XTT_SERVER_SIGNATURE_TYPE_ED25519),
                                         &self->public_key.ed25519);
+    TRACE1(root_verify_return, ret);
 
     if (0 != ret) {
         return XTT_ERROR_BAD_SIGNATURE;
@@ -313,6 +565,7 @@ int sign_lrswTPM(unsigned char *signature_out,
                  uint16_t msg_len,
                  struct xtt_daa_context *self)
 {
+    TRACE1(daa_sign_entry, msg_len);
     int rc = xtt_daa_sign_lrswTPM(signature_out,
                                   msg,
                                   msg_len,
@@ -320,6 +573,7 @@ int sign_lrswTPM(unsigned char *signature_out,
                                   self->basename_length,
                                   &self->cred.lrsw,
                                   self->tpm_context);
+    TRACE1(daa_sign_return, rc);
 
     if (0 != rc)
         return XTT_ERROR_CRYPTO;
@@ -332,6 +586,7 @@ int sign_lrsw(unsigned char *signature_out,
               uint16_t msg_len,
               struct xtt_daa_context *self)
 {
+    TRACE1(daa_sign_entry, msg_len);
     int rc = xtt_daa_sign_lrsw(signature_out,
                                msg,
                                msg_len,
@@ -339,6 +594,7 @@ int sign_lrsw(unsigned char *signature_out,
                                self->basename_length,
                                &self->cred.lrsw,
                                &self->priv_key.lrsw);
+    TRACE1(daa_sign_return, rc);
 
     if (0 != rc)
         return XTT_ERROR_CRYPTO;
@@ -351,12 +607,83 @@ int verify_lrswTPM(unsigned char *signature,
                    uint16_t msg_len,
                    struct xtt_daa_group_public_key_context *self)
 {
-    int ret = xtt_daa_verify_lrswTPM(signature,
-                                     msg,
-                                     msg_len,
-                                     self->basename,
-                                     self->basename_length,
-                                     &self->gpk.lrsw);
+    TRACE1(daa_verify_entry, msg_len);
+    STATS_CLOCK(start);
+    int ret = xtt_daa_verify_lrswTPM_prepared(signature,
+                                              msg,
+                                              msg_len,
+                                              self->basename,
+                                              self->basename_length,
+                                              &self->prepared_gpk.lrsw);
+    STATS_RECORD(XTT_STATS_PHASE_DAA_VERIFY, stats_now_ns() - start);
+    TRACE1(daa_verify_return, ret);
+
+    if (0 != ret) {
+        return XTT_ERROR_BAD_SIGNATURE;
+    } else {
+        return XTT_ERROR_SUCCESS;
+    }
+}
+
+int batch_verify_lrswTPM(int *results_out,
+                         const struct xtt_daa_verify_item *items,
+                         uint16_t item_count,
+                         struct xtt_daa_group_public_key_context *self)
+{
+    TRACE1(daa_batch_verify_entry, item_count);
+    STATS_CLOCK(start);
+    int ret = xtt_daa_batch_verify_lrswTPM_prepared(results_out,
+                                                    items,
+                                                    item_count,
+                                                    &self->prepared_gpk.lrsw);
+    STATS_RECORD_BATCH(XTT_STATS_PHASE_DAA_VERIFY, stats_now_ns() - start, item_count);
+    TRACE2(daa_batch_verify_return, item_count, ret);
+
+    if (0 != ret) {
+        return XTT_ERROR_BAD_SIGNATURE;
+    } else {
+        return XTT_ERROR_SUCCESS;
+    }
+}
+
+int verify_lrswTPM_precomputed(unsigned char *signature,
+                               unsigned char *msg,
+                               uint16_t msg_len,
+                               struct xtt_daa_group_public_key_context *self)
+{
+    TRACE1(daa_verify_entry, msg_len);
+    STATS_CLOCK(start);
+    int ret = xtt_daa_verify_lrswTPM_precomputed(signature,
+                                                 msg,
+                                                 msg_len,
+                                                 self->basename,
+                                                 self->basename_length,
+                                                 &self->prepared_gpk.lrsw,
+                                                 self->pairing_tables.lrsw);
+    STATS_RECORD(XTT_STATS_PHASE_DAA_VERIFY, stats_now_ns() - start);
+    TRACE1(daa_verify_return, ret);
+
+    if (0 != ret) {
+        return XTT_ERROR_BAD_SIGNATURE;
+    } else {
+        return XTT_ERROR_SUCCESS;
+    }
+}
+
+int batch_verify_lrswTPM_precomputed(int *results_out,
+                                     const struct xtt_daa_verify_item *items,
+                                     uint16_t item_count,
+                                     struct xtt_daa_group_public_key_context *self)
+{
+    TRACE1(daa_batch_verify_entry, item_count);
+    STATS_CLOCK(start);
+    int ret = xtt_daa_batch_verify_lrswTPM_precomputed(results_out,
+                                                       items,
+                                                       item_count,
+                                                       &self->prepared_gpk.lrsw,
+                                                       self->pairing_tables.lrsw);
+    STATS_RECORD_BATCH(XTT_STATS_PHASE_DAA_VERIFY, stats_now_ns() - start, item_count);
+    TRACE2(daa_batch_verify_return, item_count, ret);
 
     if (0 != ret) {
         return XTT_ERROR_BAD_SIGNATURE;
@@ -27,6 +27,82 @@
 extern "C" {
 #endif
 
+/*
+ * Get the scratch area to use for transient handshake buffers.
+ *
+ * This is the caller-provided area, if one was set via xtt_handshake_context_use_scratch,
+ * and a thread-local area otherwise.
+ */
+struct xtt_handshake_scratch* handshake_scratch(const struct xtt_handshake_context *ctx);
+
+/*
+ * A hash_ext (i.e. hash(length || input)) computed incrementally,
+ * so a transcript's pieces can be hashed straight from the messages they're in.
+ *
+ * The input's total length is fixed when the transcript is started.
+ * Anything absorbed beyond that is ignored.
+ */
+struct handshake_transcript {
+    xtt_hash_state state;
+    const struct xtt_handshake_suite *suite;
+    uint16_t remaining;
+    int rc;
+};
+
+void transcript_start(struct handshake_transcript *transcript,
+                      uint16_t input_length,
+                      const struct xtt_handshake_context *ctx);
+
+void transcript_absorb(struct handshake_transcript *transcript,
+                       const unsigned char *in,
+                       uint16_t in_len);
+
+/*
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_CRYPTO if any step of the hash failed
+ */
+xtt_error_code transcript_finish(unsigned char *hash_out,
+                                 struct handshake_transcript *transcript);
+
+/*
+ * A keyed PRF that's been fed the input prefix shared by several outputs,
+ * so each output only costs the work for its own label.
+ */
+struct keyed_prf {
+    xtt_prf_state state;
+    const struct xtt_handshake_suite *suite;
+    uint16_t out_len;
+    int rc;
+};
+
+void keyed_prf_start(struct keyed_prf *prf,
+                     uint16_t out_len,
+                     const unsigned char *key,
+                     uint16_t key_len,
+                     const unsigned char *prefix,
+                     uint16_t prefix_len,
+                     const struct xtt_handshake_suite *suite);
+
+/*
+ * Compute prf<out_len>(prefix || label), leaving `prf` untouched for the next label.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_CRYPTO if any step of the PRF failed
+ */
+xtt_error_code keyed_prf_expand(unsigned char *out,
+                                const struct keyed_prf *prf,
+                                const unsigned char *label,
+                                uint16_t label_len);
+
+/*
+ * Release (and clear) `prf`'s state, once every label has been expanded.
+ *
+ * Every started keyed_prf must be released, whether or not starting it succeeded.
+ */
+void keyed_prf_release(struct keyed_prf *prf);
+
 void copy_dh_pubkey_x25519(unsigned char* out,
                            uint16_t* out_length,
                            const struct xtt_handshake_context* self);
@@ -91,6 +167,39 @@ int decrypt_aes256(unsigned char* decrypted,
                    uint16_t addl_len,
                    struct xtt_handshake_context *self);
 
+/* In-place, detached-MAC sealing of records, keyed by a session context. */
+int seal_record_chacha(unsigned char* mac_out,
+                       unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self);
+
+int open_record_chacha(unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* mac,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self);
+
+int seal_record_aes256(unsigned char* mac_out,
+                       unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self);
+
+int open_record_aes256(unsigned char* data,
+                       uint16_t data_len,
+                       const unsigned char* mac,
+                       const unsigned char* addl_data,
+                       uint16_t addl_len,
+                       const unsigned char* nonce,
+                       const struct xtt_session_context *self);
+
 void read_longterm_key_ed25519(struct xtt_server_handshake_context *self,
                                uint16_t* key_length,
                                unsigned char* key_in);
@@ -100,6 +209,10 @@ int verify_server_signature_ed25519(const unsigned char *signature,
                                     uint16_t msg_len,
                                     const unsigned char *server_public_key);
 
+int batch_verify_server_signatures_ed25519(int *results_out,
+                                           const struct xtt_ed25519_verify_item *items,
+                                           uint16_t item_count);
+
 int sign_server_ed25519(unsigned char *signature_out,
                         const unsigned char *msg,
                         uint16_t msg_len,
@@ -129,6 +242,21 @@ int verify_lrswTPM(unsigned char *signature,
                    uint16_t msg_len,
                    struct xtt_daa_group_public_key_context *self);
 
+int batch_verify_lrswTPM(int *results_out,
+                         const struct xtt_daa_verify_item *items,
+                         uint16_t item_count,
+                         struct xtt_daa_group_public_key_context *self);
+
+int verify_lrswTPM_precomputed(unsigned char *signature,
+                               unsigned char *msg,
+                               uint16_t msg_len,
+                               struct xtt_daa_group_public_key_context *self);
+
+int batch_verify_lrswTPM_precomputed(int *results_out,
+                                     const struct xtt_daa_verify_item *items,
+                                     uint16_t item_count,
+                                     struct xtt_daa_group_public_key_context *self);
+
 #ifdef __cplusplus
 }
 #endif
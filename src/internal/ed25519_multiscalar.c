@@ -0,0 +1,556 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include "ed25519_multiscalar.h"
+
+#include <string.h>
+#include <assert.h>
+
+// Group order, little-endian.
+static const unsigned char group_order[32] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+    0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+int
+ed25519_scalar_is_canonical(const unsigned char scalar[32])
+{
+    for (int i = 31; i >= 0; --i) {
+        if (scalar[i] < group_order[i])
+            return 1;
+        if (scalar[i] > group_order[i])
+            return 0;
+    }
+
+    return 0;
+}
+
+#ifdef XTT_HAVE_ED25519_MULTISCALAR
+
+/*
+ * Field elements mod 2^255 - 19, as five 51-bit limbs.
+ *
+ * Multiplication and subtraction leave their outputs with limbs below ~2^51.
+ * Addition doesn't carry, so its limbs can reach ~2^53:
+ * that's still fine as an input to anything,
+ * as long as no more than two sums are added together before being multiplied.
+ */
+typedef uint64_t fe[5];
+
+typedef unsigned __int128 uint128;
+
+#define MASK51 ((UINT64_C(1) << 51) - 1)
+
+static const fe fe_d2 = {0x69b9426b2f159ULL, 0x35050762add7aULL, 0x3cf44c0038052ULL, 0x6738cc7407977ULL, 0x2406d9dc56dffULL};
+static const fe fe_d = {0x34dca135978a3ULL, 0x1a8283b156ebdULL, 0x5e7a26001c029ULL, 0x739c663a03cbbULL, 0x52036cee2b6ffULL};
+static const fe fe_sqrtm1 = {0x61b274a0ea0b0ULL, 0xd5a5fc8f189dULL, 0x7ef5e9cbd0c60ULL, 0x78595a6804c9eULL, 0x2b8324804fc1dULL};
+
+// The standard base point.
+static const unsigned char base_point[32] = {
+    0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+};
+
+// Extended coordinates: x = X/Z, y = Y/Z, x*y = T/Z
+struct ge_extended {
+    fe X;
+    fe Y;
+    fe Z;
+    fe T;
+};
+
+// Ready to be added: (Y+X, Y-X, Z, 2d*T)
+struct ge_cached {
+    fe YplusX;
+    fe YminusX;
+    fe Z;
+    fe T2d;
+};
+
+static uint64_t load64(const unsigned char *in)
+{
+    uint64_t out = 0;
+    for (int i = 7; i >= 0; --i)
+        out = (out << 8) | in[i];
+    return out;
+}
+
+static void fe_copy(fe out, const fe in)
+{
+    memcpy(out, in, sizeof(fe));
+}
+
+static void fe_zero(fe out)
+{
+    memset(out, 0, sizeof(fe));
+}
+
+static void fe_one(fe out)
+{
+    fe_zero(out);
+    out[0] = 1;
+}
+
+static void fe_carry(fe h)
+{
+    uint64_t c;
+    c = h[0] >> 51; h[0] &= MASK51; h[1] += c;
+    c = h[1] >> 51; h[1] &= MASK51; h[2] += c;
+    c = h[2] >> 51; h[2] &= MASK51; h[3] += c;
+    c = h[3] >> 51; h[3] &= MASK51; h[4] += c;
+    c = h[4] >> 51; h[4] &= MASK51; h[0] += 19 * c;
+}
+
+static void fe_add(fe out, const fe a, const fe b)
+{
+    for (int i = 0; i < 5; ++i)
+        out[i] = a[i] + b[i];
+}
+
+static void fe_sub(fe out, const fe a, const fe b)
+{
+    // Add 4p first, so no limb goes negative.
+    out[0] = (a[0] + UINT64_C(0x1FFFFFFFFFFFB4)) - b[0];
+    for (int i = 1; i < 5; ++i)
+        out[i] = (a[i] + UINT64_C(0x1FFFFFFFFFFFFC)) - b[i];
+    fe_carry(out);
+}
+
+static void fe_neg(fe out, const fe a)
+{
+    fe zero;
+    fe_zero(zero);
+    fe_sub(out, zero, a);
+}
+
+static void fe_reduce_products(fe out, uint128 r0, uint128 r1, uint128 r2, uint128 r3, uint128 r4)
+{
+    uint64_t c;
+    c = (uint64_t)(r0 >> 51); out[0] = (uint64_t)r0 & MASK51; r1 += c;
+    c = (uint64_t)(r1 >> 51); out[1] = (uint64_t)r1 & MASK51; r2 += c;
+    c = (uint64_t)(r2 >> 51); out[2] = (uint64_t)r2 & MASK51; r3 += c;
+    c = (uint64_t)(r3 >> 51); out[3] = (uint64_t)r3 & MASK51; r4 += c;
+    c = (uint64_t)(r4 >> 51); out[4] = (uint64_t)r4 & MASK51;
+    out[0] += 19 * c;
+    c = out[0] >> 51; out[0] &= MASK51; out[1] += c;
+}
+
+static void fe_mul(fe out, const fe a, const fe b)
+{
+    uint64_t b1_19 = 19 * b[1], b2_19 = 19 * b[2], b3_19 = 19 * b[3], b4_19 = 19 * b[4];
+
+    uint128 r0 = (uint128)a[0] * b[0] + (uint128)a[1] * b4_19 + (uint128)a[2] * b3_19 + (uint128)a[3] * b2_19 + (uint128)a[4] * b1_19;
+    uint128 r1 = (uint128)a[0] * b[1] + (uint128)a[1] * b[0] + (uint128)a[2] * b4_19 + (uint128)a[3] * b3_19 + (uint128)a[4] * b2_19;
+    uint128 r2 = (uint128)a[0] * b[2] + (uint128)a[1] * b[1] + (uint128)a[2] * b[0] + (uint128)a[3] * b4_19 + (uint128)a[4] * b3_19;
+    uint128 r3 = (uint128)a[0] * b[3] + (uint128)a[1] * b[2] + (uint128)a[2] * b[1] + (uint128)a[3] * b[0] + (uint128)a[4] * b4_19;
+    uint128 r4 = (uint128)a[0] * b[4] + (uint128)a[1] * b[3] + (uint128)a[2] * b[2] + (uint128)a[3] * b[1] + (uint128)a[4] * b[0];
+
+    fe_reduce_products(out, r0, r1, r2, r3, r4);
+}
+
+static void fe_sq(fe out, const fe a)
+{
+    uint64_t a0_2 = 2 * a[0], a1_2 = 2 * a[1];
+    uint64_t a1_38 = 38 * a[1], a2_38 = 38 * a[2], a3_38 = 38 * a[3];
+    uint64_t a3_19 = 19 * a[3], a4_19 = 19 * a[4];
+
+    uint128 r0 = (uint128)a[0] * a[0] + (uint128)a1_38 * a[4] + (uint128)a2_38 * a[3];
+    uint128 r1 = (uint128)a0_2 * a[1] + (uint128)a2_38 * a[4] + (uint128)a3_19 * a[3];
+    uint128 r2 = (uint128)a0_2 * a[2] + (uint128)a[1] * a[1] + (uint128)a3_38 * a[4];
+    uint128 r3 = (uint128)a0_2 * a[3] + (uint128)a1_2 * a[2] + (uint128)a4_19 * a[4];
+    uint128 r4 = (uint128)a0_2 * a[4] + (uint128)a1_2 * a[3] + (uint128)a[2] * a[2];
+
+    fe_reduce_products(out, r0, r1, r2, r3, r4);
+}
+
+static void fe_sq_times(fe out, const fe a, int count)
+{
+    fe_sq(out, a);
+    for (int i = 1; i < count; ++i)
+        fe_sq(out, out);
+}
+
+static void fe_frombytes(fe out, const unsigned char in[32])
+{
+    out[0] = load64(in) & MASK51;
+    out[1] = (load64(in + 6) >> 3) & MASK51;
+    out[2] = (load64(in + 12) >> 6) & MASK51;
+    out[3] = (load64(in + 19) >> 1) & MASK51;
+    out[4] = (load64(in + 24) >> 12) & MASK51;
+}
+
+// Fully reduce mod p.
+static void fe_canonicalize(fe h)
+{
+    uint64_t c;
+
+#define CARRY_CHAIN() \
+    c = h[0] >> 51; h[0] &= MASK51; h[1] += c; \
+    c = h[1] >> 51; h[1] &= MASK51; h[2] += c; \
+    c = h[2] >> 51; h[2] &= MASK51; h[3] += c; \
+    c = h[3] >> 51; h[3] &= MASK51; h[4] += c;
+#define CARRY_FULL() CARRY_CHAIN() c = h[4] >> 51; h[4] &= MASK51; h[0] += 19 * c;
+
+    // 1) Now 0 <= h < 2^255.
+    CARRY_FULL()
+    CARRY_FULL()
+
+    // 2) Offset by 19, so that h >= p carries out of the top.
+    h[0] += 19;
+    CARRY_FULL()
+
+    // 3) Undo the offset by adding 2^255 - 19, and drop the 2^255.
+    h[0] += MASK51 + 1 - 19;
+    h[1] += MASK51;
+    h[2] += MASK51;
+    h[3] += MASK51;
+    h[4] += MASK51;
+    CARRY_CHAIN()
+    h[4] &= MASK51;
+
+#undef CARRY_FULL
+#undef CARRY_CHAIN
+}
+
+static int fe_iszero(const fe a)
+{
+    fe h;
+    fe_copy(h, a);
+    fe_canonicalize(h);
+
+    return 0 == (h[0] | h[1] | h[2] | h[3] | h[4]);
+}
+
+static int fe_equal(const fe a, const fe b)
+{
+    fe diff;
+    fe_sub(diff, a, b);
+
+    return fe_iszero(diff);
+}
+
+static int fe_isnegative(const fe a)
+{
+    fe h;
+    fe_copy(h, a);
+    fe_canonicalize(h);
+
+    return (int)(h[0] & 1);
+}
+
+// a^((p-5)/8)
+static void fe_pow22523(fe out, const fe z)
+{
+    fe t0, t1, t2;
+
+    fe_sq(t0, z);
+    fe_sq_times(t1, t0, 2);
+    fe_mul(t1, z, t1);
+    fe_mul(t0, t0, t1);
+    fe_sq(t0, t0);
+    fe_mul(t0, t1, t0);
+    fe_sq_times(t1, t0, 5);
+    fe_mul(t0, t1, t0);
+    fe_sq_times(t1, t0, 10);
+    fe_mul(t1, t1, t0);
+    fe_sq_times(t2, t1, 20);
+    fe_mul(t1, t2, t1);
+    fe_sq_times(t1, t1, 10);
+    fe_mul(t0, t1, t0);
+    fe_sq_times(t1, t0, 50);
+    fe_mul(t1, t1, t0);
+    fe_sq_times(t2, t1, 100);
+    fe_mul(t1, t2, t1);
+    fe_sq_times(t1, t1, 50);
+    fe_mul(t0, t1, t0);
+    fe_sq_times(t0, t0, 2);
+    fe_mul(out, t0, z);
+}
+
+static int point_encoding_is_canonical(const unsigned char in[32])
+{
+    // Non-canonical means y >= p, i.e. y is one of p .. 2^255-1.
+    if (0x7f != (in[31] & 0x7f))
+        return 1;
+    for (int i = 30; i > 0; --i) {
+        if (0xff != in[i])
+            return 1;
+    }
+
+    return in[0] < 0xed;
+}
+
+static void ge_identity(struct ge_extended *out)
+{
+    fe_zero(out->X);
+    fe_one(out->Y);
+    fe_one(out->Z);
+    fe_zero(out->T);
+}
+
+static int ge_is_identity(const struct ge_extended *p)
+{
+    return fe_iszero(p->X) && fe_equal(p->Y, p->Z);
+}
+
+// T is only needed as input to an addition, so it's skipped unless `want_t`.
+static void ge_double(struct ge_extended *out, const struct ge_extended *p, int want_t)
+{
+    fe xx, yy, b, aa;
+    fe x1, y1, z1, t1;
+
+    fe_sq(xx, p->X);
+    fe_sq(yy, p->Y);
+    fe_sq(b, p->Z);
+    fe_add(b, b, b);
+    fe_add(aa, p->X, p->Y);
+    fe_sq(aa, aa);
+
+    fe_add(y1, yy, xx);
+    fe_sub(z1, yy, xx);
+    fe_sub(x1, aa, y1);
+    fe_sub(t1, b, z1);
+
+    fe_mul(out->X, x1, t1);
+    fe_mul(out->Y, y1, z1);
+    fe_mul(out->Z, z1, t1);
+    if (want_t)
+        fe_mul(out->T, x1, y1);
+}
+
+static void ge_add_cached(struct ge_extended *out, const struct ge_extended *p, const struct ge_cached *q, int subtract)
+{
+    fe a, b, c, d;
+    fe e, f, g, h;
+
+    fe_sub(a, p->Y, p->X);
+    fe_add(b, p->Y, p->X);
+    if (subtract) {
+        // -Q = (-x, y): swaps Y+X and Y-X, and negates T.
+        fe_mul(a, a, q->YplusX);
+        fe_mul(b, b, q->YminusX);
+        fe_mul(c, p->T, q->T2d);
+        fe_neg(c, c);
+    } else {
+        fe_mul(a, a, q->YminusX);
+        fe_mul(b, b, q->YplusX);
+        fe_mul(c, p->T, q->T2d);
+    }
+    fe_mul(d, p->Z, q->Z);
+    fe_add(d, d, d);
+
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+
+    fe_mul(out->X, e, f);
+    fe_mul(out->Y, g, h);
+    fe_mul(out->Z, f, g);
+    fe_mul(out->T, e, h);
+}
+
+static void ge_to_cached(struct ge_cached *out, const struct ge_extended *p)
+{
+    fe_add(out->YplusX, p->Y, p->X);
+    fe_sub(out->YminusX, p->Y, p->X);
+    fe_copy(out->Z, p->Z);
+    fe_mul(out->T2d, p->T, fe_d2);
+}
+
+static int ge_decompress(struct ge_extended *out, const unsigned char in[32])
+{
+    fe u, v, v3, vxx, check;
+
+    if (!point_encoding_is_canonical(in))
+        return -1;
+
+    // 1) x^2 = (y^2 - 1) / (d*y^2 + 1) = u / v
+    fe_frombytes(out->Y, in);
+    fe_one(out->Z);
+    fe_sq(u, out->Y);
+    fe_mul(v, u, fe_d);
+    fe_sub(u, u, out->Z);
+    fe_add(v, v, out->Z);
+
+    // 2) x = u * v^3 * (u * v^7)^((p-5)/8)
+    fe_sq(v3, v);
+    fe_mul(v3, v3, v);
+    fe_sq(out->X, v3);
+    fe_mul(out->X, out->X, v);
+    fe_mul(out->X, out->X, u);
+    fe_pow22523(out->X, out->X);
+    fe_mul(out->X, out->X, v3);
+    fe_mul(out->X, out->X, u);
+
+    // 3) That's a square root of either u/v or -u/v.
+    fe_sq(vxx, out->X);
+    fe_mul(vxx, vxx, v);
+    fe_sub(check, vxx, u);
+    if (!fe_iszero(check)) {
+        fe_add(check, vxx, u);
+        if (!fe_iszero(check))
+            return -1;
+        fe_mul(out->X, out->X, fe_sqrtm1);
+    }
+
+    // 4) Pick the root with the encoded sign.
+    int sign = in[31] >> 7;
+    if (fe_iszero(out->X) && sign)
+        return -1;
+    if (fe_isnegative(out->X) != sign)
+        fe_neg(out->X, out->X);
+
+    fe_mul(out->T, out->X, out->Y);
+
+    return 0;
+}
+
+static int ge_has_small_order(const struct ge_extended *p)
+{
+    struct ge_extended p8;
+    ge_double(&p8, p, 0);
+    ge_double(&p8, &p8, 0);
+    ge_double(&p8, &p8, 0);
+
+    return ge_is_identity(&p8);
+}
+
+/*
+ * Width-5 sliding window: each digit is 0 or odd in [-15, 15],
+ * and every non-zero digit is followed by at least four zeros.
+ */
+static void scalar_to_naf(signed char digits[256], const unsigned char scalar[32])
+{
+    for (int i = 0; i < 256; ++i)
+        digits[i] = 1 & (scalar[i >> 3] >> (i & 7));
+
+    for (int i = 0; i < 256; ++i) {
+        if (0 == digits[i])
+            continue;
+
+        for (int b = 1; b <= 6 && i + b < 256; ++b) {
+            if (0 == digits[i + b])
+                continue;
+
+            if (digits[i] + (digits[i + b] << b) <= 15) {
+                digits[i] += digits[i + b] << b;
+                digits[i + b] = 0;
+            } else if (digits[i] - (digits[i + b] << b) >= -15) {
+                digits[i] -= digits[i + b] << b;
+                for (int k = i + b; k < 256; ++k) {
+                    if (0 == digits[k]) {
+                        digits[k] = 1;
+                        break;
+                    }
+                    digits[k] = 0;
+                }
+            } else {
+                break;
+            }
+        }
+    }
+}
+
+// table = P, 3P, 5P, .. 15P
+static int build_table(struct ge_cached table[8], const unsigned char encoding[32])
+{
+    struct ge_extended point, multiple;
+    struct ge_cached doubled;
+
+    if (0 != ge_decompress(&point, encoding))
+        return -1;
+    if (ge_has_small_order(&point))
+        return -1;
+
+    ge_to_cached(&table[0], &point);
+    ge_double(&multiple, &point, 1);
+    ge_to_cached(&doubled, &multiple);
+    for (int j = 1; j < 8; ++j) {
+        ge_add_cached(&point, &point, &doubled, 0);
+        ge_to_cached(&table[j], &point);
+    }
+
+    return 0;
+}
+
+int
+ed25519_multiscalar_is_small_order(const unsigned char base_scalar[32],
+                                   const unsigned char (*scalars)[32],
+                                   const unsigned char (*points)[32],
+                                   uint16_t count)
+{
+    // The base point goes in the last slot.
+    struct ge_cached tables[ED25519_MULTISCALAR_MAX_POINTS + 1][8];
+    signed char digits[ED25519_MULTISCALAR_MAX_POINTS + 1][256];
+
+    if (count > ED25519_MULTISCALAR_MAX_POINTS)
+        return -1;
+
+    // 1) Decode every point, and build its table of odd multiples.
+    for (uint16_t i = 0; i < count; ++i) {
+        if (0 != build_table(tables[i], points[i]))
+            return -1;
+        scalar_to_naf(digits[i], scalars[i]);
+    }
+    if (0 != build_table(tables[count], base_point))
+        return -1;
+    scalar_to_naf(digits[count], base_scalar);
+
+    // 2) Straus: one shared run of doublings, with each point's digits added in along the way.
+    int top = 255;
+    while (top >= 0) {
+        uint16_t i = 0;
+        while (i <= count && 0 == digits[i][top])
+            ++i;
+        if (i <= count)
+            break;
+        --top;
+    }
+
+    struct ge_extended sum;
+    ge_identity(&sum);
+    for (int position = top; position >= 0; --position) {
+        int any_digit = 0;
+        for (uint16_t i = 0; i <= count; ++i)
+            any_digit |= digits[i][position];
+
+        if (position < top)
+            ge_double(&sum, &sum, any_digit);
+
+        if (!any_digit)
+            continue;
+
+        for (uint16_t i = 0; i <= count; ++i) {
+            signed char digit = digits[i][position];
+            if (digit > 0)
+                ge_add_cached(&sum, &sum, &tables[i][digit / 2], 0);
+            else if (digit < 0)
+                ge_add_cached(&sum, &sum, &tables[i][-digit / 2], 1);
+        }
+    }
+
+    // 3) Clear the cofactor.
+    return ge_has_small_order(&sum) ? 0 : -1;
+}
+
+#endif
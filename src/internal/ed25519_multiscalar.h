@@ -0,0 +1,76 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_ED25519_MULTISCALAR_INTERNAL_H
+#define XTT_ED25519_MULTISCALAR_INTERNAL_H
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Variable-time Ed25519 group arithmetic, for batch signature verification.
+ *
+ * Only ever used on public values (signatures, public keys, and verifier-chosen randomness),
+ * so none of this is constant-time.
+ *
+ * Needs 64x64->128-bit multiplication, so it's only available where the compiler provides __int128.
+ */
+
+#if defined(__SIZEOF_INT128__)
+#define XTT_HAVE_ED25519_MULTISCALAR 1
+#endif
+
+// Each point costs ~1.3KB of stack (a table of its first 8 multiples).
+#define ED25519_MULTISCALAR_MAX_POINTS 32
+
+/*
+ * Check whether
+ *      8 * (base_scalar*B + scalars[0]*points[0] + ... + scalars[count-1]*points[count-1])
+ * is the identity, where B is the standard base point.
+ *
+ * in:
+ *      base_scalar, scalars    - Little-endian, each less than the group order.
+ *      points                  - Compressed Edwards points.
+ *                                Each must be canonically-encoded, on the curve, and not of small order.
+ *      count                   - At most ED25519_MULTISCALAR_MAX_POINTS.
+ *
+ * return:
+ *      0 if the sum is a small-order point
+ *      -1 if it isn't, or if any point is invalid
+ */
+int ed25519_multiscalar_is_small_order(const unsigned char base_scalar[32],
+                                       const unsigned char (*scalars)[32],
+                                       const unsigned char (*points)[32],
+                                       uint16_t count);
+
+/*
+ * return:
+ *      1 if `scalar` (little-endian) is less than the group order
+ *      0 otherwise
+ */
+int ed25519_scalar_is_canonical(const unsigned char scalar[32]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
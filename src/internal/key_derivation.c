@@ -19,10 +19,18 @@
 #include "key_derivation.h"
 #include "message_utils.h"
 #include "byte_utils.h"
+#include "crypto_utils.h"
+#include "suites.h"
+#include "stats.h"
+
+#include <xtt/crypto_wrapper.h>
 
 #include <string.h>
 #include <assert.h>
 
+// The handshake_secret is keyed with all-zeroes.
+static const unsigned char zero_prf_key[XTT_HANDSHAKE_MAX_HASH_LENGTH] = {0};
+
 static
 xtt_error_code
 generate_handshake_key_hash(unsigned char *hash_out,
@@ -39,10 +47,14 @@ derive_handshake_keys(struct xtt_handshake_context *handshake_ctx,
                       const unsigned char *others_pub_key,
                       int is_client)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(handshake_ctx);
+
     xtt_error_code rc;
 
+    STATS_CLOCK(hash_start);
+
     // 1) Create HandshakeKeyHash.
-    rc = generate_handshake_key_hash(handshake_ctx->hash_out_buffer,
+    rc = generate_handshake_key_hash(scratch->hash_out_buffer,
                                      handshake_ctx,
                                      client_init,
                                      server_initandattest_uptocookie,
@@ -51,25 +63,60 @@ derive_handshake_keys(struct xtt_handshake_context *handshake_ctx,
         return rc;
 
     // 3) Run Diffie-Hellman
-    int dh_rc = handshake_ctx->do_diffie_hellman(handshake_ctx->shared_secret_buffer,
-                                                 others_pub_key,
-                                                 handshake_ctx);
-    if (0 != dh_rc)
+    STATS_CLOCK(dh_start);
+    int dh_rc = HANDSHAKE_SUITE(handshake_ctx)->do_diffie_hellman(scratch->shared_secret_buffer,
+                                                        others_pub_key,
+                                                        handshake_ctx);
+    STATS_CLOCK(dh_end);
+    STATS_RECORD(XTT_STATS_PHASE_DIFFIE_HELLMAN, dh_end - dh_start);
+    if (0 != dh_rc) {
+        xtt_crypto_secure_clear(scratch->shared_secret_buffer, sizeof(scratch->shared_secret_buffer));
         return XTT_ERROR_DIFFIE_HELLMAN;
+    }
 
     // 4) Create handshake_secret: prf_key -> prf<hash_size>(shared_secret)
-    int prf_rc = handshake_ctx->prf(handshake_ctx->handshake_secret,
-                                    handshake_ctx->hash_length,
-                                    handshake_ctx->shared_secret_buffer,
-                                    handshake_ctx->shared_secret_length,
-                                    handshake_ctx->prf_key,
-                                    handshake_ctx->hash_length);
-    if (0 != prf_rc)
+    int prf_rc = HANDSHAKE_SUITE(handshake_ctx)->prf(scratch->handshake_secret,
+                                           HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                                           scratch->shared_secret_buffer,
+                                           HANDSHAKE_SUITE(handshake_ctx)->shared_secret_length,
+                                           zero_prf_key,
+                                           HANDSHAKE_SUITE(handshake_ctx)->hash_length);
+    // The shared secret isn't needed past the handshake_secret.
+    xtt_crypto_secure_clear(scratch->shared_secret_buffer, sizeof(scratch->shared_secret_buffer));
+    if (0 != prf_rc) {
+        xtt_crypto_secure_clear(scratch->handshake_secret, sizeof(scratch->handshake_secret));
         return XTT_ERROR_CRYPTO;
+    }
+
+    // 5) Create keys and iv's: prf_key -> prf<length>(HandshakeKeyHash || label)
+    //      (HandshakeKeyHash is absorbed once per output length, then shared by that length's labels).
+    struct keyed_prf key_prf;
+    keyed_prf_start(&key_prf,
+                    HANDSHAKE_SUITE(handshake_ctx)->key_length,
+                    scratch->handshake_secret,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    scratch->hash_out_buffer,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    handshake_ctx->suite);
+
+    struct keyed_prf iv_prf;
+    keyed_prf_start(&iv_prf,
+                    HANDSHAKE_SUITE(handshake_ctx)->iv_length,
+                    scratch->handshake_secret,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    scratch->hash_out_buffer,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    handshake_ctx->suite);
+
+    struct keyed_prf secret_prf;
+    keyed_prf_start(&secret_prf,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    scratch->handshake_secret,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    scratch->hash_out_buffer,
+                    HANDSHAKE_SUITE(handshake_ctx)->hash_length,
+                    handshake_ctx->suite);
 
-    // 5) Create keys and iv's
-    memcpy(handshake_ctx->hash_buffer, handshake_ctx->hash_out_buffer, handshake_ctx->hash_length);
-    unsigned char *context_cpy = handshake_ctx->hash_buffer + handshake_ctx->hash_length;
     unsigned char *out_ptr;
 
     // 5i) Create ClientHandshakeKey
@@ -77,20 +124,17 @@ derive_handshake_keys(struct xtt_handshake_context *handshake_ctx,
         const char *client_handshake_context_string = "XTT handshake client key";
         uint16_t client_handshake_context_string_length = 24;
         assert(strlen(client_handshake_context_string) == client_handshake_context_string_length);
-        memcpy(context_cpy, client_handshake_context_string, client_handshake_context_string_length);
         if (is_client) {
             out_ptr = (unsigned char*)&handshake_ctx->tx_key;
         } else {
             out_ptr = (unsigned char*)&handshake_ctx->rx_key;
         }
-        prf_rc = handshake_ctx->prf(out_ptr,
-                                    handshake_ctx->key_length,
-                                    handshake_ctx->hash_buffer,
-                                    handshake_ctx->hash_length + client_handshake_context_string_length,
-                                    handshake_ctx->handshake_secret,
-                                    handshake_ctx->hash_length);
-        if (XTT_ERROR_SUCCESS != prf_rc)
-            return prf_rc;
+        rc = keyed_prf_expand(out_ptr,
+                              &key_prf,
+                              (const unsigned char*)client_handshake_context_string,
+                              client_handshake_context_string_length);
+        if (XTT_ERROR_SUCCESS != rc)
+            goto cleanup;
     }
 
     // 5ii) Create ClientHandshakeIV
@@ -98,20 +142,17 @@ derive_handshake_keys(struct xtt_handshake_context *handshake_ctx,
         const char *client_handshake_context_iv_string = "XTT handshake client iv";
         uint16_t client_handshake_context_iv_string_length = 23;
         assert(strlen(client_handshake_context_iv_string) == client_handshake_context_iv_string_length);
-        memcpy(context_cpy, client_handshake_context_iv_string, client_handshake_context_iv_string_length);
         if (is_client) {
             out_ptr = (unsigned char*)&handshake_ctx->tx_iv;
         } else {
             out_ptr = (unsigned char*)&handshake_ctx->rx_iv;
         }
-        prf_rc = handshake_ctx->prf(out_ptr,
-                                    handshake_ctx->iv_length,
-                                    handshake_ctx->hash_buffer,
-                                    handshake_ctx->hash_length + client_handshake_context_iv_string_length,
-                                    handshake_ctx->handshake_secret,
-                                    handshake_ctx->hash_length);
-        if (XTT_ERROR_SUCCESS != prf_rc)
-            return prf_rc;
+        rc = keyed_prf_expand(out_ptr,
+                              &iv_prf,
+                              (const unsigned char*)client_handshake_context_iv_string,
+                              client_handshake_context_iv_string_length);
+        if (XTT_ERROR_SUCCESS != rc)
+            goto cleanup;
     }
 
     // 5iii) Create ServerHandshakeKey
@@ -119,66 +160,63 @@ derive_handshake_keys(struct xtt_handshake_context *handshake_ctx,
         const char *server_handshake_context_string = "XTT handshake server key";
         uint16_t server_handshake_context_string_length = 24;
         assert(strlen(server_handshake_context_string) == server_handshake_context_string_length);
-        memcpy(context_cpy, server_handshake_context_string, server_handshake_context_string_length);
         if (is_client) {
             out_ptr = (unsigned char*)&handshake_ctx->rx_key;
         } else {
             out_ptr = (unsigned char*)&handshake_ctx->tx_key;
         }
-        prf_rc = handshake_ctx->prf(out_ptr,
-                                    handshake_ctx->key_length,
-                                    handshake_ctx->hash_buffer,
-                                    handshake_ctx->hash_length + server_handshake_context_string_length,
-                                    handshake_ctx->handshake_secret,
-                                    handshake_ctx->hash_length);
-
-// if (is_client) {
-// printf("Client's server_handshake_key: {");
-// for (size_t i=0; i<handshake_ctx->key_length; ++i) {
-//     printf("%#02X", out_ptr[i]);
-//     if (i < (handshake_ctx->key_length-1)) {
-//         printf(", ");
-//     } else {
-//         printf("}\n");
-//     }
-// }
-// } else {
-// printf("Server's server_handshake_key: {");
-// for (size_t i=0; i<handshake_ctx->key_length; ++i) {
-//     printf("%#02X", out_ptr[i]);
-//     if (i < (handshake_ctx->key_length-1)) {
-//         printf(", ");
-//     } else {
-//         printf("}\n");
-//     }
-// }
-// }
-        if (XTT_ERROR_SUCCESS != prf_rc)
-            return prf_rc;
+        rc = keyed_prf_expand(out_ptr,
+                              &key_prf,
+                              (const unsigned char*)server_handshake_context_string,
+                              server_handshake_context_string_length);
+        if (XTT_ERROR_SUCCESS != rc)
+            goto cleanup;
     }
 
-    // 5ii) Create ServerHandshakeIV
+    // 5iv) Create ServerHandshakeIV
     {
         const char *server_handshake_context_iv_string = "XTT handshake server iv";
         uint16_t server_handshake_context_iv_string_length = 23;
         assert(strlen(server_handshake_context_iv_string) == server_handshake_context_iv_string_length);
-        memcpy(context_cpy, server_handshake_context_iv_string, server_handshake_context_iv_string_length);
         if (is_client) {
             out_ptr = (unsigned char*)&handshake_ctx->rx_iv;
         } else {
             out_ptr = (unsigned char*)&handshake_ctx->tx_iv;
         }
-        prf_rc = handshake_ctx->prf(out_ptr,
-                                    handshake_ctx->iv_length,
-                                    handshake_ctx->hash_buffer,
-                                    handshake_ctx->hash_length + server_handshake_context_iv_string_length,
-                                    handshake_ctx->handshake_secret,
-                                    handshake_ctx->hash_length);
-        if (XTT_ERROR_SUCCESS != prf_rc)
-            return prf_rc;
+        rc = keyed_prf_expand(out_ptr,
+                              &iv_prf,
+                              (const unsigned char*)server_handshake_context_iv_string,
+                              server_handshake_context_iv_string_length);
+        if (XTT_ERROR_SUCCESS != rc)
+            goto cleanup;
+    }
+
+    // 6) Create SessionSecret (see xtt_initialize_session_context)
+    {
+        const char *session_secret_string = "XTT session secret";
+        uint16_t session_secret_string_length = 18;
+        assert(strlen(session_secret_string) == session_secret_string_length);
+        rc = keyed_prf_expand(handshake_ctx->session_secret,
+                              &secret_prf,
+                              (const unsigned char*)session_secret_string,
+                              session_secret_string_length);
+        if (XTT_ERROR_SUCCESS != rc)
+            goto cleanup;
     }
 
-    return XTT_ERROR_SUCCESS;
+    // Key derivation is everything but the Diffie-Hellman.
+    STATS_RECORD(XTT_STATS_PHASE_KEY_DERIVATION, (dh_start - hash_start) + (stats_now_ns() - dh_end));
+
+cleanup:
+    keyed_prf_release(&key_prf);
+    keyed_prf_release(&iv_prf);
+    keyed_prf_release(&secret_prf);
+
+    // Everything the handshake needs from the handshake_secret has been derived by now,
+    // and the scratch area outlives the handshake.
+    xtt_crypto_secure_clear(scratch->handshake_secret, sizeof(scratch->handshake_secret));
+
+    return rc;
 }
 
 xtt_error_code
@@ -188,66 +226,29 @@ generate_handshake_key_hash(unsigned char *hash_out,
                             const unsigned char *server_initandattest_uptocookie,
                             const xtt_server_cookie *server_cookie)
 {
+    struct handshake_transcript transcript;
+    xtt_error_code rc;
+
     uint16_t client_init_length = xtt_clientinit_length(handshake_ctx->version, handshake_ctx->suite_spec);
     uint16_t server_initandattest_up_to_cookie_length = xtt_serverinitandattest_uptocookie_length(handshake_ctx->version,
                                                                                                  handshake_ctx->suite_spec);
 
     // 1) Create inner hash: hash_ext(ClientInit || ServerInitAndAttest-up-to-cookie)
-    uint16_t inner_hash_input_length = client_init_length + server_initandattest_up_to_cookie_length;
-    assert(sizeof(handshake_ctx->hash_buffer) >= sizeof(inner_hash_input_length) + inner_hash_input_length);
-
-    unsigned char *hash_input = handshake_ctx->hash_buffer;
-
-    // 1i) Copy in the inner hash length to the hash input buffer.
-    short_to_bigendian(inner_hash_input_length, hash_input);
-    hash_input += sizeof(inner_hash_input_length);
-
-    // 1ii) Copy in the ClientInit to the hash input buffer.
-    memcpy(hash_input, client_init, client_init_length);
-    hash_input += client_init_length;
-
-    // 1iii) Copy in the ServerInitAndAttest-up-to-cookie to the hash input buffer.
-    memcpy(hash_input,
-           server_initandattest_uptocookie,
-           server_initandattest_up_to_cookie_length);
-    hash_input += server_initandattest_up_to_cookie_length;
-                                                                                            
-    // 1iv) Hash the hash input buffer to get the inner hash.
     //      (and save that inner hash to our handshake_ctx, for later use).
-    uint16_t inner_hash_length;
-    int hash_rc = handshake_ctx->hash(handshake_ctx->inner_hash,
-                                      &inner_hash_length,
-                                      handshake_ctx->hash_buffer,
-                                      inner_hash_input_length + sizeof(inner_hash_input_length));
-    if (0 != hash_rc)
-        return XTT_ERROR_CRYPTO;
+    transcript_start(&transcript,
+                     client_init_length + server_initandattest_up_to_cookie_length,
+                     handshake_ctx);
+    transcript_absorb(&transcript, client_init, client_init_length);
+    transcript_absorb(&transcript, server_initandattest_uptocookie, server_initandattest_up_to_cookie_length);
+    rc = transcript_finish(handshake_ctx->inner_hash, &transcript);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
 
     // 2) Create HandshakeKeyHash: hash_ext(inner-hash || server_cookie)
-    uint16_t outer_hash_input_length = inner_hash_length + sizeof(xtt_server_cookie);
-    assert(sizeof(handshake_ctx->hash_buffer) >= sizeof(outer_hash_input_length) + outer_hash_input_length);
-
-    hash_input = handshake_ctx->hash_buffer;
-
-    // 2i) Copy in the outer hash length to the hash input buffer.
-    short_to_bigendian(outer_hash_input_length, hash_input);
-    hash_input += sizeof(outer_hash_input_length);
-
-    // 2ii) Copy the inner hash to the hash input buffer.
-    memcpy(hash_input, handshake_ctx->inner_hash, handshake_ctx->hash_length);
-    hash_input += handshake_ctx->hash_length;
-
-    // 2iii) Copy the server_cookie to the hash input buffer.
-    memcpy(hash_input, server_cookie, sizeof(xtt_server_cookie));
-    hash_input += sizeof(xtt_server_cookie);
-
-    // 2iv) Hash the hash input buffer to get the HandshakeKeyHash.
-    uint16_t outer_hash_length;
-    hash_rc = handshake_ctx->hash(hash_out,
-                                  &outer_hash_length,
-                                  handshake_ctx->hash_buffer,
-                                  outer_hash_input_length + sizeof(outer_hash_input_length));
-    if (0 != hash_rc)
-        return XTT_ERROR_CRYPTO;
-
-    return XTT_ERROR_SUCCESS;
+    transcript_start(&transcript,
+                     HANDSHAKE_SUITE(handshake_ctx)->hash_length + sizeof(xtt_server_cookie),
+                     handshake_ctx);
+    transcript_absorb(&transcript, handshake_ctx->inner_hash, HANDSHAKE_SUITE(handshake_ctx)->hash_length);
+    transcript_absorb(&transcript, server_cookie->data, sizeof(xtt_server_cookie));
+    return transcript_finish(hash_out, &transcript);
 }
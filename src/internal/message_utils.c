@@ -20,6 +20,7 @@
 
 #include "message_utils.h"
 #include "byte_utils.h"
+#include "suites.h"
 
 #include <assert.h>
 
@@ -59,7 +60,7 @@ uint16_t xtt_clientinit_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -132,7 +133,7 @@ uint16_t xtt_serverinitandattest_unencrypted_part_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -155,7 +156,7 @@ uint16_t xtt_serverinitandattest_encrypted_part_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -178,7 +179,7 @@ xtt_serverinitandattest_total_length(xtt_version version,
 
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                     return body_length + sizeof(xtt_chacha_mac);
@@ -199,7 +200,7 @@ xtt_serverinitandattest_uptosignature_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -220,7 +221,7 @@ xtt_serverinitandattest_encrypted_part_uptosignature_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -239,7 +240,7 @@ xtt_serverinitandattest_uptocookie_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -296,7 +297,7 @@ xtt_serverinitandattest_access_server_cookie(const unsigned char* msg_start,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -334,7 +335,7 @@ xtt_encrypted_serverinitandattest_access_signature(const unsigned char* encrypte
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -368,7 +369,7 @@ uint16_t xtt_identityclientattest_encrypted_part_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -394,7 +395,7 @@ xtt_identityclientattest_total_length(xtt_version version,
 
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                     return body_length + sizeof(xtt_chacha_mac);
@@ -415,7 +416,7 @@ xtt_identityclientattest_uptofirstsignature_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -441,7 +442,7 @@ xtt_identityclientattest_encrypted_part_uptofirstsignature_length(xtt_version ve
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -509,7 +510,7 @@ xtt_encrypted_identityclientattest_access_gid(const unsigned char *encrypted_sta
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -530,7 +531,7 @@ xtt_encrypted_identityclientattest_access_id(const unsigned char *encrypted_star
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -552,7 +553,7 @@ xtt_encrypted_identityclientattest_access_longtermsignature(const unsigned char
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -575,7 +576,7 @@ xtt_encrypted_identityclientattest_access_daasignature(const unsigned char *encr
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -611,7 +612,7 @@ uint16_t xtt_identityserverfinished_encrypted_part_length(xtt_version version,
 {
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                 case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
@@ -634,7 +635,7 @@ xtt_identityserverfinished_total_length(xtt_version version,
 
     switch (version) {
         case XTT_VERSION_ONE:
-            switch (suite_spec) {
+            switch (SUITE_SPEC(suite_spec)) {
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
                 case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
                     return body_length + sizeof(xtt_chacha_mac);
@@ -693,6 +694,165 @@ xtt_encrypted_identityserverfinished_access_longtermkey(const unsigned char *enc
     return 0;
 }
 
+uint16_t xtt_sessionclientattest_unencrypted_part_length(xtt_version version)
+{
+    return xtt_identityclientattest_unencrypted_part_length(version);
+}
+
+uint16_t xtt_sessionclientattest_encrypted_part_length(xtt_version version,
+                                                       xtt_suite_spec suite_spec)
+{
+    switch (version) {
+        case XTT_VERSION_ONE:
+            switch (SUITE_SPEC(suite_spec)) {
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+                    return sizeof(xtt_client_id)
+                           + sizeof(xtt_ed25519_signature);
+            }
+    }
+
+    assert(0);
+    return 0;
+}
+
+uint16_t
+xtt_sessionclientattest_total_length(xtt_version version,
+                                     xtt_suite_spec suite_spec)
+{
+    uint16_t body_length = xtt_sessionclientattest_unencrypted_part_length(version)
+        + xtt_sessionclientattest_encrypted_part_length(version, suite_spec);
+
+    switch (version) {
+        case XTT_VERSION_ONE:
+            switch (SUITE_SPEC(suite_spec)) {
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+                    return body_length + sizeof(xtt_chacha_mac);
+                case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+                    return body_length + sizeof(xtt_aes256_mac);
+            }
+    }
+
+    assert(0);
+    return 0;
+}
+
+uint16_t
+xtt_sessionclientattest_encrypted_part_uptosignature_length(xtt_version version,
+                                                            xtt_suite_spec suite_spec)
+{
+    switch (version) {
+        case XTT_VERSION_ONE:
+            switch (SUITE_SPEC(suite_spec)) {
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+                    return sizeof(xtt_client_id);
+            }
+    }
+
+    assert(0);
+    return 0;
+}
+
+unsigned char*
+xtt_encrypted_sessionclientattest_access_id(const unsigned char *encrypted_start,
+                                            xtt_version version)
+{
+    switch (version) {
+        case XTT_VERSION_ONE:
+            return (unsigned char*)encrypted_start;
+    }
+
+    assert(0);
+    return NULL;
+}
+
+unsigned char*
+xtt_encrypted_sessionclientattest_access_longtermsignature(const unsigned char *encrypted_start,
+                                                           xtt_version version,
+                                                           xtt_suite_spec suite_spec)
+{
+    switch (version) {
+        case XTT_VERSION_ONE:
+            switch (SUITE_SPEC(suite_spec)) {
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+                    return (unsigned char*)(encrypted_start
+                                            + sizeof(xtt_client_id));
+            }
+    }
+
+    assert(0);
+    return NULL;
+}
+
+uint16_t xtt_sessionserverfinished_unencrypted_part_length(xtt_version version)
+{
+    return xtt_identityserverfinished_unencrypted_part_length(version);
+}
+
+uint16_t xtt_sessionserverfinished_encrypted_part_length(xtt_version version,
+                                                         xtt_suite_spec suite_spec)
+{
+    switch (version) {
+        case XTT_VERSION_ONE:
+            switch (SUITE_SPEC(suite_spec)) {
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+                    return sizeof(xtt_client_id);
+            }
+    }
+
+    assert(0);
+    return 0;
+}
+
+uint16_t
+xtt_sessionserverfinished_total_length(xtt_version version,
+                                       xtt_suite_spec suite_spec)
+{
+    uint16_t body_length = xtt_sessionserverfinished_unencrypted_part_length(version)
+        + xtt_sessionserverfinished_encrypted_part_length(version, suite_spec);
+
+    switch (version) {
+        case XTT_VERSION_ONE:
+            switch (SUITE_SPEC(suite_spec)) {
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512:
+                case XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B:
+                    return body_length + sizeof(xtt_chacha_mac);
+                case XTT_X25519_LRSW_ED25519_AES256GCM_SHA512:
+                case XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B:
+                    return body_length + sizeof(xtt_aes256_mac);
+            }
+    }
+
+    assert(0);
+    return 0;
+}
+
+unsigned char*
+xtt_encrypted_sessionserverfinished_access_id(const unsigned char *encrypted_start,
+                                              xtt_version version)
+{
+    switch (version) {
+        case XTT_VERSION_ONE:
+            return (unsigned char*)encrypted_start;
+    }
+
+    assert(0);
+    return NULL;
+}
+
 uint16_t xtt_record_unencrypted_header_length(xtt_version version)
 {
     switch (version) {
@@ -176,6 +176,49 @@ unsigned char*
 xtt_encrypted_identityserverfinished_access_longtermkey(const unsigned char *encrypted_start,
                                                         xtt_version version);
 
+/* Session_ClientAttest accessors */
+/* (The unencrypted part is laid-out the same as an Identity_ClientAttest's,
+ *  so the Identity_ClientAttest accessors for it apply) */
+uint16_t xtt_sessionclientattest_unencrypted_part_length(xtt_version version);
+
+uint16_t xtt_sessionclientattest_encrypted_part_length(xtt_version version,
+                                                       xtt_suite_spec suite_spec);
+
+uint16_t
+xtt_sessionclientattest_total_length(xtt_version version,
+                                     xtt_suite_spec suite_spec);
+
+uint16_t
+xtt_sessionclientattest_encrypted_part_uptosignature_length(xtt_version version,
+                                                            xtt_suite_spec suite_spec);
+
+/* encrypted_start = part of message _after_ the additional data */
+unsigned char*
+xtt_encrypted_sessionclientattest_access_id(const unsigned char *encrypted_start,
+                                            xtt_version version);
+
+unsigned char*
+xtt_encrypted_sessionclientattest_access_longtermsignature(const unsigned char *encrypted_start,
+                                                           xtt_version version,
+                                                           xtt_suite_spec suite_spec);
+
+/* Session_ServerFinished accessors */
+/* (The unencrypted part is laid-out the same as an Identity_ServerFinished's,
+ *  so the Identity_ServerFinished accessors for it apply) */
+uint16_t xtt_sessionserverfinished_unencrypted_part_length(xtt_version version);
+
+uint16_t xtt_sessionserverfinished_encrypted_part_length(xtt_version version,
+                                                         xtt_suite_spec suite_spec);
+
+uint16_t
+xtt_sessionserverfinished_total_length(xtt_version version,
+                                       xtt_suite_spec suite_spec);
+
+/* encrypted_start = part of message _after_ the additional data */
+unsigned char*
+xtt_encrypted_sessionserverfinished_access_id(const unsigned char *encrypted_start,
+                                              xtt_version version);
+
 /* Record accessors */
 /* msg_start = beginning of full message */
 uint16_t xtt_record_unencrypted_header_length(xtt_version version);
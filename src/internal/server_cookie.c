@@ -18,38 +18,287 @@
 
 #include "server_cookie.h"
 #include "message_utils.h"
+#include "byte_utils.h"
 
 #include <xtt/crypto_wrapper.h>
 
+#include <string.h>
+
+/*
+ * ServerCookie layout:
+ *      key_epoch (4, big-endian) || aead_nonce (12) || sealed_state || mac (16)
+ *
+ *      sealed_state = ClientInit nonce || client's ECDHE public key || own ECDHE private key || reserved
+ *
+ * The key_epoch, version, and suite_spec are the associated data.
+ */
+#define COOKIE_EPOCH_OFFSET 0
+#define COOKIE_NONCE_OFFSET (COOKIE_EPOCH_OFFSET + sizeof(uint32_t))
+#define COOKIE_SEALED_OFFSET (COOKIE_NONCE_OFFSET + sizeof(xtt_chacha_nonce))
+#define COOKIE_STATE_LENGTH (sizeof(xtt_signing_nonce) + sizeof(xtt_x25519_pub_key) + sizeof(xtt_x25519_priv_key) + 2)
+#define COOKIE_ADDL_DATA_LENGTH (sizeof(uint32_t) + sizeof(xtt_version_raw) + sizeof(xtt_suite_spec_raw))
+
+// The replay filter is indexed by the cookie's MAC, which is uniformly random
+// (and, since only authenticated cookies are ever recorded, can't be chosen by a client).
+#define COOKIE_MAC_OFFSET (sizeof(xtt_server_cookie) - sizeof(xtt_chacha_mac))
+#define REPLAY_FILTER_BITS_PER_COOKIE 6
+
+typedef char xtt_server_cookie_layout_fits[(COOKIE_SEALED_OFFSET + COOKIE_STATE_LENGTH + sizeof(xtt_chacha_mac)) == sizeof(xtt_server_cookie) ? 1 : -1];
+typedef char xtt_cookie_replay_filter_words_is_power_of_two[(XTT_COOKIE_REPLAY_FILTER_WORDS & (XTT_COOKIE_REPLAY_FILTER_WORDS - 1)) == 0 ? 1 : -1];
+
+static
+void
+build_addl_data(unsigned char *addl_data_out,
+                const xtt_server_cookie *cookie,
+                xtt_version version,
+                xtt_suite_spec suite_spec);
+
+static
+xtt_error_code
+check_cookie_epoch(uint32_t *cookie_epoch_out,
+                   const xtt_server_cookie *cookie,
+                   const struct xtt_server_cookie_context *cookie_ctx);
+
+static
+uint32_t
+replay_filter_position(uint64_t *mask_out,
+                       const xtt_server_cookie *cookie);
+
 xtt_error_code
 build_server_cookie(xtt_server_cookie *cookie,
+                    const unsigned char *client_init,
                     struct xtt_handshake_context *handshake_ctx,
                     struct xtt_server_cookie_context *cookie_ctx)
 {
-    (void)cookie_ctx;
+    xtt_error_code rc = XTT_ERROR_SUCCESS;
+    unsigned char state[COOKIE_STATE_LENGTH];
+    unsigned char addl_data[COOKIE_ADDL_DATA_LENGTH];
+
+    // 1) Stamp the cookie with the epoch of the key we'll seal it under.
+    uint32_t epoch = __atomic_load_n(&cookie_ctx->epoch, __ATOMIC_ACQUIRE);
+    const xtt_chacha_key *key = &cookie_ctx->keys[epoch % XTT_SERVER_COOKIE_KEY_SLOTS];
+    long_to_bigendian(epoch, cookie->data + COOKIE_EPOCH_OFFSET);
+
+    // 2) Pick a fresh AEAD nonce.
+    xtt_crypto_get_random(cookie->data + COOKIE_NONCE_OFFSET,
+                          sizeof(xtt_chacha_nonce));
 
-    // For now, just generate a random nonce,
-    // and don't support the 'no-local-state' option.
-    xtt_crypto_get_random(cookie->data,
-                         sizeof(xtt_server_cookie)); 
+    // 3) Gather the state we'll need to rebuild this handshake_ctx.
+    unsigned char *state_ptr = state;
+    memcpy(state_ptr,
+           xtt_clientinit_access_nonce(client_init, handshake_ctx->version)->data,
+           sizeof(xtt_signing_nonce));
+    state_ptr += sizeof(xtt_signing_nonce);
+    memcpy(state_ptr,
+           xtt_clientinit_access_ecdhe_key(client_init, handshake_ctx->version),
+           sizeof(xtt_x25519_pub_key));
+    state_ptr += sizeof(xtt_x25519_pub_key);
+    memcpy(state_ptr,
+           handshake_ctx->dh_priv_key.x25519.data,
+           sizeof(xtt_x25519_priv_key));
+    state_ptr += sizeof(xtt_x25519_priv_key);
+    memset(state_ptr, 0, state + sizeof(state) - state_ptr);
 
-    // Save cookie to context
+    // 4) Seal it.
+    build_addl_data(addl_data, cookie, handshake_ctx->version, handshake_ctx->suite_spec);
+    uint16_t sealed_len;
+    int seal_rc = xtt_crypto_aead_chacha_encrypt(cookie->data + COOKIE_SEALED_OFFSET,
+                                                 &sealed_len,
+                                                 state,
+                                                 sizeof(state),
+                                                 addl_data,
+                                                 sizeof(addl_data),
+                                                 (const xtt_chacha_nonce*)(cookie->data + COOKIE_NONCE_OFFSET),
+                                                 key);
+    if (0 != seal_rc)
+        rc = XTT_ERROR_CRYPTO;
+
+    xtt_crypto_secure_clear(state, sizeof(state));
+
+    // 5) Save cookie to context
     handshake_ctx->server_cookie = *cookie;
 
+    return rc;
+}
+
+xtt_error_code
+check_server_cookie(const xtt_server_cookie *cookie,
+                    const struct xtt_handshake_context *handshake_ctx,
+                    struct xtt_server_cookie_context *cookie_ctx)
+{
+    // 1) Ensure that this is the same cookie as the one we sent
+    //  (or the one this handshake_ctx was restored from).
+    if (0 != xtt_crypto_memcmp(cookie->data,
+                               handshake_ctx->server_cookie.data,
+                               sizeof(xtt_server_cookie)))
+        return XTT_ERROR_BAD_COOKIE;
+
+    // 2) Ensure that its key hasn't been rotated-out.
+    uint32_t cookie_epoch;
+    xtt_error_code rc = check_cookie_epoch(&cookie_epoch, cookie, cookie_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 3) Ensure that it hasn't been used before.
+    //  (Don't record it yet: anyone who saw it go by could be the one echoing it.)
+    uint64_t mask;
+    uint32_t index = replay_filter_position(&mask, cookie);
+    if ((__atomic_load_n(&cookie_ctx->replay_filters[cookie_epoch % XTT_SERVER_COOKIE_KEY_SLOTS].words[index], __ATOMIC_RELAXED) & mask) == mask) {
+        __atomic_add_fetch(&cookie_ctx->replays, 1, __ATOMIC_RELAXED);
+        return XTT_ERROR_BAD_COOKIE;
+    }
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+record_server_cookie(const xtt_server_cookie *cookie,
+                     struct xtt_server_cookie_context *cookie_ctx)
+{
+    // 1) Ensure that its key hasn't been rotated-out since it was checked.
+    uint32_t cookie_epoch;
+    xtt_error_code rc = check_cookie_epoch(&cookie_epoch, cookie, cookie_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 2) Record it, unless another ClientAttest echoing it got here first.
+    struct xtt_cookie_replay_filter *filter = &cookie_ctx->replay_filters[cookie_epoch % XTT_SERVER_COOKIE_KEY_SLOTS];
+    uint64_t mask;
+    uint32_t index = replay_filter_position(&mask, cookie);
+    uint64_t previous = __atomic_fetch_or(&filter->words[index], mask, __ATOMIC_RELAXED);
+    if ((previous & mask) == mask) {
+        __atomic_add_fetch(&cookie_ctx->replays, 1, __ATOMIC_RELAXED);
+        return XTT_ERROR_BAD_COOKIE;
+    }
+    __atomic_add_fetch(&filter->recorded, 1, __ATOMIC_RELAXED);
+
     return XTT_ERROR_SUCCESS;
 }
 
 xtt_error_code
-validate_server_cookie(xtt_server_cookie *cookie,
-                       struct xtt_handshake_context *handshake_ctx,
-                       struct xtt_server_cookie_context *cookie_ctx)
-{
-    (void)cookie_ctx;
-    // In the future, check that version and suite_spec are the same as before,
-    // and that the cookie decrypts using one of the cookie_ctx keys and hasn't been seen before.
-
-    // For now, just ensure that this is the same cookie as the one we sent.
-    return xtt_crypto_memcmp(cookie->data,
-                            handshake_ctx->server_cookie.data,
-                            sizeof(xtt_server_cookie));
+open_server_cookie(xtt_signing_nonce *client_nonce_out,
+                   xtt_x25519_pub_key *client_ecdhe_key_out,
+                   xtt_x25519_priv_key *own_ecdhe_key_out,
+                   const xtt_server_cookie *cookie,
+                   xtt_version version,
+                   xtt_suite_spec suite_spec,
+                   const struct xtt_server_cookie_context *cookie_ctx)
+{
+    xtt_error_code rc;
+    unsigned char state[COOKIE_STATE_LENGTH];
+    unsigned char addl_data[COOKIE_ADDL_DATA_LENGTH];
+
+    // 1) Find the key it was sealed under.
+    uint32_t cookie_epoch;
+    rc = check_cookie_epoch(&cookie_epoch, cookie, cookie_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+    const xtt_chacha_key *key = &cookie_ctx->keys[cookie_epoch % XTT_SERVER_COOKIE_KEY_SLOTS];
+
+    // 1ii) Don't bother opening it if it's already been used.
+    //  (It only gets recorded as used by `record_server_cookie`.)
+    uint64_t mask;
+    uint32_t index = replay_filter_position(&mask, cookie);
+    if ((__atomic_load_n(&cookie_ctx->replay_filters[cookie_epoch % XTT_SERVER_COOKIE_KEY_SLOTS].words[index], __ATOMIC_RELAXED) & mask) == mask)
+        return XTT_ERROR_BAD_COOKIE;
+
+    // 2) Open it.
+    build_addl_data(addl_data, cookie, version, suite_spec);
+    uint16_t state_len;
+    int open_rc = xtt_crypto_aead_chacha_decrypt(state,
+                                                 &state_len,
+                                                 cookie->data + COOKIE_SEALED_OFFSET,
+                                                 sizeof(xtt_server_cookie) - COOKIE_SEALED_OFFSET,
+                                                 addl_data,
+                                                 sizeof(addl_data),
+                                                 (const xtt_chacha_nonce*)(cookie->data + COOKIE_NONCE_OFFSET),
+                                                 key);
+    if (0 != open_rc || sizeof(state) != state_len) {
+        xtt_crypto_secure_clear(state, sizeof(state));
+        return XTT_ERROR_BAD_COOKIE;
+    }
+
+    // 3) Copy out the handshake state.
+    const unsigned char *state_ptr = state;
+    memcpy(client_nonce_out->data, state_ptr, sizeof(xtt_signing_nonce));
+    state_ptr += sizeof(xtt_signing_nonce);
+    memcpy(client_ecdhe_key_out->data, state_ptr, sizeof(xtt_x25519_pub_key));
+    state_ptr += sizeof(xtt_x25519_pub_key);
+    memcpy(own_ecdhe_key_out->data, state_ptr, sizeof(xtt_x25519_priv_key));
+
+    xtt_crypto_secure_clear(state, sizeof(state));
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void
+build_addl_data(unsigned char *addl_data_out,
+                const xtt_server_cookie *cookie,
+                xtt_version version,
+                xtt_suite_spec suite_spec)
+{
+    memcpy(addl_data_out, cookie->data + COOKIE_EPOCH_OFFSET, sizeof(uint32_t));
+    addl_data_out += sizeof(uint32_t);
+
+    *addl_data_out = version;
+    addl_data_out += sizeof(xtt_version_raw);
+
+    short_to_bigendian(suite_spec, addl_data_out);
+}
+
+void
+reset_cookie_replay_filter(struct xtt_cookie_replay_filter *filter)
+{
+    for (uint32_t i = 0; i < XTT_COOKIE_REPLAY_FILTER_WORDS; ++i)
+        __atomic_store_n(&filter->words[i], 0, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&filter->recorded, 0, __ATOMIC_RELAXED);
+}
+
+double
+cookie_replay_filter_false_positive_rate(const struct xtt_cookie_replay_filter *filter)
+{
+    // A fresh cookie lands in a uniformly-random word,
+    // and is a false-positive if all of its bits happen to be set already.
+    double sum = 0;
+    for (uint32_t i = 0; i < XTT_COOKIE_REPLAY_FILTER_WORDS; ++i) {
+        double fill = (double)__builtin_popcountll(__atomic_load_n(&filter->words[i], __ATOMIC_RELAXED)) / 64;
+        double word_rate = 1;
+        for (int j = 0; j < REPLAY_FILTER_BITS_PER_COOKIE; ++j)
+            word_rate *= fill;
+        sum += word_rate;
+    }
+
+    return sum / XTT_COOKIE_REPLAY_FILTER_WORDS;
+}
+
+xtt_error_code
+check_cookie_epoch(uint32_t *cookie_epoch_out,
+                   const xtt_server_cookie *cookie,
+                   const struct xtt_server_cookie_context *cookie_ctx)
+{
+    bigendian_to_long(cookie->data + COOKIE_EPOCH_OFFSET, cookie_epoch_out);
+
+    // Only the current and previous keys are still accepted.
+    uint32_t current_epoch = __atomic_load_n(&cookie_ctx->epoch, __ATOMIC_ACQUIRE);
+    if (*cookie_epoch_out != current_epoch && *cookie_epoch_out != current_epoch - 1)
+        return XTT_ERROR_COOKIE_ROTATION;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+uint32_t
+replay_filter_position(uint64_t *mask_out,
+                       const xtt_server_cookie *cookie)
+{
+    const unsigned char *mac = cookie->data + COOKIE_MAC_OFFSET;
+
+    uint32_t index;
+    bigendian_to_long(mac, &index);
+
+    *mask_out = 0;
+    for (int i = 0; i < REPLAY_FILTER_BITS_PER_COOKIE; ++i)
+        *mask_out |= (uint64_t)1 << (mac[sizeof(uint32_t) + i] & 63);
+
+    return index & (XTT_COOKIE_REPLAY_FILTER_WORDS - 1);
 }
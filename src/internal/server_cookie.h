@@ -28,15 +28,85 @@
 extern "C" {
 #endif
 
+/*
+ * Build a ServerCookie that seals (under the cookie_ctx's current key)
+ * everything `open_server_cookie` needs to rebuild this handshake_ctx,
+ * and save a copy of it to the handshake_ctx.
+ *
+ * The handshake_ctx's own Diffie-Hellman key pair MUST already be set.
+ */
 xtt_error_code
 build_server_cookie(xtt_server_cookie *cookie,
+                    const unsigned char *client_init,
                     struct xtt_handshake_context *handshake_ctx,
                     struct xtt_server_cookie_context *cookie_ctx);
 
+/*
+ * Check that an echoed ServerCookie is the one saved in the handshake_ctx,
+ * that its key hasn't been rotated-out, and that it hasn't been recorded as used.
+ *
+ * Doesn't record it: the cookie travels in the clear, so echoing it proves nothing.
+ * Call `record_server_cookie` once the ClientAttest carrying it has been decrypted
+ * and its signatures verified.
+ *
+ * Safe to call from any number of threads.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_COOKIE if it's not the cookie we sent, or if it's been used before
+ *      XTT_ERROR_COOKIE_ROTATION if it was sealed under a key that's no longer accepted
+ */
 xtt_error_code
-validate_server_cookie(xtt_server_cookie *cookie,
-                       struct xtt_handshake_context *handshake_ctx,
-                       struct xtt_server_cookie_context *cookie_ctx);
+check_server_cookie(const xtt_server_cookie *cookie,
+                    const struct xtt_handshake_context *handshake_ctx,
+                    struct xtt_server_cookie_context *cookie_ctx);
+
+/*
+ * Record a ServerCookie as used, so no later ClientAttest can echo it.
+ *
+ * Safe to call from any number of threads:
+ * of two concurrent calls for the same cookie, exactly one succeeds.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_COOKIE if it's already been recorded
+ *      XTT_ERROR_COOKIE_ROTATION if it was sealed under a key that's no longer accepted
+ */
+xtt_error_code
+record_server_cookie(const xtt_server_cookie *cookie,
+                     struct xtt_server_cookie_context *cookie_ctx);
+
+/*
+ * Open a ServerCookie built by `build_server_cookie`.
+ *
+ * `version` and `suite_spec` are those claimed by the client,
+ * and must be the ones the cookie was built for.
+ *
+ * return:
+ *      XTT_ERROR_SUCCESS on success
+ *      XTT_ERROR_BAD_COOKIE if the cookie doesn't authenticate, or if it's been seen before
+ *      XTT_ERROR_COOKIE_ROTATION if it was sealed under a key that's no longer accepted
+ */
+xtt_error_code
+open_server_cookie(xtt_signing_nonce *client_nonce_out,
+                   xtt_x25519_pub_key *client_ecdhe_key_out,
+                   xtt_x25519_priv_key *own_ecdhe_key_out,
+                   const xtt_server_cookie *cookie,
+                   xtt_version version,
+                   xtt_suite_spec suite_spec,
+                   const struct xtt_server_cookie_context *cookie_ctx);
+
+/*
+ * Forget every cookie recorded in a replay filter.
+ */
+void
+reset_cookie_replay_filter(struct xtt_cookie_replay_filter *filter);
+
+/*
+ * The chance that a fresh cookie would be mistaken for one already recorded in this filter.
+ */
+double
+cookie_replay_filter_false_positive_rate(const struct xtt_cookie_replay_filter *filter);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_INTERNAL_SERVER_HANDSHAKE_H
+#define XTT_INTERNAL_SERVER_HANDSHAKE_H
+#pragma once
+
+#include <xtt/context.h>
+#include <xtt/crypto_types.h>
+#include <xtt/error_codes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The individual steps of the server-side handshake messages.
+ *
+ * `xtt_build_server_init_and_attest` and `xtt_build_identity_server_finished`
+ * simply run these in order; they're exposed separately so the server engine
+ * can run each step on a different pool of threads.
+ *
+ * None of these build an Error message on failure: that's left to the caller.
+ */
+
+/*
+ * Parse the ClientInit, initialize the handshake context (taking its key pair from key_pool, if non-NULL),
+ * and fill in the unencrypted part of the ServerInitAndAttest (including the ServerCookie).
+ */
+xtt_error_code
+build_serverinitandattest_unencrypted_part(unsigned char* out_buffer,
+                                           struct xtt_server_handshake_context* ctx_out,
+                                           const unsigned char* client_init,
+                                           struct xtt_server_cookie_context* cookie_ctx,
+                                           struct xtt_x25519_key_pool* key_pool);
+
+/*
+ * Run Diffie-Hellman and derive the handshake AEAD keys.
+ *
+ * `out_buffer` must already contain the unencrypted part of the ServerInitAndAttest.
+ */
+xtt_error_code
+derive_serverinitandattest_keys(const unsigned char* out_buffer,
+                                const unsigned char* client_init,
+                                struct xtt_server_handshake_context* ctx);
+
+/*
+ * Sign the ServerInitAndAttest, then AEAD encrypt it.
+ *
+ * The handshake keys MUST already have been derived.
+ */
+xtt_error_code
+sign_and_encrypt_serverinitandattest(unsigned char* out_buffer,
+                                     uint16_t* out_length,
+                                     const unsigned char* client_init,
+                                     const struct xtt_server_certificate_context* certificate_ctx,
+                                     struct xtt_server_handshake_context* ctx);
+
+/*
+ * Build and AEAD encrypt the IdentityServerFinished.
+ */
+xtt_error_code
+build_identityserverfinished(unsigned char *out_buffer,
+                             uint16_t *out_length,
+                             const xtt_client_id *client_id,
+                             struct xtt_server_handshake_context* handshake_ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
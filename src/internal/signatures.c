@@ -16,9 +16,14 @@
  *
  *****************************************************************************/
 
+#define _POSIX_C_SOURCE 200112L
+
 #include "signatures.h"
 #include "message_utils.h"
 #include "byte_utils.h"
+#include "crypto_utils.h"
+#include "suites.h"
+#include "stats.h"
 
 #include <xtt/crypto_wrapper.h>
 
@@ -27,6 +32,13 @@
 #include <time.h>
 #include <stdio.h>
 
+#define CLIENT_SIGNATURES_BATCH_CHUNK 64
+
+static
+void
+verify_client_signatures_chunk(struct xtt_identity_verification_job *jobs,
+                               uint16_t job_count);
+
 static
 xtt_error_code
 generate_server_sig_hash(unsigned char *hash_out,
@@ -46,6 +58,16 @@ generate_client_sig_hash(unsigned char *hash_out,
                          int is_daa,
                          struct xtt_handshake_context *handshake_ctx);
 
+static
+xtt_error_code
+generate_session_client_sig_hash(unsigned char *hash_out,
+                                 const unsigned char *server_cookie,
+                                 const struct xtt_server_certificate_raw_type *certificate,
+                                 const unsigned char *server_signature,
+                                 const unsigned char *sessionclientattest_unencrypted_part,
+                                 const unsigned char *sessionclientattest_encryptedpart_uptosignature,
+                                 struct xtt_handshake_context *handshake_ctx);
+
 static
 xtt_error_code
 is_expiry_passed(const xtt_certificate_expiry *expiry);
@@ -58,9 +80,11 @@ generate_server_signature(unsigned char* signature_out,
                           struct xtt_handshake_context *handshake_ctx,
                           const struct xtt_server_certificate_context *certificate_ctx)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(handshake_ctx);
+
     xtt_error_code rc;
 
-    rc = generate_server_sig_hash(handshake_ctx->hash_out_buffer,
+    rc = generate_server_sig_hash(scratch->hash_out_buffer,
                                   client_init,
                                   server_initandattest_unencrypted_part,
                                   server_initandattest_encryptedpart_uptosignature,
@@ -69,8 +93,8 @@ generate_server_signature(unsigned char* signature_out,
         return rc;
 
     rc = certificate_ctx->sign(signature_out,
-                               handshake_ctx->hash_out_buffer,
-                               handshake_ctx->hash_length,
+                               scratch->hash_out_buffer,
+                               HANDSHAKE_SUITE(handshake_ctx)->hash_length,
                                certificate_ctx);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
@@ -88,9 +112,11 @@ generate_daa_signature(unsigned char *signature_out,
                        struct xtt_handshake_context *handshake_ctx,
                        struct xtt_daa_context *daa_ctx)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(handshake_ctx);
+
     xtt_error_code rc;
 
-    rc = generate_client_sig_hash(handshake_ctx->hash_out_buffer,
+    rc = generate_client_sig_hash(scratch->hash_out_buffer,
                                   server_cookie,
                                   certificate,
                                   server_signature,
@@ -102,8 +128,8 @@ generate_daa_signature(unsigned char *signature_out,
         return rc;
 
     rc = daa_ctx->sign(signature_out,
-                       handshake_ctx->hash_out_buffer,
-                       handshake_ctx->hash_length,
+                       scratch->hash_out_buffer,
+                       HANDSHAKE_SUITE(handshake_ctx)->hash_length,
                        daa_ctx);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
@@ -112,32 +138,33 @@ generate_daa_signature(unsigned char *signature_out,
 }
 
 xtt_error_code
-verify_daa_signature(unsigned char *signature,
-                     const unsigned char *server_cookie,
-                     const unsigned char *server_signature,
-                     const unsigned char *identityclientattest_unencrypted_part,
-                     const unsigned char *identityclientattest_encryptedpart_uptosignature,
-                     struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
-                     struct xtt_server_certificate_context *server_certificate_ctx,
-                     struct xtt_handshake_context *handshake_ctx)
+generate_client_longterm_signature(unsigned char *signature_out,
+                                   const unsigned char *server_cookie,
+                                   const struct xtt_server_certificate_raw_type *certificate,
+                                   const unsigned char *server_signature,
+                                   const unsigned char *identityclientattest_unencrypted_part,
+                                   const unsigned char *identityclientattest_encryptedpart_uptosignature,
+                                   struct xtt_client_handshake_context *handshake_ctx)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
     xtt_error_code rc;
 
-    rc = generate_client_sig_hash(handshake_ctx->hash_out_buffer,
+    rc = generate_client_sig_hash(scratch->hash_out_buffer,
                                   server_cookie,
-                                  server_certificate_ctx->serialized_certificate,
+                                  certificate,
                                   server_signature,
                                   identityclientattest_unencrypted_part,
                                   identityclientattest_encryptedpart_uptosignature,
-                                  1,
-                                  handshake_ctx);
+                                  0,
+                                  &handshake_ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
-    rc = daa_group_pub_key_ctx->verify_signature(signature,
-                                                 handshake_ctx->hash_out_buffer,
-                                                 handshake_ctx->hash_length,
-                                                 daa_group_pub_key_ctx);
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->longterm_sign(signature_out,
+                                                  scratch->hash_out_buffer,
+                                                  HANDSHAKE_SUITE(&handshake_ctx->base)->hash_length,
+                                                  handshake_ctx);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
@@ -145,31 +172,32 @@ verify_daa_signature(unsigned char *signature,
 }
 
 xtt_error_code
-generate_client_longterm_signature(unsigned char *signature_out,
-                                   const unsigned char *server_cookie,
-                                   const struct xtt_server_certificate_raw_type *certificate,
-                                   const unsigned char *server_signature,
-                                   const unsigned char *identityclientattest_unencrypted_part,
-                                   const unsigned char *identityclientattest_encryptedpart_uptosignature,
-                                   struct xtt_client_handshake_context *handshake_ctx)
+generate_session_client_longterm_signature(unsigned char *signature_out,
+                                           const unsigned char *server_cookie,
+                                           const struct xtt_server_certificate_raw_type *certificate,
+                                           const unsigned char *server_signature,
+                                           const unsigned char *sessionclientattest_unencrypted_part,
+                                           const unsigned char *sessionclientattest_encryptedpart_uptosignature,
+                                           struct xtt_client_handshake_context *handshake_ctx)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
     xtt_error_code rc;
 
-    rc = generate_client_sig_hash(handshake_ctx->base.hash_out_buffer,
-                                  server_cookie,
-                                  certificate,
-                                  server_signature,
-                                  identityclientattest_unencrypted_part,
-                                  identityclientattest_encryptedpart_uptosignature,
-                                  0,
-                                  &handshake_ctx->base);
+    rc = generate_session_client_sig_hash(scratch->hash_out_buffer,
+                                          server_cookie,
+                                          certificate,
+                                          server_signature,
+                                          sessionclientattest_unencrypted_part,
+                                          sessionclientattest_encryptedpart_uptosignature,
+                                          &handshake_ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
-    rc = handshake_ctx->longterm_sign(signature_out,
-                                      handshake_ctx->base.hash_out_buffer,
-                                      handshake_ctx->base.hash_length,
-                                      handshake_ctx);
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->longterm_sign(signature_out,
+                                                  scratch->hash_out_buffer,
+                                                  HANDSHAKE_SUITE(&handshake_ctx->base)->hash_length,
+                                                  handshake_ctx);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
@@ -177,17 +205,72 @@ generate_client_longterm_signature(unsigned char *signature_out,
 }
 
 xtt_error_code
-verify_client_longterm_signature(unsigned char *signature,
-                                 const unsigned char *server_cookie,
-                                 const unsigned char *server_signature,
-                                 const unsigned char *identityclientattest_unencrypted_part,
-                                 const unsigned char *identityclientattest_encryptedpart_uptosignature,
-                                 struct xtt_server_certificate_context *server_certificate_ctx,
-                                 struct xtt_server_handshake_context *handshake_ctx)
+verify_session_client_longterm_signature(const unsigned char *signature,
+                                         const unsigned char *client_longterm_key,
+                                         const unsigned char *server_cookie,
+                                         const unsigned char *server_signature,
+                                         const unsigned char *sessionclientattest_unencrypted_part,
+                                         const unsigned char *sessionclientattest_encryptedpart_uptosignature,
+                                         const struct xtt_server_certificate_context *server_certificate_ctx,
+                                         struct xtt_server_handshake_context *handshake_ctx)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
     xtt_error_code rc;
 
-    rc = generate_client_sig_hash(handshake_ctx->base.hash_out_buffer,
+    rc = generate_session_client_sig_hash(scratch->hash_out_buffer,
+                                          server_cookie,
+                                          server_certificate_ctx->serialized_certificate,
+                                          server_signature,
+                                          sessionclientattest_unencrypted_part,
+                                          sessionclientattest_encryptedpart_uptosignature,
+                                          &handshake_ctx->base);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    STATS_CLOCK(verify_start);
+    int verify_rc = HANDSHAKE_SUITE(&handshake_ctx->base)->verify_client_longterm_signature(signature,
+                                                                                scratch->hash_out_buffer,
+                                                                                HANDSHAKE_SUITE(&handshake_ctx->base)->hash_length,
+                                                                                client_longterm_key);
+    STATS_RECORD(XTT_STATS_PHASE_LONGTERM_VERIFY, stats_now_ns() - verify_start);
+    if (0 != verify_rc)
+        return XTT_ERROR_BAD_SIGNATURE;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+prepare_client_signatures_verification(struct xtt_identity_verification_job *job_out,
+                                       const unsigned char *server_cookie,
+                                       const unsigned char *server_signature,
+                                       const unsigned char *identityclientattest_unencrypted_part,
+                                       const unsigned char *identityclientattest_encryptedpart_uptosignature,
+                                       struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
+                                       struct xtt_server_certificate_context *server_certificate_ctx,
+                                       struct xtt_server_handshake_context *handshake_ctx)
+{
+    xtt_error_code rc;
+
+    job_out->daa_group_pub_key_ctx = daa_group_pub_key_ctx;
+    job_out->verify_client_longterm_signature = HANDSHAKE_SUITE(&handshake_ctx->base)->verify_client_longterm_signature;
+    job_out->batch_verify_client_longterm_signatures = HANDSHAKE_SUITE(&handshake_ctx->base)->batch_verify_client_longterm_signatures;
+    job_out->hash_length = HANDSHAKE_SUITE(&handshake_ctx->base)->hash_length;
+
+    // 1) Hash the input to the DAA signature.
+    rc = generate_client_sig_hash(job_out->daa_signature_hash.sha512.data,
+                                  server_cookie,
+                                  server_certificate_ctx->serialized_certificate,
+                                  server_signature,
+                                  identityclientattest_unencrypted_part,
+                                  identityclientattest_encryptedpart_uptosignature,
+                                  1,
+                                  &handshake_ctx->base);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 2) Hash the input to the longterm_key signature.
+    rc = generate_client_sig_hash(job_out->longterm_signature_hash.sha512.data,
                                   server_cookie,
                                   server_certificate_ctx->serialized_certificate,
                                   server_signature,
@@ -198,18 +281,140 @@ verify_client_longterm_signature(unsigned char *signature,
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
-    unsigned char *client_longterm_key = xtt_encrypted_identityclientattest_access_longtermkey(identityclientattest_encryptedpart_uptosignature,
-                                                                                               handshake_ctx->base.version);
-    rc = handshake_ctx->verify_client_longterm_signature(signature,
-                                                         handshake_ctx->base.hash_out_buffer,
-                                                         handshake_ctx->base.hash_length,
-                                                         client_longterm_key);
+    // 3) Copy the signatures and the claimed longterm_key.
+    memcpy(job_out->daa_signature.lrsw.data,
+           xtt_encrypted_identityclientattest_access_daasignature(identityclientattest_encryptedpart_uptosignature,
+                                                                  handshake_ctx->base.version,
+                                                                  handshake_ctx->base.suite_spec),
+           sizeof(xtt_daa_signature_lrsw));
+    memcpy(job_out->longterm_signature.ed25519.data,
+           xtt_encrypted_identityclientattest_access_longtermsignature(identityclientattest_encryptedpart_uptosignature,
+                                                                       handshake_ctx->base.version,
+                                                                       handshake_ctx->base.suite_spec),
+           HANDSHAKE_SUITE(&handshake_ctx->base)->longterm_key_signature_length);
+    memcpy(job_out->longterm_key.ed25519.data,
+           xtt_encrypted_identityclientattest_access_longtermkey(identityclientattest_encryptedpart_uptosignature,
+                                                                 handshake_ctx->base.version),
+           HANDSHAKE_SUITE(&handshake_ctx->base)->longterm_key_length);
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+verify_client_signatures(struct xtt_identity_verification_job *job)
+{
+    xtt_error_code rc;
+
+    // 1) Verify the DAA signature.
+    rc = job->daa_group_pub_key_ctx->verify_signature(job->daa_signature.lrsw.data,
+                                                      job->daa_signature_hash.sha512.data,
+                                                      job->hash_length,
+                                                      job->daa_group_pub_key_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 2) Verify the longterm_key signature.
+    STATS_CLOCK(verify_start);
+    rc = job->verify_client_longterm_signature(job->longterm_signature.ed25519.data,
+                                               job->longterm_signature_hash.sha512.data,
+                                               job->hash_length,
+                                               job->longterm_key.ed25519.data);
+    STATS_RECORD(XTT_STATS_PHASE_LONGTERM_VERIFY, stats_now_ns() - verify_start);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
     return XTT_ERROR_SUCCESS;
 }
 
+xtt_error_code
+verify_client_signatures_batch(struct xtt_identity_verification_job *jobs,
+                               uint16_t job_count)
+{
+    xtt_error_code ret = XTT_ERROR_SUCCESS;
+
+    for (uint16_t begin = 0; begin < job_count; begin += CLIENT_SIGNATURES_BATCH_CHUNK) {
+        uint16_t chunk_size = job_count - begin;
+        if (chunk_size > CLIENT_SIGNATURES_BATCH_CHUNK)
+            chunk_size = CLIENT_SIGNATURES_BATCH_CHUNK;
+
+        verify_client_signatures_chunk(&jobs[begin], chunk_size);
+
+        for (uint16_t i = begin; i < begin + chunk_size; ++i) {
+            if (XTT_ERROR_SUCCESS != jobs[i].verdict)
+                ret = XTT_ERROR_BAD_SIGNATURE;
+        }
+    }
+
+    return ret;
+}
+
+void
+verify_client_signatures_chunk(struct xtt_identity_verification_job *jobs,
+                               uint16_t job_count)
+{
+    struct xtt_daa_verify_item daa_items[CLIENT_SIGNATURES_BATCH_CHUNK];
+    int daa_results[CLIENT_SIGNATURES_BATCH_CHUNK];
+    struct xtt_ed25519_verify_item longterm_items[CLIENT_SIGNATURES_BATCH_CHUNK];
+    int longterm_results[CLIENT_SIGNATURES_BATCH_CHUNK];
+
+    assert(job_count <= CLIENT_SIGNATURES_BATCH_CHUNK);
+
+    // 1) Verify the DAA signatures, one batch per run of jobs with the same group.
+    uint16_t run_begin = 0;
+    while (run_begin < job_count) {
+        struct xtt_daa_group_public_key_context *gpk_ctx = jobs[run_begin].daa_group_pub_key_ctx;
+
+        uint16_t run_end = run_begin;
+        while (run_end < job_count && jobs[run_end].daa_group_pub_key_ctx == gpk_ctx) {
+            daa_items[run_end] = (struct xtt_daa_verify_item){.signature=jobs[run_end].daa_signature.lrsw.data,
+                                                              .msg=jobs[run_end].daa_signature_hash.sha512.data,
+                                                              .msg_len=jobs[run_end].hash_length,
+                                                              .basename=gpk_ctx->basename,
+                                                              .basename_len=gpk_ctx->basename_length};
+            ++run_end;
+        }
+
+        (void)gpk_ctx->batch_verify_signatures(&daa_results[run_begin],
+                                               &daa_items[run_begin],
+                                               run_end - run_begin,
+                                               gpk_ctx);
+
+        run_begin = run_end;
+    }
+
+    // 2) Verify the longterm_key signatures, one batch per run of jobs with the same verifier.
+    run_begin = 0;
+    while (run_begin < job_count) {
+        int (*batch_verify)(int*, const struct xtt_ed25519_verify_item*, uint16_t)
+            = jobs[run_begin].batch_verify_client_longterm_signatures;
+
+        uint16_t run_end = run_begin;
+        while (run_end < job_count && jobs[run_end].batch_verify_client_longterm_signatures == batch_verify) {
+            longterm_items[run_end] = (struct xtt_ed25519_verify_item){.signature=jobs[run_end].longterm_signature.ed25519.data,
+                                                                       .msg=jobs[run_end].longterm_signature_hash.sha512.data,
+                                                                       .msg_len=jobs[run_end].hash_length,
+                                                                       .pub_key=&jobs[run_end].longterm_key.ed25519};
+            ++run_end;
+        }
+
+        STATS_CLOCK(verify_start);
+        (void)batch_verify(&longterm_results[run_begin],
+                           &longterm_items[run_begin],
+                           run_end - run_begin);
+        STATS_RECORD_BATCH(XTT_STATS_PHASE_LONGTERM_VERIFY, stats_now_ns() - verify_start, run_end - run_begin);
+
+        run_begin = run_end;
+    }
+
+    // 3) A job passes only if both of its signatures did.
+    for (uint16_t i = 0; i < job_count; ++i) {
+        if (0 != daa_results[i] || 0 != longterm_results[i])
+            jobs[i].verdict = XTT_ERROR_BAD_SIGNATURE;
+        else
+            jobs[i].verdict = XTT_ERROR_SUCCESS;
+    }
+}
+
 xtt_error_code
 verify_server_signature(const unsigned char *signature,
                         const xtt_client_id* intended_server_client_id,
@@ -219,6 +424,8 @@ verify_server_signature(const unsigned char *signature,
                         const unsigned char *server_initandattest_encryptedpart_uptosignature,
                         struct xtt_client_handshake_context *handshake_ctx)
 {
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
     xtt_error_code rc;
 
     // 1) Check that the certificate is for the correct server ClientID.
@@ -252,17 +459,17 @@ verify_server_signature(const unsigned char *signature,
         return rc;
 
     // 5) Check that the server signature verifies using the server cert.
-    rc = generate_server_sig_hash(handshake_ctx->base.hash_out_buffer,
+    rc = generate_server_sig_hash(scratch->hash_out_buffer,
                                   client_init,
                                   server_initandattest_unencrypted_part,
                                   server_initandattest_encryptedpart_uptosignature,
                                   &handshake_ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
-    rc = handshake_ctx->verify_server_signature(signature,
-                                                handshake_ctx->base.hash_out_buffer,
-                                                handshake_ctx->base.hash_length,
-                                                xtt_server_certificate_access_pubkey(xtt_encrypted_serverinitandattest_access_certificate(server_initandattest_encryptedpart_uptosignature,
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->verify_server_signature(signature,
+                                                            scratch->hash_out_buffer,
+                                                            HANDSHAKE_SUITE(&handshake_ctx->base)->hash_length,
+                                                            xtt_server_certificate_access_pubkey(xtt_encrypted_serverinitandattest_access_certificate(server_initandattest_encryptedpart_uptosignature,
                                                                                                             handshake_ctx->base.version)));
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
@@ -277,57 +484,44 @@ generate_server_sig_hash(unsigned char *hash_out,
                          const unsigned char *server_initandattest_encryptedpart_uptosignature,
                          struct xtt_handshake_context *handshake_ctx)
 {
+    struct handshake_transcript transcript;
+
     uint16_t client_init_length = xtt_clientinit_length(handshake_ctx->version, handshake_ctx->suite_spec);
     uint16_t server_initandattest_up_to_signature_length = xtt_serverinitandattest_uptosignature_length(handshake_ctx->version,
                                                                                                        handshake_ctx->suite_spec);
 
-    // 1) Create inner hash: hash_ext(ClientInit || ServerInitAndAttest-up-to-signature)
-    uint16_t inner_hash_input_length = client_init_length + server_initandattest_up_to_signature_length;
-    assert(sizeof(handshake_ctx->hash_buffer) >= sizeof(inner_hash_input_length) + inner_hash_input_length);
-
-    unsigned char *hash_input = handshake_ctx->hash_buffer;
-
-    // 1i) Copy in the inner hash length to the hash input buffer.
-    short_to_bigendian(inner_hash_input_length, hash_input);
-    hash_input += sizeof(inner_hash_input_length);
-
-    // 1ii) Copy in the ClientInit to the hash input buffer.
-    memcpy(hash_input, client_init, client_init_length);
-    hash_input += client_init_length;
-
-    // 1iii) Copy in the ServerInitAndAttest unencrypted part to the hash input buffer.
-    memcpy(hash_input,
-           server_initandattest_unencrypted_part,
-           xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->version,
-                                                          handshake_ctx->suite_spec));
-    hash_input += xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->version,
-                                                                 handshake_ctx->suite_spec);
-                                                                                            
-    // 1iv) Copy in the ServerInitAndAttest encrypted-part-up-to-signature to the hash input buffer.
-    memcpy(hash_input,
-           server_initandattest_encryptedpart_uptosignature,
-           xtt_serverinitandattest_encrypted_part_uptosignature_length(handshake_ctx->version,
-                                                                      handshake_ctx->suite_spec));
-    hash_input += xtt_serverinitandattest_encrypted_part_uptosignature_length(handshake_ctx->version,
-                                                                             handshake_ctx->suite_spec);
-
-    // 1v) Hash the hash input buffer to get the inner hash.
-    uint16_t inner_hash_length;
-    int hash_ret = handshake_ctx->hash(hash_out,
-                                            &inner_hash_length,
-                                            handshake_ctx->hash_buffer,
-                                            inner_hash_input_length + sizeof(inner_hash_input_length));
-    if (0 != hash_ret)
-        return XTT_ERROR_CRYPTO;
+    // ServerSigHash = hash_ext(ClientInit || ServerInitAndAttest-up-to-signature)
+    transcript_start(&transcript,
+                     client_init_length + server_initandattest_up_to_signature_length,
+                     handshake_ctx);
 
-    return XTT_ERROR_SUCCESS;
+    // 1) The ClientInit.
+    transcript_absorb(&transcript, client_init, client_init_length);
+
+    // 2) The ServerInitAndAttest unencrypted part.
+    transcript_absorb(&transcript,
+                      server_initandattest_unencrypted_part,
+                      xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->version,
+                                                                     handshake_ctx->suite_spec));
+
+    // 3) The ServerInitAndAttest encrypted-part-up-to-signature.
+    transcript_absorb(&transcript,
+                      server_initandattest_encryptedpart_uptosignature,
+                      xtt_serverinitandattest_encrypted_part_uptosignature_length(handshake_ctx->version,
+                                                                                 handshake_ctx->suite_spec));
+
+    return transcript_finish(hash_out, &transcript);
 }
 
 xtt_error_code
 is_expiry_passed(const xtt_certificate_expiry *expiry)
 {
+    // gmtime_r, since clients may be checking certificates on several threads at once.
     time_t now_timet = time(NULL);
-    struct tm *now = gmtime(&now_timet);
+    struct tm now_tm;
+    struct tm *now = gmtime_r(&now_timet, &now_tm);
+    if (NULL == now)
+        return XTT_ERROR_BAD_EXPIRY;
 
     int year, month, day;
     if (3 != sscanf(expiry->data, "%4d%2d%2d", &year, &month, &day))
@@ -359,66 +553,100 @@ generate_client_sig_hash(unsigned char *hash_out,
                          int is_daa,
                          struct xtt_handshake_context *handshake_ctx)
 {
+    struct handshake_transcript transcript;
+
     // ClientSigHash = hash_ext(inner-hash || server_cookie || certificate || signature_s || Identity_ClientAttest-up-to-sig)
     //      inner-hash = 'inner-hash' from HandshakeKeyHash (saved during HandshakeKeyHash generation)
+    //
+    // As deployed, only the first byte of the server_cookie is included,
+    // and the whole is cut off at the length below (which falls within the ClientAttest's unencrypted part).
+    // That's kept as-is, so signatures stay compatible.
 
-    uint16_t outer_hash_input_length = handshake_ctx->hash_length
+    uint16_t outer_hash_input_length = HANDSHAKE_SUITE(handshake_ctx)->hash_length
                                             + sizeof(*server_cookie)
                                             + xtt_identityclientattest_uptofirstsignature_length(handshake_ctx->version,
                                                                                                  handshake_ctx->suite_spec);
     if (is_daa)
-        outer_hash_input_length += handshake_ctx->longterm_key_signature_length;
-    assert(sizeof(handshake_ctx->hash_buffer) >= sizeof(outer_hash_input_length) + outer_hash_input_length);
-
-    unsigned char *hash_input = handshake_ctx->hash_buffer;
-
-    // 1) Copy in the outer hash length to the hash input buffer.
-    short_to_bigendian(outer_hash_input_length, hash_input);
-    hash_input += sizeof(outer_hash_input_length);
-
-    // 2) Copy the inner hash to the hash input buffer.
-    memcpy(hash_input, handshake_ctx->inner_hash, handshake_ctx->hash_length);
-    hash_input += handshake_ctx->hash_length;
-
-    // 3) Copy the server_cookie to the hash input buffer.
-    memcpy(hash_input, server_cookie, sizeof(xtt_server_cookie));
-    hash_input += sizeof(*server_cookie);
-
-    // 4) Copy the certificate to the hash input buffer.
-    memcpy(hash_input,
-           certificate,
-           xtt_server_certificate_length(handshake_ctx->suite_spec));
-    hash_input += xtt_server_certificate_length(handshake_ctx->suite_spec);
-
-    // 5) Copy the server_signature to the hash input buffer.
-    memcpy(hash_input, server_signature, handshake_ctx->longterm_key_signature_length);
-    hash_input += handshake_ctx->longterm_key_signature_length;
-
-    // 6) Copy ClientAttest-up-to-signature into the hash input buffer.
-    // 6i) Copy the 'unencrypted part'
-    memcpy(hash_input,
-           identityclientattest_unencrypted_part,
-           xtt_identityclientattest_unencrypted_part_length(handshake_ctx->version));
-    hash_input += xtt_identityclientattest_unencrypted_part_length(handshake_ctx->version);
-    // 6ii) Copy the encrypted-part-up-to-signature
-    //      (If a DAA signature, copy the longterm_signature, too)
+        outer_hash_input_length += HANDSHAKE_SUITE(handshake_ctx)->longterm_key_signature_length;
+
+    transcript_start(&transcript, outer_hash_input_length, handshake_ctx);
+
+    // 1) The inner hash.
+    transcript_absorb(&transcript, handshake_ctx->inner_hash, HANDSHAKE_SUITE(handshake_ctx)->hash_length);
+
+    // 2) The server_cookie (see above).
+    transcript_absorb(&transcript, server_cookie, sizeof(*server_cookie));
+
+    // 3) The certificate.
+    transcript_absorb(&transcript,
+                      (const unsigned char*)certificate,
+                      xtt_server_certificate_length(handshake_ctx->suite_spec));
+
+    // 4) The server_signature.
+    transcript_absorb(&transcript, server_signature, HANDSHAKE_SUITE(handshake_ctx)->longterm_key_signature_length);
+
+    // 5) ClientAttest-up-to-signature.
+    // 5i) The 'unencrypted part'
+    transcript_absorb(&transcript,
+                      identityclientattest_unencrypted_part,
+                      xtt_identityclientattest_unencrypted_part_length(handshake_ctx->version));
+    // 5ii) The encrypted-part-up-to-signature
+    //      (If a DAA signature, the longterm_signature, too)
     uint16_t encrypted_part_to_signature_length = xtt_identityclientattest_encrypted_part_uptofirstsignature_length(handshake_ctx->version,
                                                                                                                     handshake_ctx->suite_spec);
     if (is_daa)
-        encrypted_part_to_signature_length += handshake_ctx->longterm_key_signature_length;
-    memcpy(hash_input,
-           identityclientattest_encryptedpart_uptosignature,
-           encrypted_part_to_signature_length);
-    hash_input += encrypted_part_to_signature_length;
-
-    // 7) Hash the hash input buffer to get the ClientSigHash.
-    uint16_t outer_hash_length;
-    int hash_rc = handshake_ctx->hash(hash_out,
-                                           &outer_hash_length,
-                                           handshake_ctx->hash_buffer,
-                                           outer_hash_input_length + sizeof(outer_hash_input_length));
-    if (0 != hash_rc)
-        return XTT_ERROR_CRYPTO;
+        encrypted_part_to_signature_length += HANDSHAKE_SUITE(handshake_ctx)->longterm_key_signature_length;
+    transcript_absorb(&transcript,
+                      identityclientattest_encryptedpart_uptosignature,
+                      encrypted_part_to_signature_length);
 
-    return XTT_ERROR_SUCCESS;
+    return transcript_finish(hash_out, &transcript);
+}
+
+static
+xtt_error_code
+generate_session_client_sig_hash(unsigned char *hash_out,
+                                 const unsigned char *server_cookie,
+                                 const struct xtt_server_certificate_raw_type *certificate,
+                                 const unsigned char *server_signature,
+                                 const unsigned char *sessionclientattest_unencrypted_part,
+                                 const unsigned char *sessionclientattest_encryptedpart_uptosignature,
+                                 struct xtt_handshake_context *handshake_ctx)
+{
+    struct handshake_transcript transcript;
+
+    // SessionClientSigHash = hash_ext(inner-hash || server_cookie || certificate || signature_s || Session_ClientAttest-up-to-sig)
+    //      inner-hash = 'inner-hash' from HandshakeKeyHash (saved during HandshakeKeyHash generation)
+
+    uint16_t unencrypted_part_length = xtt_sessionclientattest_unencrypted_part_length(handshake_ctx->version);
+    uint16_t encrypted_part_to_signature_length = xtt_sessionclientattest_encrypted_part_uptosignature_length(handshake_ctx->version,
+                                                                                                              handshake_ctx->suite_spec);
+    uint16_t outer_hash_input_length = HANDSHAKE_SUITE(handshake_ctx)->hash_length
+                                            + sizeof(xtt_server_cookie)
+                                            + xtt_server_certificate_length(handshake_ctx->suite_spec)
+                                            + HANDSHAKE_SUITE(handshake_ctx)->longterm_key_signature_length
+                                            + unencrypted_part_length
+                                            + encrypted_part_to_signature_length;
+
+    transcript_start(&transcript, outer_hash_input_length, handshake_ctx);
+
+    // 1) The inner hash.
+    transcript_absorb(&transcript, handshake_ctx->inner_hash, HANDSHAKE_SUITE(handshake_ctx)->hash_length);
+
+    // 2) The server_cookie.
+    transcript_absorb(&transcript, server_cookie, sizeof(xtt_server_cookie));
+
+    // 3) The certificate.
+    transcript_absorb(&transcript,
+                      (const unsigned char*)certificate,
+                      xtt_server_certificate_length(handshake_ctx->suite_spec));
+
+    // 4) The server_signature.
+    transcript_absorb(&transcript, server_signature, HANDSHAKE_SUITE(handshake_ctx)->longterm_key_signature_length);
+
+    // 5) Session_ClientAttest-up-to-signature.
+    transcript_absorb(&transcript, sessionclientattest_unencrypted_part, unencrypted_part_length);
+    transcript_absorb(&transcript, sessionclientattest_encryptedpart_uptosignature, encrypted_part_to_signature_length);
+
+    return transcript_finish(hash_out, &transcript);
 }
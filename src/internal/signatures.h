@@ -56,16 +56,6 @@ generate_daa_signature(unsigned char *signature_out,
                        struct xtt_handshake_context *handshake_ctx,
                        struct xtt_daa_context *daa_ctx);
 
-xtt_error_code
-verify_daa_signature(unsigned char *signature,
-                     const unsigned char *server_cookie,
-                     const unsigned char *server_signature,
-                     const unsigned char *identityclientattest_unencrypted_part,
-                     const unsigned char *identityclientattest_encryptedpart_uptosignature,
-                     struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
-                     struct xtt_server_certificate_context *server_certificate_ctx,
-                     struct xtt_handshake_context *handshake_ctx);
-
 xtt_error_code
 generate_client_longterm_signature(unsigned char *signature_out,
                                    const unsigned char *server_cookie,
@@ -75,14 +65,58 @@ generate_client_longterm_signature(unsigned char *signature_out,
                                    const unsigned char *identityclientattest_encryptedpart_uptosignature,
                                    struct xtt_client_handshake_context *handshake_ctx);
 
+/*
+ * The longterm_key signature in a Session_ClientAttest.
+ *
+ * Signs hash_ext(inner-hash || server_cookie || certificate || signature_s || Session_ClientAttest-up-to-sig).
+ */
+xtt_error_code
+generate_session_client_longterm_signature(unsigned char *signature_out,
+                                           const unsigned char *server_cookie,
+                                           const struct xtt_server_certificate_raw_type *certificate,
+                                           const unsigned char *server_signature,
+                                           const unsigned char *sessionclientattest_unencrypted_part,
+                                           const unsigned char *sessionclientattest_encryptedpart_uptosignature,
+                                           struct xtt_client_handshake_context *handshake_ctx);
+
+xtt_error_code
+verify_session_client_longterm_signature(const unsigned char *signature,
+                                         const unsigned char *client_longterm_key,
+                                         const unsigned char *server_cookie,
+                                         const unsigned char *server_signature,
+                                         const unsigned char *sessionclientattest_unencrypted_part,
+                                         const unsigned char *sessionclientattest_encryptedpart_uptosignature,
+                                         const struct xtt_server_certificate_context *server_certificate_ctx,
+                                         struct xtt_server_handshake_context *handshake_ctx);
+
+/*
+ * Hash the inputs to both of the client's signatures in an IdentityClientAttest,
+ * and copy out the signatures and claimed longterm_key,
+ * so they can be verified without the handshake_context.
+ */
+xtt_error_code
+prepare_client_signatures_verification(struct xtt_identity_verification_job *job_out,
+                                       const unsigned char *server_cookie,
+                                       const unsigned char *server_signature,
+                                       const unsigned char *identityclientattest_unencrypted_part,
+                                       const unsigned char *identityclientattest_encryptedpart_uptosignature,
+                                       struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
+                                       struct xtt_server_certificate_context *server_certificate_ctx,
+                                       struct xtt_server_handshake_context *handshake_ctx);
+
+xtt_error_code
+verify_client_signatures(struct xtt_identity_verification_job *job);
+
+/*
+ * Verify the signatures of many jobs, setting each job's verdict.
+ *
+ * DAA signatures are batched per group public key context,
+ * and longterm_key signatures per verification function,
+ * over runs of consecutive jobs that share them.
+ */
 xtt_error_code
-verify_client_longterm_signature(unsigned char *signature,
-                                 const unsigned char *server_cookie,
-                                 const unsigned char *server_signature,
-                                 const unsigned char *identityclientattest_unencrypted_part,
-                                 const unsigned char *identityclientattest_encryptedpart_uptosignature,
-                                 struct xtt_server_certificate_context *server_certificate_ctx,
-                                 struct xtt_server_handshake_context *handshake_ctx);
+verify_client_signatures_batch(struct xtt_identity_verification_job *jobs,
+                               uint16_t job_count);
 
 #ifdef __cplusplus
 }
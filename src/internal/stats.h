@@ -0,0 +1,63 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_INTERNAL_STATS_H
+#define XTT_INTERNAL_STATS_H
+#pragma once
+
+#include <xtt/stats.h>
+#include <xtt/error_codes.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t
+stats_now_ns(void);
+
+void
+stats_record_phase(xtt_stats_phase phase,
+                   uint64_t ns,
+                   uint32_t samples);
+
+void
+stats_count_error(xtt_error_code rc);
+
+/*
+ * Without XTT_ENABLE_STATS these expand to nothing,
+ * and their arguments are never evaluated.
+ */
+#ifdef XTT_ENABLE_STATS
+#define STATS_CLOCK(var) uint64_t var = stats_now_ns()
+#define STATS_RECORD(phase, ns) stats_record_phase((phase), (ns), 1)
+#define STATS_RECORD_BATCH(phase, ns, samples) stats_record_phase((phase), (ns), (samples))
+#define STATS_COUNT_ERROR(rc) do { if (XTT_ERROR_SUCCESS != (rc)) stats_count_error(rc); } while (0)
+#else
+#define STATS_CLOCK(var) do {} while (0)
+#define STATS_RECORD(phase, ns) do {} while (0)
+#define STATS_RECORD_BATCH(phase, ns, samples) do {} while (0)
+#define STATS_COUNT_ERROR(rc) do {} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
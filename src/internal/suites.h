@@ -0,0 +1,127 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_SUITES_INTERNAL_H
+#define XTT_SUITES_INTERNAL_H
+#pragma once
+
+#include <xtt/context.h>
+#include <xtt/crypto_types.h>
+#include <xtt/crypto_wrapper.h>
+
+#include "crypto_providers.h"
+#include "crypto_utils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A suite's incremental hash and PRF primitives:
+ * the built-in provider's own, when the build has only that provider and one suite (see crypto_providers.h),
+ * or else the crypto wrapper's, which call through the current provider.
+ */
+#ifdef XTT_DIRECT_PROVIDER
+#define XTT_SUITE_PRIMITIVE(name) XTT_DIRECT_PRIMITIVE(name)
+#else
+#define XTT_SUITE_PRIMITIVE(name) xtt_crypto_##name
+#endif
+
+/*
+ * The handshake suite table for an x25519/lrsw/ed25519 suite,
+ * given its AEAD (`chacha` or `aes256`) and hash (`sha512` or `blake2b`).
+ */
+#define XTT_SUITE_TABLE(aead_name, hash_name) {                                     \
+    .is_available = xtt_crypto_aead_##aead_name##_is_available,                     \
+    .copy_dh_pubkey = copy_dh_pubkey_x25519,                                        \
+    .do_diffie_hellman = do_diffie_hellman_x25519,                                  \
+    .prf = xtt_crypto_prf_##hash_name,                                              \
+    .prf_init = XTT_SUITE_PRIMITIVE(prf_##hash_name##_init),                                  \
+    .prf_update = XTT_SUITE_PRIMITIVE(prf_##hash_name##_update),                              \
+    .prf_final = XTT_SUITE_PRIMITIVE(prf_##hash_name##_final),                                \
+    .prf_copy = XTT_SUITE_PRIMITIVE(prf_copy),                                                \
+    .prf_release = XTT_SUITE_PRIMITIVE(prf_release),                                          \
+    .encrypt = encrypt_##aead_name,                                                 \
+    .decrypt = decrypt_##aead_name,                                                 \
+    .hash = xtt_crypto_hash_##hash_name,                                            \
+    .hash_init = XTT_SUITE_PRIMITIVE(hash_##hash_name##_init),                                \
+    .hash_update = XTT_SUITE_PRIMITIVE(hash_##hash_name##_update),                            \
+    .hash_final = XTT_SUITE_PRIMITIVE(hash_##hash_name##_final),                              \
+    .hash_release = XTT_SUITE_PRIMITIVE(hash_release),                                        \
+                                                                                    \
+    .read_longterm_key = read_longterm_key_ed25519,                                 \
+    .verify_client_longterm_signature = verify_server_signature_ed25519,            \
+    .batch_verify_client_longterm_signatures = batch_verify_server_signatures_ed25519, \
+                                                                                    \
+    .verify_server_signature = verify_server_signature_ed25519,                     \
+    .copy_longterm_key = copy_longterm_key_ed25519,                                 \
+    .compare_longterm_keys = compare_longterm_keys_ed25519,                         \
+    .longterm_sign = longterm_sign_ed25519,                                         \
+                                                                                    \
+    .longterm_key_length = sizeof(xtt_ed25519_pub_key),                             \
+    .longterm_key_signature_length = sizeof(xtt_ed25519_signature),                 \
+    .shared_secret_length = sizeof(xtt_x25519_shared_secret),                       \
+    .hash_length = sizeof(xtt_##hash_name),                                         \
+    .mac_length = sizeof(xtt_##aead_name##_mac),                                    \
+    .key_length = sizeof(xtt_##aead_name##_key),                                    \
+    .iv_length = sizeof(xtt_##aead_name##_nonce),                                   \
+}
+
+#define XTT_SUITE_TABLE_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512 XTT_SUITE_TABLE(chacha, sha512)
+#define XTT_SUITE_TABLE_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B XTT_SUITE_TABLE(chacha, blake2b)
+#define XTT_SUITE_TABLE_X25519_LRSW_ED25519_AES256GCM_SHA512 XTT_SUITE_TABLE(aes256, sha512)
+#define XTT_SUITE_TABLE_X25519_LRSW_ED25519_AES256GCM_BLAKE2B XTT_SUITE_TABLE(aes256, blake2b)
+
+/*
+ * Building with XTT_FIXED_SUITE defined to a suite's name (without the `XTT_` prefix)
+ * builds the library for only that suite.
+ *
+ * Each file then has its own copy of that suite's table,
+ * so calls through it become direct calls and its lengths become constants.
+ * If only one provider is built as well, the table's hash and PRF entries are that provider's functions,
+ * so transcripts and key derivation skip the provider dispatch too.
+ * Anything with a `suite` member (a handshake context, transcript, or PRF) can be passed to HANDSHAKE_SUITE.
+ */
+#ifdef XTT_FIXED_SUITE
+
+#define XTT_SUITE_PASTE_(a, b) a##b
+#define XTT_SUITE_PASTE(a, b) XTT_SUITE_PASTE_(a, b)
+
+#define XTT_FIXED_SUITE_SPEC XTT_SUITE_PASTE(XTT_, XTT_FIXED_SUITE)
+
+static const struct xtt_handshake_suite xtt_fixed_suite = XTT_SUITE_PASTE(XTT_SUITE_TABLE_, XTT_FIXED_SUITE);
+
+#define HANDSHAKE_SUITE(has_suite) ((void)(has_suite), &xtt_fixed_suite)
+
+// Lengths are those of the fixed suite whatever suite_spec is given.
+// Any other suite_spec is refused when a context is initialized, before such a length can matter.
+#define SUITE_SPEC(suite_spec) ((void)(suite_spec), XTT_FIXED_SUITE_SPEC)
+
+#else
+
+#define HANDSHAKE_SUITE(has_suite) ((has_suite)->suite)
+
+#define SUITE_SPEC(suite_spec) (suite_spec)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#ifndef XTT_INTERNAL_TRACE_H
+#define XTT_INTERNAL_TRACE_H
+#pragma once
+
+/*
+ * USDT (static tracepoint) probes, under the provider "xtt".
+ *
+ * Each public function in messages.c has a <name>_entry and a <name>_return probe
+ * (named without the xtt_ prefix). Unless listed otherwise, their arguments are:
+ *
+ *      <name>_entry:   suite_spec, length of the message being parsed (or 0)
+ *      <name>_return:  xtt_error_code, suite_spec, length of the message built (or 0)
+ *
+ * The suite_spec is 0 where it isn't known yet (i.e. before a server has parsed the ClientInit).
+ *
+ *      verify_identity_client_attest_entry:    (none)
+ *      verify_identity_client_attest_return:   verdict
+ *      verify_identity_client_attests_entry:   job_count
+ *      verify_identity_client_attests_return:  xtt_error_code, job_count
+ *
+ * Each suite callback doing public-key or AEAD crypto has its own pair too;
+ * their return probes end with the callback's result (0 on success):
+ *
+ *      do_diffie_hellman_entry/_return:        suite_spec / suite_spec, rc
+ *      encrypt_entry/_return:                  suite_spec, plaintext length / suite_spec, ciphertext length, rc
+ *      decrypt_entry/_return:                  suite_spec, ciphertext length / suite_spec, plaintext length, rc
+ *      seal_record_entry/_return:              suite_spec, length / suite_spec, rc
+ *      open_record_entry/_return:              suite_spec, length / suite_spec, rc
+ *      server_sign_entry/_return:              message length / rc
+ *      longterm_sign_entry/_return:            suite_spec, message length / suite_spec, rc
+ *      daa_sign_entry/_return:                 message length / rc
+ *      ed25519_verify_entry/_return:           message length / rc
+ *      ed25519_batch_verify_entry/_return:     item count / item count, rc
+ *      root_verify_entry/_return:              (none) / rc
+ *      daa_verify_entry/_return:               message length / rc
+ *      daa_batch_verify_entry/_return:         item count / item count, rc
+ *
+ * Without XTT_ENABLE_USDT these expand to nothing, and their arguments are never evaluated.
+ * With it, an inactive probe is a single nop.
+ */
+#ifdef XTT_ENABLE_USDT
+#include <sys/sdt.h>
+#define TRACE0(name) DTRACE_PROBE(xtt, name)
+#define TRACE1(name, a1) DTRACE_PROBE1(xtt, name, a1)
+#define TRACE2(name, a1, a2) DTRACE_PROBE2(xtt, name, a1, a2)
+#define TRACE3(name, a1, a2, a3) DTRACE_PROBE3(xtt, name, a1, a2, a3)
+#else
+#define TRACE0(name) do {} while (0)
+#define TRACE1(name, a1) do {} while (0)
+#define TRACE2(name, a1, a2) do {} while (0)
+#define TRACE3(name, a1, a2, a3) do {} while (0)
+#endif
+
+#endif
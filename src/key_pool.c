@@ -0,0 +1,345 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <xtt/key_pool.h>
+#include <xtt/crypto_wrapper.h>
+
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <assert.h>
+
+#define POOL_MASK ((uint64_t)XTT_X25519_KEY_POOL_CAPACITY - 1)
+
+// Compile-time check that the capacity is a power of two.
+typedef char xtt_x25519_key_pool_capacity_is_power_of_two[(XTT_X25519_KEY_POOL_CAPACITY & (XTT_X25519_KEY_POOL_CAPACITY - 1)) == 0 ? 1 : -1];
+
+// How long the refill thread sleeps if nobody wakes it.
+#define REFILL_POLL_MS 50
+
+static int enqueue(struct xtt_x25519_key_pool *pool,
+                   const xtt_x25519_pub_key *pub,
+                   const xtt_x25519_priv_key *priv);
+
+static int dequeue(struct xtt_x25519_key_pool *pool,
+                   xtt_x25519_pub_key *pub_out,
+                   xtt_x25519_priv_key *priv_out);
+
+static uint32_t available(const struct xtt_x25519_key_pool *pool);
+
+static int fill(struct xtt_x25519_key_pool *pool);
+
+static void clear_slots(struct xtt_x25519_key_pool *pool);
+
+static void* refill_main(void *arg);
+
+static uint64_t now_ms(void);
+
+static void lock_reuse(struct xtt_x25519_key_pool *pool);
+
+static void unlock_reuse(struct xtt_x25519_key_pool *pool);
+
+xtt_error_code
+xtt_initialize_x25519_key_pool(struct xtt_x25519_key_pool *pool,
+                               const struct xtt_x25519_key_pool_config *config)
+{
+    if (NULL != config) {
+        if (XTT_X25519_KEY_POOL_CAPACITY < config->low_water_mark)
+            return XTT_ERROR_BAD_INIT;
+        pool->config = *config;
+    } else {
+        memset(&pool->config, 0, sizeof(pool->config));
+    }
+    if (0 == pool->config.low_water_mark)
+        pool->config.low_water_mark = XTT_X25519_KEY_POOL_CAPACITY / 2;
+
+    // 1) Initialize the ring.
+    for (uint64_t i = 0; i < XTT_X25519_KEY_POOL_CAPACITY; ++i)
+        pool->slots[i].sequence = i;
+    pool->enqueue_pos = 0;
+    pool->dequeue_pos = 0;
+
+    pool->hits = 0;
+    pool->misses = 0;
+    pool->reuses = 0;
+    pool->generated = 0;
+
+    pool->reuse_lock = 0;
+    pool->reuse_uses = 0;
+    pool->reuse_expiry_ms = 0;
+
+    // 2) Fill it up, so the first handshakes don't miss.
+    if (0 != fill(pool))
+        return XTT_ERROR_CRYPTO;
+
+    // 3) Start the refill thread.
+    pthread_mutex_init(&pool->refill_lock, NULL);
+    pthread_cond_init(&pool->refill_cond, NULL);
+    pool->running = 1;
+    if (0 != pthread_create(&pool->refill_thread, NULL, refill_main, pool)) {
+        pthread_cond_destroy(&pool->refill_cond);
+        pthread_mutex_destroy(&pool->refill_lock);
+        clear_slots(pool);
+        return XTT_ERROR_BAD_INIT;
+    }
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+xtt_x25519_key_pool_acquire(struct xtt_x25519_key_pool *pool,
+                            xtt_x25519_pub_key *pub_out,
+                            xtt_x25519_priv_key *priv_out)
+{
+    int reuse_enabled = pool->config.reuse_max_uses > 1;
+
+    // 1) If allowed, hand out the current key pair again.
+    if (reuse_enabled) {
+        int reused = 0;
+
+        lock_reuse(pool);
+        if (0 < pool->reuse_uses
+                && pool->reuse_uses < pool->config.reuse_max_uses
+                && now_ms() < pool->reuse_expiry_ms) {
+            *pub_out = pool->reuse_pub;
+            *priv_out = pool->reuse_priv;
+            ++pool->reuse_uses;
+            reused = 1;
+        }
+        unlock_reuse(pool);
+
+        if (reused) {
+            __atomic_add_fetch(&pool->reuses, 1, __ATOMIC_RELAXED);
+            return XTT_ERROR_SUCCESS;
+        }
+    }
+
+    // 2) Take a fresh key pair from the pool, or generate one if it's empty.
+    if (0 == dequeue(pool, pub_out, priv_out)) {
+        __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_add_fetch(&pool->misses, 1, __ATOMIC_RELAXED);
+        if (0 != xtt_crypto_create_x25519_key_pair(pub_out, priv_out))
+            return XTT_ERROR_CRYPTO;
+    }
+
+    // 3) Nudge the refill thread, if we're running low.
+    // (If this wake-up is missed, the refill thread polls anyway).
+    if (available(pool) < pool->config.low_water_mark)
+        pthread_cond_signal(&pool->refill_cond);
+
+    // 4) Start a new reuse window with this key pair.
+    if (reuse_enabled) {
+        lock_reuse(pool);
+        pool->reuse_pub = *pub_out;
+        pool->reuse_priv = *priv_out;
+        pool->reuse_uses = 1;
+        pool->reuse_expiry_ms = now_ms() + pool->config.reuse_max_age_ms;
+        unlock_reuse(pool);
+    }
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void
+xtt_x25519_key_pool_get_stats(struct xtt_x25519_key_pool_stats *stats_out,
+                              const struct xtt_x25519_key_pool *pool)
+{
+    stats_out->hits = __atomic_load_n(&pool->hits, __ATOMIC_RELAXED);
+    stats_out->misses = __atomic_load_n(&pool->misses, __ATOMIC_RELAXED);
+    stats_out->reuses = __atomic_load_n(&pool->reuses, __ATOMIC_RELAXED);
+    stats_out->generated = __atomic_load_n(&pool->generated, __ATOMIC_RELAXED);
+    stats_out->available = available(pool);
+}
+
+void
+xtt_x25519_key_pool_shutdown(struct xtt_x25519_key_pool *pool)
+{
+    pthread_mutex_lock(&pool->refill_lock);
+    pool->running = 0;
+    pthread_cond_signal(&pool->refill_cond);
+    pthread_mutex_unlock(&pool->refill_lock);
+
+    pthread_join(pool->refill_thread, NULL);
+
+    pthread_cond_destroy(&pool->refill_cond);
+    pthread_mutex_destroy(&pool->refill_lock);
+
+    clear_slots(pool);
+    xtt_crypto_secure_clear(pool->reuse_priv.data, sizeof(xtt_x25519_priv_key));
+    pool->reuse_uses = 0;
+}
+
+/*
+ * The ring is a bounded multi-producer/multi-consumer queue (after D. Vyukov):
+ * each slot's sequence number says whether it's ready to be written (== position)
+ * or read (== position + 1), so producers and consumers only ever contend on their own position.
+ */
+int
+enqueue(struct xtt_x25519_key_pool *pool,
+        const xtt_x25519_pub_key *pub,
+        const xtt_x25519_priv_key *priv)
+{
+    struct xtt_x25519_key_pool_slot *slot;
+    uint64_t pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &pool->slots[pos & POOL_MASK];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (0 == diff) {
+            if (__atomic_compare_exchange_n(&pool->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;  // full
+        } else {
+            pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->pub = *pub;
+    slot->priv = *priv;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+int
+dequeue(struct xtt_x25519_key_pool *pool,
+        xtt_x25519_pub_key *pub_out,
+        xtt_x25519_priv_key *priv_out)
+{
+    struct xtt_x25519_key_pool_slot *slot;
+    uint64_t pos = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &pool->slots[pos & POOL_MASK];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+        if (0 == diff) {
+            if (__atomic_compare_exchange_n(&pool->dequeue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;  // empty
+        } else {
+            pos = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    *pub_out = slot->pub;
+    *priv_out = slot->priv;
+    xtt_crypto_secure_clear(slot->priv.data, sizeof(xtt_x25519_priv_key));
+    __atomic_store_n(&slot->sequence, pos + POOL_MASK + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+uint32_t
+available(const struct xtt_x25519_key_pool *pool)
+{
+    uint64_t dequeued = __atomic_load_n(&pool->dequeue_pos, __ATOMIC_RELAXED);
+    uint64_t enqueued = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+
+    if (enqueued <= dequeued)
+        return 0;
+
+    return (uint32_t)(enqueued - dequeued);
+}
+
+int
+fill(struct xtt_x25519_key_pool *pool)
+{
+    xtt_x25519_pub_key pub;
+    xtt_x25519_priv_key priv;
+    int ret = 0;
+
+    while (available(pool) < XTT_X25519_KEY_POOL_CAPACITY) {
+        if (0 != xtt_crypto_create_x25519_key_pair(&pub, &priv)) {
+            ret = -1;
+            break;
+        }
+
+        if (0 != enqueue(pool, &pub, &priv))
+            break;
+
+        __atomic_add_fetch(&pool->generated, 1, __ATOMIC_RELAXED);
+    }
+
+    xtt_crypto_secure_clear(priv.data, sizeof(xtt_x25519_priv_key));
+
+    return ret;
+}
+
+void
+clear_slots(struct xtt_x25519_key_pool *pool)
+{
+    for (uint64_t i = 0; i < XTT_X25519_KEY_POOL_CAPACITY; ++i)
+        xtt_crypto_secure_clear(pool->slots[i].priv.data, sizeof(xtt_x25519_priv_key));
+}
+
+void*
+refill_main(void *arg)
+{
+    struct xtt_x25519_key_pool *pool = arg;
+
+    pthread_mutex_lock(&pool->refill_lock);
+    while (pool->running) {
+        pthread_mutex_unlock(&pool->refill_lock);
+        (void)fill(pool);
+        pthread_mutex_lock(&pool->refill_lock);
+
+        if (!pool->running)
+            break;
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)REFILL_POLL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        (void)pthread_cond_timedwait(&pool->refill_cond, &pool->refill_lock, &deadline);
+    }
+    pthread_mutex_unlock(&pool->refill_lock);
+
+    return NULL;
+}
+
+uint64_t
+now_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+void
+lock_reuse(struct xtt_x25519_key_pool *pool)
+{
+    while (__atomic_exchange_n(&pool->reuse_lock, 1, __ATOMIC_ACQUIRE))
+        ;
+}
+
+void
+unlock_reuse(struct xtt_x25519_key_pool *pool)
+{
+    __atomic_store_n(&pool->reuse_lock, 0, __ATOMIC_RELEASE);
+}
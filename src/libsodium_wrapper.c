@@ -16,18 +16,14 @@
  *
  *****************************************************************************/
 
-#include <xtt/crypto_wrapper.h>
+#include <xtt/crypto_provider.h>
 #include <xtt/crypto_types.h>
 #include <xtt/error_codes.h>
 
-#include <sodium.h>
+#include "internal/crypto_providers.h"
+#include "internal/ed25519_multiscalar.h"
 
-#if defined(__linux__)
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <linux/random.h>
-#endif
+#include <sodium.h>
 
 #include <assert.h>
 #include <string.h>
@@ -37,24 +33,9 @@
  * Thus, we just blindly return their return value, since we have no context to parse the codes.
  */
 
-int xtt_crypto_initialize_crypto()
+static int libsodium_initialize(void)
 {
-    int init_ret;
-#if defined(__linux__) && defined(RNDGETENTCNT)
-    int rand_fd;
-    int ent_count;
-
-    if ((rand_fd = open("/dev/random", O_RDONLY)) != -1) {
-        if (ioctl(rand_fd, RNDGETENTCNT, &ent_count) == 0 && ent_count < 160) {
-            return XTT_ERROR_INSUFFICIENT_ENTROPY;
-        }
-
-        (void) close(rand_fd);
-    }
-    /* TODO: Check entropy on other platforms */
-#endif
-
-    init_ret = sodium_init();
+    int init_ret = sodium_init();
     if (init_ret == -1) {
         return XTT_ERROR_BAD_INIT;
     } else {    /* Can also include init_ret == 1, indicating libsodium already initialized */
@@ -62,33 +43,31 @@ int xtt_crypto_initialize_crypto()
     }
 }
 
-int xtt_crypto_memcmp(const unsigned char *one, const unsigned char *two, uint16_t length)
+static int libsodium_memcmp_ct(const unsigned char *one, const unsigned char *two, uint16_t length)
 {
     return sodium_memcmp(one, two, length);
 }
 
-void xtt_crypto_secure_clear(unsigned char* memory, uint16_t memory_length)
+static void libsodium_secure_clear(unsigned char* memory, uint16_t memory_length)
 {
     sodium_memzero(memory, memory_length);
 }
 
-int xtt_crypto_get_random(unsigned char* buffer, uint16_t buffer_length)
+static int libsodium_get_random(unsigned char* buffer, uint16_t buffer_length)
 {
     randombytes_buf(buffer, buffer_length);
     
     return 0;
 }
 
-int xtt_crypto_create_x25519_key_pair(xtt_x25519_pub_key *pub, xtt_x25519_priv_key *priv)
+static int libsodium_x25519_public_key(xtt_x25519_pub_key *pub, const xtt_x25519_priv_key *priv)
 {
-    randombytes_buf(priv->data, sizeof(xtt_x25519_priv_key));
-
     return crypto_scalarmult_base(pub->data, priv->data);
 }
 
-int xtt_crypto_do_x25519_diffie_hellman(unsigned char* shared_secret,
-                                        const xtt_x25519_priv_key* my_sk,
-                                        const xtt_x25519_pub_key* other_pk)
+static int libsodium_do_x25519_diffie_hellman(unsigned char* shared_secret,
+                                              const xtt_x25519_priv_key* my_sk,
+                                              const xtt_x25519_pub_key* other_pk)
 {
     int rc = crypto_scalarmult(shared_secret,
                                my_sk->data,
@@ -99,66 +78,99 @@ int xtt_crypto_do_x25519_diffie_hellman(unsigned char* shared_secret,
     return rc;
 }
 
-int xtt_crypto_hash_sha512(unsigned char* out,
-                           uint16_t* out_length,
-                           const unsigned char* in,
-                           uint16_t in_len)
+typedef char sha512_state_fits[sizeof(crypto_hash_sha512_state) <= sizeof(xtt_hash_state) ? 1 : -1];
+typedef char blake2b_state_fits[sizeof(crypto_generichash_blake2b_state) <= sizeof(xtt_hash_state) ? 1 : -1];
+
+XTT_PROVIDER_PRIMITIVE int libsodium_hash_sha512_init(xtt_hash_state* state)
+{
+    return crypto_hash_sha512_init((crypto_hash_sha512_state*)state);
+}
+
+XTT_PROVIDER_PRIMITIVE int libsodium_hash_sha512_update(xtt_hash_state* state,
+                                                        const unsigned char* in,
+                                                        uint16_t in_len)
 {
-    crypto_hash_sha512_state h;
+    return crypto_hash_sha512_update((crypto_hash_sha512_state*)state, in, in_len);
+}
 
+XTT_PROVIDER_PRIMITIVE int libsodium_hash_sha512_final(unsigned char* out,
+                                                       uint16_t* out_length,
+                                                       xtt_hash_state* state)
+{
     *out_length = sizeof(xtt_sha512);
 
-    if (0 != crypto_hash_sha512_init(&h))
-        return -1;
-    if (0 != crypto_hash_sha512_update(&h, in, in_len))
-        return -1;
-    if (0 != crypto_hash_sha512_final(&h, out))
-        return -1;
+    return crypto_hash_sha512_final((crypto_hash_sha512_state*)state, out);
+}
 
-    return 0;
+XTT_PROVIDER_PRIMITIVE int libsodium_hash_blake2b_init(xtt_hash_state* state)
+{
+    return crypto_generichash_blake2b_init((crypto_generichash_blake2b_state*)state,
+                                           NULL,
+                                           0,
+                                           sizeof(xtt_blake2b));
 }
 
-int xtt_crypto_hash_blake2b(unsigned char* out,
-                            uint16_t* out_length,
-                            const unsigned char* in,
-                            uint16_t in_len)
+XTT_PROVIDER_PRIMITIVE int libsodium_hash_blake2b_update(xtt_hash_state* state,
+                                                         const unsigned char* in,
+                                                         uint16_t in_len)
 {
-    crypto_generichash_blake2b_state h;
+    return crypto_generichash_blake2b_update((crypto_generichash_blake2b_state*)state, in, in_len);
+}
 
+XTT_PROVIDER_PRIMITIVE int libsodium_hash_blake2b_final(unsigned char* out,
+                                                        uint16_t* out_length,
+                                                        xtt_hash_state* state)
+{
     *out_length = sizeof(xtt_blake2b);
 
-    if (0 != crypto_generichash_blake2b_init(&h,
-                                             NULL,
-                                             0,
-                                             sizeof(xtt_blake2b)))
-        return -1;
-    if (0 != crypto_generichash_blake2b_update(&h, in, in_len))
-        return -1;
-    if (0 != crypto_generichash_blake2b_final(&h,
-                                              out,
-                                              sizeof(xtt_blake2b)))
-        return -1;
+    return crypto_generichash_blake2b_final((crypto_generichash_blake2b_state*)state,
+                                            out,
+                                            sizeof(xtt_blake2b));
+}
+
+// libsodium's states are plain memory, so copying one is just that.
+static int libsodium_hash_copy(xtt_hash_state* dst, const xtt_hash_state* src)
+{
+    *dst = *src;
 
     return 0;
 }
 
-int xtt_crypto_prf_sha512(unsigned char* out,
-                          uint16_t out_len,
-                          const unsigned char* in,
-                          uint16_t in_len,
-                          const unsigned char* key,
-                          uint16_t key_len)
+XTT_PROVIDER_PRIMITIVE void libsodium_hash_release(xtt_hash_state* state)
 {
-    crypto_auth_hmacsha512_state h;
-    unsigned char buffer[crypto_hash_sha512_BYTES];
+    sodium_memzero(state, sizeof(xtt_hash_state));
+}
 
+typedef char hmacsha512_state_fits[sizeof(crypto_auth_hmacsha512_state) <= sizeof(xtt_prf_state) ? 1 : -1];
+typedef char keyed_blake2b_state_fits[sizeof(crypto_generichash_blake2b_state) <= sizeof(xtt_prf_state) ? 1 : -1];
+
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_sha512_init(xtt_prf_state* state,
+                                                     uint16_t out_len,
+                                                     const unsigned char* key,
+                                                     uint16_t key_len)
+{
     if (out_len > crypto_hash_sha512_BYTES)
         return -1;
-    if (0 != crypto_auth_hmacsha512_init(&h, key, key_len))
-        return -1;
-    if (0 != crypto_auth_hmacsha512_update(&h, in, in_len))
+
+    return crypto_auth_hmacsha512_init((crypto_auth_hmacsha512_state*)state, key, key_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_sha512_update(xtt_prf_state* state,
+                                                       const unsigned char* in,
+                                                       uint16_t in_len)
+{
+    return crypto_auth_hmacsha512_update((crypto_auth_hmacsha512_state*)state, in, in_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_sha512_final(unsigned char* out,
+                                                      uint16_t out_len,
+                                                      xtt_prf_state* state)
+{
+    unsigned char buffer[crypto_hash_sha512_BYTES];
+
+    if (out_len > crypto_hash_sha512_BYTES)
         return -1;
-    if (0 != crypto_auth_hmacsha512_final(&h, buffer))
+    if (0 != crypto_auth_hmacsha512_final((crypto_auth_hmacsha512_state*)state, buffer))
         return -1;
 
     memcpy(out, buffer, out_len);
@@ -166,42 +178,59 @@ int xtt_crypto_prf_sha512(unsigned char* out,
     return 0;
 }
 
-int xtt_crypto_prf_blake2b(unsigned char* out,
-                           uint16_t out_len,
-                           const unsigned char* in,
-                           uint16_t in_len,
-                           const unsigned char* key,
-                           uint16_t key_len)
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_blake2b_init(xtt_prf_state* state,
+                                                      uint16_t out_len,
+                                                      const unsigned char* key,
+                                                      uint16_t key_len)
 {
-    crypto_generichash_blake2b_state h;
-
     if (out_len > crypto_generichash_blake2b_BYTES_MAX)
         return -1;
-    if (0 != crypto_generichash_blake2b_init(&h,
-                                             key,
-                                             key_len,
-                                             out_len))
-        return -1;
-    if (0 != crypto_generichash_blake2b_update(&h, in, in_len))
-        return -1;
-    if (0 != crypto_generichash_blake2b_final(&h,
-                                              out,
-                                              out_len))
-        return -1;
+
+    return crypto_generichash_blake2b_init((crypto_generichash_blake2b_state*)state,
+                                           key,
+                                           key_len,
+                                           out_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_blake2b_update(xtt_prf_state* state,
+                                                        const unsigned char* in,
+                                                        uint16_t in_len)
+{
+    return crypto_generichash_blake2b_update((crypto_generichash_blake2b_state*)state, in, in_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_blake2b_final(unsigned char* out,
+                                                       uint16_t out_len,
+                                                       xtt_prf_state* state)
+{
+    return crypto_generichash_blake2b_final((crypto_generichash_blake2b_state*)state,
+                                            out,
+                                            out_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int libsodium_prf_copy(xtt_prf_state* dst, const xtt_prf_state* src)
+{
+    *dst = *src;
 
     return 0;
 }
 
-int xtt_crypto_create_ed25519_key_pair(xtt_ed25519_pub_key *pub_key,
-                                       xtt_ed25519_priv_key *priv_key)
+XTT_PROVIDER_PRIMITIVE void libsodium_prf_release(xtt_prf_state* state)
+{
+    sodium_memzero(state, sizeof(xtt_prf_state));
+}
+
+static int libsodium_ed25519_key_pair_from_seed(xtt_ed25519_pub_key *pub_key,
+                                                 xtt_ed25519_priv_key *priv_key,
+                                                 const unsigned char seed[32])
 {
-    return crypto_sign_ed25519_keypair(pub_key->data, priv_key->data);
+    return crypto_sign_ed25519_seed_keypair(pub_key->data, priv_key->data, seed);
 }
 
-int xtt_crypto_sign_ed25519(unsigned char* signature_out,
-                            const unsigned char* msg,
-                            uint16_t msg_len,
-                            const xtt_ed25519_priv_key* priv_key)
+static int libsodium_sign_ed25519(unsigned char* signature_out,
+                                  const unsigned char* msg,
+                                  uint16_t msg_len,
+                                  const xtt_ed25519_priv_key* priv_key)
 {
     unsigned long long sig_len_ignore;
 
@@ -219,10 +248,10 @@ int xtt_crypto_sign_ed25519(unsigned char* signature_out,
     return sig_ret;
 }
 
-int xtt_crypto_verify_ed25519(const unsigned char* signature,
-                              const unsigned char* msg,
-                              uint16_t msg_len,
-                              const xtt_ed25519_pub_key* pub_key)
+static int libsodium_verify_ed25519(const unsigned char* signature,
+                                    const unsigned char* msg,
+                                    uint16_t msg_len,
+                                    const xtt_ed25519_pub_key* pub_key)
 {
     return crypto_sign_ed25519_verify_detached(signature,
                                                msg,
@@ -230,115 +259,318 @@ int xtt_crypto_verify_ed25519(const unsigned char* signature,
                                                pub_key->data);
 }
 
+// Two points (R and the public key) per signature.
+#define ED25519_BATCH_CHUNK (ED25519_MULTISCALAR_MAX_POINTS / 2)
 
-int xtt_crypto_aead_chacha_encrypt(unsigned char* ciphertext,
-                                   uint16_t* ciphertext_len,
-                                   const unsigned char* message,
-                                   uint16_t msg_len,
-                                   const unsigned char* addl_data,
-                                   uint16_t addl_len,
-                                   const xtt_chacha_nonce* nonce,
-                                   const xtt_chacha_key* key)
-{
-    unsigned long long ciphertext_len_long;
-    int ret = crypto_aead_chacha20poly1305_ietf_encrypt(ciphertext,
-                                                        &ciphertext_len_long,
-                                                        message,
-                                                        msg_len,
-                                                        addl_data,
-                                                        addl_len,
-                                                        NULL,
-                                                        nonce->data,
-                                                        key->data);
-
-    if (ciphertext_len_long <= UINT32_MAX) {
-        *ciphertext_len = ciphertext_len_long;
-        return ret;
-    } else {
-        return XTT_ERROR_UINT32_OVERFLOW;
+static int verify_ed25519_chunk(const struct xtt_ed25519_verify_item *items,
+                                uint16_t item_count);
+
+static void verify_ed25519_range(int *results_out,
+                                 const struct xtt_ed25519_verify_item *items,
+                                 uint16_t item_count);
+
+static int libsodium_batch_verify_ed25519(int *results_out,
+                                          const struct xtt_ed25519_verify_item *items,
+                                          uint16_t item_count)
+{
+    int ret = 0;
+
+    for (uint16_t begin = 0; begin < item_count; begin += ED25519_BATCH_CHUNK) {
+        uint16_t chunk_size = item_count - begin;
+        if (chunk_size > ED25519_BATCH_CHUNK)
+            chunk_size = ED25519_BATCH_CHUNK;
+
+        verify_ed25519_range(&results_out[begin], &items[begin], chunk_size);
+
+        for (uint16_t i = begin; i < begin + chunk_size; ++i) {
+            if (0 != results_out[i])
+                ret = -1;
+        }
     }
+
+    return ret;
 }
 
-int xtt_crypto_aead_chacha_decrypt(unsigned char* decrypted,
-                                   uint16_t* decrypted_len,
-                                   const unsigned char* ciphertext,
-                                   uint16_t ciphertext_len,
-                                   const unsigned char* addl_data,
-                                   uint16_t addl_len,
-                                   const xtt_chacha_nonce* nonce,
-                                   const xtt_chacha_key* key)
-{
-    unsigned long long decrypted_len_long;
-    int ret = crypto_aead_chacha20poly1305_ietf_decrypt(decrypted,
-                                                        &decrypted_len_long,
-                                                        NULL,
-                                                        ciphertext,
-                                                        ciphertext_len,
-                                                        addl_data,
-                                                        addl_len,
-                                                        nonce->data,
-                                                        key->data);
-
-    if (decrypted_len_long <= UINT32_MAX) {
-        *decrypted_len = decrypted_len_long;
-        return ret;
-    } else {
-        return XTT_ERROR_UINT32_OVERFLOW;
+/*
+ * Check the signatures together; if that fails, check each half the same way,
+ * so a few bad signatures in a chunk are found without verifying all the good ones alone.
+ */
+static void verify_ed25519_range(int *results_out,
+                                 const struct xtt_ed25519_verify_item *items,
+                                 uint16_t item_count)
+{
+    if (1 == item_count) {
+        results_out[0] = libsodium_verify_ed25519(items[0].signature,
+                                                  items[0].msg,
+                                                  items[0].msg_len,
+                                                  items[0].pub_key);
+        return;
     }
-}
 
-int xtt_crypto_aead_aes256_encrypt(unsigned char* ciphertext,
-                                   uint16_t* ciphertext_len,
-                                   const unsigned char* message,
-                                   uint16_t msg_len,
-                                   const unsigned char* addl_data,
-                                   uint16_t addl_len,
-                                   const xtt_aes256_nonce* nonce,
-                                   const xtt_aes256_key* key)
-{
-    unsigned long long ciphertext_len_long;
-    int ret = crypto_aead_aes256gcm_encrypt(ciphertext,
-                                            &ciphertext_len_long,
-                                            message,
-                                            msg_len,
-                                            addl_data,
-                                            addl_len,
-                                            NULL,
-                                            nonce->data,
-                                            key->data);
-
-    if (ciphertext_len_long <= UINT32_MAX) {
-        *ciphertext_len = ciphertext_len_long;
-        return ret;
-    } else {
-        return XTT_ERROR_UINT32_OVERFLOW;
+    if (0 == verify_ed25519_chunk(items, item_count)) {
+        for (uint16_t i = 0; i < item_count; ++i)
+            results_out[i] = 0;
+        return;
     }
+
+    uint16_t half = item_count / 2;
+    verify_ed25519_range(results_out, items, half);
+    verify_ed25519_range(results_out + half, items + half, item_count - half);
 }
 
-int xtt_crypto_aead_aes256_decrypt(unsigned char* decrypted,
-                                   uint16_t* decrypted_len,
-                                   const unsigned char* ciphertext,
-                                   uint16_t ciphertext_len,
-                                   const unsigned char* addl_data,
-                                   uint16_t addl_len,
-                                   const xtt_aes256_nonce* nonce,
-                                   const xtt_aes256_key* key)
-{
-    unsigned long long decrypted_len_long;
-    int ret = crypto_aead_aes256gcm_decrypt(decrypted,
-                                            &decrypted_len_long,
-                                            NULL,
-                                            ciphertext,
-                                            ciphertext_len,
-                                            addl_data,
-                                            addl_len,
-                                            nonce->data,
-                                            key->data);
-
-    if (decrypted_len_long <= UINT32_MAX) {
-        *decrypted_len = decrypted_len_long;
-        return ret;
-    } else {
-        return XTT_ERROR_UINT32_OVERFLOW;
+static int verify_ed25519_chunk(const struct xtt_ed25519_verify_item *items,
+                                uint16_t item_count)
+{
+#ifdef XTT_HAVE_ED25519_MULTISCALAR
+    /*
+     * Each signature (R, s) on M under A satisfies  s*B = R + h*A,  with h = H(R || A || M).
+     * So, for random 128-bit z_i,
+     *      8 * ( -(sum z_i*s_i)*B + sum z_i*R_i + sum (z_i*h_i)*A_i )
+     * is the identity if all are valid, and almost surely isn't otherwise.
+     */
+    unsigned char scalars[ED25519_MULTISCALAR_MAX_POINTS][crypto_core_ed25519_SCALARBYTES];
+    unsigned char points[ED25519_MULTISCALAR_MAX_POINTS][crypto_core_ed25519_BYTES];
+    unsigned char base_scalar[crypto_core_ed25519_SCALARBYTES] = {0};
+
+    assert(item_count <= ED25519_BATCH_CHUNK);
+
+    for (uint16_t i = 0; i < item_count; ++i) {
+        const unsigned char *R = items[i].signature;
+        const unsigned char *s = items[i].signature + crypto_core_ed25519_BYTES;
+
+        if (!ed25519_scalar_is_canonical(s))
+            return -1;
+
+        // The check below is cofactored, but crypto_sign_verify_detached isn't:
+        // a torsion component in R or A would be multiplied away here and still fail there.
+        // So only points in the prime-order subgroup go in the batch,
+        // and anything else is left to the single verifier.
+        if (!crypto_core_ed25519_is_valid_point(R)
+                || !crypto_core_ed25519_is_valid_point(items[i].pub_key->data))
+            return -1;
+
+        // 1) h = H(R || A || M) mod l
+        crypto_hash_sha512_state hash_state;
+        unsigned char hash[crypto_hash_sha512_BYTES];
+        unsigned char h[crypto_core_ed25519_SCALARBYTES];
+        crypto_hash_sha512_init(&hash_state);
+        crypto_hash_sha512_update(&hash_state, R, crypto_core_ed25519_BYTES);
+        crypto_hash_sha512_update(&hash_state, items[i].pub_key->data, sizeof(xtt_ed25519_pub_key));
+        crypto_hash_sha512_update(&hash_state, items[i].msg, items[i].msg_len);
+        crypto_hash_sha512_final(&hash_state, hash);
+        crypto_core_ed25519_scalar_reduce(h, hash);
+
+        // 2) z, random and 128 bits
+        unsigned char z[crypto_core_ed25519_SCALARBYTES] = {0};
+        randombytes_buf(z, 16);
+
+        // 3) z*R, (z*h)*A, and accumulate z*s for the base point
+        memcpy(scalars[2 * i], z, sizeof(z));
+        memcpy(points[2 * i], R, crypto_core_ed25519_BYTES);
+
+        crypto_core_ed25519_scalar_mul(scalars[2 * i + 1], z, h);
+        memcpy(points[2 * i + 1], items[i].pub_key->data, sizeof(xtt_ed25519_pub_key));
+
+        unsigned char zs[crypto_core_ed25519_SCALARBYTES];
+        crypto_core_ed25519_scalar_mul(zs, z, s);
+        crypto_core_ed25519_scalar_add(base_scalar, base_scalar, zs);
     }
+
+    crypto_core_ed25519_scalar_negate(base_scalar, base_scalar);
+
+    return ed25519_multiscalar_is_small_order(base_scalar,
+                                              (const unsigned char (*)[32])scalars,
+                                              (const unsigned char (*)[32])points,
+                                              2 * item_count);
+#else
+    (void)items;
+    (void)item_count;
+
+    return -1;
+#endif
 }
+
+static int libsodium_aead_chacha_is_available(void)
+{
+    return 1;
+}
+
+static int libsodium_aead_aes256_is_available(void)
+{
+    return crypto_aead_aes256gcm_is_available();
+}
+
+static int libsodium_aead_chacha_encrypt_detached(unsigned char* ciphertext,
+                                                  unsigned char* mac_out,
+                                                  const unsigned char* message,
+                                                  uint16_t msg_len,
+                                                  const unsigned char* addl_data,
+                                                  uint16_t addl_len,
+                                                  const xtt_chacha_nonce* nonce,
+                                                  const xtt_chacha_key* key)
+{
+    return crypto_aead_chacha20poly1305_ietf_encrypt_detached(ciphertext,
+                                                              mac_out,
+                                                              NULL,
+                                                              message,
+                                                              msg_len,
+                                                              addl_data,
+                                                              addl_len,
+                                                              NULL,
+                                                              nonce->data,
+                                                              key->data);
+}
+
+static int libsodium_aead_chacha_decrypt_detached(unsigned char* decrypted,
+                                                  const unsigned char* ciphertext,
+                                                  uint16_t ciphertext_len,
+                                                  const unsigned char* mac,
+                                                  const unsigned char* addl_data,
+                                                  uint16_t addl_len,
+                                                  const xtt_chacha_nonce* nonce,
+                                                  const xtt_chacha_key* key)
+{
+    return crypto_aead_chacha20poly1305_ietf_decrypt_detached(decrypted,
+                                                              NULL,
+                                                              ciphertext,
+                                                              ciphertext_len,
+                                                              mac,
+                                                              addl_data,
+                                                              addl_len,
+                                                              nonce->data,
+                                                              key->data);
+}
+
+static int libsodium_aead_aes256_encrypt_detached(unsigned char* ciphertext,
+                                                  unsigned char* mac_out,
+                                                  const unsigned char* message,
+                                                  uint16_t msg_len,
+                                                  const unsigned char* addl_data,
+                                                  uint16_t addl_len,
+                                                  const xtt_aes256_nonce* nonce,
+                                                  const xtt_aes256_key* key)
+{
+    return crypto_aead_aes256gcm_encrypt_detached(ciphertext,
+                                                  mac_out,
+                                                  NULL,
+                                                  message,
+                                                  msg_len,
+                                                  addl_data,
+                                                  addl_len,
+                                                  NULL,
+                                                  nonce->data,
+                                                  key->data);
+}
+
+static int libsodium_aead_aes256_decrypt_detached(unsigned char* decrypted,
+                                                  const unsigned char* ciphertext,
+                                                  uint16_t ciphertext_len,
+                                                  const unsigned char* mac,
+                                                  const unsigned char* addl_data,
+                                                  uint16_t addl_len,
+                                                  const xtt_aes256_nonce* nonce,
+                                                  const xtt_aes256_key* key)
+{
+    return crypto_aead_aes256gcm_decrypt_detached(decrypted,
+                                                  NULL,
+                                                  ciphertext,
+                                                  ciphertext_len,
+                                                  mac,
+                                                  addl_data,
+                                                  addl_len,
+                                                  nonce->data,
+                                                  key->data);
+}
+
+typedef char aes256_key_schedule_fits[sizeof(crypto_aead_aes256gcm_state) <= sizeof(xtt_aes256_key_schedule) ? 1 : -1];
+
+static int libsodium_aead_aes256_expand_key(xtt_aes256_key_schedule* schedule_out,
+                                            const xtt_aes256_key* key)
+{
+    if (!crypto_aead_aes256gcm_is_available())
+        return -1;
+
+    return crypto_aead_aes256gcm_beforenm((crypto_aead_aes256gcm_state*)schedule_out, key->data);
+}
+
+static int libsodium_aead_aes256_encrypt_detached_expanded(unsigned char* ciphertext,
+                                                           unsigned char* mac_out,
+                                                           const unsigned char* message,
+                                                           uint16_t msg_len,
+                                                           const unsigned char* addl_data,
+                                                           uint16_t addl_len,
+                                                           const xtt_aes256_nonce* nonce,
+                                                           const xtt_aes256_key_schedule* schedule)
+{
+    unsigned long long mac_len_ignore;
+
+    return crypto_aead_aes256gcm_encrypt_detached_afternm(ciphertext,
+                                                          mac_out,
+                                                          &mac_len_ignore,
+                                                          message,
+                                                          msg_len,
+                                                          addl_data,
+                                                          addl_len,
+                                                          NULL,
+                                                          nonce->data,
+                                                          (const crypto_aead_aes256gcm_state*)schedule);
+}
+
+static int libsodium_aead_aes256_decrypt_detached_expanded(unsigned char* decrypted,
+                                                           const unsigned char* ciphertext,
+                                                           uint16_t ciphertext_len,
+                                                           const unsigned char* mac,
+                                                           const unsigned char* addl_data,
+                                                           uint16_t addl_len,
+                                                           const xtt_aes256_nonce* nonce,
+                                                           const xtt_aes256_key_schedule* schedule)
+{
+    return crypto_aead_aes256gcm_decrypt_detached_afternm(decrypted,
+                                                          NULL,
+                                                          ciphertext,
+                                                          ciphertext_len,
+                                                          mac,
+                                                          addl_data,
+                                                          addl_len,
+                                                          nonce->data,
+                                                          (const crypto_aead_aes256gcm_state*)schedule);
+}
+
+const struct xtt_crypto_provider xtt_crypto_provider_libsodium = {
+    .name = "libsodium",
+    .initialize = libsodium_initialize,
+    .memcmp_ct = libsodium_memcmp_ct,
+    .secure_clear = libsodium_secure_clear,
+    .get_random = libsodium_get_random,
+    .x25519_public_key = libsodium_x25519_public_key,
+    .do_x25519_diffie_hellman = libsodium_do_x25519_diffie_hellman,
+    .hash_sha512_init = libsodium_hash_sha512_init,
+    .hash_sha512_update = libsodium_hash_sha512_update,
+    .hash_sha512_final = libsodium_hash_sha512_final,
+    .hash_blake2b_init = libsodium_hash_blake2b_init,
+    .hash_blake2b_update = libsodium_hash_blake2b_update,
+    .hash_blake2b_final = libsodium_hash_blake2b_final,
+    .hash_copy = libsodium_hash_copy,
+    .hash_release = libsodium_hash_release,
+    .prf_sha512_init = libsodium_prf_sha512_init,
+    .prf_sha512_update = libsodium_prf_sha512_update,
+    .prf_sha512_final = libsodium_prf_sha512_final,
+    .prf_blake2b_init = libsodium_prf_blake2b_init,
+    .prf_blake2b_update = libsodium_prf_blake2b_update,
+    .prf_blake2b_final = libsodium_prf_blake2b_final,
+    .prf_copy = libsodium_prf_copy,
+    .prf_release = libsodium_prf_release,
+    .ed25519_key_pair_from_seed = libsodium_ed25519_key_pair_from_seed,
+    .sign_ed25519 = libsodium_sign_ed25519,
+    .verify_ed25519 = libsodium_verify_ed25519,
+    .batch_verify_ed25519 = libsodium_batch_verify_ed25519,
+    .aead_chacha_is_available = libsodium_aead_chacha_is_available,
+    .aead_aes256_is_available = libsodium_aead_aes256_is_available,
+    .aead_chacha_encrypt_detached = libsodium_aead_chacha_encrypt_detached,
+    .aead_chacha_decrypt_detached = libsodium_aead_chacha_decrypt_detached,
+    .aead_aes256_encrypt_detached = libsodium_aead_aes256_encrypt_detached,
+    .aead_aes256_decrypt_detached = libsodium_aead_aes256_decrypt_detached,
+    .aead_aes256_expand_key = libsodium_aead_aes256_expand_key,
+    .aead_aes256_encrypt_detached_expanded = libsodium_aead_aes256_encrypt_detached_expanded,
+    .aead_aes256_decrypt_detached_expanded = libsodium_aead_aes256_decrypt_detached_expanded,
+};
@@ -22,9 +22,14 @@
 
 #include "internal/message_utils.h"
 #include "internal/byte_utils.h"
+#include "internal/crypto_utils.h"
 #include "internal/server_cookie.h"
 #include "internal/signatures.h"
 #include "internal/key_derivation.h"
+#include "internal/server_handshake.h"
+#include "internal/suites.h"
+#include "internal/stats.h"
+#include "internal/trace.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -34,13 +39,47 @@
 static
 xtt_error_code
 parse_client_init(struct xtt_server_handshake_context *ctx_out,
-                  const unsigned char* client_init);
+                  const unsigned char* client_init,
+                  struct xtt_x25519_key_pool *key_pool);
 
 static
 xtt_error_code
 parse_server_initandattest(struct xtt_client_handshake_context *handshake_ctx,
                            const unsigned char* server_init_and_attest);
 
+static
+xtt_error_code
+restore_server_handshake_context(struct xtt_server_handshake_context* handshake_ctx_out,
+                                 const unsigned char* client_attest,
+                                 const struct xtt_server_certificate_context* certificate_ctx,
+                                 struct xtt_server_cookie_context* cookie_ctx);
+
+static
+xtt_error_code
+pre_parse_client_attest(xtt_client_id* client_id_out,
+                        xtt_daa_group_id* daa_group_id_out,
+                        const unsigned char* client_attest,
+                        struct xtt_server_cookie_context* cookie_ctx,
+                        struct xtt_server_handshake_context* handshake_ctx);
+
+static
+xtt_error_code
+parse_identity_server_finished(xtt_client_id* client_id,
+                               const unsigned char* identity_server_finished,
+                               struct xtt_client_handshake_context* handshake_ctx);
+
+static
+xtt_error_code
+parse_session_server_finished(const xtt_client_id* client_id,
+                              const unsigned char* session_server_finished,
+                              struct xtt_client_handshake_context* handshake_ctx);
+
+static
+uint16_t
+clientattest_total_length(xtt_msg_type msg_type,
+                          xtt_version version,
+                          xtt_suite_spec suite_spec);
+
 uint16_t
 xtt_get_message_length(const unsigned char* buffer)
 {
@@ -62,6 +101,8 @@ xtt_build_client_init(unsigned char* out_buffer,
                       uint16_t* out_length,
                       struct xtt_client_handshake_context* ctx)
 {
+    TRACE2(build_client_init_entry, ctx->base.suite_spec, 0);
+
     // 1) Set message type.
     *xtt_access_msg_type(out_buffer) = XTT_CLIENTINIT_MSG;
 
@@ -83,17 +124,19 @@ xtt_build_client_init(unsigned char* out_buffer,
     // 6) Set Diffie-Hellman key pair.
     // Key pair is assumed to have been generated previously
     // by a call to the init function for the handshake context.
-    ctx->base.copy_dh_pubkey(xtt_clientinit_access_ecdhe_key(out_buffer,
-                                                             ctx->base.version),
-                             NULL,
-                             &ctx->base);
+    HANDSHAKE_SUITE(&ctx->base)->copy_dh_pubkey(xtt_clientinit_access_ecdhe_key(out_buffer,
+                                                                    ctx->base.version),
+                                    NULL,
+                                    &ctx->base);
 
     // 7) Report ClientInit message length.
     *out_length = xtt_clientinit_length(ctx->base.version, ctx->base.suite_spec);
 
     // 8) Copy ClientInit message for later parsing of response.
-    assert(sizeof(ctx->base.client_init_buffer) >= *out_length);
-    memcpy(ctx->base.client_init_buffer, out_buffer, *out_length);
+    assert(sizeof(ctx->client_init_buffer) >= *out_length);
+    memcpy(ctx->client_init_buffer, out_buffer, *out_length);
+
+    TRACE3(build_client_init_return, XTT_ERROR_SUCCESS, ctx->base.suite_spec, *out_length);
 
     return XTT_ERROR_SUCCESS;
 }
@@ -106,13 +149,87 @@ xtt_build_server_init_and_attest(unsigned char* out_buffer,
                                  const struct xtt_server_certificate_context* certificate_ctx,
                                  struct xtt_server_cookie_context* cookie_ctx)
 {
+    TRACE2(build_server_init_and_attest_entry, 0, xtt_get_message_length(client_init));
+
+    xtt_error_code rc = xtt_build_server_init_and_attest_from_key_pool(out_buffer,
+                                                                       out_length,
+                                                                       ctx_out,
+                                                                       client_init,
+                                                                       certificate_ctx,
+                                                                       cookie_ctx,
+                                                                       NULL);
+    TRACE3(build_server_init_and_attest_return, rc, ctx_out->base.suite_spec, *out_length);
+
+    return rc;
+}
+
+xtt_error_code
+xtt_build_server_init_and_attest_from_key_pool(unsigned char* out_buffer,
+                                               uint16_t* out_length,
+                                               struct xtt_server_handshake_context* ctx_out,
+                                               const unsigned char* client_init,
+                                               const struct xtt_server_certificate_context* certificate_ctx,
+                                               struct xtt_server_cookie_context* cookie_ctx,
+                                               struct xtt_x25519_key_pool* key_pool)
+{
+    TRACE2(build_server_init_and_attest_from_key_pool_entry, 0, xtt_get_message_length(client_init));
+
     xtt_error_code rc;
 
-    // 1) Parse ClientInit and initialize our handshake_context using it.
-    rc = parse_client_init(ctx_out, client_init);
+    // 1) Parse ClientInit, and fill in the unencrypted part of the ServerInitAndAttest.
+    rc = build_serverinitandattest_unencrypted_part(out_buffer,
+                                                    ctx_out,
+                                                    client_init,
+                                                    cookie_ctx,
+                                                    key_pool);
     if (XTT_ERROR_SUCCESS != rc)
         goto finish;
 
+    // 2) Run Diffie-Hellman and get handshake AEAD keys.
+    rc = derive_serverinitandattest_keys(out_buffer,
+                                         client_init,
+                                         ctx_out);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    // 3) Sign, and AEAD encrypt the message.
+    rc = sign_and_encrypt_serverinitandattest(out_buffer,
+                                              out_length,
+                                              client_init,
+                                              certificate_ctx,
+                                              ctx_out);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+finish:
+    if (XTT_ERROR_SUCCESS == rc) {
+        TRACE3(build_server_init_and_attest_from_key_pool_return, XTT_ERROR_SUCCESS, ctx_out->base.suite_spec, *out_length);
+
+        return XTT_ERROR_SUCCESS;
+    } else {
+        STATS_COUNT_ERROR(rc);
+        (void)build_error_msg(out_buffer, out_length, ctx_out->base.version);
+
+        TRACE3(build_server_init_and_attest_from_key_pool_return, rc, ctx_out->base.suite_spec, *out_length);
+
+        return rc;
+    }
+}
+
+xtt_error_code
+build_serverinitandattest_unencrypted_part(unsigned char* out_buffer,
+                                           struct xtt_server_handshake_context* ctx_out,
+                                           const unsigned char* client_init,
+                                           struct xtt_server_cookie_context* cookie_ctx,
+                                           struct xtt_x25519_key_pool* key_pool)
+{
+    xtt_error_code rc;
+
+    // 1) Parse ClientInit and initialize our handshake_context using it.
+    rc = parse_client_init(ctx_out, client_init, key_pool);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
     // 2) Set message type.
     *xtt_access_msg_type(out_buffer) = XTT_SERVERINITANDATTEST_MSG;
 
@@ -128,87 +245,97 @@ xtt_build_server_init_and_attest(unsigned char* out_buffer,
                        xtt_serverinitandattest_access_suite_spec(out_buffer, ctx_out->base.version));
 
     // 6) Copy own Diffie-Hellman public key.
-    ctx_out->base.copy_dh_pubkey(xtt_serverinitandattest_access_ecdhe_key(out_buffer,
-                                                                          ctx_out->base.version),
-                                 NULL,
-                                 &ctx_out->base);
+    HANDSHAKE_SUITE(&ctx_out->base)->copy_dh_pubkey(xtt_serverinitandattest_access_ecdhe_key(out_buffer,
+                                                                                 ctx_out->base.version),
+                                        NULL,
+                                        &ctx_out->base);
 
     // 7) Generate ServerCookie
     rc = build_server_cookie(xtt_serverinitandattest_access_server_cookie(out_buffer,
                                                                           ctx_out->base.version,
                                                                           ctx_out->base.suite_spec),
+                             client_init,
                              &ctx_out->base,
                              cookie_ctx);
     if (XTT_ERROR_SUCCESS != rc)
-        goto finish;
+        return rc;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+derive_serverinitandattest_keys(const unsigned char* out_buffer,
+                                const unsigned char* client_init,
+                                struct xtt_server_handshake_context* ctx)
+{
+    return derive_handshake_keys(&ctx->base,
+                                 client_init,
+                                 out_buffer,
+                                 xtt_serverinitandattest_access_server_cookie(out_buffer,
+                                                                              ctx->base.version,
+                                                                              ctx->base.suite_spec),
+                                 xtt_clientinit_access_ecdhe_key(client_init,
+                                                                 ctx->base.version),
+                                 0);
+}
+
+xtt_error_code
+sign_and_encrypt_serverinitandattest(unsigned char* out_buffer,
+                                     uint16_t* out_length,
+                                     const unsigned char* client_init,
+                                     const struct xtt_server_certificate_context* certificate_ctx,
+                                     struct xtt_server_handshake_context* ctx)
+{
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&ctx->base);
+
+    xtt_error_code rc;
 
-    // 8) Copy own certificate.
-    memcpy(xtt_encrypted_serverinitandattest_access_certificate(ctx_out->base.buffer, 
-                                                                ctx_out->base.version),
+    // 1) Copy own certificate.
+    memcpy(xtt_encrypted_serverinitandattest_access_certificate(scratch->buffer,
+                                                                ctx->base.version),
            certificate_ctx->serialized_certificate,
-           xtt_server_certificate_length(ctx_out->base.suite_spec));
+           xtt_server_certificate_length(ctx->base.suite_spec));
 
-    // 9) Create signature.
-    rc = generate_server_signature(xtt_encrypted_serverinitandattest_access_signature(ctx_out->base.buffer,
-                                                                                      ctx_out->base.version,
-                                                                                      ctx_out->base.suite_spec),
+    // 2) Create signature.
+    rc = generate_server_signature(xtt_encrypted_serverinitandattest_access_signature(scratch->buffer,
+                                                                                      ctx->base.version,
+                                                                                      ctx->base.suite_spec),
                                    client_init,
                                    out_buffer,
-                                   ctx_out->base.buffer,
-                                   &ctx_out->base,
+                                   scratch->buffer,
+                                   &ctx->base,
                                    certificate_ctx);
     if (XTT_ERROR_SUCCESS != rc)
-        goto finish;
+        return rc;
 
-    // 9ii) Copy signature for later, too.
-    memcpy(ctx_out->base.server_signature_buffer,
-           xtt_encrypted_serverinitandattest_access_signature(ctx_out->base.buffer,
-                                                              ctx_out->base.version,
-                                                              ctx_out->base.suite_spec),
+    // 2ii) Copy signature for later, too.
+    memcpy(ctx->server_signature_buffer,
+           xtt_encrypted_serverinitandattest_access_signature(scratch->buffer,
+                                                              ctx->base.version,
+                                                              ctx->base.suite_spec),
            certificate_ctx->signature_length);
 
-    // 10) Run Diffie-Hellman and get handshake AEAD keys.
-    // TODO: Move this earlier, in case it fails?
-    rc = derive_handshake_keys(&ctx_out->base,
-                               client_init,
-                               out_buffer,
-                               xtt_serverinitandattest_access_server_cookie(out_buffer,
-                                                                            ctx_out->base.version,
-                                                                            ctx_out->base.suite_spec),
-                               xtt_clientinit_access_ecdhe_key(client_init,
-                                                               ctx_out->base.version),
-                               0);
-    if (XTT_ERROR_SUCCESS != rc)
-        goto finish;
-
-    // 11) AEAD encrypt the message
+    // 3) AEAD encrypt the message
     uint16_t encrypted_len;
-    rc = ctx_out->base.encrypt(out_buffer + xtt_serverinitandattest_unencrypted_part_length(ctx_out->base.version,
-                                                                                            ctx_out->base.suite_spec),
-                               &encrypted_len,
-                               ctx_out->base.buffer,
-                               xtt_serverinitandattest_encrypted_part_length(ctx_out->base.version,
-                                                                             ctx_out->base.suite_spec),
-                               out_buffer,
-                               xtt_serverinitandattest_unencrypted_part_length(ctx_out->base.version,
-                                                                               ctx_out->base.suite_spec),
-                               &ctx_out->base);
+    rc = HANDSHAKE_SUITE(&ctx->base)->encrypt(out_buffer + xtt_serverinitandattest_unencrypted_part_length(ctx->base.version,
+                                                                                               ctx->base.suite_spec),
+                                  &encrypted_len,
+                                  scratch->buffer,
+                                  xtt_serverinitandattest_encrypted_part_length(ctx->base.version,
+                                                                                ctx->base.suite_spec),
+                                  out_buffer,
+                                  xtt_serverinitandattest_unencrypted_part_length(ctx->base.version,
+                                                                                  ctx->base.suite_spec),
+                                  &ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
-        goto finish;
-
-finish:
-    if (XTT_ERROR_SUCCESS == rc) {
-        // 12) Report ServerInitAndAttest message length.
-        *out_length = xtt_serverinitandattest_unencrypted_part_length(ctx_out->base.version, ctx_out->base.suite_spec)
-                        + encrypted_len;
-        assert(xtt_serverinitandattest_total_length(ctx_out->base.version, ctx_out->base.suite_spec) == *out_length);
+        return rc;
 
-        return XTT_ERROR_SUCCESS;
-    } else {
-        (void)build_error_msg(out_buffer, out_length, ctx_out->base.version);
+    // 4) Report ServerInitAndAttest message length.
+    *out_length = xtt_serverinitandattest_unencrypted_part_length(ctx->base.version, ctx->base.suite_spec)
+                    + encrypted_len;
+    assert(xtt_serverinitandattest_total_length(ctx->base.version, ctx->base.suite_spec) == *out_length);
 
-        return rc;
-    }
+    return XTT_ERROR_SUCCESS;
 }
 
 xtt_error_code
@@ -216,6 +343,8 @@ xtt_preparse_serverinitandattest(xtt_certificate_root_id *claimed_root_out,
                                  const unsigned char* server_init_and_attest,
                                  struct xtt_client_handshake_context* handshake_ctx)
 {
+    TRACE2(preparse_serverinitandattest_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(server_init_and_attest));
+
     xtt_error_code rc;
 
     // 1) Parse ServerInitAndAttest,
@@ -228,14 +357,17 @@ xtt_preparse_serverinitandattest(xtt_certificate_root_id *claimed_root_out,
 finish:
     if (XTT_ERROR_SUCCESS == rc) {
         //  2) Get the root_id claimed in the server's certificate.
-        unsigned char *server_initandattest_decryptedpart = handshake_ctx->base.server_initandattest_buffer;
+        unsigned char *server_initandattest_decryptedpart = handshake_ctx->server_initandattest_buffer;
         memcpy(claimed_root_out->data,
                xtt_server_certificate_access_rootid(xtt_encrypted_serverinitandattest_access_certificate(server_initandattest_decryptedpart,
                                                                                                          handshake_ctx->base.version)),
                sizeof(xtt_certificate_root_id));
+        TRACE3(preparse_serverinitandattest_return, XTT_ERROR_SUCCESS, handshake_ctx->base.suite_spec, 0);
         return XTT_ERROR_SUCCESS;
     } else {
         *claimed_root_out = xtt_null_server_root_id;
+        STATS_COUNT_ERROR(rc);
+        TRACE3(preparse_serverinitandattest_return, rc, handshake_ctx->base.suite_spec, 0);
         return rc;
     }
 }
@@ -250,20 +382,27 @@ xtt_build_identity_client_attest(unsigned char* out_buffer,
                                  struct xtt_daa_context* daa_ctx,
                                  struct xtt_client_handshake_context* handshake_ctx)
 {
+    TRACE2(build_identity_client_attest_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(server_init_and_attest));
+
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
     xtt_error_code rc;
 
     // 1) Check server signature
-    rc = verify_server_signature(xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->base.server_initandattest_buffer,
+    rc = verify_server_signature(xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->server_initandattest_buffer,
                                                                                     handshake_ctx->base.version,
                                                                                     handshake_ctx->base.suite_spec),
                                  intended_server_client_id,
                                  root_server_certificate,
-                                 handshake_ctx->base.client_init_buffer,
+                                 handshake_ctx->client_init_buffer,
                                  server_init_and_attest,
-                                 handshake_ctx->base.server_initandattest_buffer,
+                                 handshake_ctx->server_initandattest_buffer,
                                  handshake_ctx);
-    if (XTT_ERROR_SUCCESS != rc)
+    if (XTT_ERROR_SUCCESS != rc) {
+        STATS_COUNT_ERROR(rc);
+        TRACE3(build_identity_client_attest_return, rc, handshake_ctx->base.suite_spec, 0);
         return rc;
+    }
 
     // 2) Set message type.
     *xtt_access_msg_type(out_buffer) = XTT_ID_CLIENTATTEST_MSG;
@@ -287,57 +426,57 @@ xtt_build_identity_client_attest(unsigned char* out_buffer,
            sizeof(xtt_server_cookie));
 
     // 7) Copy longterm public key in.
-    handshake_ctx->copy_longterm_key(xtt_encrypted_identityclientattest_access_longtermkey(handshake_ctx->base.buffer,
-                                                                                           handshake_ctx->base.version),
-                                     NULL,
-                                     handshake_ctx);
+    HANDSHAKE_SUITE(&handshake_ctx->base)->copy_longterm_key(xtt_encrypted_identityclientattest_access_longtermkey(scratch->buffer,
+                                                                                                       handshake_ctx->base.version),
+                                                 NULL,
+                                                 handshake_ctx);
 
     // 8) Create longterm_signature with longterm key.
-    rc = generate_client_longterm_signature(xtt_encrypted_identityclientattest_access_longtermsignature(handshake_ctx->base.buffer,
+    rc = generate_client_longterm_signature(xtt_encrypted_identityclientattest_access_longtermsignature(scratch->buffer,
                                                                                                         handshake_ctx->base.version,
                                                                                                         handshake_ctx->base.suite_spec),
                                 (unsigned char*)xtt_serverinitandattest_access_server_cookie(server_init_and_attest,
                                                                                              handshake_ctx->base.version,
                                                                                              handshake_ctx->base.suite_spec),
-                                xtt_encrypted_serverinitandattest_access_certificate(handshake_ctx->base.server_initandattest_buffer,
+                                xtt_encrypted_serverinitandattest_access_certificate(handshake_ctx->server_initandattest_buffer,
                                                                                      handshake_ctx->base.version),
-                                xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->base.server_initandattest_buffer,
+                                xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->server_initandattest_buffer,
                                                                                    handshake_ctx->base.version,
                                                                                    handshake_ctx->base.suite_spec),
                                 out_buffer,
-                                handshake_ctx->base.buffer,
+                                scratch->buffer,
                                 handshake_ctx);
     if (XTT_ERROR_SUCCESS != rc)
         goto finish;
 
     // 9) Copy GID.
-    memcpy(xtt_encrypted_identityclientattest_access_gid(handshake_ctx->base.buffer,
+    memcpy(xtt_encrypted_identityclientattest_access_gid(scratch->buffer,
                                                          handshake_ctx->base.version,
                                                          handshake_ctx->base.suite_spec),
            daa_ctx->gid.data,
            sizeof(xtt_daa_group_id));
 
     // 10) Copy my clientID.
-    memcpy(xtt_encrypted_identityclientattest_access_id(handshake_ctx->base.buffer,
+    memcpy(xtt_encrypted_identityclientattest_access_id(scratch->buffer,
                                                         handshake_ctx->base.version,
                                                         handshake_ctx->base.suite_spec),
            requested_client_id->data,
            sizeof(xtt_client_id));
 
     // 11) Create DAA signature.
-    rc = generate_daa_signature(xtt_encrypted_identityclientattest_access_daasignature(handshake_ctx->base.buffer,
+    rc = generate_daa_signature(xtt_encrypted_identityclientattest_access_daasignature(scratch->buffer,
                                                                                        handshake_ctx->base.version,
                                                                                        handshake_ctx->base.suite_spec),
                                 (unsigned char*)xtt_serverinitandattest_access_server_cookie(server_init_and_attest,
                                                                                              handshake_ctx->base.version,
                                                                                              handshake_ctx->base.suite_spec),
-                                xtt_encrypted_serverinitandattest_access_certificate(handshake_ctx->base.server_initandattest_buffer,
+                                xtt_encrypted_serverinitandattest_access_certificate(handshake_ctx->server_initandattest_buffer,
                                                                                      handshake_ctx->base.version),
-                                xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->base.server_initandattest_buffer,
+                                xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->server_initandattest_buffer,
                                                                                    handshake_ctx->base.version,
                                                                                    handshake_ctx->base.suite_spec),
                                 out_buffer,
-                                handshake_ctx->base.buffer,
+                                scratch->buffer,
                                 &handshake_ctx->base,
                                 daa_ctx);
     if (XTT_ERROR_SUCCESS != rc)
@@ -345,14 +484,14 @@ xtt_build_identity_client_attest(unsigned char* out_buffer,
 
     // 12) AEAD encrypt the message
     uint16_t encrypted_len;
-    rc = handshake_ctx->base.encrypt(out_buffer + xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
-                                     &encrypted_len,
-                                     handshake_ctx->base.buffer,
-                                     xtt_identityclientattest_encrypted_part_length(handshake_ctx->base.version,
-                                                                                    handshake_ctx->base.suite_spec),
-                                     out_buffer,
-                                     xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
-                                     &handshake_ctx->base);
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->encrypt(out_buffer + xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                            &encrypted_len,
+                                            scratch->buffer,
+                                            xtt_identityclientattest_encrypted_part_length(handshake_ctx->base.version,
+                                                                                           handshake_ctx->base.suite_spec),
+                                            out_buffer,
+                                            xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                            &handshake_ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
         goto finish;
 
@@ -363,26 +502,305 @@ finish:
                         + encrypted_len;
         assert(xtt_identityclientattest_total_length(handshake_ctx->base.version, handshake_ctx->base.suite_spec) == *out_length);
 
+        TRACE3(build_identity_client_attest_return, XTT_ERROR_SUCCESS, handshake_ctx->base.suite_spec, *out_length);
+
         return XTT_ERROR_SUCCESS;
     } else {
+        STATS_COUNT_ERROR(rc);
         (void)build_error_msg(out_buffer, out_length, handshake_ctx->base.version);
 
+        TRACE3(build_identity_client_attest_return, rc, handshake_ctx->base.suite_spec, *out_length);
+
         return rc;
     }
 }
 
+xtt_error_code
+xtt_build_session_client_attest(unsigned char* out_buffer,
+                                uint16_t* out_length,
+                                const unsigned char* server_init_and_attest,
+                                const struct xtt_server_root_certificate_context* root_server_certificate,
+                                const xtt_client_id* client_id,
+                                const xtt_client_id* intended_server_client_id,
+                                struct xtt_client_handshake_context* handshake_ctx)
+{
+    TRACE2(build_session_client_attest_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(server_init_and_attest));
+
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
+    xtt_error_code rc;
+
+    // 1) Check server signature
+    rc = verify_server_signature(xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->server_initandattest_buffer,
+                                                                                    handshake_ctx->base.version,
+                                                                                    handshake_ctx->base.suite_spec),
+                                 intended_server_client_id,
+                                 root_server_certificate,
+                                 handshake_ctx->client_init_buffer,
+                                 server_init_and_attest,
+                                 handshake_ctx->server_initandattest_buffer,
+                                 handshake_ctx);
+    if (XTT_ERROR_SUCCESS != rc) {
+        STATS_COUNT_ERROR(rc);
+        TRACE3(build_session_client_attest_return, rc, handshake_ctx->base.suite_spec, 0);
+        return rc;
+    }
+
+    // 2) Set message type.
+    *xtt_access_msg_type(out_buffer) = XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG;
+
+    // 3) Set length.
+    short_to_bigendian(xtt_sessionclientattest_total_length(handshake_ctx->base.version, handshake_ctx->base.suite_spec),
+                       xtt_access_length(out_buffer));
+
+    // 4) Set version.
+    *xtt_access_version(out_buffer) = handshake_ctx->base.version;
+
+    // 5) Set suite spec.
+    short_to_bigendian(handshake_ctx->base.suite_spec,
+                       xtt_identityclientattest_access_suite_spec(out_buffer, handshake_ctx->base.version));
+
+    // 6) Copy server cookie
+    memcpy(xtt_identityclientattest_access_servercookie(out_buffer, handshake_ctx->base.version),
+           xtt_serverinitandattest_access_server_cookie(server_init_and_attest,
+                                                        handshake_ctx->base.version,
+                                                        handshake_ctx->base.suite_spec),
+           sizeof(xtt_server_cookie));
+
+    // 7) Copy my ClientID.
+    memcpy(xtt_encrypted_sessionclientattest_access_id(scratch->buffer,
+                                                       handshake_ctx->base.version),
+           client_id->data,
+           sizeof(xtt_client_id));
+
+    // 8) Create longterm_signature with longterm key.
+    rc = generate_session_client_longterm_signature(xtt_encrypted_sessionclientattest_access_longtermsignature(scratch->buffer,
+                                                                                                               handshake_ctx->base.version,
+                                                                                                               handshake_ctx->base.suite_spec),
+                                                    (unsigned char*)xtt_serverinitandattest_access_server_cookie(server_init_and_attest,
+                                                                                                                 handshake_ctx->base.version,
+                                                                                                                 handshake_ctx->base.suite_spec),
+                                                    xtt_encrypted_serverinitandattest_access_certificate(handshake_ctx->server_initandattest_buffer,
+                                                                                                         handshake_ctx->base.version),
+                                                    xtt_encrypted_serverinitandattest_access_signature(handshake_ctx->server_initandattest_buffer,
+                                                                                                       handshake_ctx->base.version,
+                                                                                                       handshake_ctx->base.suite_spec),
+                                                    out_buffer,
+                                                    scratch->buffer,
+                                                    handshake_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    // 9) AEAD encrypt the message
+    uint16_t encrypted_len;
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->encrypt(out_buffer + xtt_sessionclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                            &encrypted_len,
+                                            scratch->buffer,
+                                            xtt_sessionclientattest_encrypted_part_length(handshake_ctx->base.version,
+                                                                                          handshake_ctx->base.suite_spec),
+                                            out_buffer,
+                                            xtt_sessionclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                            &handshake_ctx->base);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+finish:
+    if (XTT_ERROR_SUCCESS == rc) {
+        // 10) Report Session_ClientAttest message length.
+        *out_length = xtt_sessionclientattest_unencrypted_part_length(handshake_ctx->base.version)
+                        + encrypted_len;
+        assert(xtt_sessionclientattest_total_length(handshake_ctx->base.version, handshake_ctx->base.suite_spec) == *out_length);
+
+        TRACE3(build_session_client_attest_return, XTT_ERROR_SUCCESS, handshake_ctx->base.suite_spec, *out_length);
+
+        return XTT_ERROR_SUCCESS;
+    } else {
+        STATS_COUNT_ERROR(rc);
+        (void)build_error_msg(out_buffer, out_length, handshake_ctx->base.version);
+
+        TRACE3(build_session_client_attest_return, rc, handshake_ctx->base.suite_spec, *out_length);
+
+        return rc;
+    }
+}
+
+xtt_error_code
+xtt_restore_server_handshake_context(struct xtt_server_handshake_context* handshake_ctx_out,
+                                     const unsigned char* client_attest,
+                                     const struct xtt_server_certificate_context* certificate_ctx,
+                                     struct xtt_server_cookie_context* cookie_ctx)
+{
+    TRACE2(restore_server_handshake_context_entry, 0, xtt_get_message_length(client_attest));
+
+    xtt_error_code rc = restore_server_handshake_context(handshake_ctx_out,
+                                                         client_attest,
+                                                         certificate_ctx,
+                                                         cookie_ctx);
+    STATS_COUNT_ERROR(rc);
+    TRACE3(restore_server_handshake_context_return, rc, handshake_ctx_out->base.suite_spec, 0);
+
+    return rc;
+}
+
+xtt_error_code
+restore_server_handshake_context(struct xtt_server_handshake_context* handshake_ctx_out,
+                                 const unsigned char* client_attest,
+                                 const struct xtt_server_certificate_context* certificate_ctx,
+                                 struct xtt_server_cookie_context* cookie_ctx)
+{
+    // 1) Check message type.
+    xtt_msg_type msg_type = *xtt_access_msg_type(client_attest);
+    if (XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG == msg_type)
+        return XTT_ERROR_UNSUPPORTED_MESSAGE;
+    if (XTT_ID_CLIENTATTEST_MSG != msg_type && XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG != msg_type)
+        return XTT_ERROR_INCORRECT_TYPE;
+
+    // 2) Check the length of the ClientAttest message.
+    uint16_t clientattest_length;
+    bigendian_to_short(xtt_access_length(client_attest),
+                       &clientattest_length);
+    uint16_t minimum_length = sizeof(xtt_msg_type_raw)
+        + sizeof(xtt_length)
+        + sizeof(xtt_version_raw)
+        + sizeof(xtt_suite_spec_raw);
+    if (clientattest_length < minimum_length)
+        return XTT_ERROR_INCORRECT_LENGTH;
+    xtt_version_raw claimed_version = *xtt_access_version(client_attest);
+    xtt_suite_spec claimed_suite_spec;
+    xtt_suite_spec_raw claimed_suite_spec_raw;
+    bigendian_to_short(xtt_identityclientattest_access_suite_spec(client_attest,
+                                                                  claimed_version),
+                       &claimed_suite_spec_raw);
+    claimed_suite_spec = claimed_suite_spec_raw;
+    if (clientattest_length != clientattest_total_length(msg_type, claimed_version, claimed_suite_spec))
+        return XTT_ERROR_INCORRECT_LENGTH;
+
+    xtt_error_code rc;
+
+    // 3) Open the echoed server_cookie
+    //  (this also checks that it was built for this version and suite_spec).
+    const xtt_server_cookie *cookie = (const xtt_server_cookie*)xtt_identityclientattest_access_servercookie(client_attest,
+                                                                                                             claimed_version);
+    xtt_signing_nonce client_nonce;
+    xtt_x25519_pub_key client_ecdhe_key;
+    xtt_x25519_priv_key own_ecdhe_key;
+    rc = open_server_cookie(&client_nonce,
+                            &client_ecdhe_key,
+                            &own_ecdhe_key,
+                            cookie,
+                            claimed_version,
+                            claimed_suite_spec,
+                            cookie_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 4) Initialize our handshake_context, with the Diffie-Hellman key pair we used before.
+    rc = xtt_initialize_server_handshake_context(handshake_ctx_out,
+                                                 claimed_version,
+                                                 claimed_suite_spec);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    handshake_ctx_out->base.dh_priv_key.x25519 = own_ecdhe_key;
+    if (0 != xtt_crypto_x25519_public_key(&handshake_ctx_out->base.dh_pub_key.x25519,
+                                          &handshake_ctx_out->base.dh_priv_key.x25519)) {
+        rc = XTT_ERROR_CRYPTO;
+        goto finish;
+    }
+
+    // 5) Rebuild the client's ClientInit.
+    unsigned char client_init[sizeof(((struct xtt_client_handshake_context*)0)->client_init_buffer)];
+    assert(sizeof(client_init) >= xtt_clientinit_length(claimed_version, claimed_suite_spec));
+    *xtt_access_msg_type(client_init) = XTT_CLIENTINIT_MSG;
+    short_to_bigendian(xtt_clientinit_length(claimed_version, claimed_suite_spec),
+                       xtt_access_length(client_init));
+    *xtt_access_version(client_init) = claimed_version;
+    short_to_bigendian(claimed_suite_spec,
+                       xtt_clientinit_access_suite_spec(client_init, claimed_version));
+    memcpy(xtt_clientinit_access_nonce(client_init, claimed_version)->data,
+           client_nonce.data,
+           sizeof(xtt_signing_nonce));
+    memcpy(xtt_clientinit_access_ecdhe_key(client_init, claimed_version),
+           client_ecdhe_key.data,
+           sizeof(xtt_x25519_pub_key));
+
+    // 6) Rebuild the unencrypted part of our ServerInitAndAttest.
+    unsigned char server_initandattest[512];
+    assert(sizeof(server_initandattest) >= xtt_serverinitandattest_total_length(claimed_version, claimed_suite_spec));
+    *xtt_access_msg_type(server_initandattest) = XTT_SERVERINITANDATTEST_MSG;
+    short_to_bigendian(xtt_serverinitandattest_total_length(claimed_version, claimed_suite_spec),
+                       xtt_access_length(server_initandattest));
+    *xtt_access_version(server_initandattest) = claimed_version;
+    short_to_bigendian(claimed_suite_spec,
+                       xtt_serverinitandattest_access_suite_spec(server_initandattest, claimed_version));
+    HANDSHAKE_SUITE(&handshake_ctx_out->base)->copy_dh_pubkey(xtt_serverinitandattest_access_ecdhe_key(server_initandattest,
+                                                                                           claimed_version),
+                                                  NULL,
+                                                  &handshake_ctx_out->base);
+    memcpy(xtt_serverinitandattest_access_server_cookie(server_initandattest,
+                                                        claimed_version,
+                                                        claimed_suite_spec),
+           cookie,
+           sizeof(xtt_server_cookie));
+    handshake_ctx_out->base.server_cookie = *cookie;
+
+    // 7) Re-derive the handshake keys.
+    rc = derive_serverinitandattest_keys(server_initandattest,
+                                         client_init,
+                                         handshake_ctx_out);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    // 8) Re-sign and re-encrypt the ServerInitAndAttest.
+    //  Our signature is deterministic, so this recovers the one the client saw,
+    //  and leaves our sequence number where it was.
+    uint16_t server_initandattest_length;
+    rc = sign_and_encrypt_serverinitandattest(server_initandattest,
+                                              &server_initandattest_length,
+                                              client_init,
+                                              certificate_ctx,
+                                              handshake_ctx_out);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+finish:
+    xtt_crypto_secure_clear(own_ecdhe_key.data, sizeof(xtt_x25519_priv_key));
+
+    return rc;
+}
+
 xtt_error_code
 xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
                             xtt_daa_group_id* daa_group_id_out,
                             const unsigned char* client_attest,
                             struct xtt_server_cookie_context* cookie_ctx,
                             struct xtt_server_handshake_context* handshake_ctx)
+{
+    TRACE2(pre_parse_client_attest_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(client_attest));
+
+    xtt_error_code rc = pre_parse_client_attest(client_id_out,
+                                                daa_group_id_out,
+                                                client_attest,
+                                                cookie_ctx,
+                                                handshake_ctx);
+    STATS_COUNT_ERROR(rc);
+    TRACE3(pre_parse_client_attest_return, rc, handshake_ctx->base.suite_spec, 0);
+
+    return rc;
+}
+
+xtt_error_code
+pre_parse_client_attest(xtt_client_id* client_id_out,
+                        xtt_daa_group_id* daa_group_id_out,
+                        const unsigned char* client_attest,
+                        struct xtt_server_cookie_context* cookie_ctx,
+                        struct xtt_server_handshake_context* handshake_ctx)
 {
     // 1) Get message type.
     xtt_msg_type msg_type = *xtt_access_msg_type(client_attest);
-    if (XTT_ID_CLIENTATTEST_MSG != msg_type
-            && XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG != msg_type
-            && XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG != msg_type)
+    if (XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG == msg_type)
+        return XTT_ERROR_UNSUPPORTED_MESSAGE;
+    if (XTT_ID_CLIENTATTEST_MSG != msg_type && XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG != msg_type)
         return XTT_ERROR_INCORRECT_TYPE;
 
     // 2) Check the length of the ClientAttest message.
@@ -402,7 +820,7 @@ xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
                                                                   claimed_version),
                        &claimed_suite_spec_raw);
     claimed_suite_spec = claimed_suite_spec_raw;
-    if (clientattest_length != xtt_identityclientattest_total_length(claimed_version, claimed_suite_spec))
+    if (clientattest_length != clientattest_total_length(msg_type, claimed_version, claimed_suite_spec))
         return XTT_ERROR_INCORRECT_LENGTH;
 
     // 3) Check client's version and suite_spec
@@ -414,12 +832,12 @@ xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
 
     xtt_error_code rc;
 
-    // 4) Check that client's echoed server_cookie is the one we sent.
-    // TODO: We probably don't need to do this, the signature will validate the cookie (it's just a nonce)
-    rc = validate_server_cookie((xtt_server_cookie*)xtt_identityclientattest_access_servercookie(client_attest,
-                                                                                                 handshake_ctx->base.version),
-                                &handshake_ctx->base,
-                                cookie_ctx);
+    // 4) Check that client's echoed server_cookie is the one we sent, and hasn't been used.
+    //  It only gets recorded as used once the ClientAttest's signatures check out.
+    rc = check_server_cookie((const xtt_server_cookie*)xtt_identityclientattest_access_servercookie(client_attest,
+                                                                                                    handshake_ctx->base.version),
+                             &handshake_ctx->base,
+                             cookie_ctx);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
@@ -427,40 +845,66 @@ xtt_pre_parse_client_attest(xtt_client_id* client_id_out,
     switch (msg_type) {
         case XTT_ID_CLIENTATTEST_MSG: {
             uint16_t decrypted_len;
-            assert(sizeof(handshake_ctx->base.clientattest_buffer) >= xtt_identityclientattest_encrypted_part_length(handshake_ctx->base.version,
+            assert(sizeof(handshake_ctx->clientattest_buffer) >= xtt_identityclientattest_encrypted_part_length(handshake_ctx->base.version,
                                                                                                                 handshake_ctx->base.suite_spec));
-            rc = handshake_ctx->base.decrypt(handshake_ctx->base.clientattest_buffer,
-                                             &decrypted_len,
-                                             client_attest + xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
-                                             xtt_identityclientattest_encrypted_part_length(handshake_ctx->base.version,
-                                                                                            handshake_ctx->base.suite_spec)
-                                                   + handshake_ctx->base.mac_length,
-                                             client_attest,
-                                             xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
-                                             &handshake_ctx->base);
+            rc = HANDSHAKE_SUITE(&handshake_ctx->base)->decrypt(handshake_ctx->clientattest_buffer,
+                                                    &decrypted_len,
+                                                    client_attest + xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                                    xtt_identityclientattest_encrypted_part_length(handshake_ctx->base.version,
+                                                                                                   handshake_ctx->base.suite_spec)
+                                                   + HANDSHAKE_SUITE(&handshake_ctx->base)->mac_length,
+                                                    client_attest,
+                                                    xtt_identityclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                                    &handshake_ctx->base);
             if (XTT_ERROR_SUCCESS != rc)
                 return rc;
 
             // 7) Copy claimed DAA GID.
             memcpy(daa_group_id_out->data,
-                   xtt_encrypted_identityclientattest_access_gid(handshake_ctx->base.clientattest_buffer,
+                   xtt_encrypted_identityclientattest_access_gid(handshake_ctx->clientattest_buffer,
                                                                  handshake_ctx->base.version,
                                                                  handshake_ctx->base.suite_spec),
                    sizeof(xtt_daa_group_id));
 
             // 8) Copy requested ClientID
             memcpy(client_id_out->data,
-                   xtt_encrypted_identityclientattest_access_id(handshake_ctx->base.clientattest_buffer,
+                   xtt_encrypted_identityclientattest_access_id(handshake_ctx->clientattest_buffer,
                                                                 handshake_ctx->base.version,
                                                                 handshake_ctx->base.suite_spec),
                    sizeof(xtt_client_id));
 
             break;
         }
+        case XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG: {
+            uint16_t decrypted_len;
+            assert(sizeof(handshake_ctx->clientattest_buffer) >= xtt_sessionclientattest_encrypted_part_length(handshake_ctx->base.version,
+                                                                                                               handshake_ctx->base.suite_spec));
+            rc = HANDSHAKE_SUITE(&handshake_ctx->base)->decrypt(handshake_ctx->clientattest_buffer,
+                                                    &decrypted_len,
+                                                    client_attest + xtt_sessionclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                                    xtt_sessionclientattest_encrypted_part_length(handshake_ctx->base.version,
+                                                                                                  handshake_ctx->base.suite_spec)
+                                                   + HANDSHAKE_SUITE(&handshake_ctx->base)->mac_length,
+                                                    client_attest,
+                                                    xtt_sessionclientattest_unencrypted_part_length(handshake_ctx->base.version),
+                                                    &handshake_ctx->base);
+            if (XTT_ERROR_SUCCESS != rc)
+                return rc;
+
+            // 7) A Session handshake has no DAA signature.
+            memcpy(daa_group_id_out->data,
+                   xtt_null_daa_group_id.data,
+                   sizeof(xtt_daa_group_id));
+
+            // 8) Copy the client's ClientID
+            memcpy(client_id_out->data,
+                   xtt_encrypted_sessionclientattest_access_id(handshake_ctx->clientattest_buffer,
+                                                               handshake_ctx->base.version),
+                   sizeof(xtt_client_id));
+
+            break;
+        }
         case XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG:
-        case XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG:
-            // TODO: Implement this
-            return XTT_ERROR_INCORRECT_TYPE;
         case XTT_CLIENTINIT_MSG:
         case XTT_SERVERINITANDATTEST_MSG:
         case XTT_ID_SERVERFINISHED_MSG:
@@ -480,49 +924,194 @@ xtt_build_identity_server_finished(unsigned char *out_buffer,
                                    xtt_client_id *client_id,
                                    struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
                                    struct xtt_server_certificate_context *certificate_ctx,
+                                   struct xtt_server_cookie_context* cookie_ctx,
                                    struct xtt_server_handshake_context* handshake_ctx)
 {
+    TRACE2(build_identity_server_finished_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(client_attest));
+
+    struct xtt_identity_verification_job job;
+
+    // 1) Capture the signatures and their inputs.
+    xtt_error_code rc = xtt_submit_identity_server_finished(&job,
+                                                            client_attest,
+                                                            daa_group_pub_key_ctx,
+                                                            certificate_ctx,
+                                                            handshake_ctx);
+
+    // 2) Verify the DAA and longterm_key signatures.
+    if (XTT_ERROR_SUCCESS == rc)
+        (void)xtt_verify_identity_client_attest(&job);
+
+    // 3) Build the ServerFinished (or an Error message, if anything failed).
+    rc = xtt_complete_identity_server_finished(out_buffer,
+                                               out_length,
+                                               &job,
+                                               client_id,
+                                               cookie_ctx,
+                                               handshake_ctx);
+    TRACE3(build_identity_server_finished_return, rc, handshake_ctx->base.suite_spec, *out_length);
+
+    return rc;
+}
+
+xtt_error_code
+xtt_submit_identity_server_finished(struct xtt_identity_verification_job *job_out,
+                                    const unsigned char* client_attest,
+                                    struct xtt_daa_group_public_key_context* daa_group_pub_key_ctx,
+                                    struct xtt_server_certificate_context *certificate_ctx,
+                                    struct xtt_server_handshake_context* handshake_ctx)
+{
+    TRACE2(submit_identity_server_finished_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(client_attest));
+
     xtt_error_code rc;
 
-    // 1) Verify DAA Signature
-    rc = verify_daa_signature(xtt_encrypted_identityclientattest_access_daasignature(handshake_ctx->base.clientattest_buffer,
-                                                                                     handshake_ctx->base.version,
-                                                                                     handshake_ctx->base.suite_spec),
-                              (unsigned char*)&handshake_ctx->base.server_cookie,
-                              handshake_ctx->base.server_signature_buffer,
-                              client_attest,
-                              handshake_ctx->base.clientattest_buffer,
-                              daa_group_pub_key_ctx,
-                              certificate_ctx,
-                              &handshake_ctx->base);
-    if (XTT_ERROR_SUCCESS != rc)
+    // Until it's verified, the job must not be trusted.
+    job_out->verdict = XTT_ERROR_BAD_SIGNATURE;
+
+    rc = prepare_client_signatures_verification(job_out,
+                                                (unsigned char*)&handshake_ctx->base.server_cookie,
+                                                handshake_ctx->server_signature_buffer,
+                                                client_attest,
+                                                handshake_ctx->clientattest_buffer,
+                                                daa_group_pub_key_ctx,
+                                                certificate_ctx,
+                                                handshake_ctx);
+    if (XTT_ERROR_SUCCESS != rc) {
+        job_out->verdict = rc;
+        TRACE3(submit_identity_server_finished_return, rc, handshake_ctx->base.suite_spec, 0);
         return rc;
+    }
+
+    TRACE3(submit_identity_server_finished_return, XTT_ERROR_SUCCESS, handshake_ctx->base.suite_spec, 0);
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+xtt_verify_identity_client_attest(struct xtt_identity_verification_job *job)
+{
+    TRACE0(verify_identity_client_attest_entry);
+
+    job->verdict = verify_client_signatures(job);
+
+    TRACE1(verify_identity_client_attest_return, job->verdict);
+
+    return job->verdict;
+}
+
+xtt_error_code
+xtt_verify_identity_client_attests(struct xtt_identity_verification_job *jobs,
+                                   uint16_t job_count)
+{
+    TRACE1(verify_identity_client_attests_entry, job_count);
+
+    xtt_error_code rc = verify_client_signatures_batch(jobs, job_count);
+
+    TRACE2(verify_identity_client_attests_return, rc, job_count);
 
-    // 2) Read-out the claimed longterm_key.
-    handshake_ctx->read_longterm_key(handshake_ctx,
-                                     NULL,
-                                     xtt_encrypted_identityclientattest_access_longtermkey(handshake_ctx->base.clientattest_buffer,
-                                                                                           handshake_ctx->base.version));
-
-    // 3) Verify longterm_key_signature
-    rc = verify_client_longterm_signature(xtt_encrypted_identityclientattest_access_longtermsignature(handshake_ctx->base.clientattest_buffer,
-                                                                                                      handshake_ctx->base.version,
-                                                                                                      handshake_ctx->base.suite_spec),
-                                          (unsigned char*)&handshake_ctx->base.server_cookie,
-                                          handshake_ctx->base.server_signature_buffer,
-                                          client_attest,
-                                          handshake_ctx->base.clientattest_buffer,
-                                          certificate_ctx,
-                                          handshake_ctx);
+    return rc;
+}
+
+xtt_error_code
+xtt_complete_identity_server_finished(unsigned char *out_buffer,
+                                      uint16_t *out_length,
+                                      const struct xtt_identity_verification_job *job,
+                                      xtt_client_id *client_id,
+                                      struct xtt_server_cookie_context* cookie_ctx,
+                                      struct xtt_server_handshake_context* handshake_ctx)
+{
+    TRACE2(complete_identity_server_finished_entry, handshake_ctx->base.suite_spec, 0);
+
+    xtt_error_code rc;
+
+    // 1) Check the verdict.
+    rc = job->verdict;
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    // 2) Now that it's been verified, record the server_cookie as used.
+    rc = record_server_cookie(&handshake_ctx->base.server_cookie, cookie_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    // 3) Read-out the client's longterm_key.
+    HANDSHAKE_SUITE(&handshake_ctx->base)->read_longterm_key(handshake_ctx,
+                                                 NULL,
+                                                 xtt_encrypted_identityclientattest_access_longtermkey(handshake_ctx->clientattest_buffer,
+                                                                                                       handshake_ctx->base.version));
+
+    // 4) Build and encrypt the ServerFinished.
+    rc = build_identityserverfinished(out_buffer,
+                                      out_length,
+                                      client_id,
+                                      handshake_ctx);
     if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+finish:
+    if (XTT_ERROR_SUCCESS == rc) {
+        TRACE3(complete_identity_server_finished_return, XTT_ERROR_SUCCESS, handshake_ctx->base.suite_spec, *out_length);
+
+        return XTT_ERROR_SUCCESS;
+    } else {
+        STATS_COUNT_ERROR(rc);
+        (void)build_error_msg(out_buffer, out_length, handshake_ctx->base.version);
+
+        TRACE3(complete_identity_server_finished_return, rc, handshake_ctx->base.suite_spec, *out_length);
+
         return rc;
+    }
+}
+
+xtt_error_code
+xtt_build_session_server_finished(unsigned char *out_buffer,
+                                  uint16_t *out_length,
+                                  const unsigned char* client_attest,
+                                  const xtt_ed25519_pub_key *client_longterm_key,
+                                  struct xtt_server_certificate_context *certificate_ctx,
+                                  struct xtt_server_cookie_context* cookie_ctx,
+                                  struct xtt_server_handshake_context* handshake_ctx)
+{
+    TRACE2(build_session_server_finished_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(client_attest));
+
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
+    xtt_error_code rc;
+
+    // 1) Check message type.
+    if (XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG != *xtt_access_msg_type(client_attest)) {
+        rc = XTT_ERROR_INCORRECT_TYPE;
+        goto finish;
+    }
+
+    // 2) Verify the longterm_key signature, against the key we have on record for this client.
+    rc = verify_session_client_longterm_signature(xtt_encrypted_sessionclientattest_access_longtermsignature(handshake_ctx->clientattest_buffer,
+                                                                                                             handshake_ctx->base.version,
+                                                                                                             handshake_ctx->base.suite_spec),
+                                                  client_longterm_key->data,
+                                                  handshake_ctx->base.server_cookie.data,
+                                                  handshake_ctx->server_signature_buffer,
+                                                  client_attest,
+                                                  handshake_ctx->clientattest_buffer,
+                                                  certificate_ctx,
+                                                  handshake_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+
+    // 3) Now that it's been verified, record the server_cookie as used, and save the client's longterm_key.
+    rc = record_server_cookie(&handshake_ctx->base.server_cookie, cookie_ctx);
+    if (XTT_ERROR_SUCCESS != rc)
+        goto finish;
+    HANDSHAKE_SUITE(&handshake_ctx->base)->read_longterm_key(handshake_ctx,
+                                                 NULL,
+                                                 (unsigned char*)client_longterm_key->data);
 
     // 4) Set message type.
-    *xtt_access_msg_type(out_buffer) = XTT_ID_SERVERFINISHED_MSG;
+    *xtt_access_msg_type(out_buffer) = XTT_SESSION_SERVERFINISHED_MSG;
 
     // 5) Set length.
-    short_to_bigendian(xtt_identityserverfinished_total_length(handshake_ctx->base.version,
-                                                               handshake_ctx->base.suite_spec),
+    short_to_bigendian(xtt_sessionserverfinished_total_length(handshake_ctx->base.version,
+                                                              handshake_ctx->base.suite_spec),
                        xtt_access_length(out_buffer));
 
     // 6) Set version.
@@ -532,52 +1121,128 @@ xtt_build_identity_server_finished(unsigned char *out_buffer,
     short_to_bigendian(handshake_ctx->base.suite_spec,
                        xtt_identityserverfinished_access_suite_spec(out_buffer, handshake_ctx->base.version));
 
-    // 8) Set the client's id.
-    memcpy(xtt_encrypted_identityserverfinished_access_id(handshake_ctx->base.buffer,
-                                                          handshake_ctx->base.version),
-           client_id->data,
+    // 8) Echo the client's id.
+    memcpy(xtt_encrypted_sessionserverfinished_access_id(scratch->buffer,
+                                                         handshake_ctx->base.version),
+           xtt_encrypted_sessionclientattest_access_id(handshake_ctx->clientattest_buffer,
+                                                       handshake_ctx->base.version),
            sizeof(xtt_client_id));
 
-    // 9) Set the longterm_key (echo)
-    memcpy(xtt_encrypted_identityserverfinished_access_longtermkey(handshake_ctx->base.buffer,
-                                                                   handshake_ctx->base.version),
-           xtt_encrypted_identityclientattest_access_longtermkey(handshake_ctx->base.clientattest_buffer,
-                                                                 handshake_ctx->base.version),
-           handshake_ctx->base.longterm_key_length);
-
-    // 10) AEAD encrypt the message
+    // 9) AEAD encrypt the message
     uint16_t encrypted_len;
-    rc = handshake_ctx->base.encrypt(out_buffer + xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
-                                     &encrypted_len,
-                                     handshake_ctx->base.buffer,
-                                     xtt_identityserverfinished_encrypted_part_length(handshake_ctx->base.version,
-                                                                                      handshake_ctx->base.suite_spec),
-                                     out_buffer,
-                                     xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
-                                     &handshake_ctx->base);
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->encrypt(out_buffer + xtt_sessionserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            &encrypted_len,
+                                            scratch->buffer,
+                                            xtt_sessionserverfinished_encrypted_part_length(handshake_ctx->base.version,
+                                                                                            handshake_ctx->base.suite_spec),
+                                            out_buffer,
+                                            xtt_sessionserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            &handshake_ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
         goto finish;
 
 finish:
     if (XTT_ERROR_SUCCESS == rc) {
-        // 11) Report ServerFinished message length.
-        *out_length = xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version)
+        // 10) Report Session_ServerFinished message length.
+        *out_length = xtt_sessionserverfinished_unencrypted_part_length(handshake_ctx->base.version)
                         + encrypted_len;
-        assert(xtt_identityserverfinished_total_length(handshake_ctx->base.version, handshake_ctx->base.suite_spec) == *out_length);
+        assert(xtt_sessionserverfinished_total_length(handshake_ctx->base.version, handshake_ctx->base.suite_spec) == *out_length);
+
+        TRACE3(build_session_server_finished_return, XTT_ERROR_SUCCESS, handshake_ctx->base.suite_spec, *out_length);
 
         return XTT_ERROR_SUCCESS;
     } else {
+        STATS_COUNT_ERROR(rc);
         (void)build_error_msg(out_buffer, out_length, handshake_ctx->base.version);
 
+        TRACE3(build_session_server_finished_return, rc, handshake_ctx->base.suite_spec, *out_length);
+
         return rc;
     }
 }
 
+xtt_error_code
+build_identityserverfinished(unsigned char *out_buffer,
+                             uint16_t *out_length,
+                             const xtt_client_id *client_id,
+                             struct xtt_server_handshake_context* handshake_ctx)
+{
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
+    xtt_error_code rc;
+
+    // 1) Set message type.
+    *xtt_access_msg_type(out_buffer) = XTT_ID_SERVERFINISHED_MSG;
+
+    // 2) Set length.
+    short_to_bigendian(xtt_identityserverfinished_total_length(handshake_ctx->base.version,
+                                                               handshake_ctx->base.suite_spec),
+                       xtt_access_length(out_buffer));
+
+    // 3) Set version.
+    *xtt_access_version(out_buffer) = handshake_ctx->base.version;
+
+    // 4) Set suite spec.
+    short_to_bigendian(handshake_ctx->base.suite_spec,
+                       xtt_identityserverfinished_access_suite_spec(out_buffer, handshake_ctx->base.version));
+
+    // 5) Set the client's id.
+    memcpy(xtt_encrypted_identityserverfinished_access_id(scratch->buffer,
+                                                          handshake_ctx->base.version),
+           client_id->data,
+           sizeof(xtt_client_id));
+
+    // 6) Set the longterm_key (echo)
+    memcpy(xtt_encrypted_identityserverfinished_access_longtermkey(scratch->buffer,
+                                                                   handshake_ctx->base.version),
+           xtt_encrypted_identityclientattest_access_longtermkey(handshake_ctx->clientattest_buffer,
+                                                                 handshake_ctx->base.version),
+           HANDSHAKE_SUITE(&handshake_ctx->base)->longterm_key_length);
+
+    // 7) AEAD encrypt the message
+    uint16_t encrypted_len;
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->encrypt(out_buffer + xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            &encrypted_len,
+                                            scratch->buffer,
+                                            xtt_identityserverfinished_encrypted_part_length(handshake_ctx->base.version,
+                                                                                             handshake_ctx->base.suite_spec),
+                                            out_buffer,
+                                            xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            &handshake_ctx->base);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 8) Report ServerFinished message length.
+    *out_length = xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version)
+                    + encrypted_len;
+    assert(xtt_identityserverfinished_total_length(handshake_ctx->base.version, handshake_ctx->base.suite_spec) == *out_length);
+
+    return XTT_ERROR_SUCCESS;
+}
+
 xtt_error_code
 xtt_parse_identity_server_finished(xtt_client_id* client_id,
                                    const unsigned char* identity_server_finished,
                                    struct xtt_client_handshake_context* handshake_ctx)
 {
+    TRACE2(parse_identity_server_finished_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(identity_server_finished));
+
+    xtt_error_code rc = parse_identity_server_finished(client_id,
+                                                       identity_server_finished,
+                                                       handshake_ctx);
+    STATS_COUNT_ERROR(rc);
+    TRACE3(parse_identity_server_finished_return, rc, handshake_ctx->base.suite_spec, 0);
+
+    return rc;
+}
+
+xtt_error_code
+parse_identity_server_finished(xtt_client_id* client_id,
+                               const unsigned char* identity_server_finished,
+                               struct xtt_client_handshake_context* handshake_ctx)
+{
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
     // 1) Check the length of the ServerFinished message.
     uint16_t serverfinished_length;
     bigendian_to_short(xtt_access_length(identity_server_finished), &serverfinished_length);
@@ -612,34 +1277,116 @@ xtt_parse_identity_server_finished(xtt_client_id* client_id,
 
     // 4) AEAD decrypt the message
     uint16_t decrypted_len;
-    assert(sizeof(handshake_ctx->base.buffer) >= xtt_identityserverfinished_encrypted_part_length(handshake_ctx->base.version,
+    assert(sizeof(scratch->buffer) >= xtt_identityserverfinished_encrypted_part_length(handshake_ctx->base.version,
                                                                                              handshake_ctx->base.suite_spec));
 
-    rc = handshake_ctx->base.decrypt(handshake_ctx->base.buffer,
-                                     &decrypted_len,
-                                     identity_server_finished + xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
-                                     xtt_identityserverfinished_encrypted_part_length(handshake_ctx->base.version,
-                                                                                      handshake_ctx->base.suite_spec)
-                                           + handshake_ctx->base.mac_length,
-                                     identity_server_finished,
-                                     xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
-                                     &handshake_ctx->base);
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->decrypt(scratch->buffer,
+                                            &decrypted_len,
+                                            identity_server_finished + xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            xtt_identityserverfinished_encrypted_part_length(handshake_ctx->base.version,
+                                                                                             handshake_ctx->base.suite_spec)
+                                           + HANDSHAKE_SUITE(&handshake_ctx->base)->mac_length,
+                                            identity_server_finished,
+                                            xtt_identityserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            &handshake_ctx->base);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
     // 5) Get the client_id sent by the server (and make sure it matches ours, if we requested one).
     if (0 == xtt_crypto_memcmp(xtt_null_client_id.data, client_id->data, sizeof(xtt_client_id))) {
         memcpy(client_id,
-               xtt_encrypted_identityserverfinished_access_id(handshake_ctx->base.buffer, handshake_ctx->base.version),
+               xtt_encrypted_identityserverfinished_access_id(scratch->buffer, handshake_ctx->base.version),
                sizeof(xtt_client_id));
     } else if (0 != xtt_crypto_memcmp(client_id->data,
-                                      xtt_encrypted_identityserverfinished_access_id(handshake_ctx->base.buffer, handshake_ctx->base.version),
+                                      xtt_encrypted_identityserverfinished_access_id(scratch->buffer, handshake_ctx->base.version),
                                       sizeof(xtt_client_id))) {
         return XTT_ERROR_BAD_FINISH;
     }
 
-    if (0 != handshake_ctx->compare_longterm_keys(xtt_encrypted_identityserverfinished_access_longtermkey(handshake_ctx->base.buffer, handshake_ctx->base.version),
-                                                  handshake_ctx)) {
+    if (0 != HANDSHAKE_SUITE(&handshake_ctx->base)->compare_longterm_keys(xtt_encrypted_identityserverfinished_access_longtermkey(scratch->buffer, handshake_ctx->base.version),
+                                                              handshake_ctx)) {
+        return XTT_ERROR_BAD_FINISH;
+    }
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+xtt_parse_session_server_finished(const xtt_client_id* client_id,
+                                  const unsigned char* session_server_finished,
+                                  struct xtt_client_handshake_context* handshake_ctx)
+{
+    TRACE2(parse_session_server_finished_entry, handshake_ctx->base.suite_spec, xtt_get_message_length(session_server_finished));
+
+    xtt_error_code rc = parse_session_server_finished(client_id,
+                                                      session_server_finished,
+                                                      handshake_ctx);
+    STATS_COUNT_ERROR(rc);
+    TRACE3(parse_session_server_finished_return, rc, handshake_ctx->base.suite_spec, 0);
+
+    return rc;
+}
+
+xtt_error_code
+parse_session_server_finished(const xtt_client_id* client_id,
+                              const unsigned char* session_server_finished,
+                              struct xtt_client_handshake_context* handshake_ctx)
+{
+    struct xtt_handshake_scratch *scratch = handshake_scratch(&handshake_ctx->base);
+
+    // 1) Check the length of the ServerFinished message.
+    uint16_t serverfinished_length;
+    bigendian_to_short(xtt_access_length(session_server_finished), &serverfinished_length);
+    uint16_t minimum_length = sizeof(xtt_msg_type_raw)
+        + sizeof(xtt_length)
+        + sizeof(xtt_version_raw)
+        + sizeof(xtt_suite_spec_raw);
+    if (serverfinished_length < minimum_length)
+        return XTT_ERROR_INCORRECT_LENGTH;
+    xtt_version_raw claimed_version = *xtt_access_version(session_server_finished);
+    xtt_suite_spec claimed_suite_spec;
+    xtt_suite_spec_raw claimed_suite_spec_raw;
+    bigendian_to_short(xtt_identityserverfinished_access_suite_spec(session_server_finished,
+                                                                    claimed_version),
+                       &claimed_suite_spec_raw);
+    claimed_suite_spec = claimed_suite_spec_raw;
+    if (serverfinished_length != xtt_sessionserverfinished_total_length(claimed_version, claimed_suite_spec))
+        return XTT_ERROR_INCORRECT_LENGTH;
+
+    // 2) Check message type.
+    if (XTT_SESSION_SERVERFINISHED_MSG != *xtt_access_msg_type(session_server_finished))
+        return XTT_ERROR_INCORRECT_TYPE;
+
+    // 3) Check server's version and suite_spec
+    if (claimed_version != handshake_ctx->base.version)
+        return XTT_ERROR_UNKNOWN_VERSION;
+
+    if (claimed_suite_spec != handshake_ctx->base.suite_spec)
+        return XTT_ERROR_UNKNOWN_SUITE_SPEC;
+
+    xtt_error_code rc;
+
+    // 4) AEAD decrypt the message
+    uint16_t decrypted_len;
+    assert(sizeof(scratch->buffer) >= xtt_sessionserverfinished_encrypted_part_length(handshake_ctx->base.version,
+                                                                                      handshake_ctx->base.suite_spec));
+
+    rc = HANDSHAKE_SUITE(&handshake_ctx->base)->decrypt(scratch->buffer,
+                                            &decrypted_len,
+                                            session_server_finished + xtt_sessionserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            xtt_sessionserverfinished_encrypted_part_length(handshake_ctx->base.version,
+                                                                                            handshake_ctx->base.suite_spec)
+                                           + HANDSHAKE_SUITE(&handshake_ctx->base)->mac_length,
+                                            session_server_finished,
+                                            xtt_sessionserverfinished_unencrypted_part_length(handshake_ctx->base.version),
+                                            &handshake_ctx->base);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // 5) Make sure the server echoed our client_id.
+    if (0 != xtt_crypto_memcmp(client_id->data,
+                               xtt_encrypted_sessionserverfinished_access_id(scratch->buffer, handshake_ctx->base.version),
+                               sizeof(xtt_client_id))) {
         return XTT_ERROR_BAD_FINISH;
     }
 
@@ -648,7 +1395,8 @@ xtt_parse_identity_server_finished(xtt_client_id* client_id,
 
 xtt_error_code
 parse_client_init(struct xtt_server_handshake_context *ctx_out,
-                  const unsigned char* client_init)
+                  const unsigned char* client_init,
+                  struct xtt_x25519_key_pool *key_pool)
 {
     // 1) Check the length of the Client Init message.
     uint16_t client_init_length;
@@ -675,9 +1423,10 @@ parse_client_init(struct xtt_server_handshake_context *ctx_out,
     xtt_error_code rc;
 
     // 3) Initialize own context from version and suite_spec from client.
-    rc = xtt_initialize_server_handshake_context(ctx_out,
-                                                 ctx_out->base.version,
-                                                 ctx_out->base.suite_spec);
+    rc = xtt_initialize_server_handshake_context_from_key_pool(ctx_out,
+                                                               ctx_out->base.version,
+                                                               ctx_out->base.suite_spec,
+                                                               key_pool);
     if (XTT_ERROR_SUCCESS != rc)
         return rc;
 
@@ -723,7 +1472,7 @@ parse_server_initandattest(struct xtt_client_handshake_context *handshake_ctx,
 
     // 4) Run Diffie-Hellman and get handshake AEAD keys.
     rc = derive_handshake_keys(&handshake_ctx->base,
-                              handshake_ctx->base.client_init_buffer,
+                              handshake_ctx->client_init_buffer,
                               server_init_and_attest,
                               xtt_serverinitandattest_access_server_cookie(server_init_and_attest,
                                                                                    handshake_ctx->base.version,
@@ -736,19 +1485,19 @@ parse_server_initandattest(struct xtt_client_handshake_context *handshake_ctx,
 
     // 5) AEAD decrypt the message
     uint16_t decrypted_len;
-    assert(sizeof(handshake_ctx->base.server_initandattest_buffer) >= xtt_serverinitandattest_encrypted_part_length(handshake_ctx->base.version,
+    assert(sizeof(handshake_ctx->server_initandattest_buffer) >= xtt_serverinitandattest_encrypted_part_length(handshake_ctx->base.version,
                                                                                                                handshake_ctx->base.suite_spec));
-    int decrypt_rc = handshake_ctx->base.decrypt(handshake_ctx->base.server_initandattest_buffer,
-                                                 &decrypted_len,
-                                                 server_init_and_attest + xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->base.version,
-                                                                                                                          handshake_ctx->base.suite_spec),
-                                                 xtt_serverinitandattest_encrypted_part_length(handshake_ctx->base.version,
-                                                                                               handshake_ctx->base.suite_spec)
-                                                       + handshake_ctx->base.mac_length,
-                                                 server_init_and_attest,
-                                                 xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->base.version,
-                                                                                                 handshake_ctx->base.suite_spec),
-                                                 &handshake_ctx->base);
+    int decrypt_rc = HANDSHAKE_SUITE(&handshake_ctx->base)->decrypt(handshake_ctx->server_initandattest_buffer,
+                                                        &decrypted_len,
+                                                        server_init_and_attest + xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->base.version,
+                                                                                                                                 handshake_ctx->base.suite_spec),
+                                                        xtt_serverinitandattest_encrypted_part_length(handshake_ctx->base.version,
+                                                                                                      handshake_ctx->base.suite_spec)
+                                                       + HANDSHAKE_SUITE(&handshake_ctx->base)->mac_length,
+                                                        server_init_and_attest,
+                                                        xtt_serverinitandattest_unencrypted_part_length(handshake_ctx->base.version,
+                                                                                                        handshake_ctx->base.suite_spec),
+                                                        &handshake_ctx->base);
     if (0 != decrypt_rc)
         return XTT_ERROR_CRYPTO;
 
@@ -770,3 +1519,16 @@ build_error_msg(unsigned char *out_buffer,
 
     return XTT_ERROR_SUCCESS;
 }
+
+uint16_t
+clientattest_total_length(xtt_msg_type msg_type,
+                          xtt_version version,
+                          xtt_suite_spec suite_spec)
+{
+    switch (msg_type) {
+        case XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG:
+            return xtt_sessionclientattest_total_length(version, suite_spec);
+        default:
+            return xtt_identityclientattest_total_length(version, suite_spec);
+    }
+}
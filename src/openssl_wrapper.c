@@ -0,0 +1,854 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt/crypto_provider.h>
+#include <xtt/crypto_types.h>
+#include <xtt/error_codes.h>
+
+#include "internal/crypto_providers.h"
+
+#include <openssl/crypto.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include <pthread.h>
+#include <string.h>
+
+#define AEAD_KEY_LENGTH 32
+#define AEAD_MAC_LENGTH 16
+
+/* Nb. OpenSSL returns 1 on success, and these all translate that to the usual 0 */
+
+static EVP_CIPHER *chacha20poly1305_cipher;
+static EVP_CIPHER *aes256gcm_cipher;
+static EVP_MD *sha512_md;
+static EVP_MD *blake2b_md;
+static EVP_MAC *hmac_mac;
+static EVP_MAC *blake2b_mac;
+
+/*
+ * Each thread keeps one cipher context, and remembers which cipher and key it was last keyed with,
+ * so that consecutive messages under the same key (i.e. a session's records) only set the nonce
+ * and skip re-expanding the key.
+ */
+struct thread_cipher {
+    EVP_CIPHER_CTX *ctx;
+    const EVP_CIPHER *cipher;
+    unsigned char key[AEAD_KEY_LENGTH];
+};
+
+static pthread_once_t thread_cipher_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_cipher_key;
+
+XTT_PROVIDER_PRIMITIVE void openssl_hash_release(xtt_hash_state* state);
+
+XTT_PROVIDER_PRIMITIVE void openssl_prf_release(xtt_prf_state* state);
+
+static void create_thread_cipher_key(void);
+
+static void free_thread_cipher(void *cipher);
+
+static EVP_CIPHER_CTX* keyed_cipher_ctx(const EVP_CIPHER *cipher,
+                                        const unsigned char *key,
+                                        const unsigned char *nonce,
+                                        int encrypt);
+
+static int aead_encrypt_detached(const EVP_CIPHER *cipher,
+                                 unsigned char* ciphertext,
+                                 unsigned char* mac_out,
+                                 const unsigned char* message,
+                                 uint16_t msg_len,
+                                 const unsigned char* addl_data,
+                                 uint16_t addl_len,
+                                 const unsigned char* nonce,
+                                 const unsigned char* key);
+
+static int aead_decrypt_detached(const EVP_CIPHER *cipher,
+                                 unsigned char* decrypted,
+                                 const unsigned char* ciphertext,
+                                 uint16_t ciphertext_len,
+                                 const unsigned char* mac,
+                                 const unsigned char* addl_data,
+                                 uint16_t addl_len,
+                                 const unsigned char* nonce,
+                                 const unsigned char* key);
+
+static int openssl_initialize(void)
+{
+    if (1 != OPENSSL_init_crypto(0, NULL))
+        return XTT_ERROR_BAD_INIT;
+
+    // Fetch the ciphers once, rather than implicitly on every message.
+    if (NULL == chacha20poly1305_cipher)
+        chacha20poly1305_cipher = EVP_CIPHER_fetch(NULL, "ChaCha20-Poly1305", NULL);
+    if (NULL == aes256gcm_cipher)
+        aes256gcm_cipher = EVP_CIPHER_fetch(NULL, "AES-256-GCM", NULL);
+    if (NULL == chacha20poly1305_cipher || NULL == aes256gcm_cipher)
+        return XTT_ERROR_BAD_INIT;
+
+    // Likewise the hashes, and the MACs the PRFs are built on.
+    if (NULL == sha512_md)
+        sha512_md = EVP_MD_fetch(NULL, "SHA512", NULL);
+    if (NULL == blake2b_md)
+        blake2b_md = EVP_MD_fetch(NULL, "BLAKE2B-512", NULL);
+    if (NULL == hmac_mac)
+        hmac_mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if (NULL == blake2b_mac)
+        blake2b_mac = EVP_MAC_fetch(NULL, "BLAKE2BMAC", NULL);
+    if (NULL == sha512_md || NULL == blake2b_md || NULL == hmac_mac || NULL == blake2b_mac)
+        return XTT_ERROR_BAD_INIT;
+
+    return 0;
+}
+
+static int openssl_memcmp_ct(const unsigned char *one, const unsigned char *two, uint16_t length)
+{
+    return (0 == CRYPTO_memcmp(one, two, length)) ? 0 : -1;
+}
+
+static void openssl_secure_clear(unsigned char* memory, uint16_t memory_length)
+{
+    OPENSSL_cleanse(memory, memory_length);
+}
+
+static int openssl_get_random(unsigned char* buffer, uint16_t buffer_length)
+{
+    return (1 == RAND_bytes(buffer, buffer_length)) ? 0 : -1;
+}
+
+static int openssl_x25519_public_key(xtt_x25519_pub_key *pub, const xtt_x25519_priv_key *priv)
+{
+    size_t pub_length = sizeof(xtt_x25519_pub_key);
+    int ret = -1;
+
+    EVP_PKEY *pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, NULL, priv->data, sizeof(xtt_x25519_priv_key));
+    if (NULL == pkey)
+        return -1;
+
+    if (1 == EVP_PKEY_get_raw_public_key(pkey, pub->data, &pub_length) && sizeof(xtt_x25519_pub_key) == pub_length)
+        ret = 0;
+
+    EVP_PKEY_free(pkey);
+
+    return ret;
+}
+
+static int openssl_do_x25519_diffie_hellman(unsigned char* shared_secret,
+                                            const xtt_x25519_priv_key* my_sk,
+                                            const xtt_x25519_pub_key* other_pk)
+{
+    size_t shared_secret_length = sizeof(xtt_x25519_pub_key);
+    EVP_PKEY_CTX *ctx = NULL;
+    int ret = XTT_ERROR_DIFFIE_HELLMAN;
+
+    EVP_PKEY *mine = EVP_PKEY_new_raw_private_key(EVP_PKEY_X25519, NULL, my_sk->data, sizeof(xtt_x25519_priv_key));
+    EVP_PKEY *theirs = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, other_pk->data, sizeof(xtt_x25519_pub_key));
+    if (NULL == mine || NULL == theirs)
+        goto cleanup;
+
+    ctx = EVP_PKEY_CTX_new(mine, NULL);
+    if (NULL == ctx)
+        goto cleanup;
+
+    // Nb. OpenSSL itself rejects an all-zero shared secret.
+    if (1 == EVP_PKEY_derive_init(ctx)
+            && 1 == EVP_PKEY_derive_set_peer(ctx, theirs)
+            && 1 == EVP_PKEY_derive(ctx, shared_secret, &shared_secret_length)
+            && sizeof(xtt_x25519_pub_key) == shared_secret_length)
+        ret = 0;
+
+cleanup:
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(theirs);
+    EVP_PKEY_free(mine);
+
+    return ret;
+}
+
+/*
+ * A hash or PRF state holds just a pointer to OpenSSL's context,
+ * which `_init` allocates, and `_final` (or `_release`) frees.
+ */
+struct openssl_hash_state {
+    EVP_MD_CTX *ctx;
+};
+
+struct openssl_prf_state {
+    EVP_MAC_CTX *ctx;
+};
+
+typedef char hash_state_fits[sizeof(struct openssl_hash_state) <= sizeof(xtt_hash_state) ? 1 : -1];
+typedef char prf_state_fits[sizeof(struct openssl_prf_state) <= sizeof(xtt_prf_state) ? 1 : -1];
+
+static int hash_init(xtt_hash_state* state, const EVP_MD *md)
+{
+    struct openssl_hash_state *hash = (struct openssl_hash_state*)state;
+
+    hash->ctx = EVP_MD_CTX_new();
+    if (NULL == hash->ctx)
+        return -1;
+
+    if (1 != EVP_DigestInit_ex2(hash->ctx, md, NULL)) {
+        openssl_hash_release(state);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int hash_update(xtt_hash_state* state,
+                       const unsigned char* in,
+                       uint16_t in_len)
+{
+    struct openssl_hash_state *hash = (struct openssl_hash_state*)state;
+
+    return (1 == EVP_DigestUpdate(hash->ctx, in, in_len)) ? 0 : -1;
+}
+
+static int hash_final(unsigned char* out,
+                      uint16_t* out_length,
+                      uint16_t digest_length,
+                      xtt_hash_state* state)
+{
+    struct openssl_hash_state *hash = (struct openssl_hash_state*)state;
+    unsigned int length = 0;
+    int ret = -1;
+
+    *out_length = digest_length;
+
+    if (1 == EVP_DigestFinal_ex(hash->ctx, out, &length) && digest_length == length)
+        ret = 0;
+
+    openssl_hash_release(state);
+
+    return ret;
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_hash_sha512_init(xtt_hash_state* state)
+{
+    return hash_init(state, sha512_md);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_hash_sha512_update(xtt_hash_state* state,
+                                                      const unsigned char* in,
+                                                      uint16_t in_len)
+{
+    return hash_update(state, in, in_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_hash_sha512_final(unsigned char* out,
+                                                     uint16_t* out_length,
+                                                     xtt_hash_state* state)
+{
+    return hash_final(out, out_length, sizeof(xtt_sha512), state);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_hash_blake2b_init(xtt_hash_state* state)
+{
+    return hash_init(state, blake2b_md);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_hash_blake2b_update(xtt_hash_state* state,
+                                                       const unsigned char* in,
+                                                       uint16_t in_len)
+{
+    return hash_update(state, in, in_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_hash_blake2b_final(unsigned char* out,
+                                                      uint16_t* out_length,
+                                                      xtt_hash_state* state)
+{
+    return hash_final(out, out_length, sizeof(xtt_blake2b), state);
+}
+
+static int openssl_hash_copy(xtt_hash_state* dst, const xtt_hash_state* src)
+{
+    struct openssl_hash_state *to = (struct openssl_hash_state*)dst;
+    const struct openssl_hash_state *from = (const struct openssl_hash_state*)src;
+
+    to->ctx = EVP_MD_CTX_new();
+    if (NULL == to->ctx || 1 != EVP_MD_CTX_copy_ex(to->ctx, from->ctx)) {
+        openssl_hash_release(dst);
+        return -1;
+    }
+
+    return 0;
+}
+
+XTT_PROVIDER_PRIMITIVE void openssl_hash_release(xtt_hash_state* state)
+{
+    struct openssl_hash_state *hash = (struct openssl_hash_state*)state;
+
+    EVP_MD_CTX_free(hash->ctx);
+    hash->ctx = NULL;
+}
+
+static int prf_init(xtt_prf_state* state,
+                    EVP_MAC *mac,
+                    const OSSL_PARAM *params,
+                    const unsigned char* key,
+                    uint16_t key_len)
+{
+    struct openssl_prf_state *prf = (struct openssl_prf_state*)state;
+    static const unsigned char no_key[1];
+
+    prf->ctx = EVP_MAC_CTX_new(mac);
+    if (NULL == prf->ctx)
+        return -1;
+
+    // Nb. a NULL key would mean "re-use the last key", so an empty one is passed as such.
+    if (1 != EVP_MAC_init(prf->ctx, (NULL != key) ? key : no_key, key_len, params)) {
+        openssl_prf_release(state);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int prf_update(xtt_prf_state* state,
+                      const unsigned char* in,
+                      uint16_t in_len)
+{
+    struct openssl_prf_state *prf = (struct openssl_prf_state*)state;
+
+    return (1 == EVP_MAC_update(prf->ctx, in, in_len)) ? 0 : -1;
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_prf_sha512_init(xtt_prf_state* state,
+                                                   uint16_t out_len,
+                                                   const unsigned char* key,
+                                                   uint16_t key_len)
+{
+    char digest[] = "SHA512";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+
+    if (out_len > sizeof(xtt_sha512))
+        return -1;
+
+    return prf_init(state, hmac_mac, params, key, key_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_prf_sha512_update(xtt_prf_state* state,
+                                                     const unsigned char* in,
+                                                     uint16_t in_len)
+{
+    return prf_update(state, in, in_len);
+}
+
+// HMAC-SHA512, truncated to out_len.
+XTT_PROVIDER_PRIMITIVE int openssl_prf_sha512_final(unsigned char* out,
+                                                    uint16_t out_len,
+                                                    xtt_prf_state* state)
+{
+    struct openssl_prf_state *prf = (struct openssl_prf_state*)state;
+    unsigned char buffer[sizeof(xtt_sha512)];
+    size_t length = 0;
+    int ret = -1;
+
+    if (out_len <= sizeof(buffer)
+            && 1 == EVP_MAC_final(prf->ctx, buffer, &length, sizeof(buffer))
+            && sizeof(buffer) == length) {
+        memcpy(out, buffer, out_len);
+        ret = 0;
+    }
+
+    OPENSSL_cleanse(buffer, sizeof(buffer));
+    openssl_prf_release(state);
+
+    return ret;
+}
+
+// Keyed BLAKE2b with an out_len-byte digest, as libsodium's crypto_generichash.
+XTT_PROVIDER_PRIMITIVE int openssl_prf_blake2b_init(xtt_prf_state* state,
+                                                    uint16_t out_len,
+                                                    const unsigned char* key,
+                                                    uint16_t key_len)
+{
+    size_t size = out_len;
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_size_t(OSSL_MAC_PARAM_SIZE, &size),
+        OSSL_PARAM_construct_end()
+    };
+
+    if (0 == out_len || out_len > sizeof(xtt_blake2b))
+        return -1;
+
+    return prf_init(state, blake2b_mac, params, key, key_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_prf_blake2b_update(xtt_prf_state* state,
+                                                      const unsigned char* in,
+                                                      uint16_t in_len)
+{
+    return prf_update(state, in, in_len);
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_prf_blake2b_final(unsigned char* out,
+                                                     uint16_t out_len,
+                                                     xtt_prf_state* state)
+{
+    struct openssl_prf_state *prf = (struct openssl_prf_state*)state;
+    size_t length = 0;
+    int ret = -1;
+
+    if (out_len == EVP_MAC_CTX_get_mac_size(prf->ctx)
+            && 1 == EVP_MAC_final(prf->ctx, out, &length, out_len)
+            && out_len == length)
+        ret = 0;
+
+    openssl_prf_release(state);
+
+    return ret;
+}
+
+XTT_PROVIDER_PRIMITIVE int openssl_prf_copy(xtt_prf_state* dst, const xtt_prf_state* src)
+{
+    struct openssl_prf_state *to = (struct openssl_prf_state*)dst;
+    const struct openssl_prf_state *from = (const struct openssl_prf_state*)src;
+
+    to->ctx = EVP_MAC_CTX_dup(from->ctx);
+
+    return (NULL != to->ctx) ? 0 : -1;
+}
+
+XTT_PROVIDER_PRIMITIVE void openssl_prf_release(xtt_prf_state* state)
+{
+    struct openssl_prf_state *prf = (struct openssl_prf_state*)state;
+
+    EVP_MAC_CTX_free(prf->ctx);
+    prf->ctx = NULL;
+}
+
+static int openssl_ed25519_key_pair_from_seed(xtt_ed25519_pub_key *pub_key,
+                                              xtt_ed25519_priv_key *priv_key,
+                                              const unsigned char seed[32])
+{
+    size_t pub_length = sizeof(xtt_ed25519_pub_key);
+    int ret = -1;
+
+    EVP_PKEY *pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, NULL, seed, 32);
+    if (NULL == pkey)
+        return -1;
+
+    if (1 == EVP_PKEY_get_raw_public_key(pkey, pub_key->data, &pub_length) && sizeof(xtt_ed25519_pub_key) == pub_length) {
+        // Same layout as libsodium's: seed || public key
+        memcpy(priv_key->data, seed, 32);
+        memcpy(priv_key->data + 32, pub_key->data, sizeof(xtt_ed25519_pub_key));
+        ret = 0;
+    }
+
+    EVP_PKEY_free(pkey);
+
+    return ret;
+}
+
+static int openssl_sign_ed25519(unsigned char* signature_out,
+                                const unsigned char* msg,
+                                uint16_t msg_len,
+                                const xtt_ed25519_priv_key* priv_key)
+{
+    size_t sig_length = sizeof(xtt_ed25519_signature);
+    EVP_MD_CTX *ctx = NULL;
+    int ret = -1;
+
+    EVP_PKEY *pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, NULL, priv_key->data, 32);
+    if (NULL == pkey)
+        goto cleanup;
+
+    ctx = EVP_MD_CTX_new();
+    if (NULL == ctx)
+        goto cleanup;
+
+    if (1 == EVP_DigestSignInit(ctx, NULL, NULL, NULL, pkey)
+            && 1 == EVP_DigestSign(ctx, signature_out, &sig_length, msg, msg_len)
+            && sizeof(xtt_ed25519_signature) == sig_length)
+        ret = 0;
+
+cleanup:
+    EVP_MD_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+
+    return ret;
+}
+
+static int openssl_verify_ed25519(const unsigned char* signature,
+                                  const unsigned char* msg,
+                                  uint16_t msg_len,
+                                  const xtt_ed25519_pub_key* pub_key)
+{
+    EVP_MD_CTX *ctx = NULL;
+    int ret = -1;
+
+    EVP_PKEY *pkey = EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, NULL, pub_key->data, sizeof(xtt_ed25519_pub_key));
+    if (NULL == pkey)
+        goto cleanup;
+
+    ctx = EVP_MD_CTX_new();
+    if (NULL == ctx)
+        goto cleanup;
+
+    if (1 == EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, pkey)
+            && 1 == EVP_DigestVerify(ctx, signature, sizeof(xtt_ed25519_signature), msg, msg_len))
+        ret = 0;
+
+cleanup:
+    EVP_MD_CTX_free(ctx);
+    EVP_PKEY_free(pkey);
+
+    return ret;
+}
+
+// OpenSSL has no batch verification, so this just checks each signature.
+static int openssl_batch_verify_ed25519(int *results_out,
+                                        const struct xtt_ed25519_verify_item *items,
+                                        uint16_t item_count)
+{
+    int ret = 0;
+
+    for (uint16_t i = 0; i < item_count; ++i) {
+        results_out[i] = openssl_verify_ed25519(items[i].signature,
+                                                items[i].msg,
+                                                items[i].msg_len,
+                                                items[i].pub_key);
+        if (0 != results_out[i])
+            ret = -1;
+    }
+
+    return ret;
+}
+
+static int openssl_aead_chacha_is_available(void)
+{
+    return 1;
+}
+
+// As with libsodium, only where AES and carry-less multiplication are done in hardware.
+static int openssl_aead_aes256_is_available(void)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(__aarch64__) && defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    return (hwcap & HWCAP_AES) && (hwcap & HWCAP_PMULL);
+#else
+    return 0;
+#endif
+}
+
+static int openssl_aead_chacha_encrypt_detached(unsigned char* ciphertext,
+                                                unsigned char* mac_out,
+                                                const unsigned char* message,
+                                                uint16_t msg_len,
+                                                const unsigned char* addl_data,
+                                                uint16_t addl_len,
+                                                const xtt_chacha_nonce* nonce,
+                                                const xtt_chacha_key* key)
+{
+    return aead_encrypt_detached(chacha20poly1305_cipher,
+                                 ciphertext,
+                                 mac_out,
+                                 message,
+                                 msg_len,
+                                 addl_data,
+                                 addl_len,
+                                 nonce->data,
+                                 key->data);
+}
+
+static int openssl_aead_chacha_decrypt_detached(unsigned char* decrypted,
+                                                const unsigned char* ciphertext,
+                                                uint16_t ciphertext_len,
+                                                const unsigned char* mac,
+                                                const unsigned char* addl_data,
+                                                uint16_t addl_len,
+                                                const xtt_chacha_nonce* nonce,
+                                                const xtt_chacha_key* key)
+{
+    return aead_decrypt_detached(chacha20poly1305_cipher,
+                                 decrypted,
+                                 ciphertext,
+                                 ciphertext_len,
+                                 mac,
+                                 addl_data,
+                                 addl_len,
+                                 nonce->data,
+                                 key->data);
+}
+
+static int openssl_aead_aes256_encrypt_detached(unsigned char* ciphertext,
+                                                unsigned char* mac_out,
+                                                const unsigned char* message,
+                                                uint16_t msg_len,
+                                                const unsigned char* addl_data,
+                                                uint16_t addl_len,
+                                                const xtt_aes256_nonce* nonce,
+                                                const xtt_aes256_key* key)
+{
+    return aead_encrypt_detached(aes256gcm_cipher,
+                                 ciphertext,
+                                 mac_out,
+                                 message,
+                                 msg_len,
+                                 addl_data,
+                                 addl_len,
+                                 nonce->data,
+                                 key->data);
+}
+
+static int openssl_aead_aes256_decrypt_detached(unsigned char* decrypted,
+                                                const unsigned char* ciphertext,
+                                                uint16_t ciphertext_len,
+                                                const unsigned char* mac,
+                                                const unsigned char* addl_data,
+                                                uint16_t addl_len,
+                                                const xtt_aes256_nonce* nonce,
+                                                const xtt_aes256_key* key)
+{
+    return aead_decrypt_detached(aes256gcm_cipher,
+                                 decrypted,
+                                 ciphertext,
+                                 ciphertext_len,
+                                 mac,
+                                 addl_data,
+                                 addl_len,
+                                 nonce->data,
+                                 key->data);
+}
+
+/*
+ * OpenSSL's expanded keys live in its (heap-allocated) cipher contexts,
+ * so the "schedule" is just the key: the per-thread cipher context does the caching instead.
+ */
+typedef char aes256_key_fits[sizeof(xtt_aes256_key) <= sizeof(xtt_aes256_key_schedule) ? 1 : -1];
+
+static int openssl_aead_aes256_expand_key(xtt_aes256_key_schedule* schedule_out,
+                                          const xtt_aes256_key* key)
+{
+    if (!openssl_aead_aes256_is_available())
+        return -1;
+
+    memcpy(schedule_out->data, key->data, sizeof(xtt_aes256_key));
+
+    return 0;
+}
+
+static int openssl_aead_aes256_encrypt_detached_expanded(unsigned char* ciphertext,
+                                                         unsigned char* mac_out,
+                                                         const unsigned char* message,
+                                                         uint16_t msg_len,
+                                                         const unsigned char* addl_data,
+                                                         uint16_t addl_len,
+                                                         const xtt_aes256_nonce* nonce,
+                                                         const xtt_aes256_key_schedule* schedule)
+{
+    return aead_encrypt_detached(aes256gcm_cipher,
+                                 ciphertext,
+                                 mac_out,
+                                 message,
+                                 msg_len,
+                                 addl_data,
+                                 addl_len,
+                                 nonce->data,
+                                 schedule->data);
+}
+
+static int openssl_aead_aes256_decrypt_detached_expanded(unsigned char* decrypted,
+                                                         const unsigned char* ciphertext,
+                                                         uint16_t ciphertext_len,
+                                                         const unsigned char* mac,
+                                                         const unsigned char* addl_data,
+                                                         uint16_t addl_len,
+                                                         const xtt_aes256_nonce* nonce,
+                                                         const xtt_aes256_key_schedule* schedule)
+{
+    return aead_decrypt_detached(aes256gcm_cipher,
+                                 decrypted,
+                                 ciphertext,
+                                 ciphertext_len,
+                                 mac,
+                                 addl_data,
+                                 addl_len,
+                                 nonce->data,
+                                 schedule->data);
+}
+
+void create_thread_cipher_key(void)
+{
+    (void)pthread_key_create(&thread_cipher_key, free_thread_cipher);
+}
+
+void free_thread_cipher(void *cipher)
+{
+    struct thread_cipher *thread_cipher = cipher;
+
+    EVP_CIPHER_CTX_free(thread_cipher->ctx);
+    OPENSSL_clear_free(thread_cipher, sizeof(struct thread_cipher));
+}
+
+EVP_CIPHER_CTX* keyed_cipher_ctx(const EVP_CIPHER *cipher,
+                                 const unsigned char *key,
+                                 const unsigned char *nonce,
+                                 int encrypt)
+{
+    if (NULL == cipher || 0 != pthread_once(&thread_cipher_once, create_thread_cipher_key))
+        return NULL;
+
+    struct thread_cipher *thread_cipher = pthread_getspecific(thread_cipher_key);
+    if (NULL == thread_cipher) {
+        thread_cipher = OPENSSL_zalloc(sizeof(struct thread_cipher));
+        if (NULL == thread_cipher)
+            return NULL;
+
+        thread_cipher->ctx = EVP_CIPHER_CTX_new();
+        if (NULL == thread_cipher->ctx || 0 != pthread_setspecific(thread_cipher_key, thread_cipher)) {
+            free_thread_cipher(thread_cipher);
+            return NULL;
+        }
+    }
+
+    // 1) Same cipher and key as last time: just set the nonce (and direction)
+    if (cipher == thread_cipher->cipher
+            && 0 == CRYPTO_memcmp(key, thread_cipher->key, AEAD_KEY_LENGTH)) {
+        if (1 != EVP_CipherInit_ex(thread_cipher->ctx, NULL, NULL, NULL, nonce, encrypt))
+            goto fail;
+
+        return thread_cipher->ctx;
+    }
+
+    // 2) Otherwise, re-key
+    if (1 != EVP_CipherInit_ex(thread_cipher->ctx, cipher, NULL, key, nonce, encrypt))
+        goto fail;
+
+    thread_cipher->cipher = cipher;
+    memcpy(thread_cipher->key, key, AEAD_KEY_LENGTH);
+
+    return thread_cipher->ctx;
+
+fail:
+    thread_cipher->cipher = NULL;
+    return NULL;
+}
+
+int aead_encrypt_detached(const EVP_CIPHER *cipher,
+                          unsigned char* ciphertext,
+                          unsigned char* mac_out,
+                          const unsigned char* message,
+                          uint16_t msg_len,
+                          const unsigned char* addl_data,
+                          uint16_t addl_len,
+                          const unsigned char* nonce,
+                          const unsigned char* key)
+{
+    int out_length;
+
+    EVP_CIPHER_CTX *ctx = keyed_cipher_ctx(cipher, key, nonce, 1);
+    if (NULL == ctx)
+        return -1;
+
+    if (addl_len > 0 && 1 != EVP_EncryptUpdate(ctx, NULL, &out_length, addl_data, addl_len))
+        return -1;
+    if (msg_len > 0 && 1 != EVP_EncryptUpdate(ctx, ciphertext, &out_length, message, msg_len))
+        return -1;
+    if (1 != EVP_EncryptFinal_ex(ctx, ciphertext + msg_len, &out_length))
+        return -1;
+    if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, AEAD_MAC_LENGTH, mac_out))
+        return -1;
+
+    return 0;
+}
+
+int aead_decrypt_detached(const EVP_CIPHER *cipher,
+                          unsigned char* decrypted,
+                          const unsigned char* ciphertext,
+                          uint16_t ciphertext_len,
+                          const unsigned char* mac,
+                          const unsigned char* addl_data,
+                          uint16_t addl_len,
+                          const unsigned char* nonce,
+                          const unsigned char* key)
+{
+    int out_length;
+
+    EVP_CIPHER_CTX *ctx = keyed_cipher_ctx(cipher, key, nonce, 0);
+    if (NULL == ctx)
+        return -1;
+
+    if (1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, AEAD_MAC_LENGTH, (void*)mac))
+        return -1;
+    if (addl_len > 0 && 1 != EVP_DecryptUpdate(ctx, NULL, &out_length, addl_data, addl_len))
+        return -1;
+
+    // Unlike libsodium, OpenSSL decrypts before checking the MAC: don't leave unauthenticated plaintext behind.
+    if ((ciphertext_len > 0 && 1 != EVP_DecryptUpdate(ctx, decrypted, &out_length, ciphertext, ciphertext_len))
+            || 1 != EVP_DecryptFinal_ex(ctx, decrypted + ciphertext_len, &out_length)) {
+        OPENSSL_cleanse(decrypted, ciphertext_len);
+        return -1;
+    }
+
+    return 0;
+}
+
+const struct xtt_crypto_provider xtt_crypto_provider_openssl = {
+    .name = "openssl",
+    .initialize = openssl_initialize,
+    .memcmp_ct = openssl_memcmp_ct,
+    .secure_clear = openssl_secure_clear,
+    .get_random = openssl_get_random,
+    .x25519_public_key = openssl_x25519_public_key,
+    .do_x25519_diffie_hellman = openssl_do_x25519_diffie_hellman,
+    .hash_sha512_init = openssl_hash_sha512_init,
+    .hash_sha512_update = openssl_hash_sha512_update,
+    .hash_sha512_final = openssl_hash_sha512_final,
+    .hash_blake2b_init = openssl_hash_blake2b_init,
+    .hash_blake2b_update = openssl_hash_blake2b_update,
+    .hash_blake2b_final = openssl_hash_blake2b_final,
+    .hash_copy = openssl_hash_copy,
+    .hash_release = openssl_hash_release,
+    .prf_sha512_init = openssl_prf_sha512_init,
+    .prf_sha512_update = openssl_prf_sha512_update,
+    .prf_sha512_final = openssl_prf_sha512_final,
+    .prf_blake2b_init = openssl_prf_blake2b_init,
+    .prf_blake2b_update = openssl_prf_blake2b_update,
+    .prf_blake2b_final = openssl_prf_blake2b_final,
+    .prf_copy = openssl_prf_copy,
+    .prf_release = openssl_prf_release,
+    .ed25519_key_pair_from_seed = openssl_ed25519_key_pair_from_seed,
+    .sign_ed25519 = openssl_sign_ed25519,
+    .verify_ed25519 = openssl_verify_ed25519,
+    .batch_verify_ed25519 = openssl_batch_verify_ed25519,
+    .aead_chacha_is_available = openssl_aead_chacha_is_available,
+    .aead_aes256_is_available = openssl_aead_aes256_is_available,
+    .aead_chacha_encrypt_detached = openssl_aead_chacha_encrypt_detached,
+    .aead_chacha_decrypt_detached = openssl_aead_chacha_decrypt_detached,
+    .aead_aes256_encrypt_detached = openssl_aead_aes256_encrypt_detached,
+    .aead_aes256_decrypt_detached = openssl_aead_aes256_decrypt_detached,
+    .aead_aes256_expand_key = openssl_aead_aes256_expand_key,
+    .aead_aes256_encrypt_detached_expanded = openssl_aead_aes256_encrypt_detached_expanded,
+    .aead_aes256_decrypt_detached_expanded = openssl_aead_aes256_decrypt_detached_expanded,
+};
@@ -0,0 +1,444 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt/record.h>
+#include <xtt/crypto_wrapper.h>
+
+#include "internal/message_utils.h"
+#include "internal/byte_utils.h"
+#include "internal/stats.h"
+
+#include <string.h>
+#include <assert.h>
+
+#define REPLAY_WINDOW_MASK(ctx) ((uint32_t)(ctx)->rx_replay_window_words - 1)
+#define REPLAY_WINDOW_SIZE(ctx) (((uint32_t)(ctx)->rx_replay_window_words - 1) * 64)
+
+typedef union {
+    xtt_chacha_nonce chacha;
+    xtt_aes256_nonce aes256;
+} record_nonce;
+
+static xtt_error_code
+seal_record(unsigned char *record,
+            uint16_t *record_length_out,
+            uint16_t payload_length,
+            xtt_encapsulated_payload_type payload_type,
+            struct xtt_session_context *ctx);
+
+static xtt_error_code
+open_record(unsigned char **payload_out,
+            uint16_t *payload_length_out,
+            xtt_encapsulated_payload_type *payload_type_out,
+            unsigned char *record,
+            uint16_t record_length,
+            struct xtt_session_context *ctx);
+
+static void
+prepare_record_nonce(record_nonce *nonce_out,
+                     const unsigned char *iv,
+                     uint16_t iv_length,
+                     xtt_sequence_number sequence_number);
+
+static uint32_t
+iov_total_length(const struct iovec *iov,
+                 int iovcnt);
+
+static xtt_error_code
+check_replay_window(const struct xtt_session_context *ctx,
+                    xtt_sequence_number sequence_number);
+
+static void
+update_replay_window(struct xtt_session_context *ctx,
+                     xtt_sequence_number sequence_number);
+
+xtt_error_code
+xtt_encrypt_record(unsigned char *record,
+                   uint16_t *record_length_out,
+                   uint16_t payload_length,
+                   xtt_encapsulated_payload_type payload_type,
+                   struct xtt_session_context *ctx)
+{
+    if (NULL == record || NULL == record_length_out || NULL == ctx)
+        return XTT_ERROR_NULL_BUFFER;
+
+    xtt_error_code rc = seal_record(record, record_length_out, payload_length, payload_type, ctx);
+    STATS_COUNT_ERROR(rc);
+
+    return rc;
+}
+
+xtt_error_code
+xtt_decrypt_record(unsigned char **payload_out,
+                   uint16_t *payload_length_out,
+                   xtt_encapsulated_payload_type *payload_type_out,
+                   unsigned char *record,
+                   uint16_t record_length,
+                   struct xtt_session_context *ctx)
+{
+    if (NULL == payload_out || NULL == payload_length_out || NULL == payload_type_out
+            || NULL == record || NULL == ctx)
+        return XTT_ERROR_NULL_BUFFER;
+
+    xtt_error_code rc = open_record(payload_out, payload_length_out, payload_type_out, record, record_length, ctx);
+    STATS_COUNT_ERROR(rc);
+
+    return rc;
+}
+
+xtt_error_code
+xtt_encrypt_record_iov(unsigned char *record_out,
+                       uint16_t *record_length_out,
+                       uint16_t record_out_capacity,
+                       const struct iovec *payload_iov,
+                       int payload_iovcnt,
+                       xtt_encapsulated_payload_type payload_type,
+                       struct xtt_session_context *ctx)
+{
+    if (NULL == record_out || NULL == record_length_out || NULL == ctx
+            || (NULL == payload_iov && 0 != payload_iovcnt))
+        return XTT_ERROR_NULL_BUFFER;
+
+    uint32_t payload_length = iov_total_length(payload_iov, payload_iovcnt);
+    if (record_out_capacity < XTT_RECORD_OVERHEAD
+            || payload_length > (uint32_t)(record_out_capacity - XTT_RECORD_OVERHEAD))
+        return XTT_ERROR_INCORRECT_LENGTH;
+
+    // Gather the fragments straight into their place in the record,
+    // which is then sealed in place.
+    unsigned char *payload = record_out + XTT_RECORD_HEADER_LENGTH;
+    for (int i = 0; i < payload_iovcnt; ++i) {
+        memcpy(payload, payload_iov[i].iov_base, payload_iov[i].iov_len);
+        payload += payload_iov[i].iov_len;
+    }
+
+    xtt_error_code rc = seal_record(record_out, record_length_out, payload_length, payload_type, ctx);
+    STATS_COUNT_ERROR(rc);
+
+    return rc;
+}
+
+xtt_error_code
+xtt_decrypt_record_iov(const struct iovec *payload_iov,
+                       int payload_iovcnt,
+                       uint16_t *payload_length_out,
+                       xtt_encapsulated_payload_type *payload_type_out,
+                       unsigned char *record,
+                       uint16_t record_length,
+                       struct xtt_session_context *ctx)
+{
+    if (NULL == payload_length_out || NULL == payload_type_out || NULL == record || NULL == ctx
+            || (NULL == payload_iov && 0 != payload_iovcnt))
+        return XTT_ERROR_NULL_BUFFER;
+
+    // Check there's room before decrypting, so a record that won't fit doesn't use up its sequence number.
+    if (record_length < XTT_RECORD_OVERHEAD
+            || (uint32_t)(record_length - XTT_RECORD_OVERHEAD) > iov_total_length(payload_iov, payload_iovcnt))
+        return XTT_ERROR_INCORRECT_LENGTH;
+
+    unsigned char *payload;
+    uint16_t payload_length;
+    xtt_error_code rc = open_record(&payload, &payload_length, payload_type_out, record, record_length, ctx);
+    STATS_COUNT_ERROR(rc);
+    if (XTT_ERROR_SUCCESS != rc)
+        return rc;
+
+    // Scatter the payload out to the caller's fragments.
+    uint16_t remaining = payload_length;
+    for (int i = 0; i < payload_iovcnt && remaining > 0; ++i) {
+        uint16_t fragment_length = payload_iov[i].iov_len < remaining ? payload_iov[i].iov_len : remaining;
+        memcpy(payload_iov[i].iov_base, payload, fragment_length);
+        payload += fragment_length;
+        remaining -= fragment_length;
+    }
+
+    *payload_length_out = payload_length;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+xtt_encrypt_records(struct xtt_record_batch_item *items,
+                    uint16_t item_count)
+{
+    if (NULL == items && 0 != item_count)
+        return XTT_ERROR_NULL_BUFFER;
+
+    xtt_error_code first_failure = XTT_ERROR_SUCCESS;
+
+    for (uint16_t i = 0; i < item_count; ++i) {
+        struct xtt_record_batch_item *item = &items[i];
+
+        if (NULL == item->record || NULL == item->ctx) {
+            item->status = XTT_ERROR_NULL_BUFFER;
+        } else {
+            item->status = seal_record(item->record,
+                                       &item->record_length,
+                                       item->payload_length,
+                                       item->payload_type,
+                                       item->ctx);
+            STATS_COUNT_ERROR(item->status);
+        }
+
+        if (XTT_ERROR_SUCCESS == first_failure)
+            first_failure = item->status;
+    }
+
+    return first_failure;
+}
+
+xtt_error_code
+xtt_decrypt_records(struct xtt_record_batch_item *items,
+                    uint16_t item_count)
+{
+    if (NULL == items && 0 != item_count)
+        return XTT_ERROR_NULL_BUFFER;
+
+    xtt_error_code first_failure = XTT_ERROR_SUCCESS;
+
+    for (uint16_t i = 0; i < item_count; ++i) {
+        struct xtt_record_batch_item *item = &items[i];
+
+        if (NULL == item->record || NULL == item->ctx) {
+            item->status = XTT_ERROR_NULL_BUFFER;
+        } else {
+            item->status = open_record(&item->payload,
+                                       &item->payload_length,
+                                       &item->payload_type,
+                                       item->record,
+                                       item->record_length,
+                                       item->ctx);
+            STATS_COUNT_ERROR(item->status);
+        }
+
+        if (XTT_ERROR_SUCCESS == first_failure)
+            first_failure = item->status;
+    }
+
+    return first_failure;
+}
+
+xtt_error_code
+seal_record(unsigned char *record,
+            uint16_t *record_length_out,
+            uint16_t payload_length,
+            xtt_encapsulated_payload_type payload_type,
+            struct xtt_session_context *ctx)
+{
+    uint16_t unencrypted_length = xtt_record_unencrypted_header_length(ctx->version);
+    uint16_t encrypted_header_length = xtt_record_encrypted_header_length(ctx->version);
+    assert(XTT_RECORD_HEADER_LENGTH == unencrypted_length + encrypted_header_length);
+    assert(XTT_RECORD_MAC_LENGTH == ctx->mac_length);
+
+    if (payload_length > UINT16_MAX - XTT_RECORD_OVERHEAD)
+        return XTT_ERROR_INCORRECT_LENGTH;
+    uint16_t record_length = payload_length + XTT_RECORD_OVERHEAD;
+
+    if (UINT32_MAX == ctx->tx_sequence_num)
+        return XTT_ERROR_UINT32_OVERFLOW;
+
+    // 1) Fill in the header, in front of the payload.
+    *xtt_access_msg_type(record) = XTT_RECORD_REGULAR_MSG;
+    short_to_bigendian(record_length, xtt_access_length(record));
+    *xtt_access_version(record) = ctx->version;
+    memcpy(xtt_record_access_session_id(record, ctx->version),
+           ctx->session_id.data,
+           sizeof(xtt_session_id));
+    long_to_bigendian(ctx->tx_sequence_num,
+                      (unsigned char*)xtt_record_access_sequence_num(record, ctx->version));
+
+    unsigned char *encrypted_start = record + unencrypted_length;
+    *xtt_encrypted_payload_access_encapsulated_payload_type(encrypted_start, ctx->version) = payload_type;
+
+    // 2) Encrypt the payload type and payload in place, with the MAC going right after them.
+    record_nonce nonce;
+    prepare_record_nonce(&nonce, ctx->tx_iv.chacha.data, ctx->iv_length, ctx->tx_sequence_num);
+
+    uint16_t encrypted_length = encrypted_header_length + payload_length;
+    int seal_rc = ctx->seal(encrypted_start + encrypted_length,
+                            encrypted_start,
+                            encrypted_length,
+                            record,
+                            unencrypted_length,
+                            (const unsigned char*)&nonce,
+                            ctx);
+
+    xtt_crypto_secure_clear((unsigned char*)&nonce, sizeof(nonce));
+
+    if (0 != seal_rc)
+        return XTT_ERROR_RECORD_FAILED_CRYPTO;
+
+    ctx->tx_sequence_num++;
+
+    *record_length_out = record_length;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+open_record(unsigned char **payload_out,
+            uint16_t *payload_length_out,
+            xtt_encapsulated_payload_type *payload_type_out,
+            unsigned char *record,
+            uint16_t record_length,
+            struct xtt_session_context *ctx)
+{
+    // 1) Check the header.
+    if (record_length < XTT_RECORD_OVERHEAD)
+        return XTT_ERROR_INCORRECT_LENGTH;
+
+    if (XTT_RECORD_REGULAR_MSG != *xtt_access_msg_type(record))
+        return XTT_ERROR_INCORRECT_TYPE;
+
+    if (ctx->version != *xtt_access_version(record))
+        return XTT_ERROR_UNKNOWN_VERSION;
+
+    uint16_t length_field;
+    bigendian_to_short(xtt_access_length(record), &length_field);
+    if (record_length != length_field)
+        return XTT_ERROR_INCORRECT_LENGTH;
+
+    if (0 != memcmp(xtt_record_access_session_id(record, ctx->version),
+                    ctx->session_id.data,
+                    sizeof(xtt_session_id)))
+        return XTT_ERROR_RECORD_FAILED_CRYPTO;
+
+    // 2) Check the sequence number against the replay window
+    //    (but only record it once the record's been authenticated).
+    xtt_sequence_number sequence_number;
+    bigendian_to_long((const unsigned char*)xtt_record_access_sequence_num(record, ctx->version),
+                      &sequence_number);
+    xtt_error_code window_rc = check_replay_window(ctx, sequence_number);
+    if (XTT_ERROR_RECORD_REPLAYED == window_rc)
+        ctx->replayed_records++;
+    else if (XTT_ERROR_RECORD_TOO_OLD == window_rc)
+        ctx->too_old_records++;
+    if (XTT_ERROR_SUCCESS != window_rc)
+        return window_rc;
+
+    // 3) Authenticate and decrypt the payload type and payload in place.
+    uint16_t unencrypted_length = xtt_record_unencrypted_header_length(ctx->version);
+    uint16_t encrypted_length = record_length - unencrypted_length - ctx->mac_length;
+    unsigned char *encrypted_start = record + unencrypted_length;
+
+    record_nonce nonce;
+    prepare_record_nonce(&nonce, ctx->rx_iv.chacha.data, ctx->iv_length, sequence_number);
+
+    int open_rc = ctx->open(encrypted_start,
+                            encrypted_length,
+                            encrypted_start + encrypted_length,
+                            record,
+                            unencrypted_length,
+                            (const unsigned char*)&nonce,
+                            ctx);
+
+    xtt_crypto_secure_clear((unsigned char*)&nonce, sizeof(nonce));
+
+    if (0 != open_rc)
+        return XTT_ERROR_RECORD_FAILED_CRYPTO;
+
+    update_replay_window(ctx, sequence_number);
+
+    // 4) Hand back the payload, where it sits in the record.
+    *payload_type_out = *xtt_encrypted_payload_access_encapsulated_payload_type(encrypted_start, ctx->version);
+    *payload_out = xtt_encrypted_payload_access_payload(encrypted_start, ctx->version);
+    *payload_length_out = encrypted_length - xtt_record_encrypted_header_length(ctx->version);
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void
+prepare_record_nonce(record_nonce *nonce_out,
+                     const unsigned char *iv,
+                     uint16_t iv_length,
+                     xtt_sequence_number sequence_number)
+{
+    // Same as prepare_nonce, but starting from the IV rather than from zeroes,
+    // so only the sequence number's bytes need XORing in.
+    unsigned char sequence_number_bytes[sizeof(xtt_sequence_number)];
+
+    assert(iv_length == sizeof(*nonce_out));
+    memcpy(nonce_out, iv, iv_length);
+
+    long_to_bigendian(sequence_number, sequence_number_bytes);
+    xor_equals((unsigned char*)nonce_out + iv_length - sizeof(xtt_sequence_number),
+               sequence_number_bytes,
+               sizeof(xtt_sequence_number));
+}
+
+uint32_t
+iov_total_length(const struct iovec *iov,
+                 int iovcnt)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len > UINT16_MAX)
+            return UINT32_MAX;
+        total += iov[i].iov_len;
+        if (total > UINT16_MAX)
+            return UINT32_MAX;
+    }
+
+    return total;
+}
+
+xtt_error_code
+check_replay_window(const struct xtt_session_context *ctx,
+                    xtt_sequence_number sequence_number)
+{
+    // Never sent (see seal_record), so one past it can't overflow.
+    if (UINT32_MAX == sequence_number)
+        return XTT_ERROR_RECORD_FAILED_CRYPTO;
+
+    // Newer than anything received yet.
+    if (sequence_number >= ctx->rx_sequence_num)
+        return XTT_ERROR_SUCCESS;
+
+    // So far behind that its word has already been reused.
+    if (ctx->rx_sequence_num - sequence_number > REPLAY_WINDOW_SIZE(ctx))
+        return XTT_ERROR_RECORD_TOO_OLD;
+
+    uint64_t word = ctx->rx_replay_window[(sequence_number / 64) & REPLAY_WINDOW_MASK(ctx)];
+    if (1 & (word >> (sequence_number % 64)))
+        return XTT_ERROR_RECORD_REPLAYED;
+
+    return XTT_ERROR_SUCCESS;
+}
+
+void
+update_replay_window(struct xtt_session_context *ctx,
+                     xtt_sequence_number sequence_number)
+{
+    // If this is the newest yet, slide the window forward:
+    // clear the words after the old newest's, up to and including this one's (at most all of them).
+    if (sequence_number >= ctx->rx_sequence_num) {
+        // (If nothing's been received yet, word 0 is already clear.)
+        uint32_t current_index = ctx->rx_sequence_num > 0 ? (ctx->rx_sequence_num - 1) / 64 : 0;
+        uint32_t new_index = sequence_number / 64;
+        uint32_t words_to_clear = new_index - current_index;
+        if (words_to_clear > ctx->rx_replay_window_words)
+            words_to_clear = ctx->rx_replay_window_words;
+
+        for (uint32_t i = 1; i <= words_to_clear; ++i)
+            ctx->rx_replay_window[(current_index + i) & REPLAY_WINDOW_MASK(ctx)] = 0;
+
+        ctx->rx_sequence_num = sequence_number + 1;
+    }
+
+    ctx->rx_replay_window[(sequence_number / 64) & REPLAY_WINDOW_MASK(ctx)] |= (uint64_t)1 << (sequence_number % 64);
+}
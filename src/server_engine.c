@@ -0,0 +1,439 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt/server_engine.h>
+#include <xtt/messages.h>
+
+#include "internal/server_handshake.h"
+#include "internal/stats.h"
+
+#include <string.h>
+#include <assert.h>
+
+static void* worker_main(void *arg);
+
+static void push_job(struct xtt_server_engine *engine,
+                     xtt_server_engine_stage stage,
+                     struct xtt_server_engine_job *job);
+
+static struct xtt_server_engine_job* pop_own_job(struct xtt_server_engine_worker *self);
+
+static struct xtt_server_engine_job* steal_job(struct xtt_server_engine_stage_pool *pool,
+                                               uint16_t thief_index);
+
+static void run_stage(struct xtt_server_engine *engine,
+                      xtt_server_engine_stage stage,
+                      struct xtt_server_engine_job *job);
+
+static void run_verify_batch(struct xtt_server_engine_worker *self,
+                             struct xtt_server_engine_job *first_job);
+
+static void complete_job(struct xtt_server_engine *engine,
+                         struct xtt_server_engine_job *job,
+                         xtt_error_code rc);
+
+static void stop_stage(struct xtt_server_engine_stage_pool *pool,
+                       uint16_t started_workers);
+
+xtt_error_code
+xtt_initialize_server_engine(struct xtt_server_engine *engine,
+                             const struct xtt_server_engine_config *config)
+{
+    if (NULL == config->certificate_ctx
+            || NULL == config->cookie_ctx
+            || NULL == config->lookup_gpk
+            || NULL == config->on_complete)
+        return XTT_ERROR_BAD_INIT;
+
+    for (int stage = 0; stage < XTT_SERVER_ENGINE_STAGE_COUNT; ++stage) {
+        if (0 == config->workers_per_stage[stage]
+                || XTT_SERVER_ENGINE_MAX_WORKERS < config->workers_per_stage[stage])
+            return XTT_ERROR_BAD_INIT;
+    }
+
+    engine->config = *config;
+    engine->running = 0;
+
+    // 1) Set up every stage's queues before starting any threads,
+    //  since workers in one stage push into the next.
+    for (int stage = 0; stage < XTT_SERVER_ENGINE_STAGE_COUNT; ++stage) {
+        struct xtt_server_engine_stage_pool *pool = &engine->stages[stage];
+
+        pool->worker_count = config->workers_per_stage[stage];
+        pool->next_worker = 0;
+        pool->depth = 0;
+        pool->shutdown = 0;
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->cond, NULL);
+
+        for (uint16_t i = 0; i < pool->worker_count; ++i) {
+            struct xtt_server_engine_worker *worker = &pool->workers[i];
+            worker->engine = engine;
+            worker->stage = (xtt_server_engine_stage)stage;
+            worker->index = i;
+            worker->head = NULL;
+            worker->tail = NULL;
+            pthread_mutex_init(&worker->lock, NULL);
+        }
+    }
+
+    // 2) Start the workers.
+    for (int stage = 0; stage < XTT_SERVER_ENGINE_STAGE_COUNT; ++stage) {
+        struct xtt_server_engine_stage_pool *pool = &engine->stages[stage];
+
+        for (uint16_t i = 0; i < pool->worker_count; ++i) {
+            if (0 != pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i])) {
+                // Nothing's been submitted yet, so just stop what we've started.
+                stop_stage(pool, i);
+                for (int started = 0; started < stage; ++started)
+                    stop_stage(&engine->stages[started], engine->stages[started].worker_count);
+                for (int unstarted = stage + 1; unstarted < XTT_SERVER_ENGINE_STAGE_COUNT; ++unstarted)
+                    stop_stage(&engine->stages[unstarted], 0);
+
+                return XTT_ERROR_BAD_INIT;
+            }
+        }
+    }
+
+    __atomic_store_n(&engine->running, 1, __ATOMIC_RELEASE);
+
+    return XTT_ERROR_SUCCESS;
+}
+
+xtt_error_code
+xtt_server_engine_submit(struct xtt_server_engine *engine,
+                         struct xtt_server_engine_job *job)
+{
+    if (!__atomic_load_n(&engine->running, __ATOMIC_ACQUIRE))
+        return XTT_ERROR_BAD_INIT;
+
+    job->msg_type = xtt_get_message_type(job->in_message);
+    if (XTT_CLIENTINIT_MSG != job->msg_type && XTT_ID_CLIENTATTEST_MSG != job->msg_type)
+        return XTT_ERROR_INCORRECT_TYPE;
+
+    job->rc = XTT_ERROR_SUCCESS;
+    job->out_length = 0;
+    job->gpk_ctx = NULL;
+
+    push_job(engine, XTT_SERVER_ENGINE_STAGE_PARSE, job);
+
+    return XTT_ERROR_SUCCESS;
+}
+
+uint32_t
+xtt_server_engine_queue_depth(const struct xtt_server_engine *engine,
+                              xtt_server_engine_stage stage)
+{
+    assert(stage < XTT_SERVER_ENGINE_STAGE_COUNT);
+
+    return __atomic_load_n(&engine->stages[stage].depth, __ATOMIC_RELAXED);
+}
+
+void
+xtt_server_engine_shutdown(struct xtt_server_engine *engine)
+{
+    __atomic_store_n(&engine->running, 0, __ATOMIC_RELEASE);
+
+    // Jobs only ever move to later stages,
+    // so stopping the stages in order drains every queue.
+    for (int stage = 0; stage < XTT_SERVER_ENGINE_STAGE_COUNT; ++stage)
+        stop_stage(&engine->stages[stage], engine->stages[stage].worker_count);
+}
+
+void*
+worker_main(void *arg)
+{
+    struct xtt_server_engine_worker *self = arg;
+    struct xtt_server_engine_stage_pool *pool = &self->engine->stages[self->stage];
+
+    for (;;) {
+        // 1) Take from our own queue first, then try to steal from our siblings.
+        struct xtt_server_engine_job *job = pop_own_job(self);
+        if (NULL == job)
+            job = steal_job(pool, self->index);
+
+        if (NULL != job) {
+            __atomic_sub_fetch(&pool->depth, 1, __ATOMIC_ACQ_REL);
+
+            if (XTT_SERVER_ENGINE_STAGE_DAA_VERIFY == self->stage)
+                run_verify_batch(self, job);
+            else
+                run_stage(self->engine, self->stage, job);
+
+            continue;
+        }
+
+        // 2) Nothing to do, so wait for a submission (or shutdown).
+        // A non-zero depth with nothing poppable just means a push is in-progress,
+        // so go around again.
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->shutdown && 0 == __atomic_load_n(&pool->depth, __ATOMIC_ACQUIRE))
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        int done = pool->shutdown && 0 == __atomic_load_n(&pool->depth, __ATOMIC_ACQUIRE);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (done)
+            break;
+    }
+
+    return NULL;
+}
+
+void
+push_job(struct xtt_server_engine *engine,
+         xtt_server_engine_stage stage,
+         struct xtt_server_engine_job *job)
+{
+    struct xtt_server_engine_stage_pool *pool = &engine->stages[stage];
+
+    // Count the job before it's visible, so the depth never goes negative.
+    __atomic_add_fetch(&pool->depth, 1, __ATOMIC_ACQ_REL);
+
+    uint32_t next = __atomic_fetch_add(&pool->next_worker, 1, __ATOMIC_RELAXED);
+    struct xtt_server_engine_worker *worker = &pool->workers[next % pool->worker_count];
+
+    pthread_mutex_lock(&worker->lock);
+    job->next = NULL;
+    job->prev = worker->tail;
+    if (NULL != worker->tail)
+        worker->tail->next = job;
+    else
+        worker->head = job;
+    worker->tail = job;
+    pthread_mutex_unlock(&worker->lock);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+struct xtt_server_engine_job*
+pop_own_job(struct xtt_server_engine_worker *self)
+{
+    // Owners take from the head, so their own jobs are handled in order.
+    pthread_mutex_lock(&self->lock);
+    struct xtt_server_engine_job *job = self->head;
+    if (NULL != job) {
+        self->head = job->next;
+        if (NULL != self->head)
+            self->head->prev = NULL;
+        else
+            self->tail = NULL;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    return job;
+}
+
+struct xtt_server_engine_job*
+steal_job(struct xtt_server_engine_stage_pool *pool,
+          uint16_t thief_index)
+{
+    // Thieves take from the tail, to stay out of the owner's way.
+    for (uint16_t i = 1; i < pool->worker_count; ++i) {
+        struct xtt_server_engine_worker *victim = &pool->workers[(thief_index + i) % pool->worker_count];
+
+        pthread_mutex_lock(&victim->lock);
+        struct xtt_server_engine_job *job = victim->tail;
+        if (NULL != job) {
+            victim->tail = job->prev;
+            if (NULL != victim->tail)
+                victim->tail->next = NULL;
+            else
+                victim->head = NULL;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (NULL != job)
+            return job;
+    }
+
+    return NULL;
+}
+
+void
+run_stage(struct xtt_server_engine *engine,
+          xtt_server_engine_stage stage,
+          struct xtt_server_engine_job *job)
+{
+    const struct xtt_server_engine_config *config = &engine->config;
+    xtt_error_code rc = XTT_ERROR_SUCCESS;
+
+    switch (stage) {
+        case XTT_SERVER_ENGINE_STAGE_PARSE:
+            if (XTT_CLIENTINIT_MSG == job->msg_type) {
+                rc = build_serverinitandattest_unencrypted_part(job->out_buffer,
+                                                                job->handshake_ctx,
+                                                                job->in_message,
+                                                                config->cookie_ctx,
+                                                                config->key_pool);
+                if (XTT_ERROR_SUCCESS != rc)
+                    break;
+
+                if (NULL != config->suite_preferences
+                        && !xtt_suite_preferences_allow(config->suite_preferences, job->handshake_ctx->base.suite_spec)) {
+                    rc = XTT_ERROR_UNKNOWN_SUITE_SPEC;
+                    break;
+                }
+
+                push_job(engine, XTT_SERVER_ENGINE_STAGE_KEY_DERIVATION, job);
+                return;
+            } else {
+                xtt_client_id requested_client_id;
+                rc = xtt_pre_parse_client_attest(&requested_client_id,
+                                                 &job->daa_group_id,
+                                                 job->in_message,
+                                                 config->cookie_ctx,
+                                                 job->handshake_ctx);
+                if (XTT_ERROR_SUCCESS != rc) {
+                    // (Already counted, by xtt_pre_parse_client_attest).
+                    complete_job(engine, job, rc);
+                    return;
+                }
+
+                rc = config->lookup_gpk(&job->gpk_ctx,
+                                        &job->daa_group_id,
+                                        config->user_data);
+                if (XTT_ERROR_SUCCESS != rc)
+                    break;
+
+                if (NULL != config->assign_client_id) {
+                    rc = config->assign_client_id(&job->client_id,
+                                                  &requested_client_id,
+                                                  &job->daa_group_id,
+                                                  config->user_data);
+                    if (XTT_ERROR_SUCCESS != rc)
+                        break;
+                } else {
+                    job->client_id = requested_client_id;
+                }
+
+                push_job(engine, XTT_SERVER_ENGINE_STAGE_DAA_VERIFY, job);
+                return;
+            }
+        case XTT_SERVER_ENGINE_STAGE_KEY_DERIVATION:
+            rc = derive_serverinitandattest_keys(job->out_buffer,
+                                                 job->in_message,
+                                                 job->handshake_ctx);
+            if (XTT_ERROR_SUCCESS != rc)
+                break;
+
+            push_job(engine, XTT_SERVER_ENGINE_STAGE_SIGN, job);
+            return;
+        case XTT_SERVER_ENGINE_STAGE_SIGN:
+            rc = sign_and_encrypt_serverinitandattest(job->out_buffer,
+                                                      &job->out_length,
+                                                      job->in_message,
+                                                      config->certificate_ctx,
+                                                      job->handshake_ctx);
+            break;
+        case XTT_SERVER_ENGINE_STAGE_DAA_VERIFY:
+            // (Run in batches, by run_verify_batch).
+        case XTT_SERVER_ENGINE_STAGE_COUNT:
+            assert(0);
+            break;
+    }
+
+    STATS_COUNT_ERROR(rc);
+    complete_job(engine, job, rc);
+}
+
+void
+run_verify_batch(struct xtt_server_engine_worker *self,
+                 struct xtt_server_engine_job *first_job)
+{
+    struct xtt_server_engine *engine = self->engine;
+    struct xtt_server_engine_stage_pool *pool = &engine->stages[self->stage];
+
+    struct xtt_server_engine_job *batch[XTT_SERVER_ENGINE_VERIFY_BATCH];
+    struct xtt_identity_verification_job verification_jobs[XTT_SERVER_ENGINE_VERIFY_BATCH];
+    uint16_t batch_size = 0;
+
+    // 1) Take whatever else is already waiting in our own queue (but don't wait for more).
+    batch[batch_size++] = first_job;
+    while (batch_size < XTT_SERVER_ENGINE_VERIFY_BATCH) {
+        struct xtt_server_engine_job *job = pop_own_job(self);
+        if (NULL == job)
+            break;
+        __atomic_sub_fetch(&pool->depth, 1, __ATOMIC_ACQ_REL);
+
+        batch[batch_size++] = job;
+    }
+
+    // 2) Capture each job's signatures (dropping any that fail here).
+    uint16_t pending = 0;
+    for (uint16_t i = 0; i < batch_size; ++i) {
+        xtt_error_code rc = xtt_submit_identity_server_finished(&verification_jobs[pending],
+                                                                batch[i]->in_message,
+                                                                batch[i]->gpk_ctx,
+                                                                engine->config.certificate_ctx,
+                                                                batch[i]->handshake_ctx);
+        if (XTT_ERROR_SUCCESS != rc) {
+            STATS_COUNT_ERROR(rc);
+            complete_job(engine, batch[i], rc);
+            continue;
+        }
+
+        batch[pending++] = batch[i];
+    }
+
+    // 3) Verify them all together.
+    (void)xtt_verify_identity_client_attests(verification_jobs, pending);
+
+    // 4) Build each ServerFinished (or Error).
+    for (uint16_t i = 0; i < pending; ++i) {
+        xtt_error_code rc = xtt_complete_identity_server_finished(batch[i]->out_buffer,
+                                                                  &batch[i]->out_length,
+                                                                  &verification_jobs[i],
+                                                                  &batch[i]->client_id,
+                                                                  engine->config.cookie_ctx,
+                                                                  batch[i]->handshake_ctx);
+        complete_job(engine, batch[i], rc);
+    }
+}
+
+void
+complete_job(struct xtt_server_engine *engine,
+             struct xtt_server_engine_job *job,
+             xtt_error_code rc)
+{
+    job->rc = rc;
+
+    if (XTT_ERROR_SUCCESS != rc)
+        (void)build_error_msg(job->out_buffer, &job->out_length, job->handshake_ctx->base.version);
+
+    engine->config.on_complete(job, engine->config.user_data);
+}
+
+void
+stop_stage(struct xtt_server_engine_stage_pool *pool,
+           uint16_t started_workers)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint16_t i = 0; i < started_workers; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    for (uint16_t i = 0; i < pool->worker_count; ++i)
+        pthread_mutex_destroy(&pool->workers[i].lock);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+}
@@ -0,0 +1,273 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <xtt/stats.h>
+
+#include "internal/stats.h"
+
+#include <string.h>
+#include <time.h>
+
+// Threads past this many share one slot, which they update with atomic read-modify-writes.
+#ifndef XTT_STATS_MAX_THREADS
+#define XTT_STATS_MAX_THREADS 64
+#endif
+
+#ifdef XTT_ENABLE_STATS
+
+// Each slot starts on its own cache line, so threads never write to a line another thread is writing.
+struct stats_slot {
+    struct xtt_stats_histogram phases[XTT_STATS_PHASE_COUNT];
+    uint64_t errors[XTT_ERROR_CODE_COUNT];
+} __attribute__((aligned(64)));
+
+static struct stats_slot slots[XTT_STATS_MAX_THREADS];
+static struct stats_slot overflow_slot;
+static uint32_t slots_claimed;
+
+// A thread keeps its slot for the life of the process.
+static __thread struct stats_slot *thread_slot;
+
+static struct stats_slot* this_thread_slot(void);
+
+static void add(uint64_t *counter, uint64_t value, int shared);
+
+static void raise_max(uint64_t *max, uint64_t value, int shared);
+
+static void merge_slot(struct xtt_stats *stats_out, const struct stats_slot *slot);
+
+static uint32_t bucket_index(uint64_t ns);
+
+#endif
+
+xtt_error_code
+xtt_stats_snapshot(struct xtt_stats *stats_out)
+{
+    if (NULL == stats_out)
+        return XTT_ERROR_NULL_BUFFER;
+
+    memset(stats_out, 0, sizeof(*stats_out));
+
+#ifdef XTT_ENABLE_STATS
+    stats_out->enabled = 1;
+
+    uint32_t claimed = __atomic_load_n(&slots_claimed, __ATOMIC_ACQUIRE);
+    stats_out->threads = claimed;
+
+    if (claimed > XTT_STATS_MAX_THREADS)
+        claimed = XTT_STATS_MAX_THREADS;
+    for (uint32_t i = 0; i < claimed; ++i)
+        merge_slot(stats_out, &slots[i]);
+
+    merge_slot(stats_out, &overflow_slot);
+#endif
+
+    return XTT_ERROR_SUCCESS;
+}
+
+uint64_t
+xtt_stats_percentile(const struct xtt_stats_histogram *histogram,
+                     double fraction)
+{
+    if (0 == histogram->count)
+        return 0;
+
+    if (fraction < 0.0)
+        fraction = 0.0;
+    if (fraction > 1.0)
+        fraction = 1.0;
+
+    uint64_t target = (uint64_t)(fraction * (double)histogram->count);
+    if ((double)target < fraction * (double)histogram->count)
+        ++target;
+    if (0 == target)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < XTT_STATS_HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= target) {
+            uint64_t upper = xtt_stats_bucket_upper_bound(i);
+            return upper < histogram->max_ns ? upper : histogram->max_ns;
+        }
+    }
+
+    return histogram->max_ns;
+}
+
+uint64_t
+xtt_stats_bucket_upper_bound(uint32_t bucket)
+{
+    if (bucket < XTT_STATS_HISTOGRAM_LINEAR_BUCKETS)
+        return bucket;
+
+    if (bucket >= XTT_STATS_HISTOGRAM_BUCKETS - 1)
+        return UINT64_MAX;
+
+    uint32_t octave = (bucket - XTT_STATS_HISTOGRAM_LINEAR_BUCKETS) / XTT_STATS_HISTOGRAM_SUB_BUCKETS;
+    uint32_t sub = (bucket - XTT_STATS_HISTOGRAM_LINEAR_BUCKETS) % XTT_STATS_HISTOGRAM_SUB_BUCKETS;
+
+    // Buckets in the octave [2^(4+octave), 2^(5+octave)) are each 2^(1+octave) wide.
+    uint64_t width = (uint64_t)1 << (1 + octave);
+    return (XTT_STATS_HISTOGRAM_SUB_BUCKETS + sub + 1) * width - 1;
+}
+
+const char*
+xtt_stats_phase_string(xtt_stats_phase phase)
+{
+    switch (phase) {
+        case XTT_STATS_PHASE_DIFFIE_HELLMAN:
+            return "diffie_hellman";
+        case XTT_STATS_PHASE_KEY_DERIVATION:
+            return "key_derivation";
+        case XTT_STATS_PHASE_SERVER_SIGN:
+            return "server_sign";
+        case XTT_STATS_PHASE_DAA_VERIFY:
+            return "daa_verify";
+        case XTT_STATS_PHASE_LONGTERM_VERIFY:
+            return "longterm_verify";
+        case XTT_STATS_PHASE_AEAD:
+            return "aead";
+        default:
+            return "unknown";
+    }
+}
+
+#ifdef XTT_ENABLE_STATS
+
+uint64_t
+stats_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void
+stats_record_phase(xtt_stats_phase phase,
+                   uint64_t ns,
+                   uint32_t samples)
+{
+    if (0 == samples)
+        return;
+
+    struct stats_slot *slot = this_thread_slot();
+    int shared = (slot == &overflow_slot);
+    struct xtt_stats_histogram *histogram = &slot->phases[phase];
+    uint64_t each = ns / samples;
+
+    add(&histogram->count, samples, shared);
+    add(&histogram->total_ns, ns, shared);
+    add(&histogram->buckets[bucket_index(each)], samples, shared);
+    raise_max(&histogram->max_ns, each, shared);
+}
+
+void
+stats_count_error(xtt_error_code rc)
+{
+    if ((uint32_t)rc >= XTT_ERROR_CODE_COUNT)
+        return;
+
+    struct stats_slot *slot = this_thread_slot();
+
+    add(&slot->errors[rc], 1, slot == &overflow_slot);
+}
+
+struct stats_slot*
+this_thread_slot(void)
+{
+    if (NULL != thread_slot)
+        return thread_slot;
+
+    uint32_t index = __atomic_fetch_add(&slots_claimed, 1, __ATOMIC_ACQ_REL);
+    if (index < XTT_STATS_MAX_THREADS)
+        thread_slot = &slots[index];
+    else
+        thread_slot = &overflow_slot;
+
+    return thread_slot;
+}
+
+void
+add(uint64_t *counter, uint64_t value, int shared)
+{
+    // An owned slot has a single writer, so a plain (but untorn) load and store is enough.
+    if (shared)
+        __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+    else
+        __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+void
+raise_max(uint64_t *max, uint64_t value, int shared)
+{
+    uint64_t current = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    if (!shared) {
+        if (value > current)
+            __atomic_store_n(max, value, __ATOMIC_RELAXED);
+        return;
+    }
+
+    while (value > current
+            && !__atomic_compare_exchange_n(max, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void
+merge_slot(struct xtt_stats *stats_out, const struct stats_slot *slot)
+{
+    for (uint32_t phase = 0; phase < XTT_STATS_PHASE_COUNT; ++phase) {
+        const struct xtt_stats_histogram *in = &slot->phases[phase];
+        struct xtt_stats_histogram *out = &stats_out->phases[phase];
+
+        out->count += __atomic_load_n(&in->count, __ATOMIC_RELAXED);
+        out->total_ns += __atomic_load_n(&in->total_ns, __ATOMIC_RELAXED);
+
+        uint64_t max = __atomic_load_n(&in->max_ns, __ATOMIC_RELAXED);
+        if (max > out->max_ns)
+            out->max_ns = max;
+
+        for (uint32_t i = 0; i < XTT_STATS_HISTOGRAM_BUCKETS; ++i)
+            out->buckets[i] += __atomic_load_n(&in->buckets[i], __ATOMIC_RELAXED);
+    }
+
+    for (uint32_t code = 0; code < XTT_ERROR_CODE_COUNT; ++code)
+        stats_out->errors[code] += __atomic_load_n(&slot->errors[code], __ATOMIC_RELAXED);
+}
+
+uint32_t
+bucket_index(uint64_t ns)
+{
+    if (ns < XTT_STATS_HISTOGRAM_LINEAR_BUCKETS)
+        return (uint32_t)ns;
+
+    // 2^magnitude <= ns < 2^(magnitude+1), and magnitude >= 4.
+    uint32_t magnitude = 63 - __builtin_clzll(ns);
+    uint32_t sub = (uint32_t)(ns >> (magnitude - 3)) & (XTT_STATS_HISTOGRAM_SUB_BUCKETS - 1);
+    uint32_t index = XTT_STATS_HISTOGRAM_LINEAR_BUCKETS + (magnitude - 4) * XTT_STATS_HISTOGRAM_SUB_BUCKETS + sub;
+
+    if (index >= XTT_STATS_HISTOGRAM_BUCKETS)
+        return XTT_STATS_HISTOGRAM_BUCKETS - 1;
+
+    return index;
+}
+
+#endif
@@ -0,0 +1,421 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Cross-checks the libsodium and OpenSSL providers against each other.
+ * Where this library was built with only one of them, there's nothing to compare.
+ */
+
+struct handshake_record {
+    unsigned char messages[4096];
+    uint16_t messages_length;
+    unsigned char records[2][64 + XTT_RECORD_OVERHEAD];
+    uint16_t record_lengths[2];
+};
+
+static const struct xtt_crypto_provider *sodium_provider;
+static const struct xtt_crypto_provider *openssl_provider;
+
+static void use_deterministic_provider(const struct xtt_crypto_provider *base);
+static void append_message(struct handshake_record *record, const unsigned char *message, uint16_t length);
+static void run_session_handshake(struct handshake_record *record_out, xtt_suite_spec suite_spec);
+static void hashes_and_prfs_agree(void);
+static void signatures_and_key_agreement_agree(void);
+static void aeads_agree(void);
+static void handshakes_are_identical(xtt_suite_spec suite_spec);
+
+int main()
+{
+    sodium_provider = xtt_crypto_find_provider("libsodium");
+    openssl_provider = xtt_crypto_find_provider("openssl");
+    if (NULL == sodium_provider || NULL == openssl_provider) {
+        printf("crypto_provider-test: only one provider built, skipping\n");
+        return 0;
+    }
+
+    EXPECT_EQ(0, xtt_crypto_set_provider(openssl_provider));
+    EXPECT_EQ(0, xtt_crypto_set_provider(sodium_provider));
+
+    hashes_and_prfs_agree();
+    signatures_and_key_agreement_agree();
+    aeads_agree();
+    handshakes_are_identical(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512);
+    handshakes_are_identical(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B);
+    if (sodium_provider->aead_aes256_is_available() && openssl_provider->aead_aes256_is_available()) {
+        handshakes_are_identical(XTT_X25519_LRSW_ED25519_AES256GCM_SHA512);
+        handshakes_are_identical(XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B);
+    }
+}
+
+// splitmix64, so both providers see the same "random" bytes.
+static uint64_t deterministic_state;
+static struct xtt_crypto_provider deterministic_provider;
+
+static
+int deterministic_random(unsigned char* buffer, uint16_t buffer_length)
+{
+    for (uint16_t i = 0; i < buffer_length; ++i) {
+        if (0 == i % 8) {
+            deterministic_state += 0x9e3779b97f4a7c15ULL;
+        }
+        uint64_t z = deterministic_state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        buffer[i] = (unsigned char)(z >> (8 * (i % 8)));
+    }
+
+    return 0;
+}
+
+void use_deterministic_provider(const struct xtt_crypto_provider *base)
+{
+    deterministic_provider = *base;
+    deterministic_provider.get_random = deterministic_random;
+    deterministic_state = 0;
+
+    EXPECT_EQ(0, xtt_crypto_set_provider(&deterministic_provider));
+}
+
+void append_message(struct handshake_record *record, const unsigned char *message, uint16_t length)
+{
+    TEST_ASSERT(record->messages_length + length <= sizeof(record->messages));
+    memcpy(record->messages + record->messages_length, message, length);
+    record->messages_length += length;
+}
+
+void hashes_and_prfs_agree(void)
+{
+    printf("starting crypto_provider-test::hashes_and_prfs_agree...\n");
+
+    unsigned char in[300];
+    unsigned char key[64];
+    EXPECT_EQ(0, sodium_provider->get_random(in, sizeof(in)));
+    EXPECT_EQ(0, sodium_provider->get_random(key, sizeof(key)));
+
+    const struct xtt_crypto_provider *providers[2] = {sodium_provider, openssl_provider};
+    for (uint16_t in_len = 0; in_len <= sizeof(in); in_len += 75) {
+        unsigned char sha512[2][64];
+        unsigned char blake2b[2][64];
+        unsigned char prf_sha512[2][64];
+        unsigned char prf_blake2b_iv[2][12];
+        unsigned char prf_blake2b_key[2][32];
+        for (int p = 0; p < 2; ++p) {
+            EXPECT_EQ(0, xtt_crypto_set_provider(providers[p]));
+
+            uint16_t out_length;
+            EXPECT_EQ(0, xtt_crypto_hash_sha512(sha512[p], &out_length, in, in_len));
+            EXPECT_EQ(0, xtt_crypto_hash_blake2b(blake2b[p], &out_length, in, in_len));
+            EXPECT_EQ(0, xtt_crypto_prf_sha512(prf_sha512[p], sizeof(prf_sha512[p]), in, in_len, key, sizeof(key)));
+            EXPECT_EQ(0, xtt_crypto_prf_blake2b(prf_blake2b_iv[p], sizeof(prf_blake2b_iv[p]), in, in_len, key, sizeof(key)));
+            EXPECT_EQ(0, xtt_crypto_prf_blake2b(prf_blake2b_key[p], sizeof(prf_blake2b_key[p]), in, in_len, key, sizeof(key)));
+        }
+        EXPECT_EQ(0, memcmp(sha512[0], sha512[1], sizeof(sha512[0])));
+        EXPECT_EQ(0, memcmp(blake2b[0], blake2b[1], sizeof(blake2b[0])));
+        EXPECT_EQ(0, memcmp(prf_sha512[0], prf_sha512[1], sizeof(prf_sha512[0])));
+        EXPECT_EQ(0, memcmp(prf_blake2b_iv[0], prf_blake2b_iv[1], sizeof(prf_blake2b_iv[0])));
+        EXPECT_EQ(0, memcmp(prf_blake2b_key[0], prf_blake2b_key[1], sizeof(prf_blake2b_key[0])));
+    }
+
+    EXPECT_EQ(0, xtt_crypto_set_provider(sodium_provider));
+
+    printf("ok\n");
+}
+
+void signatures_and_key_agreement_agree(void)
+{
+    printf("starting crypto_provider-test::signatures_and_key_agreement_agree...\n");
+
+    unsigned char seed[32];
+    unsigned char msg[100];
+    xtt_x25519_priv_key x25519_priv[2];
+    EXPECT_EQ(0, sodium_provider->get_random(seed, sizeof(seed)));
+    EXPECT_EQ(0, sodium_provider->get_random(msg, sizeof(msg)));
+    EXPECT_EQ(0, sodium_provider->get_random(x25519_priv[0].data, sizeof(xtt_x25519_priv_key)));
+    EXPECT_EQ(0, sodium_provider->get_random(x25519_priv[1].data, sizeof(xtt_x25519_priv_key)));
+
+    const struct xtt_crypto_provider *providers[2] = {sodium_provider, openssl_provider};
+    xtt_ed25519_pub_key ed25519_pub[2];
+    xtt_ed25519_priv_key ed25519_priv[2];
+    xtt_ed25519_signature signature[2];
+    xtt_x25519_pub_key x25519_pub[2][2];
+    xtt_x25519_shared_secret shared_secret[2];
+    for (int p = 0; p < 2; ++p) {
+        EXPECT_EQ(0, providers[p]->ed25519_key_pair_from_seed(&ed25519_pub[p], &ed25519_priv[p], seed));
+        EXPECT_EQ(0, providers[p]->sign_ed25519(signature[p].data, msg, sizeof(msg), &ed25519_priv[p]));
+
+        EXPECT_EQ(0, providers[p]->x25519_public_key(&x25519_pub[p][0], &x25519_priv[0]));
+        EXPECT_EQ(0, providers[p]->x25519_public_key(&x25519_pub[p][1], &x25519_priv[1]));
+        EXPECT_EQ(0, providers[p]->do_x25519_diffie_hellman(shared_secret[p].data, &x25519_priv[0], &x25519_pub[p][1]));
+    }
+
+    EXPECT_EQ(0, memcmp(ed25519_pub[0].data, ed25519_pub[1].data, sizeof(xtt_ed25519_pub_key)));
+    EXPECT_EQ(0, memcmp(ed25519_priv[0].data, ed25519_priv[1].data, sizeof(xtt_ed25519_priv_key)));
+    EXPECT_EQ(0, memcmp(signature[0].data, signature[1].data, sizeof(xtt_ed25519_signature)));
+    EXPECT_EQ(0, memcmp(x25519_pub[0], x25519_pub[1], sizeof(x25519_pub[0])));
+    EXPECT_EQ(0, memcmp(shared_secret[0].data, shared_secret[1].data, sizeof(xtt_x25519_shared_secret)));
+
+    // Each verifies the other's signatures, and rejects the same forgery.
+    EXPECT_EQ(0, openssl_provider->verify_ed25519(signature[0].data, msg, sizeof(msg), &ed25519_pub[0]));
+    EXPECT_EQ(0, sodium_provider->verify_ed25519(signature[1].data, msg, sizeof(msg), &ed25519_pub[1]));
+    msg[0] ^= 1;
+    EXPECT_NE(0, openssl_provider->verify_ed25519(signature[0].data, msg, sizeof(msg), &ed25519_pub[0]));
+    EXPECT_NE(0, sodium_provider->verify_ed25519(signature[1].data, msg, sizeof(msg), &ed25519_pub[1]));
+
+    printf("ok\n");
+}
+
+void aeads_agree(void)
+{
+    printf("starting crypto_provider-test::aeads_agree...\n");
+
+    unsigned char message[100];
+    unsigned char addl[20];
+    xtt_chacha_key chacha_key;
+    xtt_chacha_nonce chacha_nonce;
+    xtt_aes256_key aes_key;
+    xtt_aes256_nonce aes_nonce;
+    EXPECT_EQ(0, sodium_provider->get_random(message, sizeof(message)));
+    EXPECT_EQ(0, sodium_provider->get_random(addl, sizeof(addl)));
+    EXPECT_EQ(0, sodium_provider->get_random(chacha_key.data, sizeof(chacha_key)));
+    EXPECT_EQ(0, sodium_provider->get_random(chacha_nonce.data, sizeof(chacha_nonce)));
+    EXPECT_EQ(0, sodium_provider->get_random(aes_key.data, sizeof(aes_key)));
+    EXPECT_EQ(0, sodium_provider->get_random(aes_nonce.data, sizeof(aes_nonce)));
+
+    const struct xtt_crypto_provider *providers[2] = {sodium_provider, openssl_provider};
+    unsigned char ciphertext[2][sizeof(message)];
+    unsigned char mac[2][16];
+    unsigned char decrypted[sizeof(message)];
+
+    // 1) ChaCha20-Poly1305
+    for (int p = 0; p < 2; ++p)
+        EXPECT_EQ(0, providers[p]->aead_chacha_encrypt_detached(ciphertext[p], mac[p], message, sizeof(message),
+                                                                addl, sizeof(addl), &chacha_nonce, &chacha_key));
+    EXPECT_EQ(0, memcmp(ciphertext[0], ciphertext[1], sizeof(message)));
+    EXPECT_EQ(0, memcmp(mac[0], mac[1], sizeof(mac[0])));
+    EXPECT_EQ(0, openssl_provider->aead_chacha_decrypt_detached(decrypted, ciphertext[0], sizeof(message), mac[0],
+                                                                addl, sizeof(addl), &chacha_nonce, &chacha_key));
+    EXPECT_EQ(0, memcmp(decrypted, message, sizeof(message)));
+    mac[0][0] ^= 1;
+    EXPECT_NE(0, openssl_provider->aead_chacha_decrypt_detached(decrypted, ciphertext[0], sizeof(message), mac[0],
+                                                                addl, sizeof(addl), &chacha_nonce, &chacha_key));
+
+    // 2) AES-256-GCM, with and without an expanded key
+    if (!sodium_provider->aead_aes256_is_available() || !openssl_provider->aead_aes256_is_available()) {
+        printf("ok (AES-256-GCM not available)\n");
+        return;
+    }
+
+    for (int p = 0; p < 2; ++p)
+        EXPECT_EQ(0, providers[p]->aead_aes256_encrypt_detached(ciphertext[p], mac[p], message, sizeof(message),
+                                                                addl, sizeof(addl), &aes_nonce, &aes_key));
+    EXPECT_EQ(0, memcmp(ciphertext[0], ciphertext[1], sizeof(message)));
+    EXPECT_EQ(0, memcmp(mac[0], mac[1], sizeof(mac[0])));
+
+    xtt_aes256_key_schedule schedule;
+    EXPECT_EQ(0, openssl_provider->aead_aes256_expand_key(&schedule, &aes_key));
+    EXPECT_EQ(0, openssl_provider->aead_aes256_decrypt_detached_expanded(decrypted, ciphertext[0], sizeof(message), mac[0],
+                                                                         addl, sizeof(addl), &aes_nonce, &schedule));
+    EXPECT_EQ(0, memcmp(decrypted, message, sizeof(message)));
+
+    EXPECT_EQ(0, sodium_provider->aead_aes256_expand_key(&schedule, &aes_key));
+    EXPECT_EQ(0, sodium_provider->aead_aes256_decrypt_detached_expanded(decrypted, ciphertext[1], sizeof(message), mac[1],
+                                                                        addl, sizeof(addl), &aes_nonce, &schedule));
+    EXPECT_EQ(0, memcmp(decrypted, message, sizeof(message)));
+
+    printf("ok\n");
+}
+
+void run_session_handshake(struct handshake_record *record_out, xtt_suite_spec suite_spec)
+{
+    unsigned char client_to_server[1024];
+    unsigned char server_to_client[1024];
+    uint16_t length;
+
+    record_out->messages_length = 0;
+
+    // 1) Certificates and the client's registered longterm key
+    xtt_certificate_root_id root_id;
+    memcpy(root_id.data, "1234567890987654", sizeof(xtt_certificate_root_id));
+    xtt_ed25519_pub_key root_public_key;
+    xtt_ed25519_priv_key root_priv_key;
+    EXPECT_EQ(0, xtt_crypto_create_ed25519_key_pair(&root_public_key, &root_priv_key));
+
+    xtt_client_id server_id;
+    memcpy(server_id.data, "4567890987654321", sizeof(xtt_client_id));
+    xtt_ed25519_pub_key server_public_key;
+    xtt_ed25519_priv_key server_private_key;
+    EXPECT_EQ(0, xtt_crypto_create_ed25519_key_pair(&server_public_key, &server_private_key));
+
+    xtt_certificate_expiry expiry;
+    memcpy(expiry.data, "21001231", 8);
+
+    unsigned char serialized_certificate[XTT_SERVER_CERTIFICATE_ED25519_LENGTH];
+    EXPECT_EQ(0, generate_server_certificate_ed25519(serialized_certificate,
+                                                     &server_id,
+                                                     &server_public_key,
+                                                     &expiry,
+                                                     &root_id,
+                                                     &root_priv_key));
+
+    struct xtt_server_root_certificate_context root_certificate;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_root_certificate_context_ed25519(&root_certificate,
+                                                                                       &root_id,
+                                                                                       &root_public_key));
+
+    struct xtt_server_certificate_context cert_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_certificate_context_ed25519(&cert_ctx,
+                                                                                   serialized_certificate,
+                                                                                   &server_private_key));
+
+    struct xtt_server_cookie_context cookie_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_cookie_context(&cookie_ctx));
+
+    xtt_client_id client_id = {.data={4,2,7,4,2,8,3,9,4,2,4,3,3,6,5,8}};
+    xtt_ed25519_pub_key longterm_key;
+    xtt_ed25519_priv_key longterm_private_key;
+    EXPECT_EQ(0, xtt_crypto_create_ed25519_key_pair(&longterm_key, &longterm_private_key));
+
+    // 2) ClientInit
+    struct xtt_client_handshake_context client_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_client_handshake_context(&client_ctx,
+                                                                                 XTT_VERSION_ONE,
+                                                                                 suite_spec,
+                                                                                 &longterm_key,
+                                                                                 &longterm_private_key));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_client_init(client_to_server, &length, &client_ctx));
+    append_message(record_out, client_to_server, length);
+
+    // 3) ServerInitAndAttest
+    struct xtt_server_handshake_context server_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_server_init_and_attest(server_to_client,
+                                                                  &length,
+                                                                  &server_ctx,
+                                                                  client_to_server,
+                                                                  &cert_ctx,
+                                                                  &cookie_ctx));
+    append_message(record_out, server_to_client, length);
+
+    // 4) Session_ClientAttest
+    //      (with the client's scratch area its own, to check that deriving its keys leaves no secrets there).
+    static struct xtt_handshake_scratch client_scratch;
+    memset(&client_scratch, 0xAA, sizeof(client_scratch));
+    xtt_handshake_context_use_scratch(&client_ctx.base, &client_scratch);
+    xtt_certificate_root_id claimed_root_id;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_preparse_serverinitandattest(&claimed_root_id, server_to_client, &client_ctx));
+    const unsigned char no_secret[sizeof(client_scratch.handshake_secret)] = {0};
+    EXPECT_EQ(0, memcmp(client_scratch.handshake_secret, no_secret, sizeof(client_scratch.handshake_secret)));
+    EXPECT_EQ(0, memcmp(client_scratch.shared_secret_buffer, no_secret, sizeof(client_scratch.shared_secret_buffer)));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_session_client_attest(client_to_server,
+                                                                 &length,
+                                                                 server_to_client,
+                                                                 &root_certificate,
+                                                                 &client_id,
+                                                                 &server_id,
+                                                                 &client_ctx));
+    append_message(record_out, client_to_server, length);
+
+    // 5) Session_ServerFinished
+    xtt_client_id requested_client_id;
+    xtt_daa_group_id claimed_gid;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_pre_parse_client_attest(&requested_client_id,
+                                                             &claimed_gid,
+                                                             client_to_server,
+                                                             &cookie_ctx,
+                                                             &server_ctx));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_session_server_finished(server_to_client,
+                                                                   &length,
+                                                                   client_to_server,
+                                                                   &longterm_key,
+                                                                   &cert_ctx,
+                                                                   &cookie_ctx,
+                                                                   &server_ctx));
+    append_message(record_out, server_to_client, length);
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_parse_session_server_finished(&client_id, server_to_client, &client_ctx));
+
+    // 6) A record each way, under the session's keys
+    xtt_session_id session_id = {.data={0}};
+    struct xtt_session_context client_session;
+    struct xtt_session_context server_session;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_context(&client_session, &session_id, &client_ctx.base, XTT_RECORD_REPLAY_WINDOW_MAX_WORDS));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_context(&server_session, &session_id, &server_ctx.base, XTT_RECORD_REPLAY_WINDOW_MAX_WORDS));
+
+    struct xtt_session_context *senders[2] = {&client_session, &server_session};
+    struct xtt_session_context *receivers[2] = {&server_session, &client_session};
+    for (int i = 0; i < 2; ++i) {
+        const char *message = "hello, record layer";
+        uint16_t message_length = strlen(message);
+        memcpy(record_out->records[i] + XTT_RECORD_HEADER_LENGTH, message, message_length);
+        EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(record_out->records[i],
+                                                        &record_out->record_lengths[i],
+                                                        message_length,
+                                                        XTT_ENCAPSULATED_IPV6,
+                                                        senders[i]));
+
+        unsigned char received[sizeof(record_out->records[i])];
+        memcpy(received, record_out->records[i], record_out->record_lengths[i]);
+        unsigned char *payload;
+        uint16_t payload_length;
+        xtt_encapsulated_payload_type payload_type;
+        EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_decrypt_record(&payload,
+                                                        &payload_length,
+                                                        &payload_type,
+                                                        received,
+                                                        record_out->record_lengths[i],
+                                                        receivers[i]));
+        EXPECT_EQ(payload_length, message_length);
+        EXPECT_EQ(0, memcmp(payload, message, message_length));
+    }
+
+    xtt_free_server_cookie_context(&cookie_ctx);
+}
+
+void handshakes_are_identical(xtt_suite_spec suite_spec)
+{
+    printf("starting crypto_provider-test::handshakes_are_identical (suite %#x)...\n", suite_spec);
+    SKIP_UNLESS_SUITE_AVAILABLE(suite_spec);
+
+    static struct handshake_record sodium_record;
+    static struct handshake_record openssl_record;
+
+    use_deterministic_provider(sodium_provider);
+    run_session_handshake(&sodium_record, suite_spec);
+
+    use_deterministic_provider(openssl_provider);
+    run_session_handshake(&openssl_record, suite_spec);
+
+    EXPECT_EQ(sodium_record.messages_length, openssl_record.messages_length);
+    EXPECT_EQ(0, memcmp(sodium_record.messages, openssl_record.messages, sodium_record.messages_length));
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_EQ(sodium_record.record_lengths[i], openssl_record.record_lengths[i]);
+        EXPECT_EQ(0, memcmp(sodium_record.records[i], openssl_record.records[i], sodium_record.record_lengths[i]));
+    }
+
+    EXPECT_EQ(0, xtt_crypto_set_provider(sodium_provider));
+
+    printf("ok\n");
+}
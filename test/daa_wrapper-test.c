@@ -0,0 +1,335 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+xtt_daa_group_pub_key_lrsw gpk = {.data={
+    0x04, 0x27, 0xd4, 0x35, 0xbf, 0xc7, 0x1d, 0x4a, 0x42, 0xb1, 0xd2, 0x26,
+    0x25, 0x54, 0xfe, 0x12, 0x54, 0x84, 0xbc, 0x67, 0x2e, 0xe7, 0xfb, 0x68,
+    0xf7, 0x00, 0xb3, 0x7f, 0x2a, 0xb4, 0x91, 0x61, 0xb8, 0xd3, 0xed, 0x78,
+    0x53, 0x42, 0x26, 0x26, 0x48, 0x27, 0xaf, 0x66, 0xfe, 0xcf, 0xfb, 0xb3,
+    0x8d, 0xd0, 0xcc, 0x76, 0xff, 0x23, 0x38, 0x36, 0xc4, 0x9b, 0x5a, 0xfa,
+    0x58, 0x0c, 0x70, 0x34, 0xca, 0xb4, 0xf5, 0xf7, 0xfd, 0x9d, 0x06, 0x7e,
+    0xc7, 0xad, 0x6e, 0xb4, 0x7a, 0x92, 0x1a, 0xd4, 0x08, 0x27, 0xee, 0xdd,
+    0xf2, 0xf6, 0x82, 0xf6, 0x94, 0x50, 0xdd, 0xba, 0xec, 0x99, 0x37, 0xca,
+    0x11, 0x76, 0x80, 0xf7, 0xdc, 0xe8, 0xd9, 0x20, 0x0b, 0xa6, 0x99, 0xa7,
+    0x11, 0x6c, 0xf4, 0xc2, 0x5a, 0x34, 0x05, 0x52, 0x1e, 0x19, 0x30, 0x40,
+    0xa1, 0x0e, 0xe9, 0x10, 0x4d, 0xd5, 0xc0, 0x18, 0xdf, 0x04, 0xee, 0x9c,
+    0x97, 0x24, 0xaf, 0x83, 0xe6, 0x5a, 0x91, 0xcc, 0x0f, 0xcf, 0x5c, 0xfe,
+    0xa9, 0x34, 0x39, 0x81, 0x4d, 0xfe, 0x05, 0xc8, 0xca, 0x0c, 0xd8, 0x5e,
+    0xf0, 0x55, 0xad, 0xf8, 0x1d, 0xd0, 0xf1, 0xd1, 0x3b, 0x90, 0x61, 0xac,
+    0x82, 0x12, 0xfb, 0x07, 0x78, 0xee, 0xdb, 0xd6, 0x2e, 0xd7, 0xe0, 0x16,
+    0x89, 0xe1, 0x27, 0x8f, 0xac, 0xde, 0xcd, 0x71, 0x39, 0xe7, 0xec, 0x88,
+    0x01, 0xa8, 0xdb, 0xc8, 0xa7, 0x8e, 0x36, 0x90, 0xce, 0xd2, 0x1e, 0x32,
+    0x79, 0xc4, 0x6a, 0x88, 0x3c, 0x8a, 0xe5, 0x63, 0xb0, 0xd6, 0xb1, 0x31,
+    0x9d, 0x23, 0x19, 0x2a, 0xc2, 0x94, 0xb6, 0x7d, 0xc0, 0x0e, 0xd3, 0xfb,
+    0x96, 0xbd, 0xe6, 0x48, 0xec, 0xe3, 0x20, 0xee, 0xd1, 0x0d, 0x5a, 0x93,
+    0x15, 0x8c, 0xdb, 0x2d, 0x93, 0xec, 0xff, 0x0f, 0x20, 0x9f, 0x6e, 0xfd,
+    0x05, 0x3a, 0x18, 0xe3, 0xf6, 0xd8
+}};
+
+xtt_daa_credential_lrsw cred = {.data={
+    0x04, 0xe1, 0x63, 0x6e, 0x34, 0x7c, 0x7f, 0xbc, 0x41, 0xc2, 0x0b, 0xf5,
+    0x28, 0x7d, 0xb8, 0xb9, 0xbd, 0x77, 0x89, 0xb7, 0x3e, 0x0b, 0xda, 0x91,
+    0xe1, 0xe1, 0x90, 0x1c, 0xcf, 0x06, 0x6f, 0xb0, 0x10, 0xd7, 0xab, 0x7a,
+    0x3b, 0x8f, 0x29, 0x5a, 0xb3, 0x10, 0xd2, 0xba, 0xed, 0x57, 0x98, 0xed,
+    0x2c, 0x2c, 0xa0, 0x4d, 0xa0, 0x2f, 0xfc, 0x03, 0x85, 0xd6, 0xc7, 0x08,
+    0xfe, 0xfd, 0xab, 0x37, 0x5c, 0x04, 0xa4, 0x65, 0x2b, 0xf6, 0xa6, 0xb0,
+    0x75, 0xda, 0x3b, 0xc7, 0x4d, 0x11, 0x0e, 0xa5, 0x22, 0x3b, 0x64, 0xcc,
+    0x28, 0x3f, 0x8e, 0xc4, 0x91, 0x65, 0x25, 0xa8, 0x7e, 0x36, 0x67, 0xa4,
+    0x53, 0xed, 0x42, 0xda, 0xbd, 0xdc, 0x49, 0xfe, 0xe9, 0xb0, 0x0a, 0x0c,
+    0x76, 0x3c, 0x52, 0xae, 0xb1, 0x00, 0xb4, 0xa1, 0x90, 0x7c, 0xcc, 0x4e,
+    0xe8, 0xe2, 0x4e, 0xb9, 0xf7, 0xa4, 0x91, 0xa7, 0xd1, 0x57, 0x04, 0x8a,
+    0x71, 0x60, 0xca, 0x86, 0xf8, 0xc4, 0x67, 0x79, 0x68, 0x8c, 0x19, 0x59,
+    0xf2, 0xb1, 0x58, 0x4e, 0xbe, 0x7a, 0xbb, 0xc5, 0x87, 0x2f, 0xbf, 0xed,
+    0xe1, 0x6b, 0xba, 0xf1, 0xe0, 0x3b, 0xf6, 0x5f, 0xca, 0x23, 0xfa, 0x78,
+    0xb9, 0x89, 0x91, 0xbd, 0x3a, 0x51, 0x1b, 0x0a, 0xbe, 0x7c, 0x1a, 0xdb,
+    0x2a, 0xef, 0xc7, 0xb8, 0x5d, 0xbd, 0x51, 0xd5, 0x4d, 0x00, 0x5c, 0x7d,
+    0x7a, 0xc4, 0xd1, 0x04, 0xd6, 0x53, 0xc8, 0xc3, 0x8f, 0xc9, 0xfb, 0x26,
+    0xa8, 0xc8, 0xb7, 0xf6, 0x7f, 0x58, 0xb4, 0x64, 0x05, 0x8c, 0x1b, 0x8c,
+    0xea, 0x26, 0x8f, 0x1c, 0x81, 0xcf, 0xb6, 0x37, 0x7b, 0x6b, 0x11, 0x36,
+    0xa9, 0x9a, 0xd1, 0x0c, 0xf3, 0xfd, 0xc3, 0xe3, 0x9e, 0x72, 0x41, 0x97,
+    0x51, 0x18, 0xca, 0x24, 0x29, 0xf2, 0xa4, 0x6f, 0xd5, 0x50, 0x30, 0x98,
+    0x15, 0x68, 0x84, 0xf7, 0x2b, 0x5a, 0x80, 0x39
+}};
+
+xtt_daa_priv_key_lrsw daa_priv_key = {.data={
+    0x0b, 0x8a, 0x76, 0xe0, 0xbf, 0x23, 0xf2, 0x1a, 0x5b, 0x54, 0x7d, 0x8c,
+    0x97, 0xcf, 0x3f, 0xa0, 0xae, 0x72, 0xb6, 0x60, 0x29, 0x10, 0x18, 0x14,
+    0x61, 0xb6, 0x58, 0x6a, 0x44, 0x97, 0xa1, 0xf7
+}};
+
+enum { SIGNATURE_COUNT = 4 };
+
+static const char *basenames[] = {"BASENAME", "ANOTHER BASENAME"};
+
+static xtt_daa_prepared_group_pub_key_lrsw prepared_gpk;
+
+static unsigned char signatures[SIGNATURE_COUNT][sizeof(xtt_daa_signature_lrsw)];
+static unsigned char msgs[SIGNATURE_COUNT][16];
+static struct xtt_daa_verify_item items[SIGNATURE_COUNT];
+
+static xtt_daa_pairing_tables_lrsw pairing_tables;
+
+// Offset of T within a serialized signature: c, s, R, S, T, W, K.
+#define SIGNATURE_T_OFFSET (2*32 + 2*65)
+
+void initialize();
+void schnorr_check_agrees_with_ecdaa_on_good_signatures();
+void schnorr_check_agrees_with_ecdaa_on_tampered_signatures();
+void self_test_passes();
+void batch_verify_agrees_with_ecdaa();
+void precomputed_verify_agrees_with_ecdaa();
+void precomputed_batch_verify_agrees_with_ecdaa();
+
+int main()
+{
+    initialize();
+
+    schnorr_check_agrees_with_ecdaa_on_good_signatures();
+    schnorr_check_agrees_with_ecdaa_on_tampered_signatures();
+    self_test_passes();
+    batch_verify_agrees_with_ecdaa();
+    precomputed_verify_agrees_with_ecdaa();
+    precomputed_batch_verify_agrees_with_ecdaa();
+}
+
+void initialize()
+{
+    EXPECT_EQ(0, xtt_crypto_initialize_crypto());
+
+    EXPECT_EQ(0, xtt_daa_prepare_group_public_key_lrsw(&prepared_gpk, &gpk));
+    EXPECT_EQ(0, xtt_daa_precompute_pairing_tables_lrsw(&pairing_tables, &prepared_gpk));
+
+    // Signatures made by ecdaa itself, under both basenames.
+    for (int i = 0; i < SIGNATURE_COUNT; ++i) {
+        const char *basename = basenames[i % 2];
+        memset(msgs[i], 'a' + i, sizeof(msgs[i]));
+        EXPECT_EQ(0, xtt_daa_sign_lrsw(signatures[i],
+                                       msgs[i],
+                                       sizeof(msgs[i]),
+                                       (const unsigned char*)basename,
+                                       (uint16_t)strlen(basename),
+                                       &cred,
+                                       &daa_priv_key));
+        items[i] = (struct xtt_daa_verify_item){.signature=signatures[i],
+                                                .msg=msgs[i],
+                                                .msg_len=sizeof(msgs[i]),
+                                                .basename=(unsigned char*)basename,
+                                                .basename_len=(uint16_t)strlen(basename)};
+    }
+}
+
+static
+int ecdaa_verify(const struct xtt_daa_verify_item *item)
+{
+    return xtt_daa_verify_lrswTPM_prepared(item->signature,
+                                           item->msg,
+                                           item->msg_len,
+                                           item->basename,
+                                           item->basename_len,
+                                           &prepared_gpk);
+}
+
+void schnorr_check_agrees_with_ecdaa_on_good_signatures()
+{
+    printf("starting daa_wrapper-test::schnorr_check_agrees_with_ecdaa_on_good_signatures...\n");
+
+    for (int i = 0; i < SIGNATURE_COUNT; ++i) {
+        EXPECT_EQ(0, ecdaa_verify(&items[i]));
+        EXPECT_EQ(0, xtt_daa_check_schnorr_lrsw(&items[i]));
+    }
+
+    printf("ok\n");
+}
+
+void schnorr_check_agrees_with_ecdaa_on_tampered_signatures()
+{
+    printf("starting daa_wrapper-test::schnorr_check_agrees_with_ecdaa_on_tampered_signatures...\n");
+
+    unsigned char signature[sizeof(xtt_daa_signature_lrsw)];
+    unsigned char msg[sizeof(msgs[0])];
+    struct xtt_daa_verify_item item;
+
+    // 1) Different message
+    item = items[0];
+    memcpy(msg, msgs[0], sizeof(msg));
+    msg[0] ^= 1;
+    item.msg = msg;
+    EXPECT_NE(0, ecdaa_verify(&item));
+    EXPECT_NE(0, xtt_daa_check_schnorr_lrsw(&item));
+
+    // 2) Different basename
+    item = items[0];
+    item.basename = items[1].basename;
+    item.basename_len = items[1].basename_len;
+    EXPECT_NE(0, ecdaa_verify(&item));
+    EXPECT_NE(0, xtt_daa_check_schnorr_lrsw(&item));
+
+    // 3) Tampered c or s (the first two scalars of the signature)
+    const size_t scalar_length = 32;
+    const size_t tampered_bytes[] = {scalar_length - 1, 2 * scalar_length - 1};
+    for (size_t i = 0; i < sizeof(tampered_bytes) / sizeof(tampered_bytes[0]); ++i) {
+        item = items[0];
+        memcpy(signature, signatures[0], sizeof(signature));
+        signature[tampered_bytes[i]] ^= 1;
+        item.signature = signature;
+        EXPECT_NE(0, ecdaa_verify(&item));
+        EXPECT_NE(0, xtt_daa_check_schnorr_lrsw(&item));
+    }
+
+    // 4) Another signature's proof, with this one's message
+    item = items[2];
+    item.msg = msgs[0];
+    EXPECT_NE(0, ecdaa_verify(&item));
+    EXPECT_NE(0, xtt_daa_check_schnorr_lrsw(&item));
+
+    printf("ok\n");
+}
+
+void self_test_passes()
+{
+    printf("starting daa_wrapper-test::self_test_passes...\n");
+
+    EXPECT_EQ(0, xtt_daa_self_test_lrsw());
+    // Only run once, so the same answer again.
+    EXPECT_EQ(0, xtt_daa_self_test_lrsw());
+
+    struct xtt_daa_group_public_key_context ctx;
+    const char *basename = basenames[0];
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_daa_group_public_key_context_lrsw(&ctx,
+                                                                                  (const unsigned char*)basename,
+                                                                                  (uint16_t)strlen(basename),
+                                                                                  &gpk));
+
+    printf("ok\n");
+}
+
+void batch_verify_agrees_with_ecdaa()
+{
+    printf("starting daa_wrapper-test::batch_verify_agrees_with_ecdaa...\n");
+
+    int results[SIGNATURE_COUNT];
+    EXPECT_EQ(0, xtt_daa_batch_verify_lrswTPM_prepared(results, items, SIGNATURE_COUNT, &prepared_gpk));
+    for (int i = 0; i < SIGNATURE_COUNT; ++i)
+        EXPECT_EQ(0, results[i]);
+
+    unsigned char msg[sizeof(msgs[0])];
+    memcpy(msg, msgs[1], sizeof(msg));
+    msg[0] ^= 1;
+    struct xtt_daa_verify_item tampered_items[SIGNATURE_COUNT];
+    memcpy(tampered_items, items, sizeof(tampered_items));
+    tampered_items[1].msg = msg;
+    EXPECT_NE(0, xtt_daa_batch_verify_lrswTPM_prepared(results, tampered_items, SIGNATURE_COUNT, &prepared_gpk));
+    for (int i = 0; i < SIGNATURE_COUNT; ++i) {
+        if (1 == i) {
+            EXPECT_NE(0, results[i]);
+            EXPECT_NE(0, ecdaa_verify(&tampered_items[i]));
+        } else {
+            EXPECT_EQ(0, results[i]);
+            EXPECT_EQ(0, ecdaa_verify(&tampered_items[i]));
+        }
+    }
+
+    printf("ok\n");
+}
+
+static
+int precomputed_verify(const struct xtt_daa_verify_item *item)
+{
+    return xtt_daa_verify_lrswTPM_precomputed(item->signature,
+                                              item->msg,
+                                              item->msg_len,
+                                              item->basename,
+                                              item->basename_len,
+                                              &prepared_gpk,
+                                              &pairing_tables);
+}
+
+void precomputed_verify_agrees_with_ecdaa()
+{
+    printf("starting daa_wrapper-test::precomputed_verify_agrees_with_ecdaa...\n");
+
+    // 1) Good signatures
+    for (int i = 0; i < SIGNATURE_COUNT; ++i) {
+        EXPECT_EQ(0, ecdaa_verify(&items[i]));
+        EXPECT_EQ(0, precomputed_verify(&items[i]));
+    }
+
+    // 2) A different message
+    unsigned char msg[sizeof(msgs[0])];
+    struct xtt_daa_verify_item item = items[0];
+    memcpy(msg, msgs[0], sizeof(msg));
+    msg[0] ^= 1;
+    item.msg = msg;
+    EXPECT_NE(0, ecdaa_verify(&item));
+    EXPECT_NE(0, precomputed_verify(&item));
+
+    // 3) Another signature's T: the Schnorr proof doesn't cover it, so only the pairings can catch this
+    unsigned char signature[sizeof(xtt_daa_signature_lrsw)];
+    item = items[0];
+    memcpy(signature, signatures[0], sizeof(signature));
+    memcpy(signature + SIGNATURE_T_OFFSET, signatures[1] + SIGNATURE_T_OFFSET, 65);
+    item.signature = signature;
+    EXPECT_NE(0, ecdaa_verify(&item));
+    EXPECT_NE(0, precomputed_verify(&item));
+
+    printf("ok\n");
+}
+
+void precomputed_batch_verify_agrees_with_ecdaa()
+{
+    printf("starting daa_wrapper-test::precomputed_batch_verify_agrees_with_ecdaa...\n");
+
+    int results[SIGNATURE_COUNT];
+    EXPECT_EQ(0, xtt_daa_batch_verify_lrswTPM_precomputed(results, items, SIGNATURE_COUNT, &prepared_gpk, &pairing_tables));
+    for (int i = 0; i < SIGNATURE_COUNT; ++i)
+        EXPECT_EQ(0, results[i]);
+
+    // Swapped Ts pass every Schnorr check, leaving the bad ones to the pairings (and bisection).
+    unsigned char swapped_signatures[2][sizeof(xtt_daa_signature_lrsw)];
+    memcpy(swapped_signatures[0], signatures[2], sizeof(swapped_signatures[0]));
+    memcpy(swapped_signatures[1], signatures[3], sizeof(swapped_signatures[1]));
+    memcpy(swapped_signatures[0] + SIGNATURE_T_OFFSET, signatures[3] + SIGNATURE_T_OFFSET, 65);
+    memcpy(swapped_signatures[1] + SIGNATURE_T_OFFSET, signatures[2] + SIGNATURE_T_OFFSET, 65);
+    struct xtt_daa_verify_item tampered_items[SIGNATURE_COUNT];
+    memcpy(tampered_items, items, sizeof(tampered_items));
+    tampered_items[2].signature = swapped_signatures[0];
+    tampered_items[3].signature = swapped_signatures[1];
+
+    EXPECT_NE(0, xtt_daa_batch_verify_lrswTPM_precomputed(results, tampered_items, SIGNATURE_COUNT, &prepared_gpk, &pairing_tables));
+    for (int i = 0; i < SIGNATURE_COUNT; ++i) {
+        if (i >= 2) {
+            EXPECT_NE(0, results[i]);
+            EXPECT_NE(0, ecdaa_verify(&tampered_items[i]));
+            EXPECT_NE(0, precomputed_verify(&tampered_items[i]));
+        } else {
+            EXPECT_EQ(0, results[i]);
+            EXPECT_EQ(0, ecdaa_verify(&tampered_items[i]));
+            EXPECT_EQ(0, precomputed_verify(&tampered_items[i]));
+        }
+    }
+
+    printf("ok\n");
+}
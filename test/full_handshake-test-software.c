@@ -18,8 +18,6 @@
 
 #include <xtt.h>
 
-#include <sodium.h>
-
 #include <ecdaa.h>
 
 #include "test-utils.h"
@@ -27,6 +25,7 @@
 #include "../src/internal/message_utils.h"
 #include "../src/internal/byte_utils.h"
 
+#include <pthread.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -95,6 +94,13 @@ void generate_server_certificates(unsigned char *cert_serialized_out,
                                   xtt_certificate_root_id *root_id,
                                   xtt_ed25519_pub_key *root_public_key);
 
+static
+void *run_verification_job(void *job)
+{
+    (void)xtt_verify_identity_client_attest(job);
+    return NULL;
+}
+
 int main()
 {
     xtt_error_code rc;
@@ -104,7 +110,7 @@ int main()
     xtt_version version = XTT_VERSION_ONE;
     // xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512;
     // xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B;
-    xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_AES256GCM_SHA512;
+    xtt_suite_spec suite_spec = available_suite_or_default(XTT_X25519_LRSW_ED25519_AES256GCM_SHA512);
     // xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B;
 
     ///// Initialize
@@ -135,7 +141,7 @@ int main()
 
     // 8) Get GID from the GPK
     xtt_daa_group_id gid = {.data={0}};
-    int hash_ret = crypto_hash_sha256(gid.data, gpk.data, sizeof(gpk));
+    int hash_ret = group_id_from_gpk(&gid, &gpk);
     EXPECT_EQ(0, hash_ret);
 
     // 6) Set client's DAA context.
@@ -206,6 +212,58 @@ int main()
     EXPECT_EQ(xtt_get_message_type(client_to_server), XTT_ID_CLIENTATTEST_MSG);
     EXPECT_EQ(xtt_get_message_length(client_to_server), identity_clientattest_length);
 
+    // 5ii) A server that threw its handshake context away can restore it from the echoed cookie
+    struct xtt_server_handshake_context restored_handshake_ctx;
+    rc = xtt_restore_server_handshake_context(&restored_handshake_ctx,
+                                              client_to_server,
+                                              &cert_ctx,
+                                              &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    EXPECT_EQ(0, memcmp(&restored_handshake_ctx.base.tx_key, &server_handshake_ctx.base.tx_key, sizeof(server_handshake_ctx.base.tx_key)));
+    EXPECT_EQ(0, memcmp(&restored_handshake_ctx.base.rx_key, &server_handshake_ctx.base.rx_key, sizeof(server_handshake_ctx.base.rx_key)));
+    EXPECT_EQ(0, memcmp(restored_handshake_ctx.base.inner_hash, server_handshake_ctx.base.inner_hash, server_handshake_ctx.base.suite->hash_length));
+    EXPECT_EQ(0, memcmp(restored_handshake_ctx.base.session_secret, server_handshake_ctx.base.session_secret, server_handshake_ctx.base.suite->hash_length));
+    EXPECT_EQ(0, memcmp(restored_handshake_ctx.server_signature_buffer,
+                        server_handshake_ctx.server_signature_buffer,
+                        sizeof(server_handshake_ctx.server_signature_buffer)));
+    EXPECT_EQ(restored_handshake_ctx.base.tx_sequence_num, server_handshake_ctx.base.tx_sequence_num);
+    EXPECT_EQ(restored_handshake_ctx.base.rx_sequence_num, server_handshake_ctx.base.rx_sequence_num);
+
+    // 5iii) A tampered-with cookie doesn't open
+    unsigned char tampered_client_attest[sizeof(client_to_server)];
+    memcpy(tampered_client_attest, client_to_server, sizeof(client_to_server));
+    xtt_identityclientattest_access_servercookie(tampered_client_attest, version)[sizeof(xtt_server_cookie) - 1] ^= 1;
+    rc = xtt_restore_server_handshake_context(&restored_handshake_ctx,
+                                              tampered_client_attest,
+                                              &cert_ctx,
+                                              &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_COOKIE, rc);
+
+    // 5iv) A forged ClientAttest echoing the (cleartext) cookie is rejected without using it up
+    unsigned char forged_client_attest[sizeof(client_to_server)];
+    memcpy(forged_client_attest, client_to_server, sizeof(client_to_server));
+    forged_client_attest[identity_clientattest_length - 1] ^= 1;
+    xtt_client_id forged_client_id;
+    xtt_daa_group_id forged_gid;
+    struct xtt_server_handshake_context forged_handshake_ctx = server_handshake_ctx;
+    rc = xtt_pre_parse_client_attest(&forged_client_id,
+                                     &forged_gid,
+                                     forged_client_attest,
+                                     &cookie_ctx,
+                                     &forged_handshake_ctx);
+    EXPECT_NE(XTT_ERROR_SUCCESS, rc);
+    rc = xtt_restore_server_handshake_context(&forged_handshake_ctx,
+                                              forged_client_attest,
+                                              &cert_ctx,
+                                              &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    rc = xtt_pre_parse_client_attest(&forged_client_id,
+                                     &forged_gid,
+                                     forged_client_attest,
+                                     &cookie_ctx,
+                                     &forged_handshake_ctx);
+    EXPECT_NE(XTT_ERROR_SUCCESS, rc);
+
     // 6) Pre-parse Identity_ClientAttest
     xtt_client_id requested_client_id;
     xtt_daa_group_id claimed_gid;
@@ -218,29 +276,180 @@ int main()
     EXPECT_EQ(0, memcmp(claimed_gid.data, gid.data, sizeof(xtt_daa_group_id)));
     EXPECT_EQ(0, memcmp(requested_client_id.data, my_client_id.data, sizeof(xtt_client_id)));
 
+    // 6ii) Both handshakes can be exported and picked up elsewhere
+    unsigned char server_state[XTT_SERVER_HANDSHAKE_STATE_MAX_LENGTH];
+    uint16_t server_state_length;
+    rc = xtt_export_server_handshake_context(server_state, &server_state_length, &server_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    TEST_ASSERT(server_state_length < sizeof(struct xtt_server_handshake_context));
+
+    unsigned char client_state[XTT_CLIENT_HANDSHAKE_STATE_MAX_LENGTH];
+    uint16_t client_state_length;
+    rc = xtt_export_client_handshake_context(client_state, &client_state_length, &client_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    EXPECT_EQ(XTT_ERROR_INCORRECT_TYPE,
+              xtt_import_server_handshake_context(&server_handshake_ctx, client_state, client_state_length));
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH,
+              xtt_import_server_handshake_context(&server_handshake_ctx, server_state, server_state_length - 1));
+
+    memset(&server_handshake_ctx, 0, sizeof(server_handshake_ctx));
+    rc = xtt_import_server_handshake_context(&server_handshake_ctx, server_state, server_state_length);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    memset(&client_handshake_ctx, 0, sizeof(client_handshake_ctx));
+    rc = xtt_import_client_handshake_context(&client_handshake_ctx, client_state, client_state_length);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
     // 10) Build DAA GPK context from GPK we looked up, using GID just read from Identity_ClientAttest
     struct xtt_daa_group_public_key_context gpk_ctx;
     rc = xtt_initialize_daa_group_public_key_context_lrsw(&gpk_ctx,
                                                           (unsigned char*)basename,
                                                           basename_len,
                                                           &gpk);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
 
-    // 11) Validate the DAA sig in the CLientAttest, and send the Identity_ServerFinished
+    // 10ii) A GPK that doesn't deserialize is rejected at initialization
+    struct xtt_daa_group_public_key_context bad_gpk_ctx;
+    xtt_daa_group_pub_key_lrsw bad_gpk = gpk;
+    bad_gpk.data[0] = 0x00;
+    bad_gpk.data[1] ^= 0x01;
+    rc = xtt_initialize_daa_group_public_key_context_lrsw(&bad_gpk_ctx,
+                                                          (unsigned char*)basename,
+                                                          basename_len,
+                                                          &bad_gpk);
+    EXPECT_NE(XTT_ERROR_SUCCESS, rc);
+
+    // 11) Validate the DAA sig in the CLientAttest (on another thread), and send the Identity_ServerFinished
+    // 11i) A job whose signature was tampered-with gets an Error message
+    struct xtt_identity_verification_job verification_job;
+    rc = xtt_submit_identity_server_finished(&verification_job,
+                                             client_to_server,
+                                             &gpk_ctx,
+                                             &cert_ctx,
+                                             &server_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    verification_job.longterm_signature.ed25519.data[0] ^= 1;
+    rc = xtt_verify_identity_client_attest(&verification_job);
+    EXPECT_NE(XTT_ERROR_SUCCESS, rc);
     uint16_t identity_serverfinished_length;
-    rc = xtt_build_identity_server_finished(server_to_client,
-                                            &identity_serverfinished_length,
-                                            client_to_server,
-                                            &requested_client_id,
-                                            &gpk_ctx,
-                                            &cert_ctx,
-                                            &server_handshake_ctx);
+    rc = xtt_complete_identity_server_finished(server_to_client,
+                                               &identity_serverfinished_length,
+                                               &verification_job,
+                                               &requested_client_id,
+                                               &cookie_ctx,
+                                               &server_handshake_ctx);
+    EXPECT_NE(XTT_ERROR_SUCCESS, rc);
+    EXPECT_EQ(xtt_get_message_type(server_to_client), XTT_ERROR_MSG);
+
+    // 11ii) A job that's never verified gets an Error message
+    rc = xtt_submit_identity_server_finished(&verification_job,
+                                             client_to_server,
+                                             &gpk_ctx,
+                                             &cert_ctx,
+                                             &server_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    rc = xtt_complete_identity_server_finished(server_to_client,
+                                               &identity_serverfinished_length,
+                                               &verification_job,
+                                               &requested_client_id,
+                                               &cookie_ctx,
+                                               &server_handshake_ctx);
+    EXPECT_NE(XTT_ERROR_SUCCESS, rc);
+
+    // 11iii) Several jobs verified as a batch: only the tampered-with one fails
+    enum { JOB_BATCH_SIZE = 4, BAD_JOB_INDEX = 2 };
+    struct xtt_identity_verification_job verification_jobs[JOB_BATCH_SIZE];
+    for (int i = 0; i < JOB_BATCH_SIZE; ++i) {
+        rc = xtt_submit_identity_server_finished(&verification_jobs[i],
+                                                 client_to_server,
+                                                 &gpk_ctx,
+                                                 &cert_ctx,
+                                                 &server_handshake_ctx);
+        EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    }
+    verification_jobs[BAD_JOB_INDEX].longterm_signature.ed25519.data[0] ^= 1;
+    rc = xtt_verify_identity_client_attests(verification_jobs, JOB_BATCH_SIZE);
+    EXPECT_EQ(XTT_ERROR_BAD_SIGNATURE, rc);
+    for (int i = 0; i < JOB_BATCH_SIZE; ++i) {
+        if (BAD_JOB_INDEX == i) {
+            EXPECT_NE(XTT_ERROR_SUCCESS, verification_jobs[i].verdict);
+        } else {
+            EXPECT_EQ(XTT_ERROR_SUCCESS, verification_jobs[i].verdict);
+        }
+    }
+
+    // 11iv) A good job, verified on another thread
+    rc = xtt_submit_identity_server_finished(&verification_job,
+                                             client_to_server,
+                                             &gpk_ctx,
+                                             &cert_ctx,
+                                             &server_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    pthread_t verification_thread;
+    EXPECT_EQ(0, pthread_create(&verification_thread, NULL, run_verification_job, &verification_job));
+    EXPECT_EQ(0, pthread_join(verification_thread, NULL));
+    rc = xtt_complete_identity_server_finished(server_to_client,
+                                               &identity_serverfinished_length,
+                                               &verification_job,
+                                               &requested_client_id,
+                                               &cookie_ctx,
+                                               &server_handshake_ctx);
     EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
     EXPECT_EQ(0, memcmp(server_handshake_ctx.clients_longterm_key.ed25519.data,
                         client_handshake_ctx.longterm_key.ed25519.data,
-                        server_handshake_ctx.base.longterm_key_length));
+                        server_handshake_ctx.base.suite->longterm_key_length));
     EXPECT_EQ(xtt_get_message_type(server_to_client), XTT_ID_SERVERFINISHED_MSG);
     EXPECT_EQ(xtt_get_message_length(server_to_client), identity_serverfinished_length);
 
+    // 11v) Now that it's been accepted, the same cookie can't be used again
+    rc = xtt_restore_server_handshake_context(&restored_handshake_ctx,
+                                              client_to_server,
+                                              &cert_ctx,
+                                              &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_COOKIE, rc);
+    struct xtt_server_handshake_context replayed_handshake_ctx = server_handshake_ctx;
+    rc = xtt_pre_parse_client_attest(&requested_client_id,
+                                     &claimed_gid,
+                                     client_to_server,
+                                     &cookie_ctx,
+                                     &replayed_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_COOKIE, rc);
+    // (nor can a second copy that got through pre-parsing before the first was accepted)
+    unsigned char replayed_serverfinished[sizeof(server_to_client)];
+    uint16_t replayed_serverfinished_length;
+    rc = xtt_complete_identity_server_finished(replayed_serverfinished,
+                                               &replayed_serverfinished_length,
+                                               &verification_job,
+                                               &requested_client_id,
+                                               &cookie_ctx,
+                                               &replayed_handshake_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_COOKIE, rc);
+
+    struct xtt_server_cookie_stats cookie_stats;
+    xtt_server_cookie_context_get_stats(&cookie_stats, &cookie_ctx);
+    EXPECT_EQ(1, cookie_stats.recorded);
+    EXPECT_EQ(2, cookie_stats.replays);
+    TEST_ASSERT(cookie_stats.expected_false_positive_rate > 0);
+    TEST_ASSERT(cookie_stats.expected_false_positive_rate < 1e-6);
+    EXPECT_EQ(2000000, cookie_stats.bytes_per_million_cookies);
+
+    // 11vi) Cookies are remembered until their key is rotated-out
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_rotate_server_cookie_context(&cookie_ctx));
+    rc = xtt_restore_server_handshake_context(&restored_handshake_ctx,
+                                              client_to_server,
+                                              &cert_ctx,
+                                              &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_COOKIE, rc);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_rotate_server_cookie_context(&cookie_ctx));
+    rc = xtt_restore_server_handshake_context(&restored_handshake_ctx,
+                                              client_to_server,
+                                              &cert_ctx,
+                                              &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_COOKIE_ROTATION, rc);
+    xtt_server_cookie_context_get_stats(&cookie_stats, &cookie_ctx);
+    EXPECT_EQ(0, cookie_stats.recorded);
+
     // 12) Parse the Identity_serverFinished
     rc = xtt_parse_identity_server_finished(&my_client_id,
                                             server_to_client,
@@ -256,6 +465,185 @@ int main()
     rc = xtt_get_my_longterm_key_ed25519(&clients_view_of_longterm_key, &client_handshake_ctx);
     EXPECT_EQ(0, rc);
     EXPECT_EQ(0, memcmp(servers_view_of_longterm_key.data, clients_view_of_longterm_key.data, sizeof(xtt_ed25519_pub_key))); 
+
+    // 13ii) Reconnect with a Session handshake, using the now-registered longterm_key (and no DAA signature)
+    xtt_ed25519_priv_key my_longterm_private_key;
+    rc = xtt_get_my_longterm_private_key_ed25519(&my_longterm_private_key, &client_handshake_ctx);
+    EXPECT_EQ(0, rc);
+
+    struct xtt_client_handshake_context session_client_ctx;
+    rc = xtt_initialize_session_client_handshake_context(&session_client_ctx,
+                                                         version,
+                                                         suite_spec,
+                                                         &clients_view_of_longterm_key,
+                                                         &my_longterm_private_key);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    rc = xtt_build_client_init(client_to_server,
+                               &client_init_send_length,
+                               &session_client_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    struct xtt_server_handshake_context session_server_ctx;
+    rc = xtt_build_server_init_and_attest(server_to_client,
+                                          &server_initandattest_send_length,
+                                          &session_server_ctx,
+                                          client_to_server,
+                                          &cert_ctx,
+                                          &cookie_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    rc = xtt_preparse_serverinitandattest(&claimed_root_id,
+                                          server_to_client,
+                                          &session_client_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    uint16_t session_clientattest_length;
+    rc = xtt_build_session_client_attest(client_to_server,
+                                         &session_clientattest_length,
+                                         server_to_client,
+                                         &root_certificate,
+                                         &my_client_id,
+                                         &server_id,
+                                         &session_client_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    EXPECT_EQ(xtt_get_message_type(client_to_server), XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG);
+    EXPECT_EQ(xtt_get_message_length(client_to_server), session_clientattest_length);
+    TEST_ASSERT(session_clientattest_length < identity_clientattest_length);
+
+    xtt_client_id session_client_id;
+    xtt_daa_group_id session_gid;
+
+    // A Session_ClientAttest with a payload is refused as unsupported.
+    *xtt_access_msg_type(client_to_server) = XTT_SESSION_CLIENTATTEST_PAYLOAD_MSG;
+    rc = xtt_pre_parse_client_attest(&session_client_id,
+                                     &session_gid,
+                                     client_to_server,
+                                     &cookie_ctx,
+                                     &session_server_ctx);
+    EXPECT_EQ(XTT_ERROR_UNSUPPORTED_MESSAGE, rc);
+    *xtt_access_msg_type(client_to_server) = XTT_SESSION_CLIENTATTEST_NOPAYLOAD_MSG;
+
+    rc = xtt_pre_parse_client_attest(&session_client_id,
+                                     &session_gid,
+                                     client_to_server,
+                                     &cookie_ctx,
+                                     &session_server_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    EXPECT_EQ(0, memcmp(session_client_id.data, my_client_id.data, sizeof(xtt_client_id)));
+    EXPECT_EQ(0, memcmp(session_gid.data, xtt_null_daa_group_id.data, sizeof(xtt_daa_group_id)));
+
+    // 13iii) The server looks up the longterm_key registered for that ClientID: a different one must not verify
+    xtt_ed25519_pub_key other_longterm_key;
+    xtt_ed25519_priv_key other_longterm_private_key;
+    EXPECT_EQ(0, xtt_crypto_create_ed25519_key_pair(&other_longterm_key, &other_longterm_private_key));
+    uint16_t session_serverfinished_length;
+    rc = xtt_build_session_server_finished(server_to_client,
+                                           &session_serverfinished_length,
+                                           client_to_server,
+                                           &other_longterm_key,
+                                           &cert_ctx,
+                                           &cookie_ctx,
+                                           &session_server_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_SIGNATURE, rc);
+    EXPECT_EQ(xtt_get_message_type(server_to_client), XTT_ERROR_MSG);
+
+    rc = xtt_build_session_server_finished(server_to_client,
+                                           &session_serverfinished_length,
+                                           client_to_server,
+                                           &servers_view_of_longterm_key,
+                                           &cert_ctx,
+                                           &cookie_ctx,
+                                           &session_server_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    EXPECT_EQ(xtt_get_message_type(server_to_client), XTT_SESSION_SERVERFINISHED_MSG);
+    EXPECT_EQ(xtt_get_message_length(server_to_client), session_serverfinished_length);
+
+    rc = xtt_parse_session_server_finished(&my_client_id,
+                                           server_to_client,
+                                           &session_client_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    EXPECT_EQ(0, memcmp(&session_client_ctx.base.tx_key, &session_server_ctx.base.rx_key, sizeof(session_client_ctx.base.tx_key)));
+    EXPECT_EQ(0, memcmp(&session_client_ctx.base.rx_key, &session_server_ctx.base.tx_key, sizeof(session_client_ctx.base.rx_key)));
+
+    // 14) Batch-verify several DAA signatures, with one bad one among them
+    enum { BATCH_SIZE = 8, BAD_INDEX = 5 };
+    unsigned char batch_signatures[BATCH_SIZE][sizeof(xtt_daa_signature_lrsw)];
+    unsigned char batch_msgs[BATCH_SIZE][4];
+    struct xtt_daa_verify_item batch_items[BATCH_SIZE];
+    int batch_results[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        memset(batch_msgs[i], i, sizeof(batch_msgs[i]));
+        rc = xtt_daa_sign_lrsw(batch_signatures[i],
+                               batch_msgs[i],
+                               sizeof(batch_msgs[i]),
+                               (unsigned char*)basename,
+                               basename_len,
+                               &cred,
+                               &daa_priv_key);
+        EXPECT_EQ(0, rc);
+        batch_items[i] = (struct xtt_daa_verify_item){.signature=batch_signatures[i],
+                                                      .msg=batch_msgs[i],
+                                                      .msg_len=sizeof(batch_msgs[i]),
+                                                      .basename=(unsigned char*)basename,
+                                                      .basename_len=basename_len};
+    }
+
+    rc = xtt_batch_verify_daa_signatures(batch_results, batch_items, BATCH_SIZE, &gpk_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    for (int i = 0; i < BATCH_SIZE; ++i)
+        EXPECT_EQ(0, batch_results[i]);
+
+    batch_msgs[BAD_INDEX][0] ^= 1;
+    rc = xtt_batch_verify_daa_signatures(batch_results, batch_items, BATCH_SIZE, &gpk_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_SIGNATURE, rc);
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        if (BAD_INDEX == i) {
+            EXPECT_NE(0, batch_results[i]);
+        } else {
+            EXPECT_EQ(0, batch_results[i]);
+        }
+    }
+
+    // 15) Same checks, against a GPK context with precomputed pairing tables
+    static xtt_daa_pairing_tables_lrsw pairing_tables;
+    struct xtt_daa_group_public_key_context precomputed_gpk_ctx;
+    rc = xtt_initialize_daa_group_public_key_context_lrsw(&precomputed_gpk_ctx,
+                                                          (unsigned char*)basename,
+                                                          basename_len,
+                                                          &gpk);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    rc = xtt_precompute_daa_group_public_key_pairings_lrsw(&precomputed_gpk_ctx, &pairing_tables);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    rc = xtt_batch_verify_daa_signatures(batch_results, batch_items, BATCH_SIZE, &precomputed_gpk_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_SIGNATURE, rc);
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        if (BAD_INDEX == i) {
+            EXPECT_NE(0, batch_results[i]);
+        } else {
+            EXPECT_EQ(0, batch_results[i]);
+        }
+    }
+
+    rc = precomputed_gpk_ctx.verify_signature(batch_signatures[BAD_INDEX],
+                                              batch_msgs[BAD_INDEX],
+                                              sizeof(batch_msgs[BAD_INDEX]),
+                                              &precomputed_gpk_ctx);
+    EXPECT_EQ(XTT_ERROR_BAD_SIGNATURE, rc);
+
+    batch_msgs[BAD_INDEX][0] ^= 1;
+    rc = precomputed_gpk_ctx.verify_signature(batch_signatures[BAD_INDEX],
+                                              batch_msgs[BAD_INDEX],
+                                              sizeof(batch_msgs[BAD_INDEX]),
+                                              &precomputed_gpk_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+
+    rc = xtt_batch_verify_daa_signatures(batch_results, batch_items, BATCH_SIZE, &precomputed_gpk_ctx);
+    EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
+    for (int i = 0; i < BATCH_SIZE; ++i)
+        EXPECT_EQ(0, batch_results[i]);
+
+    xtt_free_server_cookie_context(&cookie_ctx);
 }
 
 void generate_server_certificates(unsigned char *cert_serialized_out,
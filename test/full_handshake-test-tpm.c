@@ -18,8 +18,6 @@
 
 #include <xtt.h>
 
-#include <sodium.h>
-
 #include <tss2/tss2_sys.h>
 #include <tss2/tss2_tcti_socket.h>
 #include <ecdaa.h>
@@ -75,7 +73,7 @@ int main()
     xtt_version version = XTT_VERSION_ONE;
     // xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512;
     // xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B;
-    xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_AES256GCM_SHA512;
+    xtt_suite_spec suite_spec = available_suite_or_default(XTT_X25519_LRSW_ED25519_AES256GCM_SHA512);
     // xtt_suite_spec suite_spec = XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B;
 
     ///// Initialize
@@ -109,7 +107,7 @@ int main()
     rc = read_gpk(&gpk);
     EXPECT_EQ(0, rc);
     xtt_daa_group_id gid = {.data={0}};
-    int hash_ret = crypto_hash_sha256(gid.data, gpk.data, sizeof(gpk));
+    int hash_ret = group_id_from_gpk(&gid, &gpk);
     EXPECT_EQ(0, hash_ret);
 
     // 6) Set client's DAA context.
@@ -218,11 +216,12 @@ int main()
                                             &requested_client_id,
                                             &gpk_ctx,
                                             &cert_ctx,
+                                            &cookie_ctx,
                                             &server_handshake_ctx);
     EXPECT_EQ(XTT_ERROR_SUCCESS, rc);
     EXPECT_EQ(0, memcmp(server_handshake_ctx.clients_longterm_key.ed25519.data,
                         client_handshake_ctx.longterm_key.ed25519.data,
-                        server_handshake_ctx.base.longterm_key_length));
+                        server_handshake_ctx.base.suite->longterm_key_length));
     EXPECT_EQ(xtt_get_message_type(server_to_client), XTT_ID_SERVERFINISHED_MSG);
     EXPECT_EQ(xtt_get_message_length(server_to_client), identity_serverfinished_length);
 
@@ -241,6 +240,8 @@ int main()
     rc = xtt_get_my_longterm_key_ed25519(&clients_view_of_longterm_key, &client_handshake_ctx);
     EXPECT_EQ(0, rc);
     EXPECT_EQ(0, memcmp(servers_view_of_longterm_key.data, clients_view_of_longterm_key.data, sizeof(xtt_ed25519_pub_key))); 
+
+    xtt_free_server_cookie_context(&cookie_ctx);
 }
 
 void generate_server_certificates(unsigned char *cert_serialized_out,
@@ -0,0 +1,129 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <string.h>
+#include <stdio.h>
+
+// A server should be able to hold this many half-open handshakes...
+#define HALF_OPEN_HANDSHAKES 100000
+// ...in this much memory.
+#define HALF_OPEN_HANDSHAKES_BUDGET (128 * 1024 * 1024)
+
+static void print_sizes(void);
+static void server_context_fits_budget(void);
+static void contexts_default_to_thread_scratch(void);
+static void client_init_with_own_scratch(void);
+
+int main()
+{
+    EXPECT_EQ(0, xtt_crypto_initialize_crypto());
+
+    print_sizes();
+    server_context_fits_budget();
+    contexts_default_to_thread_scratch();
+    client_init_with_own_scratch();
+}
+
+void print_sizes(void)
+{
+    printf("starting handshake_context_size-test::print_sizes...\n");
+
+    printf("\tsizeof(struct xtt_handshake_context) = %zu\n", sizeof(struct xtt_handshake_context));
+    printf("\tsizeof(struct xtt_server_handshake_context) = %zu\n", sizeof(struct xtt_server_handshake_context));
+    printf("\tsizeof(struct xtt_client_handshake_context) = %zu\n", sizeof(struct xtt_client_handshake_context));
+    printf("\tsizeof(struct xtt_handshake_scratch) = %zu\n", sizeof(struct xtt_handshake_scratch));
+    printf("\tsizeof(struct xtt_handshake_suite) = %zu\n", sizeof(struct xtt_handshake_suite));
+
+    printf("ok\n");
+}
+
+void server_context_fits_budget(void)
+{
+    printf("starting handshake_context_size-test::server_context_fits_budget...\n");
+
+    TEST_ASSERT((size_t)HALF_OPEN_HANDSHAKES * sizeof(struct xtt_server_handshake_context) <= HALF_OPEN_HANDSHAKES_BUDGET);
+
+    // The transient buffers must not creep back into the per-handshake state.
+    TEST_ASSERT(sizeof(struct xtt_server_handshake_context) < sizeof(struct xtt_handshake_scratch));
+
+    printf("ok\n");
+}
+
+void contexts_default_to_thread_scratch(void)
+{
+    printf("starting handshake_context_size-test::contexts_default_to_thread_scratch...\n");
+
+    xtt_suite_spec server_suite_spec = available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512);
+    xtt_suite_spec client_suite_spec = available_suite_or_default(XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B);
+
+    struct xtt_server_handshake_context server_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_handshake_context(&server_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         server_suite_spec));
+    TEST_ASSERT(NULL == server_ctx.base.scratch);
+
+    struct xtt_client_handshake_context client_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_client_handshake_context(&client_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         client_suite_spec));
+    TEST_ASSERT(NULL == client_ctx.base.scratch);
+
+    // Contexts of the same suite share a suite.
+    struct xtt_server_handshake_context other_server_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_handshake_context(&other_server_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         server_suite_spec));
+    TEST_ASSERT(server_ctx.base.suite == other_server_ctx.base.suite);
+    if (server_suite_spec != client_suite_spec)
+        TEST_ASSERT(server_ctx.base.suite != client_ctx.base.suite);
+
+    EXPECT_EQ(XTT_ERROR_UNKNOWN_CRYPTO_SPEC, xtt_initialize_server_handshake_context(&server_ctx,
+                                                                                     XTT_VERSION_ONE,
+                                                                                     (xtt_suite_spec)0));
+
+    printf("ok\n");
+}
+
+void client_init_with_own_scratch(void)
+{
+    printf("starting handshake_context_size-test::client_init_with_own_scratch...\n");
+
+    static struct xtt_handshake_scratch client_scratch;
+
+    struct xtt_client_handshake_context client_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_client_handshake_context(&client_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B)));
+    xtt_handshake_context_use_scratch(&client_ctx.base, &client_scratch);
+    TEST_ASSERT(&client_scratch == client_ctx.base.scratch);
+
+    unsigned char client_init[1024];
+    uint16_t client_init_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_client_init(client_init, &client_init_length, &client_ctx));
+    EXPECT_EQ(client_init_length, xtt_get_message_length(client_init));
+    EXPECT_EQ(XTT_CLIENTINIT_MSG, xtt_get_message_type(client_init));
+
+    xtt_handshake_context_use_scratch(&client_ctx.base, NULL);
+    TEST_ASSERT(NULL == client_ctx.base.scratch);
+
+    printf("ok\n");
+}
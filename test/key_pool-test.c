@@ -0,0 +1,259 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static struct xtt_x25519_key_pool pool;
+
+static void keys_are_valid_pairs(void);
+static void reuse_window_is_bounded_by_uses(void);
+static void reuse_window_is_bounded_by_age(void);
+static void concurrent_acquires_are_unique(void);
+static void server_init_and_attest_from_key_pool(void);
+
+int main()
+{
+    EXPECT_EQ(0, xtt_crypto_initialize_crypto());
+
+    keys_are_valid_pairs();
+    reuse_window_is_bounded_by_uses();
+    reuse_window_is_bounded_by_age();
+    concurrent_acquires_are_unique();
+    server_init_and_attest_from_key_pool();
+}
+
+void keys_are_valid_pairs(void)
+{
+    printf("starting key_pool-test::keys_are_valid_pairs...\n");
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_x25519_key_pool(&pool, NULL));
+
+    struct xtt_x25519_key_pool_stats stats;
+    xtt_x25519_key_pool_get_stats(&stats, &pool);
+    EXPECT_EQ(XTT_X25519_KEY_POOL_CAPACITY, stats.available);
+
+    xtt_x25519_pub_key pub1, pub2;
+    xtt_x25519_priv_key priv1, priv2;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_x25519_key_pool_acquire(&pool, &pub1, &priv1));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_x25519_key_pool_acquire(&pool, &pub2, &priv2));
+    TEST_ASSERT(0 != memcmp(pub1.data, pub2.data, sizeof(xtt_x25519_pub_key)));
+
+    xtt_x25519_shared_secret secret1, secret2;
+    EXPECT_EQ(0, xtt_crypto_do_x25519_diffie_hellman(secret1.data, &priv1, &pub2));
+    EXPECT_EQ(0, xtt_crypto_do_x25519_diffie_hellman(secret2.data, &priv2, &pub1));
+    EXPECT_EQ(0, memcmp(secret1.data, secret2.data, sizeof(xtt_x25519_shared_secret)));
+
+    xtt_x25519_key_pool_get_stats(&stats, &pool);
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(0, stats.misses);
+    EXPECT_EQ(0, stats.reuses);
+
+    xtt_x25519_key_pool_shutdown(&pool);
+
+    printf("ok\n");
+}
+
+void reuse_window_is_bounded_by_uses(void)
+{
+    printf("starting key_pool-test::reuse_window_is_bounded_by_uses...\n");
+
+    struct xtt_x25519_key_pool_config config = {.low_water_mark = 0,
+                                                .reuse_max_uses = 3,
+                                                .reuse_max_age_ms = 60000};
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_x25519_key_pool(&pool, &config));
+
+    xtt_x25519_pub_key pubs[4];
+    xtt_x25519_priv_key priv;
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_x25519_key_pool_acquire(&pool, &pubs[i], &priv));
+
+    EXPECT_EQ(0, memcmp(pubs[0].data, pubs[1].data, sizeof(xtt_x25519_pub_key)));
+    EXPECT_EQ(0, memcmp(pubs[0].data, pubs[2].data, sizeof(xtt_x25519_pub_key)));
+    TEST_ASSERT(0 != memcmp(pubs[0].data, pubs[3].data, sizeof(xtt_x25519_pub_key)));
+
+    struct xtt_x25519_key_pool_stats stats;
+    xtt_x25519_key_pool_get_stats(&stats, &pool);
+    EXPECT_EQ(2, stats.hits);
+    EXPECT_EQ(2, stats.reuses);
+
+    xtt_x25519_key_pool_shutdown(&pool);
+
+    printf("ok\n");
+}
+
+void reuse_window_is_bounded_by_age(void)
+{
+    printf("starting key_pool-test::reuse_window_is_bounded_by_age...\n");
+
+    struct xtt_x25519_key_pool_config config = {.low_water_mark = 0,
+                                                .reuse_max_uses = 1000,
+                                                .reuse_max_age_ms = 1};
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_x25519_key_pool(&pool, &config));
+
+    xtt_x25519_pub_key pub1, pub2;
+    xtt_x25519_priv_key priv;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_x25519_key_pool_acquire(&pool, &pub1, &priv));
+
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = 5 * 1000000L};
+    nanosleep(&pause, NULL);
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_x25519_key_pool_acquire(&pool, &pub2, &priv));
+    TEST_ASSERT(0 != memcmp(pub1.data, pub2.data, sizeof(xtt_x25519_pub_key)));
+
+    xtt_x25519_key_pool_shutdown(&pool);
+
+    printf("ok\n");
+}
+
+#define THREAD_COUNT 4
+#define ACQUIRES_PER_THREAD 512
+
+static xtt_x25519_pub_key acquired[THREAD_COUNT * ACQUIRES_PER_THREAD];
+
+static
+void*
+acquire_many(void *arg)
+{
+    xtt_x25519_pub_key *out = arg;
+    xtt_x25519_priv_key priv;
+
+    for (int i = 0; i < ACQUIRES_PER_THREAD; ++i) {
+        if (XTT_ERROR_SUCCESS != xtt_x25519_key_pool_acquire(&pool, &out[i], &priv))
+            return arg;
+    }
+
+    return NULL;
+}
+
+static
+int
+compare_pub_keys(const void *left, const void *right)
+{
+    return memcmp(left, right, sizeof(xtt_x25519_pub_key));
+}
+
+void concurrent_acquires_are_unique(void)
+{
+    printf("starting key_pool-test::concurrent_acquires_are_unique...\n");
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_x25519_key_pool(&pool, NULL));
+
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        EXPECT_EQ(0, pthread_create(&threads[i], NULL, acquire_many, &acquired[i * ACQUIRES_PER_THREAD]));
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+        void *failed;
+        EXPECT_EQ(0, pthread_join(threads[i], &failed));
+        EXPECT_EQ(NULL, failed);
+    }
+
+    qsort(acquired, THREAD_COUNT * ACQUIRES_PER_THREAD, sizeof(xtt_x25519_pub_key), compare_pub_keys);
+    for (int i = 1; i < THREAD_COUNT * ACQUIRES_PER_THREAD; ++i)
+        TEST_ASSERT(0 != memcmp(acquired[i - 1].data, acquired[i].data, sizeof(xtt_x25519_pub_key)));
+
+    struct xtt_x25519_key_pool_stats stats;
+    xtt_x25519_key_pool_get_stats(&stats, &pool);
+    EXPECT_EQ(THREAD_COUNT * ACQUIRES_PER_THREAD, stats.hits + stats.misses);
+
+    xtt_x25519_key_pool_shutdown(&pool);
+
+    printf("ok\n");
+}
+
+void server_init_and_attest_from_key_pool(void)
+{
+    printf("starting key_pool-test::server_init_and_attest_from_key_pool...\n");
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_x25519_key_pool(&pool, NULL));
+
+    xtt_certificate_root_id root_id;
+    memcpy(root_id.data, "1234567890987654", sizeof(xtt_certificate_root_id));
+    xtt_ed25519_pub_key root_public_key;
+    xtt_ed25519_priv_key root_priv_key;
+    EXPECT_EQ(0, xtt_crypto_create_ed25519_key_pair(&root_public_key, &root_priv_key));
+
+    xtt_client_id server_id;
+    memcpy(server_id.data, "4567890987654321", sizeof(xtt_client_id));
+    xtt_ed25519_pub_key server_public_key;
+    xtt_ed25519_priv_key server_private_key;
+    EXPECT_EQ(0, xtt_crypto_create_ed25519_key_pair(&server_public_key, &server_private_key));
+
+    xtt_certificate_expiry expiry;
+    memcpy(expiry.data, "21001231", 8);
+
+    unsigned char serialized_certificate[XTT_SERVER_CERTIFICATE_ED25519_LENGTH];
+    EXPECT_EQ(0, generate_server_certificate_ed25519(serialized_certificate,
+                                                     &server_id,
+                                                     &server_public_key,
+                                                     &expiry,
+                                                     &root_id,
+                                                     &root_priv_key));
+
+    struct xtt_server_certificate_context cert_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_certificate_context_ed25519(&cert_ctx,
+                                                                                   serialized_certificate,
+                                                                                   &server_private_key));
+
+    struct xtt_server_cookie_context cookie_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_cookie_context(&cookie_ctx));
+
+    struct xtt_client_handshake_context client_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_client_handshake_context(&client_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512)));
+
+    unsigned char client_to_server[1024];
+    unsigned char server_to_client[1024];
+    uint16_t length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_client_init(client_to_server, &length, &client_ctx));
+
+    struct xtt_server_handshake_context server_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_build_server_init_and_attest_from_key_pool(server_to_client,
+                                                                                &length,
+                                                                                &server_ctx,
+                                                                                client_to_server,
+                                                                                &cert_ctx,
+                                                                                &cookie_ctx,
+                                                                                &pool));
+
+    xtt_certificate_root_id claimed_root_id;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_preparse_serverinitandattest(&claimed_root_id,
+                                                                  server_to_client,
+                                                                  &client_ctx));
+    EXPECT_EQ(0, memcmp(claimed_root_id.data, root_id.data, sizeof(xtt_certificate_root_id)));
+
+    struct xtt_x25519_key_pool_stats stats;
+    xtt_x25519_key_pool_get_stats(&stats, &pool);
+    EXPECT_EQ(1, stats.hits);
+
+    xtt_free_server_cookie_context(&cookie_ctx);
+    xtt_x25519_key_pool_shutdown(&pool);
+
+    printf("ok\n");
+}
@@ -0,0 +1,468 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <string.h>
+#include <stdio.h>
+
+static xtt_error_code decrypt_copy(const unsigned char *record,
+                                   uint16_t record_length,
+                                   struct xtt_session_context *receiver);
+static void round_trip_in_place(xtt_suite_spec suite_spec);
+static void tampered_record_fails(void);
+static void replayed_record_fails(void);
+static void other_sessions_record_fails(void);
+static void starts_with_fresh_keys(void);
+static void scatter_gather_round_trip(void);
+static void batch_reports_each_record(void);
+static void out_of_order_within_window(void);
+static void too_old_record_fails(void);
+static void replay_window_width_is_per_session(void);
+
+int main()
+{
+    EXPECT_EQ(0, xtt_crypto_initialize_crypto());
+
+    round_trip_in_place(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512);
+    round_trip_in_place(XTT_X25519_LRSW_ED25519_AES256GCM_SHA512);
+    tampered_record_fails();
+    replayed_record_fails();
+    other_sessions_record_fails();
+    starts_with_fresh_keys();
+    scatter_gather_round_trip();
+    batch_reports_each_record();
+    out_of_order_within_window();
+    too_old_record_fails();
+    replay_window_width_is_per_session();
+}
+
+void round_trip_in_place(xtt_suite_spec suite_spec)
+{
+    printf("starting record-test::round_trip_in_place (suite %#x)...\n", suite_spec);
+    SKIP_UNLESS_SUITE_AVAILABLE(suite_spec);
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, suite_spec, XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    const char *message = "hello, record layer";
+    uint16_t message_length = strlen(message);
+
+    unsigned char record[64 + XTT_RECORD_OVERHEAD];
+    for (int i = 0; i < 3; ++i) {
+        memcpy(record + XTT_RECORD_HEADER_LENGTH, message, message_length);
+
+        uint16_t record_length;
+        EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(record,
+                                                        &record_length,
+                                                        message_length,
+                                                        XTT_ENCAPSULATED_IPV6,
+                                                        &sender));
+        EXPECT_EQ(record_length, message_length + XTT_RECORD_OVERHEAD);
+        EXPECT_NE(0, memcmp(record + XTT_RECORD_HEADER_LENGTH, message, message_length));
+
+        unsigned char *payload;
+        uint16_t payload_length;
+        xtt_encapsulated_payload_type payload_type;
+        EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_decrypt_record(&payload,
+                                                        &payload_length,
+                                                        &payload_type,
+                                                        record,
+                                                        record_length,
+                                                        &receiver));
+
+        // The payload is handed back where the sender put it.
+        TEST_ASSERT(payload == record + XTT_RECORD_HEADER_LENGTH);
+        EXPECT_EQ(payload_length, message_length);
+        EXPECT_EQ(payload_type, XTT_ENCAPSULATED_IPV6);
+        EXPECT_EQ(0, memcmp(payload, message, message_length));
+    }
+
+    EXPECT_EQ(sender.tx_sequence_num, 3);
+    EXPECT_EQ(receiver.rx_sequence_num, 3);
+
+    printf("ok\n");
+}
+
+void tampered_record_fails(void)
+{
+    printf("starting record-test::tampered_record_fails...\n");
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    unsigned char record[16 + XTT_RECORD_OVERHEAD] = {0};
+    uint16_t record_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(record, &record_length, 16, XTT_ENCAPSULATED_QUEUE_PROTO, &sender));
+
+    record[XTT_RECORD_HEADER_LENGTH] ^= 0x01;
+
+    unsigned char *payload;
+    uint16_t payload_length;
+    xtt_encapsulated_payload_type payload_type;
+    EXPECT_EQ(XTT_ERROR_RECORD_FAILED_CRYPTO, xtt_decrypt_record(&payload,
+                                                                 &payload_length,
+                                                                 &payload_type,
+                                                                 record,
+                                                                 record_length,
+                                                                 &receiver));
+    EXPECT_EQ(receiver.rx_sequence_num, 0);
+
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH, xtt_decrypt_record(&payload,
+                                                             &payload_length,
+                                                             &payload_type,
+                                                             record,
+                                                             record_length - 1,
+                                                             &receiver));
+
+    printf("ok\n");
+}
+
+void replayed_record_fails(void)
+{
+    printf("starting record-test::replayed_record_fails...\n");
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    unsigned char record[16 + XTT_RECORD_OVERHEAD] = {0};
+    unsigned char copy[sizeof(record)];
+    uint16_t record_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(record, &record_length, 16, XTT_ENCAPSULATED_QUEUE_PROTO, &sender));
+    memcpy(copy, record, sizeof(record));
+
+    unsigned char *payload;
+    uint16_t payload_length;
+    xtt_encapsulated_payload_type payload_type;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_decrypt_record(&payload,
+                                                    &payload_length,
+                                                    &payload_type,
+                                                    record,
+                                                    record_length,
+                                                    &receiver));
+    EXPECT_EQ(XTT_ERROR_RECORD_REPLAYED, xtt_decrypt_record(&payload,
+                                                            &payload_length,
+                                                            &payload_type,
+                                                            copy,
+                                                            record_length,
+                                                            &receiver));
+
+    struct xtt_session_stats stats;
+    xtt_session_context_get_stats(&stats, &receiver);
+    EXPECT_EQ(stats.replayed_records, 1);
+    EXPECT_EQ(stats.too_old_records, 0);
+
+    printf("ok\n");
+}
+
+void other_sessions_record_fails(void)
+{
+    printf("starting record-test::other_sessions_record_fails...\n");
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    struct xtt_session_context other_sender;
+    struct xtt_session_context other_receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+    make_session_pair(&other_sender, &other_receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    unsigned char record[16 + XTT_RECORD_OVERHEAD] = {0};
+    uint16_t record_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(record, &record_length, 16, XTT_ENCAPSULATED_QUEUE_PROTO, &other_sender));
+
+    unsigned char *payload;
+    uint16_t payload_length;
+    xtt_encapsulated_payload_type payload_type;
+    EXPECT_EQ(XTT_ERROR_RECORD_FAILED_CRYPTO, xtt_decrypt_record(&payload,
+                                                                 &payload_length,
+                                                                 &payload_type,
+                                                                 record,
+                                                                 record_length,
+                                                                 &receiver));
+
+    printf("ok\n");
+}
+
+void starts_with_fresh_keys(void)
+{
+    printf("starting record-test::starts_with_fresh_keys...\n");
+
+    struct xtt_client_handshake_context handshake_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_client_handshake_context(&handshake_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B)));
+    handshake_ctx.base.tx_sequence_num = 2;
+    handshake_ctx.base.rx_sequence_num = 1;
+    EXPECT_EQ(0, xtt_crypto_get_random(handshake_ctx.base.session_secret, sizeof(handshake_ctx.base.session_secret)));
+    memset(&handshake_ctx.base.tx_key, 0, sizeof(handshake_ctx.base.tx_key));
+    memset(&handshake_ctx.base.rx_key, 0, sizeof(handshake_ctx.base.rx_key));
+
+    xtt_session_id session_id = {{0}};
+    struct xtt_session_context session_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_context(&session_ctx, &session_id, &handshake_ctx.base, XTT_RECORD_REPLAY_WINDOW_MAX_WORDS));
+    EXPECT_EQ(session_ctx.tx_sequence_num, 0);
+    EXPECT_EQ(session_ctx.rx_sequence_num, 0);
+    EXPECT_NE(0, memcmp(&session_ctx.tx_key, &handshake_ctx.base.tx_key, sizeof(session_ctx.tx_key)));
+    EXPECT_NE(0, memcmp(&session_ctx.rx_key, &handshake_ctx.base.rx_key, sizeof(session_ctx.rx_key)));
+    EXPECT_NE(0, memcmp(&session_ctx.tx_key, &session_ctx.rx_key, sizeof(session_ctx.tx_key)));
+
+    // Another session (id) from the same handshake gets other keys.
+    session_id.data[0] = 1;
+    struct xtt_session_context other_session_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_context(&other_session_ctx, &session_id, &handshake_ctx.base, XTT_RECORD_REPLAY_WINDOW_MAX_WORDS));
+    EXPECT_NE(0, memcmp(&session_ctx.tx_key, &other_session_ctx.tx_key, sizeof(session_ctx.tx_key)));
+
+    printf("ok\n");
+}
+
+void scatter_gather_round_trip(void)
+{
+    printf("starting record-test::scatter_gather_round_trip...\n");
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    char part_one[] = "telemetry ";
+    char part_two[] = "in ";
+    char part_three[] = "fragments";
+    struct iovec payload_iov[] = {
+        {.iov_base = part_one, .iov_len = strlen(part_one)},
+        {.iov_base = part_two, .iov_len = strlen(part_two)},
+        {.iov_base = part_three, .iov_len = strlen(part_three)},
+    };
+    const char *whole = "telemetry in fragments";
+    uint16_t whole_length = strlen(whole);
+
+    unsigned char record[64];
+    uint16_t record_length;
+
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH, xtt_encrypt_record_iov(record,
+                                                                 &record_length,
+                                                                 whole_length + XTT_RECORD_OVERHEAD - 1,
+                                                                 payload_iov,
+                                                                 3,
+                                                                 XTT_ENCAPSULATED_QUEUE_PROTO,
+                                                                 &sender));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record_iov(record,
+                                                        &record_length,
+                                                        sizeof(record),
+                                                        payload_iov,
+                                                        3,
+                                                        XTT_ENCAPSULATED_QUEUE_PROTO,
+                                                        &sender));
+    EXPECT_EQ(record_length, whole_length + XTT_RECORD_OVERHEAD);
+
+    // Too little room: the record is left alone, to be retried.
+    unsigned char out_one[8];
+    unsigned char out_two[32];
+    struct iovec out_iov[] = {
+        {.iov_base = out_one, .iov_len = sizeof(out_one)},
+        {.iov_base = out_two, .iov_len = sizeof(out_two)},
+    };
+    uint16_t payload_length;
+    xtt_encapsulated_payload_type payload_type;
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH, xtt_decrypt_record_iov(out_iov,
+                                                                 1,
+                                                                 &payload_length,
+                                                                 &payload_type,
+                                                                 record,
+                                                                 record_length,
+                                                                 &receiver));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_decrypt_record_iov(out_iov,
+                                                        2,
+                                                        &payload_length,
+                                                        &payload_type,
+                                                        record,
+                                                        record_length,
+                                                        &receiver));
+    EXPECT_EQ(payload_length, whole_length);
+    EXPECT_EQ(payload_type, XTT_ENCAPSULATED_QUEUE_PROTO);
+    EXPECT_EQ(0, memcmp(out_one, whole, sizeof(out_one)));
+    EXPECT_EQ(0, memcmp(out_two, whole + sizeof(out_one), whole_length - sizeof(out_one)));
+
+    printf("ok\n");
+}
+
+void batch_reports_each_record(void)
+{
+    printf("starting record-test::batch_reports_each_record...\n");
+
+    struct xtt_session_context senders[2];
+    struct xtt_session_context receivers[2];
+    make_session_pair(&senders[0], &receivers[0], available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+    make_session_pair(&senders[1],
+                      &receivers[1],
+                      xtt_crypto_suite_available(XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B) ? XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B
+                                                                                           : available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B),
+                      XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    enum {ITEM_COUNT = 6};
+    unsigned char records[ITEM_COUNT][8 + XTT_RECORD_OVERHEAD];
+    struct xtt_record_batch_item items[ITEM_COUNT];
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        memset(records[i] + XTT_RECORD_HEADER_LENGTH, i, 8);
+        items[i].ctx = &senders[i % 2];
+        items[i].record = records[i];
+        items[i].payload_length = 8;
+        items[i].payload_type = XTT_ENCAPSULATED_IPV6;
+    }
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_records(items, ITEM_COUNT));
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        EXPECT_EQ(items[i].status, XTT_ERROR_SUCCESS);
+        EXPECT_EQ(items[i].record_length, 8 + XTT_RECORD_OVERHEAD);
+        items[i].ctx = &receivers[i % 2];
+    }
+
+    // Corrupt one record: only it fails.
+    records[2][XTT_RECORD_HEADER_LENGTH] ^= 0x80;
+
+    EXPECT_EQ(XTT_ERROR_RECORD_FAILED_CRYPTO, xtt_decrypt_records(items, ITEM_COUNT));
+    for (int i = 0; i < ITEM_COUNT; ++i) {
+        if (2 == i) {
+            EXPECT_EQ(items[i].status, XTT_ERROR_RECORD_FAILED_CRYPTO);
+            continue;
+        }
+        EXPECT_EQ(items[i].status, XTT_ERROR_SUCCESS);
+        EXPECT_EQ(items[i].payload_length, 8);
+        EXPECT_EQ(items[i].payload[0], i);
+    }
+
+    printf("ok\n");
+}
+
+xtt_error_code
+decrypt_copy(const unsigned char *record,
+             uint16_t record_length,
+             struct xtt_session_context *receiver)
+{
+    unsigned char copy[16 + XTT_RECORD_OVERHEAD];
+    memcpy(copy, record, record_length);
+
+    unsigned char *payload;
+    uint16_t payload_length;
+    xtt_encapsulated_payload_type payload_type;
+    return xtt_decrypt_record(&payload, &payload_length, &payload_type, copy, record_length, receiver);
+}
+
+void out_of_order_within_window(void)
+{
+    printf("starting record-test::out_of_order_within_window...\n");
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    enum {RECORD_COUNT = 200};
+    static unsigned char records[RECORD_COUNT][16 + XTT_RECORD_OVERHEAD];
+    uint16_t record_length;
+    for (int i = 0; i < RECORD_COUNT; ++i) {
+        memset(records[i], 0, sizeof(records[i]));
+        EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(records[i], &record_length, 16, XTT_ENCAPSULATED_IPV6, &sender));
+    }
+
+    // Newest first, then the rest in reverse, each accepted exactly once.
+    for (int i = RECORD_COUNT - 1; i >= 0; --i) {
+        EXPECT_EQ(XTT_ERROR_SUCCESS, decrypt_copy(records[i], record_length, &receiver));
+        EXPECT_EQ(XTT_ERROR_RECORD_REPLAYED, decrypt_copy(records[i], record_length, &receiver));
+    }
+    EXPECT_EQ(receiver.rx_sequence_num, RECORD_COUNT);
+
+    struct xtt_session_stats stats;
+    xtt_session_context_get_stats(&stats, &receiver);
+    EXPECT_EQ(stats.replayed_records, RECORD_COUNT);
+    EXPECT_EQ(stats.too_old_records, 0);
+    EXPECT_EQ(stats.replay_window_size, (XTT_RECORD_REPLAY_WINDOW_MAX_WORDS - 1) * 64);
+
+    printf("ok\n");
+}
+
+void too_old_record_fails(void)
+{
+    printf("starting record-test::too_old_record_fails...\n");
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    unsigned char oldest[16 + XTT_RECORD_OVERHEAD] = {0};
+    uint16_t record_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(oldest, &record_length, 16, XTT_ENCAPSULATED_IPV6, &sender));
+
+    // Jump well past the window.
+    sender.tx_sequence_num += (XTT_RECORD_REPLAY_WINDOW_MAX_WORDS + 1) * 64;
+
+    unsigned char newest[16 + XTT_RECORD_OVERHEAD] = {0};
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(newest, &record_length, 16, XTT_ENCAPSULATED_IPV6, &sender));
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, decrypt_copy(newest, record_length, &receiver));
+    EXPECT_EQ(XTT_ERROR_RECORD_TOO_OLD, decrypt_copy(oldest, record_length, &receiver));
+
+    struct xtt_session_stats stats;
+    xtt_session_context_get_stats(&stats, &receiver);
+    EXPECT_EQ(stats.replayed_records, 0);
+    EXPECT_EQ(stats.too_old_records, 1);
+
+    printf("ok\n");
+}
+
+void replay_window_width_is_per_session(void)
+{
+    printf("starting record-test::replay_window_width_is_per_session...\n");
+
+    struct xtt_client_handshake_context handshake_ctx;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_client_handshake_context(&handshake_ctx,
+                                                                         XTT_VERSION_ONE,
+                                                                         available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512)));
+    xtt_session_id session_id = {{0}};
+    struct xtt_session_context session_ctx;
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH, xtt_initialize_session_context(&session_ctx, &session_id, &handshake_ctx.base, 1));
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH, xtt_initialize_session_context(&session_ctx, &session_id, &handshake_ctx.base, 3));
+    EXPECT_EQ(XTT_ERROR_INCORRECT_LENGTH, xtt_initialize_session_context(&session_ctx,
+                                                                         &session_id,
+                                                                         &handshake_ctx.base,
+                                                                         2 * XTT_RECORD_REPLAY_WINDOW_MAX_WORDS));
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender, &receiver, available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512), 2);
+
+    struct xtt_session_stats stats;
+    xtt_session_context_get_stats(&stats, &receiver);
+    EXPECT_EQ(stats.replay_window_size, 64);
+
+    // Just past the narrow window, though well within the widest one.
+    unsigned char oldest[16 + XTT_RECORD_OVERHEAD] = {0};
+    uint16_t record_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(oldest, &record_length, 16, XTT_ENCAPSULATED_IPV6, &sender));
+    sender.tx_sequence_num += 64;
+
+    unsigned char newest[16 + XTT_RECORD_OVERHEAD] = {0};
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(newest, &record_length, 16, XTT_ENCAPSULATED_IPV6, &sender));
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, decrypt_copy(newest, record_length, &receiver));
+    EXPECT_EQ(XTT_ERROR_RECORD_TOO_OLD, decrypt_copy(oldest, record_length, &receiver));
+
+    printf("ok\n");
+}
@@ -0,0 +1,214 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define THREAD_COUNT 4
+#define RECORDS_PER_THREAD 100
+
+static uint64_t round_trip_records(uint32_t record_count);
+static void* round_trip_many(void *arg);
+static void bucket_bounds_increase(void);
+static void percentile_reads_buckets(void);
+static void snapshot_counts_records_and_errors(void);
+static void snapshot_merges_threads(void);
+
+int main()
+{
+    EXPECT_EQ(0, xtt_crypto_initialize_crypto());
+
+    bucket_bounds_increase();
+    percentile_reads_buckets();
+    snapshot_counts_records_and_errors();
+    snapshot_merges_threads();
+}
+
+uint64_t round_trip_records(uint32_t record_count)
+{
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender,
+                      &receiver,
+                      available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512),
+                      XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+
+    uint64_t failures = 0;
+    for (uint32_t i = 0; i < record_count; ++i) {
+        unsigned char record[32 + XTT_RECORD_OVERHEAD] = {0};
+        uint16_t record_length;
+        if (XTT_ERROR_SUCCESS != xtt_encrypt_record(record, &record_length, 32, XTT_ENCAPSULATED_QUEUE_PROTO, &sender))
+            ++failures;
+
+        unsigned char *payload;
+        uint16_t payload_length;
+        xtt_encapsulated_payload_type payload_type;
+        if (XTT_ERROR_SUCCESS != xtt_decrypt_record(&payload, &payload_length, &payload_type, record, record_length, &receiver))
+            ++failures;
+    }
+
+    return failures;
+}
+
+void* round_trip_many(void *arg)
+{
+    (void)arg;
+
+    if (0 != round_trip_records(RECORDS_PER_THREAD))
+        return (void*)1;
+
+    return NULL;
+}
+
+void bucket_bounds_increase(void)
+{
+    printf("starting stats-test::bucket_bounds_increase...\n");
+
+    // Exact below the linear range...
+    for (uint32_t i = 0; i < XTT_STATS_HISTOGRAM_LINEAR_BUCKETS; ++i)
+        EXPECT_EQ(xtt_stats_bucket_upper_bound(i), i);
+
+    // ...then never more than 1/8th wide.
+    for (uint32_t i = XTT_STATS_HISTOGRAM_LINEAR_BUCKETS; i < XTT_STATS_HISTOGRAM_BUCKETS - 1; ++i) {
+        uint64_t lower = xtt_stats_bucket_upper_bound(i - 1) + 1;
+        uint64_t upper = xtt_stats_bucket_upper_bound(i);
+        TEST_ASSERT(upper >= lower);
+        TEST_ASSERT((upper - lower + 1) * XTT_STATS_HISTOGRAM_SUB_BUCKETS <= lower);
+    }
+
+    EXPECT_EQ(xtt_stats_bucket_upper_bound(XTT_STATS_HISTOGRAM_BUCKETS - 1), UINT64_MAX);
+
+    printf("ok\n");
+}
+
+void percentile_reads_buckets(void)
+{
+    printf("starting stats-test::percentile_reads_buckets...\n");
+
+    struct xtt_stats_histogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    EXPECT_EQ(xtt_stats_percentile(&histogram, 0.5), 0);
+
+    // 90 samples of 5ns, and 10 of 1000ns (whose bucket is [960, 1023]).
+    histogram.buckets[5] = 90;
+    histogram.buckets[63] = 10;
+    histogram.count = 100;
+    histogram.total_ns = 90 * 5 + 10 * 1000;
+    histogram.max_ns = 1000;
+    EXPECT_EQ(xtt_stats_bucket_upper_bound(62), 959);
+    EXPECT_EQ(xtt_stats_bucket_upper_bound(63), 1023);
+
+    EXPECT_EQ(xtt_stats_percentile(&histogram, 0.0), 5);
+    EXPECT_EQ(xtt_stats_percentile(&histogram, 0.5), 5);
+    EXPECT_EQ(xtt_stats_percentile(&histogram, 0.9), 5);
+    EXPECT_EQ(xtt_stats_percentile(&histogram, 0.91), 1000);    // (Capped at the max.)
+    EXPECT_EQ(xtt_stats_percentile(&histogram, 1.0), 1000);
+
+    printf("ok\n");
+}
+
+void snapshot_counts_records_and_errors(void)
+{
+    printf("starting stats-test::snapshot_counts_records_and_errors...\n");
+
+    EXPECT_EQ(XTT_ERROR_NULL_BUFFER, xtt_stats_snapshot(NULL));
+
+    struct xtt_stats before;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_stats_snapshot(&before));
+
+    EXPECT_EQ(0, round_trip_records(3));
+
+    struct xtt_session_context sender;
+    struct xtt_session_context receiver;
+    make_session_pair(&sender,
+                      &receiver,
+                      available_suite_or_default(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512),
+                      XTT_RECORD_REPLAY_WINDOW_MAX_WORDS);
+    unsigned char record[16 + XTT_RECORD_OVERHEAD] = {0};
+    uint16_t record_length;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_encrypt_record(record, &record_length, 16, XTT_ENCAPSULATED_QUEUE_PROTO, &sender));
+    record[XTT_RECORD_HEADER_LENGTH] ^= 0x01;
+    unsigned char *payload;
+    uint16_t payload_length;
+    xtt_encapsulated_payload_type payload_type;
+    EXPECT_EQ(XTT_ERROR_RECORD_FAILED_CRYPTO, xtt_decrypt_record(&payload, &payload_length, &payload_type, record, record_length, &receiver));
+
+    struct xtt_stats after;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_stats_snapshot(&after));
+
+    if (after.enabled) {
+        const struct xtt_stats_histogram *aead = &after.phases[XTT_STATS_PHASE_AEAD];
+
+        // 4 seals and 4 opens (one of which failed).
+        EXPECT_EQ(aead->count - before.phases[XTT_STATS_PHASE_AEAD].count, 8);
+        TEST_ASSERT(aead->total_ns >= before.phases[XTT_STATS_PHASE_AEAD].total_ns);
+        TEST_ASSERT(aead->max_ns <= xtt_stats_percentile(aead, 1.0));
+        TEST_ASSERT(xtt_stats_percentile(aead, 0.5) <= aead->max_ns);
+
+        uint64_t bucketed = 0;
+        for (uint32_t i = 0; i < XTT_STATS_HISTOGRAM_BUCKETS; ++i)
+            bucketed += aead->buckets[i];
+        EXPECT_EQ(bucketed, aead->count);
+
+        EXPECT_EQ(after.errors[XTT_ERROR_RECORD_FAILED_CRYPTO] - before.errors[XTT_ERROR_RECORD_FAILED_CRYPTO], 1);
+        EXPECT_EQ(after.errors[XTT_ERROR_SUCCESS], 0);
+        TEST_ASSERT(after.threads >= 1);
+    } else {
+        // Compiled out: always empty.
+        EXPECT_EQ(after.threads, 0);
+        for (uint32_t phase = 0; phase < XTT_STATS_PHASE_COUNT; ++phase)
+            EXPECT_EQ(after.phases[phase].count, 0);
+        for (uint32_t code = 0; code < XTT_ERROR_CODE_COUNT; ++code)
+            EXPECT_EQ(after.errors[code], 0);
+    }
+
+    printf("ok\n");
+}
+
+void snapshot_merges_threads(void)
+{
+    printf("starting stats-test::snapshot_merges_threads...\n");
+
+    struct xtt_stats before;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_stats_snapshot(&before));
+
+    pthread_t threads[THREAD_COUNT];
+    for (int i = 0; i < THREAD_COUNT; ++i)
+        EXPECT_EQ(0, pthread_create(&threads[i], NULL, round_trip_many, NULL));
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+        void *failed;
+        EXPECT_EQ(0, pthread_join(threads[i], &failed));
+        TEST_ASSERT(NULL == failed);
+    }
+
+    struct xtt_stats after;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_stats_snapshot(&after));
+
+    if (after.enabled) {
+        EXPECT_EQ(after.phases[XTT_STATS_PHASE_AEAD].count - before.phases[XTT_STATS_PHASE_AEAD].count,
+                  2 * THREAD_COUNT * RECORDS_PER_THREAD);
+        EXPECT_EQ(after.threads - before.threads, THREAD_COUNT);
+    }
+
+    printf("ok\n");
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+ *
+ * Copyright 2018 Xaptum, Inc.
+ * 
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ * 
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License
+ *
+ *****************************************************************************/
+
+#include <xtt.h>
+
+#include "test-utils.h"
+
+#include <string.h>
+#include <stdio.h>
+
+static void chacha_suites_always_available(void);
+static void host_preferences_sorted_by_cost(void);
+static void choose_cheapest_for_both_ends(void);
+static void choose_fails_without_common_suite(void);
+static void unavailable_suite_refused(void);
+
+int main()
+{
+    EXPECT_EQ(0, xtt_crypto_initialize_crypto());
+
+    chacha_suites_always_available();
+    host_preferences_sorted_by_cost();
+    choose_cheapest_for_both_ends();
+    choose_fails_without_common_suite();
+    unavailable_suite_refused();
+}
+
+void chacha_suites_always_available(void)
+{
+    printf("starting suite_preferences-test::chacha_suites_always_available...\n");
+    SKIP_UNLESS_SUITE_AVAILABLE(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512);
+    SKIP_UNLESS_SUITE_AVAILABLE(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B);
+
+    EXPECT_EQ(1, xtt_crypto_suite_available(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512));
+    EXPECT_EQ(1, xtt_crypto_suite_available(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B));
+    EXPECT_EQ(0, xtt_crypto_suite_available((xtt_suite_spec)0x7777));
+
+    EXPECT_EQ(100, xtt_crypto_suite_cost(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512));
+    EXPECT_EQ(UINT32_MAX, xtt_crypto_suite_cost((xtt_suite_spec)0x7777));
+
+    int aes_available = xtt_crypto_aead_aes256_is_available();
+    EXPECT_EQ(aes_available, xtt_crypto_suite_available(XTT_X25519_LRSW_ED25519_AES256GCM_SHA512));
+    EXPECT_EQ(aes_available, xtt_crypto_suite_available(XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B));
+
+    printf("ok\n");
+}
+
+void host_preferences_sorted_by_cost(void)
+{
+    printf("starting suite_preferences-test::host_preferences_sorted_by_cost...\n");
+
+    struct xtt_suite_preferences preferences;
+    xtt_suite_preferences_from_host(&preferences);
+
+    const xtt_suite_spec all_suites[] = {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512,
+                                         XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B,
+                                         XTT_X25519_LRSW_ED25519_AES256GCM_SHA512,
+                                         XTT_X25519_LRSW_ED25519_AES256GCM_BLAKE2B};
+    uint16_t expected_count = 0;
+    for (size_t i = 0; i < sizeof(all_suites) / sizeof(all_suites[0]); ++i)
+        expected_count += xtt_crypto_suite_available(all_suites[i]);
+    TEST_ASSERT(expected_count > 0);
+    EXPECT_EQ(expected_count, preferences.count);
+
+    for (uint16_t i = 0; i < preferences.count; ++i) {
+        EXPECT_EQ(1, xtt_crypto_suite_available(preferences.suite_specs[i]));
+        EXPECT_EQ(xtt_crypto_suite_cost(preferences.suite_specs[i]), preferences.costs[i]);
+        if (i > 0)
+            TEST_ASSERT(preferences.costs[i - 1] <= preferences.costs[i]);
+    }
+
+    EXPECT_EQ(1, xtt_suite_preferences_allow(&preferences, preferences.suite_specs[0]));
+    EXPECT_EQ(0, xtt_suite_preferences_allow(&preferences, (xtt_suite_spec)0x7777));
+
+    printf("ok\n");
+}
+
+void choose_cheapest_for_both_ends(void)
+{
+    printf("starting suite_preferences-test::choose_cheapest_for_both_ends...\n");
+    SKIP_UNLESS_SUITE_AVAILABLE(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512);
+    SKIP_UNLESS_SUITE_AVAILABLE(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B);
+
+    uint32_t sha512_cost = xtt_crypto_suite_cost(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512);
+    uint32_t blake2b_cost = xtt_crypto_suite_cost(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B);
+
+    // The server finds BLAKE2b a little more expensive, but not by as much as we find it cheaper.
+    struct xtt_suite_preferences server_preferences = {
+        .suite_specs = {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512,
+                        XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B},
+        .costs = {100, 101},
+        .count = 2
+    };
+
+    xtt_suite_spec chosen;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_choose_suite(&chosen, &server_preferences, NULL));
+    if (blake2b_cost + 1 < sha512_cost) {
+        EXPECT_EQ(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B, chosen);
+    } else {
+        EXPECT_EQ(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512, chosen);
+    }
+
+    // If it's much more expensive for the server, the server's choice wins.
+    server_preferences.costs[1] = 1000;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_choose_suite(&chosen, &server_preferences, NULL));
+    EXPECT_EQ(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512, chosen);
+
+    // Our own measured costs replace the defaults...
+    struct xtt_suite_preferences client_preferences = {
+        .suite_specs = {XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_SHA512,
+                        XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B},
+        .costs = {2000, 10},
+        .count = 2
+    };
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_choose_suite(&chosen, &server_preferences, &client_preferences));
+    EXPECT_EQ(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B, chosen);
+
+    // ...and a suite we have no cost for isn't chosen.
+    client_preferences.suite_specs[0] = XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B;
+    client_preferences.costs[0] = 2000;
+    client_preferences.count = 1;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_choose_suite(&chosen, &server_preferences, &client_preferences));
+    EXPECT_EQ(XTT_X25519_LRSW_ED25519_CHACHA20POLY1305_BLAKE2B, chosen);
+
+    printf("ok\n");
+}
+
+void choose_fails_without_common_suite(void)
+{
+    printf("starting suite_preferences-test::choose_fails_without_common_suite...\n");
+
+    struct xtt_suite_preferences server_preferences = {
+        .suite_specs = {(xtt_suite_spec)0x7777},
+        .costs = {1},
+        .count = 1
+    };
+
+    xtt_suite_spec chosen;
+    EXPECT_EQ(XTT_ERROR_UNKNOWN_SUITE_SPEC, xtt_choose_suite(&chosen, &server_preferences, NULL));
+
+    server_preferences.count = 0;
+    EXPECT_EQ(XTT_ERROR_UNKNOWN_SUITE_SPEC, xtt_choose_suite(&chosen, &server_preferences, NULL));
+
+    EXPECT_EQ(XTT_ERROR_NULL_BUFFER, xtt_choose_suite(NULL, &server_preferences, NULL));
+
+    printf("ok\n");
+}
+
+void unavailable_suite_refused(void)
+{
+    printf("starting suite_preferences-test::unavailable_suite_refused...\n");
+
+    struct xtt_client_handshake_context ctx;
+    // Without hardware AES, or in a build fixed to another suite.
+    xtt_error_code expected = xtt_crypto_suite_available(XTT_X25519_LRSW_ED25519_AES256GCM_SHA512) ? XTT_ERROR_SUCCESS
+                                                                                                   : XTT_ERROR_UNKNOWN_CRYPTO_SPEC;
+    if (!xtt_crypto_aead_aes256_is_available())
+        EXPECT_EQ(XTT_ERROR_UNKNOWN_CRYPTO_SPEC, expected);
+    EXPECT_EQ(expected, xtt_initialize_client_handshake_context(&ctx,
+                                                                XTT_VERSION_ONE,
+                                                                XTT_X25519_LRSW_ED25519_AES256GCM_SHA512));
+
+    printf("ok\n");
+}
@@ -18,6 +18,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <xtt.h>
 
 #define TEST_ASSERT(cond) \
     do \
@@ -49,3 +52,73 @@
         } \
     } while(0);
 
+
+/*
+ * For cases about one particular suite: skip the case (from a void function)
+ * if this build or CPU doesn't have it, e.g. in a build with XTT_FIXED_SUITE.
+ */
+#define SKIP_UNLESS_SUITE_AVAILABLE(suite_spec) \
+    do \
+    { \
+        if (!xtt_crypto_suite_available(suite_spec)) { \
+            printf("skipped (suite %#x not available)\n", (unsigned)(suite_spec)); \
+            return; \
+        } \
+    } while(0);
+
+/*
+ * For cases that just need a handshake: `suite_spec` if it's available,
+ * or else the cheapest suite that is.
+ */
+static inline xtt_suite_spec available_suite_or_default(xtt_suite_spec suite_spec)
+{
+    if (xtt_crypto_suite_available(suite_spec))
+        return suite_spec;
+
+    struct xtt_suite_preferences preferences;
+    xtt_suite_preferences_from_host(&preferences);
+    TEST_ASSERT(preferences.count > 0);
+    return preferences.suite_specs[0];
+}
+
+/*
+ * The tests' group ID for a GPK: the first 32 bytes of its SHA-512,
+ * hashed by the current crypto provider (so tests need no crypto library of their own).
+ */
+static inline int group_id_from_gpk(xtt_daa_group_id *gid, const xtt_daa_group_pub_key_lrsw *gpk)
+{
+    xtt_sha512 digest;
+    uint16_t digest_length;
+
+    if (0 != xtt_crypto_hash_sha512(digest.data, &digest_length, gpk->data, sizeof(*gpk)))
+        return -1;
+
+    memcpy(gid->data, digest.data, sizeof(gid->data));
+
+    return 0;
+}
+
+/*
+ * A connected pair of record-layer sessions, as a client (`sender`) and server (`receiver`) would have
+ * at the end of a handshake, each with a replay window `replay_window_words` wide.
+ */
+static inline void make_session_pair(struct xtt_session_context *sender,
+                                     struct xtt_session_context *receiver,
+                                     xtt_suite_spec suite_spec,
+                                     uint16_t replay_window_words)
+{
+    struct xtt_client_handshake_context client;
+    struct xtt_server_handshake_context server;
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_client_handshake_context(&client, XTT_VERSION_ONE, suite_spec));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_server_handshake_context(&server, XTT_VERSION_ONE, suite_spec));
+
+    // A stand-in for the session secret a handshake would have derived.
+    EXPECT_EQ(0, xtt_crypto_get_random(client.base.session_secret, sizeof(client.base.session_secret)));
+    memcpy(server.base.session_secret, client.base.session_secret, sizeof(client.base.session_secret));
+
+    xtt_session_id session_id;
+    EXPECT_EQ(0, xtt_crypto_get_random(session_id.data, sizeof(session_id)));
+
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_context(sender, &session_id, &client.base, replay_window_words));
+    EXPECT_EQ(XTT_ERROR_SUCCESS, xtt_initialize_session_context(receiver, &session_id, &server.base, replay_window_words));
+}
@@ -12,6 +12,10 @@ void x25519_keys_independent();
 void dh_gives_same_secret();
 void bad_dh_fails();
 void good_ed25519_sign_succeeds();
+void ed25519_batch_verify_finds_bad_signature();
+void ed25519_batch_verify_rejects_small_order_key();
+void prf_midstate_matches_one_shot();
+void aes256_expanded_key_matches();
 void do_sign();
 
 void initialize() {
@@ -28,6 +32,10 @@ int main() {
     dh_gives_same_secret();
     bad_dh_fails();
     good_ed25519_sign_succeeds();
+    ed25519_batch_verify_finds_bad_signature();
+    ed25519_batch_verify_rejects_small_order_key();
+    prf_midstate_matches_one_shot();
+    aes256_expanded_key_matches();
     do_sign();
 }
 
@@ -153,6 +161,198 @@ void bad_dh_fails()
     printf("ok\n");
 }
 
+void ed25519_batch_verify_finds_bad_signature()
+{
+    printf("starting wrapper_sanity-test::ed25519_batch_verify_finds_bad_signature...\n");
+
+    // Enough to span several internal chunks,
+    // with two bad signatures in one chunk and another in the last.
+    enum { BATCH_SIZE = 40 };
+    int is_bad[BATCH_SIZE] = {0};
+    is_bad[17] = is_bad[21] = is_bad[39] = 1;
+    xtt_ed25519_pub_key pub_keys[BATCH_SIZE];
+    xtt_ed25519_priv_key priv_key;
+    xtt_ed25519_signature signatures[BATCH_SIZE];
+    unsigned char msgs[BATCH_SIZE][32];
+    struct xtt_ed25519_verify_item items[BATCH_SIZE];
+    int results[BATCH_SIZE];
+
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        EXPECT_EQ(xtt_crypto_create_ed25519_key_pair(&pub_keys[i], &priv_key), 0);
+        xtt_crypto_get_random(msgs[i], sizeof(msgs[i]));
+        EXPECT_EQ(xtt_crypto_sign_ed25519(signatures[i].data, msgs[i], sizeof(msgs[i]), &priv_key), 0);
+        items[i] = (struct xtt_ed25519_verify_item){.signature=signatures[i].data,
+                                                    .msg=msgs[i],
+                                                    .msg_len=sizeof(msgs[i]),
+                                                    .pub_key=&pub_keys[i]};
+    }
+
+    EXPECT_EQ(xtt_crypto_batch_verify_ed25519(results, items, BATCH_SIZE), 0);
+    for (int i = 0; i < BATCH_SIZE; ++i)
+        EXPECT_EQ(results[i], 0);
+
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        if (is_bad[i])
+            msgs[i][0] ^= 1;
+    }
+    EXPECT_NE(xtt_crypto_batch_verify_ed25519(results, items, BATCH_SIZE), 0);
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        if (is_bad[i]) {
+            EXPECT_NE(results[i], 0);
+        } else {
+            EXPECT_EQ(results[i], 0);
+        }
+    }
+
+    printf("ok\n");
+}
+
+void ed25519_batch_verify_rejects_small_order_key()
+{
+    printf("starting wrapper_sanity-test::ed25519_batch_verify_rejects_small_order_key...\n");
+
+    enum { BATCH_SIZE = 8, SMALL_ORDER_INDEX = 3 };
+    xtt_ed25519_pub_key pub_keys[BATCH_SIZE];
+    xtt_ed25519_priv_key priv_key;
+    xtt_ed25519_signature signatures[BATCH_SIZE];
+    unsigned char msgs[BATCH_SIZE][32];
+    struct xtt_ed25519_verify_item items[BATCH_SIZE];
+    int results[BATCH_SIZE];
+
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        EXPECT_EQ(xtt_crypto_create_ed25519_key_pair(&pub_keys[i], &priv_key), 0);
+        xtt_crypto_get_random(msgs[i], sizeof(msgs[i]));
+        EXPECT_EQ(xtt_crypto_sign_ed25519(signatures[i].data, msgs[i], sizeof(msgs[i]), &priv_key), 0);
+        items[i] = (struct xtt_ed25519_verify_item){.signature=signatures[i].data,
+                                                    .msg=msgs[i],
+                                                    .msg_len=sizeof(msgs[i]),
+                                                    .pub_key=&pub_keys[i]};
+    }
+
+    // The identity as public key and as R, with s = 0:
+    // s*B = R + h*A holds for any message, cofactored or not.
+    memset(pub_keys[SMALL_ORDER_INDEX].data, 0, sizeof(xtt_ed25519_pub_key));
+    pub_keys[SMALL_ORDER_INDEX].data[0] = 1;
+    memset(signatures[SMALL_ORDER_INDEX].data, 0, sizeof(xtt_ed25519_signature));
+    signatures[SMALL_ORDER_INDEX].data[0] = 1;
+
+    // libsodium rejects a small-order key on its own, OpenSSL doesn't;
+    // either way, the batch has to agree with the single verifier.
+    int single_result = xtt_crypto_verify_ed25519(signatures[SMALL_ORDER_INDEX].data,
+                                                  msgs[SMALL_ORDER_INDEX],
+                                                  sizeof(msgs[SMALL_ORDER_INDEX]),
+                                                  &pub_keys[SMALL_ORDER_INDEX]);
+
+    int batch_ret = xtt_crypto_batch_verify_ed25519(results, items, BATCH_SIZE);
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        if (SMALL_ORDER_INDEX == i && 0 != single_result) {
+            EXPECT_NE(results[i], 0);
+        } else {
+            EXPECT_EQ(results[i], 0);
+        }
+    }
+    if (0 != single_result) {
+        EXPECT_NE(batch_ret, 0);
+    } else {
+        EXPECT_EQ(batch_ret, 0);
+    }
+
+    printf("ok\n");
+}
+
+void prf_midstate_matches_one_shot()
+{
+    printf("starting wrapper_sanity-test::prf_midstate_matches_one_shot...\n");
+
+    unsigned char key[64];
+    unsigned char input[64 + 24];
+    xtt_crypto_get_random(key, sizeof(key));
+    xtt_crypto_get_random(input, sizeof(input));
+
+    // One prefix, two labels, at both a key and an IV length.
+    const uint16_t out_lengths[] = {32, 12};
+    for (size_t i = 0; i < sizeof(out_lengths) / sizeof(out_lengths[0]); ++i) {
+        uint16_t out_len = out_lengths[i];
+        unsigned char expected[64];
+        unsigned char actual[64];
+        xtt_prf_state prefix_state;
+        xtt_prf_state label_state;
+
+        EXPECT_EQ(xtt_crypto_prf_sha512_init(&prefix_state, out_len, key, sizeof(key)), 0);
+        EXPECT_EQ(xtt_crypto_prf_sha512_update(&prefix_state, input, 64), 0);
+        for (int label = 0; label < 2; ++label) {
+            input[64] = label;
+            EXPECT_EQ(xtt_crypto_prf_sha512(expected, out_len, input, sizeof(input), key, sizeof(key)), 0);
+            EXPECT_EQ(xtt_crypto_prf_copy(&label_state, &prefix_state), 0);
+            EXPECT_EQ(xtt_crypto_prf_sha512_update(&label_state, input + 64, sizeof(input) - 64), 0);
+            EXPECT_EQ(xtt_crypto_prf_sha512_final(actual, out_len, &label_state), 0);
+            EXPECT_EQ(memcmp(expected, actual, out_len), 0);
+        }
+        xtt_crypto_prf_release(&prefix_state);
+
+        EXPECT_EQ(xtt_crypto_prf_blake2b_init(&prefix_state, out_len, key, sizeof(key)), 0);
+        EXPECT_EQ(xtt_crypto_prf_blake2b_update(&prefix_state, input, 64), 0);
+        for (int label = 0; label < 2; ++label) {
+            input[64] = label;
+            EXPECT_EQ(xtt_crypto_prf_blake2b(expected, out_len, input, sizeof(input), key, sizeof(key)), 0);
+            EXPECT_EQ(xtt_crypto_prf_copy(&label_state, &prefix_state), 0);
+            EXPECT_EQ(xtt_crypto_prf_blake2b_update(&label_state, input + 64, sizeof(input) - 64), 0);
+            EXPECT_EQ(xtt_crypto_prf_blake2b_final(actual, out_len, &label_state), 0);
+            EXPECT_EQ(memcmp(expected, actual, out_len), 0);
+        }
+        xtt_crypto_prf_release(&prefix_state);
+    }
+
+    printf("ok\n");
+}
+
+void aes256_expanded_key_matches()
+{
+    printf("starting wrapper_sanity-test::aes256_expanded_key_matches...\n");
+
+    if (!xtt_crypto_aead_aes256_is_available()) {
+        xtt_aes256_key_schedule schedule;
+        xtt_aes256_key key = {{0}};
+        EXPECT_NE(xtt_crypto_aead_aes256_expand_key(&schedule, &key), 0);
+        printf("ok (AES-256-GCM not available)\n");
+        return;
+    }
+
+    xtt_aes256_key key;
+    xtt_aes256_nonce nonce;
+    xtt_aes256_key_schedule schedule;
+    unsigned char message[100];
+    unsigned char addl[13];
+    xtt_crypto_get_random(key.data, sizeof(key.data));
+    xtt_crypto_get_random(nonce.data, sizeof(nonce.data));
+    xtt_crypto_get_random(message, sizeof(message));
+    xtt_crypto_get_random(addl, sizeof(addl));
+
+    EXPECT_EQ(xtt_crypto_aead_aes256_expand_key(&schedule, &key), 0);
+
+    unsigned char ciphertext[sizeof(message)];
+    unsigned char ciphertext_expanded[sizeof(message)];
+    xtt_aes256_mac mac;
+    xtt_aes256_mac mac_expanded;
+    EXPECT_EQ(xtt_crypto_aead_aes256_encrypt_detached(ciphertext, mac.data, message, sizeof(message),
+                                                      addl, sizeof(addl), &nonce, &key), 0);
+    EXPECT_EQ(xtt_crypto_aead_aes256_encrypt_detached_expanded(ciphertext_expanded, mac_expanded.data, message, sizeof(message),
+                                                               addl, sizeof(addl), &nonce, &schedule), 0);
+    EXPECT_EQ(memcmp(ciphertext, ciphertext_expanded, sizeof(ciphertext)), 0);
+    EXPECT_EQ(memcmp(mac.data, mac_expanded.data, sizeof(mac)), 0);
+
+    unsigned char decrypted[sizeof(message)];
+    EXPECT_EQ(xtt_crypto_aead_aes256_decrypt_detached_expanded(decrypted, ciphertext, sizeof(ciphertext), mac.data,
+                                                               addl, sizeof(addl), &nonce, &schedule), 0);
+    EXPECT_EQ(memcmp(decrypted, message, sizeof(message)), 0);
+
+    mac.data[0] ^= 1;
+    EXPECT_NE(xtt_crypto_aead_aes256_decrypt_detached_expanded(decrypted, ciphertext, sizeof(ciphertext), mac.data,
+                                                               addl, sizeof(addl), &nonce, &schedule), 0);
+
+    printf("ok\n");
+}
+
 void good_ed25519_sign_succeeds()
 {
     printf("starting wrapper_sanity-test::good_ed25519_sign_succeeds...\n");